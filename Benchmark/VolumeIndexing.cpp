@@ -0,0 +1,156 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ThreadPool.hpp"
+#include "Volume.hpp"
+#include "VolumeFactory.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    using namespace DeferredRasterisation;
+
+    // Copy a linear volume into a volume of another layout.
+    template <typename VolumeType>
+    VolumeType Convert(const Volume& Source) {
+        VolumeType Target(Source.GetSize());
+        Source.ForEach([&](std::size_t X, std::size_t Y, std::size_t Z, const Voxel& Value) {
+            Target.Set(X, Y, Z, Value);
+        });
+        return Target;
+    }
+
+    // Surface detection, a voxel is on the surface if it is visible and a face touches an empty voxel or the edge of the volume.
+    template <typename VolumeType>
+    std::size_t CountSurface(const VolumeType& Source) {
+        const std::array<std::size_t, 3> Size = Source.GetSize();
+        std::size_t Count = 0;
+        Source.ForEach([&](std::size_t X, std::size_t Y, std::size_t Z, const Voxel& Value) {
+            if (Value.Alpha == 0) return;
+            Count += ((X == 0) || (Y == 0) || (Z == 0) || (X + 1 == Size[0]) || (Y + 1 == Size[1]) || (Z + 1 == Size[2])
+                || (Source(X - 1, Y, Z).Alpha == 0) || (Source(X + 1, Y, Z).Alpha == 0)
+                || (Source(X, Y - 1, Z).Alpha == 0) || (Source(X, Y + 1, Z).Alpha == 0)
+                || (Source(X, Y, Z - 1).Alpha == 0) || (Source(X, Y, Z + 1).Alpha == 0)) ? 1 : 0;
+        });
+        return Count;
+    }
+
+    // One relaxation step of light propagation, each voxel takes the brightest of its six neighbours less one.
+    template <typename VolumeType>
+    std::size_t Relax(const VolumeType& Source, VolumeType& Target) {
+        const std::array<std::size_t, 3> Size = Source.GetSize();
+        std::size_t Total = 0;
+        Source.ForEach([&](std::size_t X, std::size_t Y, std::size_t Z, const Voxel& Value) {
+            int Level = Value.Light;
+            if (X > 0) Level = std::max(Level, Source(X - 1, Y, Z).Light - 1);
+            if (Y > 0) Level = std::max(Level, Source(X, Y - 1, Z).Light - 1);
+            if (Z > 0) Level = std::max(Level, Source(X, Y, Z - 1).Light - 1);
+            if (X + 1 < Size[0]) Level = std::max(Level, Source(X + 1, Y, Z).Light - 1);
+            if (Y + 1 < Size[1]) Level = std::max(Level, Source(X, Y + 1, Z).Light - 1);
+            if (Z + 1 < Size[2]) Level = std::max(Level, Source(X, Y, Z + 1).Light - 1);
+            Voxel Lit = Value;
+            Lit.Light = static_cast<std::uint8_t>(Level);
+            Target.Set(X, Y, Z, Lit);
+            Total += static_cast<std::size_t>(Level);
+        });
+        return Total;
+    }
+
+    // Downsampling, each coarse voxel counts the non-empty voxels of the 2x2x2 cell below it.
+    template <typename VolumeType>
+    std::size_t Downsample(const VolumeType& Source) {
+        const std::array<std::size_t, 3> Size = Source.GetSize();
+        std::size_t Total = 0;
+        for (std::size_t Z = 0; Z < Size[2] / 2; ++Z) {
+            for (std::size_t Y = 0; Y < Size[1] / 2; ++Y) {
+                for (std::size_t X = 0; X < Size[0] / 2; ++X) {
+                    if constexpr (VolumeType::Indexing::ContiguousRows) {
+                        for (std::size_t Child = 0; Child < 8; ++Child) {
+                            Total += (Source(2 * X + (Child % 2), 2 * Y + ((Child / 2) % 2), 2 * Z + (Child / 4)).Alpha != 0) ? 1 : 0;
+                        }
+                    }
+                    else {
+                        // The cell is eight consecutive voxels.
+                        const Voxel* Cell = &Source(2 * X, 2 * Y, 2 * Z);
+                        for (std::size_t Child = 0; Child < 8; ++Child) {
+                            Total += (Cell[Child].Alpha != 0) ? 1 : 0;
+                        }
+                    }
+                }
+            }
+        }
+        return Total;
+    }
+
+    // Time the best of several runs of a workload in milliseconds, the result is kept so the work is not optimised away.
+    template <typename FunctionType>
+    double Time(FunctionType&& Function, std::size_t& Result) {
+        double Best = 1e30;
+        for (std::size_t Run = 0; Run < 5; ++Run) {
+            const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+            Result = Function();
+            Best = std::min(Best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count());
+        }
+        return Best;
+    }
+}
+
+// Time the neighbourhood workloads on the linear and Morton layouts of the same volume.
+int main(int ArgumentCount, char* ArgumentArray[]) {
+    const std::size_t Edge = (ArgumentCount > 1) ? static_cast<std::size_t>(std::atoi(ArgumentArray[1])) : 256;
+    std::cout << "Volume:   " << Edge << "x" << Edge / 4 << "x" << Edge << std::endl;
+
+    const Volume Linear = VolumeFactory::CreateRandomSponge(Edge, Edge / 4, Edge, 0.5, 1, Voxel(200, 100, 50, 255));
+    const MortonVolume Morton = Convert<MortonVolume>(Linear);
+    Volume LinearLit(Linear.GetSize());
+    MortonVolume MortonLit(Morton.GetSize());
+
+    auto Report = [](const char* Name, double LinearTime, double MortonTime, std::size_t LinearResult, std::size_t MortonResult) {
+        std::cout << std::left << std::setw(12) << Name << std::right << std::fixed << std::setprecision(2)
+                  << " linear " << std::setw(8) << LinearTime << " ms"
+                  << "  morton " << std::setw(8) << MortonTime << " ms"
+                  << "  speedup " << std::setw(5) << LinearTime / MortonTime << "x"
+                  << ((LinearResult == MortonResult) ? "" : "  MISMATCH") << std::endl;
+    };
+
+    std::size_t LinearResult = 0;
+    std::size_t MortonResult = 0;
+    double LinearTime = Time([&]() { return CountSurface(Linear); }, LinearResult);
+    double MortonTime = Time([&]() { return CountSurface(Morton); }, MortonResult);
+    Report("Surface", LinearTime, MortonTime, LinearResult, MortonResult);
+
+    LinearTime = Time([&]() { return Relax(Linear, LinearLit); }, LinearResult);
+    MortonTime = Time([&]() { return Relax(Morton, MortonLit); }, MortonResult);
+    Report("Light", LinearTime, MortonTime, LinearResult, MortonResult);
+
+    LinearTime = Time([&]() { return Downsample(Linear); }, LinearResult);
+    MortonTime = Time([&]() { return Downsample(Morton); }, MortonResult);
+    Report("Downsample", LinearTime, MortonTime, LinearResult, MortonResult);
+
+    return EXIT_SUCCESS;
+}
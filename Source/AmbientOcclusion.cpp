@@ -0,0 +1,175 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "AmbientOcclusion.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace DeferredRasterisation {
+    namespace {
+        /// @brief  Count the set bits of a word.
+        inline std::size_t PopCount(std::uint64_t Word) {
+            #if defined(__GNUC__)
+                return static_cast<std::size_t>(__builtin_popcountll(Word));
+            #else
+                Word = Word - ((Word >> 1) & 0x5555555555555555ull);
+                Word = (Word & 0x3333333333333333ull) + ((Word >> 2) & 0x3333333333333333ull);
+                Word = (Word + (Word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+                return static_cast<std::size_t>((Word * 0x0101010101010101ull) >> 56);
+            #endif
+        }
+    }
+
+    static_assert(AmbientOcclusion::Radius <= BrickSize, "The cube around a voxel is expected to reach no further than the neighbouring bricks.");
+
+    // Nothing to follow yet.
+    AmbientOcclusion::AmbientOcclusion(void)
+        : Size({{0, 0, 0}})
+        , Version(0) {
+    }
+
+    // Bake the changed bricks and every brick touching them.
+    void AmbientOcclusion::Update(const Volume& Source, const OccupancyBitPlane& Occupancy) {
+        assert(Occupancy.GetSize() == Source.GetSize());
+        Source.Drain(this->Cursor, this->DirtyBricks);
+
+        const std::array<std::size_t, 3>& BrickCount = Source.GetBrickCount();
+        const std::size_t Count = BrickCount[0] * BrickCount[1] * BrickCount[2];
+        this->BakeBricks.clear();
+        if (Source.GetSize() != this->Size) {
+            // A new size bakes everything.
+            this->Size = Source.GetSize();
+            this->Occlusion.assign(this->Size[0] * this->Size[1] * this->Size[2], 0);
+            this->Queued.assign(Count, 0);
+            for (std::size_t Brick = 0; Brick < Count; ++Brick) {
+                this->BakeBricks.push_back(Brick);
+            }
+        }
+        else {
+            if (this->DirtyBricks.empty()) return;
+            for (std::size_t Brick : this->DirtyBricks) {
+                const std::array<std::size_t, 3> Centre = {{Brick % BrickCount[0], (Brick / BrickCount[0]) % BrickCount[1], Brick / (BrickCount[0] * BrickCount[1])}};
+                for (std::size_t IndexZ = (Centre[2] > 0) ? (Centre[2] - 1) : 0; IndexZ < std::min(Centre[2] + 2, BrickCount[2]); ++IndexZ) {
+                    for (std::size_t IndexY = (Centre[1] > 0) ? (Centre[1] - 1) : 0; IndexY < std::min(Centre[1] + 2, BrickCount[1]); ++IndexY) {
+                        for (std::size_t IndexX = (Centre[0] > 0) ? (Centre[0] - 1) : 0; IndexX < std::min(Centre[0] + 2, BrickCount[0]); ++IndexX) {
+                            const std::size_t Neighbour = IndexX + BrickCount[0] * (IndexY + BrickCount[1] * IndexZ);
+                            if (this->Queued[Neighbour] == 0) {
+                                this->Queued[Neighbour] = 1;
+                                this->BakeBricks.push_back(Neighbour);
+                            }
+                        }
+                    }
+                }
+            }
+            for (std::size_t Brick : this->BakeBricks) {
+                this->Queued[Brick] = 0;
+            }
+        }
+
+        // Bricks write disjoint voxels, so they bake in parallel.
+        ThreadPool::GetGlobal().ParallelFor(this->BakeBricks.size(), 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                this->BakeBrick(Occupancy, this->BakeBricks[Index]);
+            }
+        });
+        ++this->Version;
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& AmbientOcclusion::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the occlusion.
+    const std::uint8_t* AmbientOcclusion::data(void) const {
+        return this->Occlusion.data();
+    }
+
+    // Get the version.
+    std::uint64_t AmbientOcclusion::GetVersion(void) const {
+        return this->Version;
+    }
+
+    // Each brick row is one byte of a bit plane row, so the cube rows around it are three bytes of each surrounding row.
+    void AmbientOcclusion::BakeBrick(const OccupancyBitPlane& Occupancy, std::size_t Brick) {
+        const std::array<std::size_t, 3>& BrickCount = Occupancy.GetBrickCount();
+        const std::array<std::size_t, 3> BrickPosition = {{Brick % BrickCount[0], (Brick / BrickCount[0]) % BrickCount[1], Brick / (BrickCount[0] * BrickCount[1])}};
+        const std::array<std::size_t, 3> Base = {{BrickPosition[0] * BrickSize, BrickPosition[1] * BrickSize, BrickPosition[2] * BrickSize}};
+        const std::array<std::size_t, 3> End = {{
+            std::min(Base[0] + BrickSize, this->Size[0]),
+            std::min(Base[1] + BrickSize, this->Size[1]),
+            std::min(Base[2] + BrickSize, this->Size[2])
+        }};
+
+        // Byte Index of a row, clear before the row and beyond its last word.
+        const std::size_t RowBytes = Occupancy.GetRowWords() * 8;
+        auto GetByte = [&](const std::uint64_t* Row, std::size_t ByteIndex) -> std::uint64_t {
+            if (ByteIndex >= RowBytes) return 0;
+            return (Row[ByteIndex / 8] >> (8 * (ByteIndex % 8))) & 0xFF;
+        };
+        const std::size_t CentreByte = Base[0] / 8;
+
+        for (std::size_t IndexZ = Base[2]; IndexZ < End[2]; ++IndexZ) {
+            for (std::size_t IndexY = Base[1]; IndexY < End[1]; ++IndexY) {
+                std::uint8_t* Target = &this->Occlusion[this->Size[0] * (IndexY + this->Size[1] * IndexZ)];
+                const std::uint64_t Own = GetByte(Occupancy.GetRow(IndexY, IndexZ), CentreByte);
+                if (Own == 0) {
+                    std::fill(Target + Base[0], Target + End[0], static_cast<std::uint8_t>(0));
+                    continue;
+                }
+
+                // Sum the cube rows of each voxel of the brick row, one population count per cube row.
+                std::array<std::size_t, BrickSize> Counts;
+                Counts.fill(0);
+                for (std::size_t CubeZ = (IndexZ > Radius) ? (IndexZ - Radius) : 0; CubeZ < std::min(IndexZ + Radius + 1, this->Size[2]); ++CubeZ) {
+                    for (std::size_t CubeY = (IndexY > Radius) ? (IndexY - Radius) : 0; CubeY < std::min(IndexY + Radius + 1, this->Size[1]); ++CubeY) {
+                        const std::uint64_t* Row = Occupancy.GetRow(CubeY, CubeZ);
+                        const std::uint64_t Window = ((CentreByte > 0) ? GetByte(Row, CentreByte - 1) : 0) | (GetByte(Row, CentreByte) << 8) | (GetByte(Row, CentreByte + 1) << 16);
+                        if (Window == 0) continue;
+                        // Solid ground is full rows, which need no counting.
+                        if (Window == 0xFFFFFF) {
+                            for (std::size_t& Count : Counts) {
+                                Count += 2 * Radius + 1;
+                            }
+                            continue;
+                        }
+                        for (std::size_t Offset = 0; Offset < BrickSize; ++Offset) {
+                            Counts[Offset] += PopCount((Window >> (8 + Offset - Radius)) & ((1ull << (2 * Radius + 1)) - 1));
+                        }
+                    }
+                }
+
+                for (std::size_t IndexX = Base[0]; IndexX < End[0]; ++IndexX) {
+                    const std::size_t Offset = IndexX - Base[0];
+                    if (((Own >> Offset) & 1) == 0) {
+                        Target[IndexX] = 0;
+                        continue;
+                    }
+                    Target[IndexX] = static_cast<std::uint8_t>(((Counts[Offset] - 1) * 255 + NeighbourCount / 2) / NeighbourCount);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_AMBIENTOCCLUSION_HPP
+#define RAYMARCH_AMBIENTOCCLUSION_HPP
+
+#include "OccupancyBitPlane.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  AmbientOcclusion holds how enclosed each occupied voxel of a volume is, from how many of the voxels around it are occupied.
+    ///         Each voxel counts the occupied voxels of the cube of side 2 * Radius + 1 around it, not counting itself, with population counts over the rows of an occupancy bit plane.
+    ///         Occlusion is stored as one byte per voxel in X-major order, 255 when every surrounding voxel is occupied, ready for an R8 3D texture.
+    ///         Empty voxels have no occlusion, and voxels outside the volume count as empty.
+    ///         A change reaches voxels one brick away at most, so updates only bake the changed bricks and their neighbours.
+    class AmbientOcclusion {
+    public:
+        /// @brief  The distance from a voxel to the edge of the cube around it.
+        constexpr static const std::size_t Radius = 2;
+        /// @brief  The number of voxels around a voxel that can occlude it.
+        constexpr static const std::size_t NeighbourCount = (2 * Radius + 1) * (2 * Radius + 1) * (2 * Radius + 1) - 1;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The occlusion of each voxel in X-major order.
+        std::vector<std::uint8_t> Occlusion;
+
+        /// @brief  Incremented whenever a bake writes occlusion, so uploads can be skipped.
+        std::uint64_t Version;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The bricks to bake, and a flag per brick set while it is in the list.
+        std::vector<std::size_t> BakeBricks;
+        std::vector<std::uint8_t> Queued;
+
+    public:
+        /// @brief  Constructor that creates empty occlusion of no size.
+        AmbientOcclusion(void);
+
+    public:
+        /// @brief  Bring the occlusion up to date with a volume, baking only around the bricks that changed since the last update.
+        ///         The first update, and any update with a volume of another size, bakes everything.
+        /// @param  Source - The volume to follow, always the same volume.
+        /// @param  Occupancy - The occupancy of the volume, already up to date with it.
+        void Update(const Volume& Source, const OccupancyBitPlane& Occupancy);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the occlusion, in X-major order.
+        /// @return A const pointer to the occlusion of the first voxel.
+        const std::uint8_t* data(void) const;
+
+        /// @brief  Get the version of the occlusion.
+        /// @return A value that changes whenever any occlusion is baked.
+        std::uint64_t GetVersion(void) const;
+
+        /// @brief  Get the occlusion of a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The fraction of surrounding voxels that are occupied, scaled to 255, zero for empty voxels.
+        std::uint8_t operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+    private:
+        /// @brief  Bake the occlusion of one brick.
+        /// @param  Occupancy - The occupancy of the volume.
+        /// @param  Brick - The linear index of the brick.
+        void BakeBrick(const OccupancyBitPlane& Occupancy, std::size_t Brick);
+    };
+
+    // Index the X-major occlusion.
+    inline std::uint8_t AmbientOcclusion::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        return this->Occlusion[X + this->Size[0] * (Y + this->Size[1] * Z)];
+    }
+}
+
+#endif // RAYMARCH_AMBIENTOCCLUSION_HPP
@@ -0,0 +1,131 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Collision.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace DeferredRasterisation {
+    // Find the voxels under the box, then test them.
+    bool Collision::Overlaps(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const std::array<float, 3>& Position, const std::array<float, 3>& Extent) {
+        std::array<int, 3> Begin;
+        std::array<int, 3> End;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const float Local = Position[Axis] - static_cast<float>(Origin[Axis]);
+            Begin[Axis] = static_cast<int>(std::floor(Local));
+            End[Axis] = static_cast<int>(std::ceil(Local + Extent[Axis]));
+        }
+        return Collision::Overlaps(Occupancy, Begin, End);
+    }
+
+    // Sweep each axis through the voxel layers the leading face crosses.
+    void Collision::Sweep(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, float DeltaTime, Body& Target) {
+        // Work relative to the volume.
+        std::array<float, 3> Position;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Position[Axis] = Target.Position[Axis] - static_cast<float>(Origin[Axis]);
+        }
+        Target.Contact = {{0, 0, 0}};
+
+        // Gravity and jumps act along Y, so it goes first to settle the box before it slides.
+        const std::size_t Order[3] = { 1, 0, 2 };
+        for (std::size_t Axis : Order) {
+            const float Move = Target.Velocity[Axis] * DeltaTime;
+            if (Move == 0.0f) continue;
+
+            // The voxels the box covers on the other axes, taken after earlier axes moved.
+            std::array<int, 3> Begin;
+            std::array<int, 3> End;
+            for (std::size_t Other = 0; Other < 3; ++Other) {
+                Begin[Other] = static_cast<int>(std::floor(Position[Other]));
+                End[Other] = static_cast<int>(std::ceil(Position[Other] + Target.Extent[Other]));
+            }
+
+            // Step the leading face into each new layer, stopping short of the first occupied one.
+            bool Blocked = false;
+            if (Move > 0.0f) {
+                const float Face = Position[Axis] + Target.Extent[Axis];
+                const int Last = static_cast<int>(std::ceil(Face + Move)) - 1;
+                for (int Layer = static_cast<int>(std::ceil(Face)); (Layer <= Last) && !Blocked; ++Layer) {
+                    Begin[Axis] = Layer;
+                    End[Axis] = Layer + 1;
+                    if (Collision::Overlaps(Occupancy, Begin, End)) {
+                        // Never move backwards, in case the box started overlapping.
+                        Position[Axis] = std::max(Position[Axis], static_cast<float>(Layer) - Target.Extent[Axis] - Skin);
+                        Blocked = true;
+                    }
+                }
+            }
+            else {
+                const int Last = static_cast<int>(std::floor(Position[Axis] + Move));
+                for (int Layer = static_cast<int>(std::floor(Position[Axis])) - 1; (Layer >= Last) && !Blocked; --Layer) {
+                    Begin[Axis] = Layer;
+                    End[Axis] = Layer + 1;
+                    if (Collision::Overlaps(Occupancy, Begin, End)) {
+                        Position[Axis] = std::min(Position[Axis], static_cast<float>(Layer + 1) + Skin);
+                        Blocked = true;
+                    }
+                }
+            }
+
+            if (Blocked) {
+                Target.Contact[Axis] = (Move > 0.0f) ? 1 : -1;
+                Target.Velocity[Axis] = 0.0f;
+            }
+            else {
+                Position[Axis] += Move;
+            }
+        }
+
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Target.Position[Axis] = Position[Axis] + static_cast<float>(Origin[Axis]);
+        }
+    }
+
+    // Bodies are independent, so batches split into even chunks.
+    void Collision::SweepBatch(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, float DeltaTime, std::vector<Body>& Targets) {
+        ThreadPool::GetGlobal().ParallelFor(Targets.size(), 256, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                Collision::Sweep(Occupancy, Origin, DeltaTime, Targets[Index]);
+            }
+        });
+    }
+
+    // Clip the box to the volume, outside is empty.
+    bool Collision::Overlaps(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Begin, const std::array<int, 3>& End) {
+        const std::array<std::size_t, 3>& Size = Occupancy.GetSize();
+        std::array<std::size_t, 3> ClippedBegin;
+        std::array<std::size_t, 3> ClippedEnd;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int First = std::max(Begin[Axis], 0);
+            const int Last = std::min(End[Axis], static_cast<int>(Size[Axis]));
+            if (First >= Last) return false;
+            ClippedBegin[Axis] = static_cast<std::size_t>(First);
+            ClippedEnd[Axis] = static_cast<std::size_t>(Last);
+        }
+        return Occupancy.Overlaps(ClippedBegin, ClippedEnd);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_COLLISION_HPP
+#define RAYMARCH_COLLISION_HPP
+
+#include "OccupancyBitPlane.hpp"
+
+#include <array>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  Collision moves axis aligned boxes through a volume, stopping them against occupied voxels.
+    ///         Boxes sweep one axis at a time, Y then X then Z, so they slide along surfaces instead of sticking to them.
+    ///         Each voxel layer a box moves into is tested with the row masks of the occupancy bit plane, 64 voxels at a time.
+    class Collision {
+    private:
+        /// @brief  Deleted destructor.
+        ~Collision(void) = delete;
+        /// @brief  Deleted constructor.
+        Collision(void) = delete;
+
+    public:
+        /// @brief  The gap left between a stopped box and the voxel it hit, so it is not touching the voxel afterwards.
+        constexpr static const float Skin = 1.0f / 1024.0f;
+
+        /// @brief  A moving box in map coordinates, voxel X, Y, Z covers the unit cube from X, Y, Z.
+        struct Body {
+            /// @brief  The minimum corner of the box.
+            std::array<float, 3> Position;
+            /// @brief  The size of the box.
+            std::array<float, 3> Extent;
+            /// @brief  The velocity of the box, axes that hit something are set to zero.
+            std::array<float, 3> Velocity;
+            /// @brief  The direction of the contact on each axis during the last sweep, -1, 0 or +1, so -1 on Y means standing on the ground.
+            std::array<int, 3> Contact;
+        };
+
+    public:
+        /// @brief  Test if a box overlaps any occupied voxel, space outside the volume is empty.
+        /// @param  Occupancy - The occupancy of the volume.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  Position - The minimum corner of the box in map coordinates.
+        /// @param  Extent - The size of the box.
+        /// @return True if the box overlaps an occupied voxel.
+        static bool Overlaps(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const std::array<float, 3>& Position, const std::array<float, 3>& Extent);
+
+        /// @brief  Move a box by its velocity over a time step, stopping at the first occupied voxel on each axis.
+        ///         A box that starts overlapping occupied voxels is only stopped by voxels it moves into.
+        /// @param  Occupancy - The occupancy of the volume.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  DeltaTime - The time step.
+        /// @param  Target - The box to move.
+        static void Sweep(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, float DeltaTime, Body& Target);
+
+        /// @brief  Move many boxes in parallel, boxes do not collide with each other.
+        /// @param  Occupancy - The occupancy of the volume.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  DeltaTime - The time step.
+        /// @param  Targets - The boxes to move.
+        static void SweepBatch(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, float DeltaTime, std::vector<Body>& Targets);
+
+    private:
+        /// @brief  Test if a box overlaps any occupied voxel, in volume coordinates.
+        /// @param  Occupancy - The occupancy of the volume.
+        /// @param  Begin - The first voxel of the box on each axis, may be outside the volume.
+        /// @param  End - One past the last voxel of the box on each axis, may be outside the volume.
+        /// @return True if the part of the box inside the volume has an occupied voxel.
+        static bool Overlaps(const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Begin, const std::array<int, 3>& End);
+    };
+}
+
+#endif // RAYMARCH_COLLISION_HPP
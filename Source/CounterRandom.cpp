@@ -0,0 +1,97 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "CounterRandom.hpp"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace DeferredRasterisation {
+    // SplitMix64 finaliser.
+    std::uint64_t CounterRandom::Mix64(std::uint64_t Value) {
+        Value += 0x9E3779B97F4A7C15ull;
+        Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+        return Value ^ (Value >> 31);
+    }
+
+    // Low bias 32 bit finaliser.
+    std::uint32_t CounterRandom::Mix32(std::uint32_t Value) {
+        Value ^= Value >> 16;
+        Value *= 0x7FEB352Du;
+        Value ^= Value >> 15;
+        Value *= 0x846CA68Bu;
+        return Value ^ (Value >> 16);
+    }
+
+    // Chain the seed and row coordinates through the 64 bit mixer.
+    std::uint32_t CounterRandom::GetRowKey(std::uint64_t Seed, int Y, int Z) {
+        std::uint64_t Key = Mix64(Seed);
+        Key = Mix64(Key ^ static_cast<std::uint32_t>(Y));
+        Key = Mix64(Key ^ static_cast<std::uint32_t>(Z));
+        return static_cast<std::uint32_t>(Key >> 32);
+    }
+
+    // Step along the row with a Weyl sequence and mix the result.
+    std::uint32_t CounterRandom::Sample(std::uint32_t RowKey, int X) {
+        return Mix32(RowKey + static_cast<std::uint32_t>(X) * 0x9E3779B9u);
+    }
+
+    // Evaluate samples along a row.
+    void CounterRandom::SampleRow(std::uint32_t RowKey, int BeginX, std::size_t Count, std::uint32_t* Output) {
+        std::size_t Index = 0;
+
+        #if defined(__SSE2__)
+            // SSE2 has no 32 bit low multiply, so build one from the two 32x32->64 bit multiplies.
+            auto MultiplyLow = [](__m128i LHS, __m128i RHS) -> __m128i {
+                const __m128i Even = _mm_mul_epu32(LHS, RHS);
+                const __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(LHS, 32), _mm_srli_epi64(RHS, 32));
+                return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+            };
+
+            const __m128i Multiplier1 = _mm_set1_epi32(0x7FEB352D);
+            const __m128i Multiplier2 = _mm_set1_epi32(static_cast<int>(0x846CA68Bu));
+            const __m128i Step = _mm_set1_epi32(static_cast<int>(4u * 0x9E3779B9u));
+            const std::uint32_t First = RowKey + static_cast<std::uint32_t>(BeginX) * 0x9E3779B9u;
+            __m128i Counter = _mm_set_epi32(static_cast<int>(First + 3u * 0x9E3779B9u), static_cast<int>(First + 2u * 0x9E3779B9u), static_cast<int>(First + 0x9E3779B9u), static_cast<int>(First));
+
+            for (; Index + 4 <= Count; Index += 4) {
+                __m128i Value = Counter;
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+                Value = MultiplyLow(Value, Multiplier1);
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 15));
+                Value = MultiplyLow(Value, Multiplier2);
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(Output + Index), Value);
+                Counter = _mm_add_epi32(Counter, Step);
+            }
+        #endif
+
+        // Evaluate the remaining samples one at a time.
+        for (; Index < Count; ++Index) {
+            Output[Index] = Sample(RowKey, BeginX + static_cast<int>(Index));
+        }
+    }
+}
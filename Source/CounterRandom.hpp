@@ -0,0 +1,77 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_COUNTERRANDOM_HPP
+#define RAYMARCH_COUNTERRANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DeferredRasterisation {
+    /// @brief  CounterRandom is a stateless counter-based random generator.
+    ///         Every sample is a pure function of a seed and integer coordinates, so samples can be drawn
+    ///         in any order, on any number of threads, and are identical on every run and every machine.
+    class CounterRandom {
+    private:
+        /// @brief  Deleted destructor.
+        ~CounterRandom(void) = delete;
+        /// @brief  Deleted constructor.
+        CounterRandom(void) = delete;
+
+    public:
+        /// @brief  Mix a 64 bit value using the SplitMix64 finaliser.
+        /// @param  Value - The value to mix.
+        /// @return The mixed value.
+        static std::uint64_t Mix64(std::uint64_t Value);
+
+        /// @brief  Mix a 32 bit value using a low bias integer finaliser.
+        /// @param  Value - The value to mix.
+        /// @return The mixed value.
+        static std::uint32_t Mix32(std::uint32_t Value);
+
+    public:
+        /// @brief  Get the key of a row of samples along the X axis.
+        /// @param  Seed - The seed of the generator.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @return The row key, passed to Sample or SampleRow.
+        static std::uint32_t GetRowKey(std::uint64_t Seed, int Y, int Z);
+
+        /// @brief  Get the sample at a position along a row.
+        /// @param  RowKey - The key of the row.
+        /// @param  X - The X coordinate of the sample.
+        /// @return A uniformly distributed 32 bit sample.
+        static std::uint32_t Sample(std::uint32_t RowKey, int X);
+
+        /// @brief  Get consecutive samples along a row, four at a time where SIMD is available.
+        /// @param  RowKey - The key of the row.
+        /// @param  BeginX - The X coordinate of the first sample.
+        /// @param  Count - The number of samples.
+        /// @param  Output - The output array, must hold at least Count samples, Output[I] equals Sample(RowKey, BeginX + I).
+        static void SampleRow(std::uint32_t RowKey, int BeginX, std::size_t Count, std::uint32_t* Output);
+    };
+}
+
+#endif // RAYMARCH_COUNTERRANDOM_HPP
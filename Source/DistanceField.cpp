@@ -0,0 +1,211 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "DistanceField.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace DeferredRasterisation {
+    namespace {
+        /// @brief  The squared distance used for "no solid voxel yet", large but finite so parabola intersections stay defined.
+        const float Unreached = 1e20f;
+    }
+
+    // Nothing to follow yet.
+    DistanceField::DistanceField(void)
+        : Size({{0, 0, 0}}) {
+    }
+
+    // Rebuild the boxes around the changed bricks.
+    void DistanceField::Update(const Volume& Source) {
+        Source.Drain(this->Cursor, this->DirtyBricks);
+
+        // A new size rebuilds everything.
+        if (Source.GetSize() != this->Size) {
+            this->Size = Source.GetSize();
+            this->Distances.assign(this->Size[0] * this->Size[1] * this->Size[2], MaxValue);
+            this->Transform(Source, {{0, 0, 0}}, this->Size);
+            return;
+        }
+        if (this->DirtyBricks.empty()) return;
+
+        // Voxels further than the clamp distance from a change keep their clamped or unchanged distance, so each changed brick only needs the box reaching that far around it.
+        const std::array<std::size_t, 3>& BrickCount = Source.GetBrickCount();
+        const std::size_t Reach = MaxValue / Resolution + 1;
+        this->Regions.clear();
+        for (std::size_t Brick : this->DirtyBricks) {
+            const std::array<std::size_t, 3> BrickPosition = {{Brick % BrickCount[0], (Brick / BrickCount[0]) % BrickCount[1], Brick / (BrickCount[0] * BrickCount[1])}};
+            std::array<std::array<std::size_t, 3>, 2> Region;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Region[0][Axis] = (BrickPosition[Axis] * BrickSize > Reach) ? (BrickPosition[Axis] * BrickSize - Reach) : 0;
+                Region[1][Axis] = std::min((BrickPosition[Axis] + 1) * BrickSize + Reach, this->Size[Axis]);
+            }
+            this->Regions.push_back(Region);
+        }
+
+        // Merge overlapping boxes into their bounds until none overlap, so no voxel is rebuilt twice.
+        auto Overlap = [](const std::array<std::array<std::size_t, 3>, 2>& First, const std::array<std::array<std::size_t, 3>, 2>& Second) -> bool {
+            return (First[0][0] < Second[1][0]) && (Second[0][0] < First[1][0]) && (First[0][1] < Second[1][1]) && (Second[0][1] < First[1][1]) && (First[0][2] < Second[1][2]) && (Second[0][2] < First[1][2]);
+        };
+        for (bool Merged = true; Merged;) {
+            Merged = false;
+            for (std::size_t First = 0; First < this->Regions.size(); ++First) {
+                for (std::size_t Second = First + 1; Second < this->Regions.size();) {
+                    if (!Overlap(this->Regions[First], this->Regions[Second])) {
+                        ++Second;
+                        continue;
+                    }
+                    for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                        this->Regions[First][0][Axis] = std::min(this->Regions[First][0][Axis], this->Regions[Second][0][Axis]);
+                        this->Regions[First][1][Axis] = std::max(this->Regions[First][1][Axis], this->Regions[Second][1][Axis]);
+                    }
+                    this->Regions[Second] = this->Regions.back();
+                    this->Regions.pop_back();
+                    Merged = true;
+                }
+            }
+        }
+
+        for (const std::array<std::array<std::size_t, 3>, 2>& Region : this->Regions) {
+            this->Transform(Source, Region[0], Region[1]);
+        }
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& DistanceField::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the distances.
+    const std::uint8_t* DistanceField::data(void) const {
+        return this->Distances.data();
+    }
+
+    // Scale a quantised distance back to voxels.
+    float DistanceField::GetDistance(std::size_t X, std::size_t Y, std::size_t Z) const {
+        return static_cast<float>(this->operator()(X, Y, Z)) / static_cast<float>(Resolution);
+    }
+
+    // Transform a margin around the box along X, then Y, then Z, then quantise the box.
+    void DistanceField::Transform(const Volume& Source, const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) {
+        // Solid voxels further than the clamp distance from the box cannot be the nearest to anything that is not clamped.
+        const std::size_t Reach = MaxValue / Resolution + 1;
+        std::array<std::size_t, 3> Outer;
+        std::array<std::size_t, 3> Extent;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Outer[Axis] = (Begin[Axis] > Reach) ? (Begin[Axis] - Reach) : 0;
+            Extent[Axis] = std::min(End[Axis] + Reach, this->Size[Axis]) - Outer[Axis];
+        }
+        this->Squared.resize(Extent[0] * Extent[1] * Extent[2]);
+
+        // Solid voxels start at zero, everything else unreached.
+        ThreadPool::GetGlobal().ParallelFor(Extent[2], 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t IndexZ = First; IndexZ < Last; ++IndexZ) {
+                for (std::size_t IndexY = 0; IndexY < Extent[1]; ++IndexY) {
+                    const Voxel* Row = &Source(Outer[0], Outer[1] + IndexY, Outer[2] + IndexZ);
+                    float* Target = &this->Squared[Extent[0] * (IndexY + Extent[1] * IndexZ)];
+                    for (std::size_t IndexX = 0; IndexX < Extent[0]; ++IndexX) {
+                        Target[IndexX] = (Row[IndexX].Alpha != 0) ? 0.0f : Unreached;
+                    }
+                }
+            }
+        });
+
+        // One pass per axis, every row of a pass is independent.
+        const std::array<std::size_t, 3> Strides = {{1, Extent[0], Extent[0] * Extent[1]}};
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const std::size_t Length = Extent[Axis];
+            const std::size_t Across = (Axis == 0) ? 1 : 0;
+            const std::size_t Along = (Axis == 2) ? 1 : 2;
+            const std::size_t RowCount = Extent[Across] * Extent[Along];
+            ThreadPool::GetGlobal().ParallelFor(RowCount, 64, [&](std::size_t First, std::size_t Last) -> void {
+                std::vector<float> Function(Length);
+                std::vector<float> Output(Length);
+                std::vector<float> Bounds(Length + 1);
+                std::vector<std::size_t> Roots(Length);
+                for (std::size_t Row = First; Row < Last; ++Row) {
+                    float* Start = &this->Squared[(Row % Extent[Across]) * Strides[Across] + (Row / Extent[Across]) * Strides[Along]];
+                    for (std::size_t Index = 0; Index < Length; ++Index) {
+                        Function[Index] = Start[Index * Strides[Axis]];
+                    }
+                    DistanceField::Transform1D(Function.data(), Length, Roots.data(), Bounds.data(), Output.data());
+                    for (std::size_t Index = 0; Index < Length; ++Index) {
+                        Start[Index * Strides[Axis]] = Function[Index];
+                    }
+                }
+            });
+        }
+
+        // Quantise the box, rounding down so marching by the stored distance never passes a solid voxel.
+        const float Limit = static_cast<float>(MaxValue);
+        ThreadPool::GetGlobal().ParallelFor(End[2] - Begin[2], 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t IndexZ = Begin[2] + First; IndexZ < Begin[2] + Last; ++IndexZ) {
+                for (std::size_t IndexY = Begin[1]; IndexY < End[1]; ++IndexY) {
+                    const float* Row = &this->Squared[Extent[0] * ((IndexY - Outer[1]) + Extent[1] * (IndexZ - Outer[2])) - Outer[0]];
+                    std::uint8_t* Target = &this->Distances[this->Size[0] * (IndexY + this->Size[1] * IndexZ)];
+                    for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                        Target[IndexX] = static_cast<std::uint8_t>(std::min(std::floor(std::sqrt(Row[IndexX]) * static_cast<float>(Resolution)), Limit));
+                    }
+                }
+            }
+        });
+    }
+
+    // Build the lower envelope of the parabolas left to right, then sample it.
+    void DistanceField::Transform1D(float* Function, std::size_t Count, std::size_t* Roots, float* Bounds, float* Output) {
+        if (Count == 0) return;
+        std::size_t Envelope = 0;
+        Roots[0] = 0;
+        Bounds[0] = -Unreached;
+        Bounds[1] = +Unreached;
+        for (std::size_t Index = 1; Index < Count; ++Index) {
+            const float Position = static_cast<float>(Index);
+            float Intersection;
+            // The first bound is below any intersection of finite parabolas, so the first parabola is never removed.
+            for (;;) {
+                const float Root = static_cast<float>(Roots[Envelope]);
+                Intersection = ((Function[Index] + Position * Position) - (Function[Roots[Envelope]] + Root * Root)) / (2.0f * Position - 2.0f * Root);
+                if (Intersection > Bounds[Envelope]) break;
+                --Envelope;
+            }
+            ++Envelope;
+            Roots[Envelope] = Index;
+            Bounds[Envelope] = Intersection;
+            Bounds[Envelope + 1] = +Unreached;
+        }
+
+        std::size_t Current = 0;
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            const float Position = static_cast<float>(Index);
+            while (Bounds[Current + 1] < Position) {
+                ++Current;
+            }
+            const float Delta = Position - static_cast<float>(Roots[Current]);
+            Output[Index] = Delta * Delta + Function[Roots[Current]];
+        }
+        std::copy(Output, Output + Count, Function);
+    }
+}
@@ -0,0 +1,126 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_DISTANCEFIELD_HPP
+#define RAYMARCH_DISTANCEFIELD_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  DistanceField holds the Euclidean distance from each voxel of a volume to the nearest non-empty voxel, for ray marching and ambient occlusion.
+    ///         Distances are computed with the separable linear time transform of Felzenszwalb and Huttenlocher, one pass per axis with rows in parallel.
+    ///         Distances are stored as one byte per voxel in X-major order, in steps of a quarter voxel rounded down, so they can be uploaded as an R8 3D texture.
+    ///         Distances are clamped, so a change only reaches voxels within the clamp distance and updates only rebuild the region around changed bricks.
+    class DistanceField {
+    public:
+        /// @brief  The number of steps per voxel of distance.
+        constexpr static const std::size_t Resolution = 4;
+        /// @brief  The largest stored value, any distance at or beyond this many steps is clamped to it.
+        ///         The clamp is sixteen voxels, two bricks, so a change only reaches the bricks near it.
+        constexpr static const std::uint8_t MaxValue = 16 * Resolution;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The quantised distance of each voxel in X-major order.
+        std::vector<std::uint8_t> Distances;
+
+        /// @brief  The squared distances of the region being rebuilt, kept to reuse its allocation.
+        std::vector<float> Squared;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The boxes rebuilt by an update, the first and one past the last voxel of each, kept to reuse its allocation.
+        std::vector<std::array<std::array<std::size_t, 3>, 2> > Regions;
+
+    public:
+        /// @brief  Constructor that creates an empty field of no size.
+        DistanceField(void);
+
+    public:
+        /// @brief  Bring the field up to date with a volume, rebuilding only around the bricks that changed since the last update.
+        ///         Each changed brick rebuilds a box reaching the clamp distance around it, and only boxes that overlap are merged.
+        ///         The first update, and any update with a volume of another size, rebuilds everything.
+        /// @param  Source - The volume to follow, always the same volume.
+        void Update(const Volume& Source);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the quantised distances, in X-major order.
+        /// @return A const pointer to the first distance.
+        const std::uint8_t* data(void) const;
+
+        /// @brief  Get the quantised distance of a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The distance in steps of 1 / Resolution voxels, rounded down and clamped to MaxValue.
+        std::uint8_t operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Get the distance of a voxel in voxels.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The distance to the nearest non-empty voxel, at most MaxValue / Resolution, zero for non-empty voxels.
+        float GetDistance(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+    private:
+        /// @brief  Recompute the distances of a box, reading the volume far enough around it that clamped results are exact.
+        /// @param  Source - The volume being followed.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box.
+        void Transform(const Volume& Source, const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End);
+
+        /// @brief  The one dimensional squared distance transform of a sampled function, the lower envelope of parabolas rooted at each sample.
+        /// @param  Function - The samples, replaced by the transform.
+        /// @param  Count - The number of samples.
+        /// @param  Roots - Scratch for the sample index of each envelope parabola, at least Count entries.
+        /// @param  Bounds - Scratch for the bounds between envelope parabolas, at least Count + 1 entries.
+        /// @param  Output - Scratch for the transform, at least Count entries.
+        static void Transform1D(float* Function, std::size_t Count, std::size_t* Roots, float* Bounds, float* Output);
+    };
+
+    // Index the X-major distances.
+    inline std::uint8_t DistanceField::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        return this->Distances[X + this->Size[0] * (Y + this->Size[1] * Z)];
+    }
+}
+
+#endif // RAYMARCH_DISTANCEFIELD_HPP
@@ -0,0 +1,243 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "EditQueue.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace DeferredRasterisation {
+    // A single voxel is a box of one.
+    EditQueue::Edit EditQueue::Edit::Set(const std::array<int, 3>& Position, Voxel Value) {
+        Edit Result = Edit::FillBox(Position, {{Position[0] + 1, Position[1] + 1, Position[2] + 1}}, Value);
+        Result.Type = EditType::Set;
+        return Result;
+    }
+
+    // Bound the sphere by the voxels its extremes fall in.
+    EditQueue::Edit EditQueue::Edit::Brush(const std::array<float, 3>& Centre, float Radius, Voxel Value) {
+        assert(Radius >= 0.0f);
+        Edit Result;
+        Result.Type = EditType::Brush;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Result.Begin[Axis] = static_cast<int>(std::floor(Centre[Axis] - Radius));
+            Result.End[Axis] = static_cast<int>(std::floor(Centre[Axis] + Radius)) + 1;
+        }
+        Result.Centre = Centre;
+        Result.Radius = Radius;
+        Result.Value = Value;
+        return Result;
+    }
+
+    // A box needs no sphere.
+    EditQueue::Edit EditQueue::Edit::FillBox(const std::array<int, 3>& Begin, const std::array<int, 3>& End, Voxel Value) {
+        Edit Result;
+        Result.Type = EditType::FillBox;
+        Result.Begin = Begin;
+        Result.End = End;
+        Result.Centre = {{0.0f, 0.0f, 0.0f}};
+        Result.Radius = 0.0f;
+        Result.Value = Value;
+        return Result;
+    }
+
+    // A carve is a brush that writes empty voxels everywhere.
+    EditQueue::Edit EditQueue::Edit::CarveSphere(const std::array<float, 3>& Centre, float Radius) {
+        Edit Result = Edit::Brush(Centre, Radius, Voxel());
+        Result.Type = EditType::CarveSphere;
+        return Result;
+    }
+
+    // Start with no batches.
+    EditQueue::EditQueue(void)
+        : Head(nullptr) {
+    }
+
+    // Free anything left in the queue.
+    EditQueue::~EditQueue(void) {
+        Batch* Current = this->Head.load(std::memory_order_acquire);
+        while (Current != nullptr) {
+            Batch* Next = Current->Next;
+            delete Current;
+            Current = Next;
+        }
+    }
+
+    // Push the batch onto the front of the list.
+    void EditQueue::Submit(std::vector<Edit>&& Edits) {
+        if (Edits.empty()) return;
+        Batch* New = new Batch;
+        New->Edits = std::move(Edits);
+        New->Next = this->Head.load(std::memory_order_relaxed);
+        // Release publishes the edits to the thread that takes the batch, a failed exchange reloads the head into Next.
+        while (!this->Head.compare_exchange_weak(New->Next, New, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Wrap the edit in a batch of one.
+    void EditQueue::Submit(const Edit& Value) {
+        this->Submit(std::vector<Edit>(1, Value));
+    }
+
+    // Detach the whole list, then reverse it into submission order.
+    void EditQueue::Take(std::vector<Edit>& Edits) {
+        Edits.clear();
+        Batch* Current = this->Head.exchange(nullptr, std::memory_order_acquire);
+        Batch* Oldest = nullptr;
+        std::size_t Count = 0;
+        while (Current != nullptr) {
+            Batch* Next = Current->Next;
+            Current->Next = Oldest;
+            Oldest = Current;
+            Count += Current->Edits.size();
+            Current = Next;
+        }
+
+        Edits.reserve(Count);
+        while (Oldest != nullptr) {
+            Batch* Next = Oldest->Next;
+            Edits.insert(Edits.end(), Oldest->Edits.begin(), Oldest->Edits.end());
+            delete Oldest;
+            Oldest = Next;
+        }
+    }
+
+    // Only the head needs to be looked at.
+    bool EditQueue::IsEmpty(void) const {
+        return this->Head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+    // Sort the edits by brick, then apply each brick on its own.
+    void EditQueue::Apply(const std::vector<Edit>& Edits, const std::array<int, 3>& Origin, Volume& Target) {
+        const std::array<std::size_t, 3> Size = Target.GetSize();
+        const std::array<std::size_t, 3>& BrickCount = Target.GetBrickCount();
+
+        // Clip an edit's bounds to a box of the target, in target coordinates.
+        auto Clip = [&Origin](const Edit& Value, const std::array<std::size_t, 3>& BoxBegin, const std::array<std::size_t, 3>& BoxEnd, std::array<std::size_t, 3>& Begin, std::array<std::size_t, 3>& End) -> bool {
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                const int First = std::max(Value.Begin[Axis] - Origin[Axis], static_cast<int>(BoxBegin[Axis]));
+                const int Last = std::min(Value.End[Axis] - Origin[Axis], static_cast<int>(BoxEnd[Axis]));
+                if (First >= Last) return false;
+                Begin[Axis] = static_cast<std::size_t>(First);
+                End[Axis] = static_cast<std::size_t>(Last);
+            }
+            return true;
+        };
+
+        // Visit the bricks an edit touches.
+        const std::array<std::size_t, 3> Zero = {{0, 0, 0}};
+        auto ForEachBrick = [&](const Edit& Value, auto&& Function) -> void {
+            std::array<std::size_t, 3> Begin;
+            std::array<std::size_t, 3> End;
+            if (!Clip(Value, Zero, Size, Begin, End)) return;
+            for (std::size_t BrickZ = Begin[2] / BrickSize; BrickZ <= (End[2] - 1) / BrickSize; ++BrickZ) {
+                for (std::size_t BrickY = Begin[1] / BrickSize; BrickY <= (End[1] - 1) / BrickSize; ++BrickY) {
+                    for (std::size_t BrickX = Begin[0] / BrickSize; BrickX <= (End[0] - 1) / BrickSize; ++BrickX) {
+                        Function(BrickX + BrickCount[0] * (BrickY + BrickCount[1] * BrickZ));
+                    }
+                }
+            }
+        };
+
+        // Counting sort keeps the edits of each brick in submission order.
+        std::vector<std::uint32_t> BrickOffsets(BrickCount[0] * BrickCount[1] * BrickCount[2] + 1, 0);
+        for (const Edit& Value : Edits) {
+            ForEachBrick(Value, [&BrickOffsets](std::size_t Brick) -> void { ++BrickOffsets[Brick + 1]; });
+        }
+        std::vector<std::size_t> ActiveBricks;
+        for (std::size_t Brick = 0; Brick + 1 < BrickOffsets.size(); ++Brick) {
+            if (BrickOffsets[Brick + 1] != 0) {
+                ActiveBricks.push_back(Brick);
+            }
+            BrickOffsets[Brick + 1] += BrickOffsets[Brick];
+        }
+        if (ActiveBricks.empty()) return;
+
+        std::vector<std::uint32_t> Order(BrickOffsets.back());
+        std::vector<std::uint32_t> BrickCursors(BrickOffsets.begin(), BrickOffsets.end() - 1);
+        for (std::size_t Index = 0; Index < Edits.size(); ++Index) {
+            ForEachBrick(Edits[Index], [&](std::size_t Brick) -> void { Order[BrickCursors[Brick]++] = static_cast<std::uint32_t>(Index); });
+        }
+
+        // Each brick belongs to one worker, so writes and brick stamps never overlap.
+        const Volume& Source = Target;
+        ThreadPool::GetGlobal().ParallelFor(ActiveBricks.size(), 1, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Active = Begin; Active < End; ++Active) {
+                const std::size_t Brick = ActiveBricks[Active];
+                const std::array<std::size_t, 3> BrickBegin = {{
+                    (Brick % BrickCount[0]) * BrickSize,
+                    ((Brick / BrickCount[0]) % BrickCount[1]) * BrickSize,
+                    (Brick / (BrickCount[0] * BrickCount[1])) * BrickSize
+                }};
+                const std::array<std::size_t, 3> BrickEnd = {{
+                    std::min(BrickBegin[0] + BrickSize, Size[0]),
+                    std::min(BrickBegin[1] + BrickSize, Size[1]),
+                    std::min(BrickBegin[2] + BrickSize, Size[2])
+                }};
+
+                for (std::uint32_t Entry = BrickOffsets[Brick]; Entry < BrickOffsets[Brick + 1]; ++Entry) {
+                    const Edit& Value = Edits[Order[Entry]];
+                    std::array<std::size_t, 3> EditBegin;
+                    std::array<std::size_t, 3> EditEnd;
+                    if (!Clip(Value, BrickBegin, BrickEnd, EditBegin, EditEnd)) continue;
+
+                    for (std::size_t IndexZ = EditBegin[2]; IndexZ < EditEnd[2]; ++IndexZ) {
+                        for (std::size_t IndexY = EditBegin[1]; IndexY < EditEnd[1]; ++IndexY) {
+                            std::size_t RowBegin = EditBegin[0];
+                            std::size_t RowEnd = EditEnd[0];
+
+                            // Sphere rows span the voxels within the radius, found from the distance left after Y and Z.
+                            if ((Value.Type == EditType::Brush) || (Value.Type == EditType::CarveSphere)) {
+                                const float DeltaY = static_cast<float>(static_cast<int>(IndexY) + Origin[1]) - Value.Centre[1];
+                                const float DeltaZ = static_cast<float>(static_cast<int>(IndexZ) + Origin[2]) - Value.Centre[2];
+                                const float Remaining = Value.Radius * Value.Radius - DeltaY * DeltaY - DeltaZ * DeltaZ;
+                                if (Remaining < 0.0f) continue;
+                                const float HalfWidth = std::sqrt(Remaining);
+                                const int First = static_cast<int>(std::ceil(Value.Centre[0] - HalfWidth)) - Origin[0];
+                                const int Last = static_cast<int>(std::floor(Value.Centre[0] + HalfWidth)) + 1 - Origin[0];
+                                if ((First >= static_cast<int>(RowEnd)) || (Last <= static_cast<int>(RowBegin)) || (First >= Last)) continue;
+                                RowBegin = static_cast<std::size_t>(std::max(First, static_cast<int>(RowBegin)));
+                                RowEnd = static_cast<std::size_t>(std::min(Last, static_cast<int>(RowEnd)));
+                            }
+
+                            if (Value.Type == EditType::Brush) {
+                                for (std::size_t IndexX = RowBegin; IndexX < RowEnd; ++IndexX) {
+                                    if (Source(IndexX, IndexY, IndexZ).Alpha != 0) {
+                                        Target.Set(IndexX, IndexY, IndexZ, Value.Value);
+                                    }
+                                }
+                            }
+                            else {
+                                Target.FillRow(RowBegin, RowEnd, IndexY, IndexZ, Value.Value);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
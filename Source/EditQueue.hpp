@@ -0,0 +1,151 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_EDITQUEUE_HPP
+#define RAYMARCH_EDITQUEUE_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  EditQueue collects voxel edits from any number of threads and applies them to volumes in batches.
+    ///         Producers submit whole batches with a single lock free push, the consumer takes every batch at once.
+    ///         Edits are applied grouped by brick, each brick on one worker in submission order, so later edits overwrite earlier ones.
+    class EditQueue {
+    public:
+        /// @brief  The kinds of edit.
+        enum class EditType : std::uint8_t {
+            /// @brief  Set a single voxel.
+            Set,
+            /// @brief  Recolour the non-empty voxels within a sphere.
+            Brush,
+            /// @brief  Set every voxel within a box.
+            FillBox,
+            /// @brief  Empty every voxel within a sphere.
+            CarveSphere
+        };
+
+        /// @brief  A single edit in map coordinates.
+        struct Edit {
+            /// @brief  The kind of edit.
+            EditType Type;
+            /// @brief  The first voxel of the box bounding the edit.
+            std::array<int, 3> Begin;
+            /// @brief  One past the last voxel of the box bounding the edit.
+            std::array<int, 3> End;
+            /// @brief  The centre of a sphere edit.
+            std::array<float, 3> Centre;
+            /// @brief  The radius of a sphere edit.
+            float Radius;
+            /// @brief  The voxel written by the edit.
+            Voxel Value;
+
+            /// @brief  Create an edit that sets a single voxel.
+            /// @param  Position - The voxel to set.
+            /// @param  Value - The voxel value, an empty voxel erases.
+            /// @return The edit.
+            static Edit Set(const std::array<int, 3>& Position, Voxel Value);
+
+            /// @brief  Create an edit that recolours the non-empty voxels within a sphere, empty voxels stay empty.
+            /// @param  Centre - The centre of the sphere.
+            /// @param  Radius - The radius of the sphere, voxels are inside if their position is no further than this from the centre.
+            /// @param  Value - The voxel value.
+            /// @return The edit.
+            static Edit Brush(const std::array<float, 3>& Centre, float Radius, Voxel Value);
+
+            /// @brief  Create an edit that sets every voxel within a box.
+            /// @param  Begin - The first voxel of the box.
+            /// @param  End - One past the last voxel of the box.
+            /// @param  Value - The voxel value, an empty voxel erases.
+            /// @return The edit.
+            static Edit FillBox(const std::array<int, 3>& Begin, const std::array<int, 3>& End, Voxel Value);
+
+            /// @brief  Create an edit that empties every voxel within a sphere.
+            /// @param  Centre - The centre of the sphere.
+            /// @param  Radius - The radius of the sphere, voxels are inside if their position is no further than this from the centre.
+            /// @return The edit.
+            static Edit CarveSphere(const std::array<float, 3>& Centre, float Radius);
+        };
+
+    private:
+        /// @brief  A submitted batch, batches form a singly linked list with the newest first.
+        struct Batch {
+            /// @brief  The edits of the batch in submission order.
+            std::vector<Edit> Edits;
+            /// @brief  The batch submitted before this one.
+            Batch* Next;
+        };
+
+        /// @brief  The newest submitted batch, or null if the queue is empty.
+        std::atomic<Batch*> Head;
+
+    public:
+        /// @brief  Constructor that creates an empty queue.
+        EditQueue(void);
+
+        /// @brief  Destructor that frees batches that were never taken.
+        ~EditQueue(void);
+
+        /// @brief  Deleted copy constructor, producers hold references to the queue.
+        EditQueue(const EditQueue&) = delete;
+
+        /// @brief  Deleted copy assignment operator, producers hold references to the queue.
+        EditQueue& operator=(const EditQueue&) = delete;
+
+    public:
+        /// @brief  Submit a batch of edits, safe to call from any thread at any time.
+        ///         Producers should gather their edits locally and submit them together, a batch costs one allocation and one atomic exchange.
+        /// @param  Edits - The edits in the order they are applied, moved into the queue.
+        void Submit(std::vector<Edit>&& Edits);
+
+        /// @brief  Submit a single edit, safe to call from any thread at any time.
+        /// @param  Value - The edit.
+        void Submit(const Edit& Value);
+
+        /// @brief  Take every submitted edit, batches are concatenated in the order they were submitted.
+        ///         Only one thread may take from a queue at a time.
+        /// @param  Edits - Output for the edits, cleared first.
+        void Take(std::vector<Edit>& Edits);
+
+        /// @brief  Test if any edits are waiting.
+        /// @return True if at least one batch has been submitted since the last take.
+        bool IsEmpty(void) const;
+
+    public:
+        /// @brief  Apply edits to a volume, clipped to the volume.
+        ///         Edits are counting sorted by the bricks they touch, then every touched brick is applied on one worker.
+        ///         Each brick sees its edits in order, so the result matches applying every edit in order on one thread.
+        /// @param  Edits - The edits in map coordinates.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  Target - The volume to edit, touched bricks are marked as changed.
+        static void Apply(const std::vector<Edit>& Edits, const std::array<int, 3>& Origin, Volume& Target);
+    };
+}
+
+#endif // RAYMARCH_EDITQUEUE_HPP
@@ -0,0 +1,63 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Entity.hpp"
+
+#include <cassert>
+
+namespace DeferredRasterisation {
+    // An entity with no model at the origin.
+    Entity::Entity(void)
+        : Model(nullptr)
+        , Position({{0.0f, 0.0f, 0.0f}})
+        , Yaw(0.0f)
+        , Pitch(0.0f)
+        , Roll(0.0f) {
+    }
+
+    // Place the model, unrolled and unpitched.
+    Entity::Entity(const std::shared_ptr<const Volume>& Model, const std::array<float, 3>& Position, float Yaw)
+        : Model(Model)
+        , Position(Position)
+        , Yaw(Yaw)
+        , Pitch(0.0f)
+        , Roll(0.0f) {
+    }
+
+    // Move the centre of the model to the origin, rotate, then move it to the position.
+    Matrix44 Entity::GetTransform(void) const {
+        assert(this->Model != nullptr);
+        const std::array<std::size_t, 3> Size = this->Model->GetSize();
+        const Vector3 Centre(
+            (static_cast<float>(Size[0]) - 1.0f) * 0.5f,
+            (static_cast<float>(Size[1]) - 1.0f) * 0.5f,
+            (static_cast<float>(Size[2]) - 1.0f) * 0.5f
+        );
+        return Matrix44::Translation(Vector3(this->Position[0], this->Position[1], this->Position[2]))
+            * Matrix44::RotationY(this->Yaw)
+            * Matrix44::RotationX(this->Pitch)
+            * Matrix44::RotationZ(this->Roll)
+            * Matrix44::Translation(Vector3(0.0f, 0.0f, 0.0f) - Centre);
+    }
+}
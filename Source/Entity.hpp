@@ -0,0 +1,72 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_ENTITY_HPP
+#define RAYMARCH_ENTITY_HPP
+
+#include "Maths.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <memory>
+
+namespace DeferredRasterisation {
+    /// @brief  Entity is a voxel model that moves freely through the map without being written into the scene.
+    ///         Entities placing the same model share it, the renderer uploads each model once and draws every entity with its own model matrix.
+    class Entity {
+    public:
+        /// @brief  The voxels of the entity, shared with other entities, the renderer uploads the model again when any of its bricks is written.
+        std::shared_ptr<const Volume> Model;
+
+        /// @brief  The position of the centre of the model in map coordinates, not limited to whole voxels.
+        std::array<float, 3> Position;
+
+        /// @brief  Rotation about the Y axis in radians, applied after the pitch.
+        float Yaw;
+
+        /// @brief  Rotation about the X axis in radians, applied after the roll.
+        float Pitch;
+
+        /// @brief  Rotation about the Z axis in radians, applied first.
+        float Roll;
+
+    public:
+        /// @brief  Constructor that creates an entity with no model at the origin.
+        Entity(void);
+
+        /// @brief  Constructor that places a model in the map.
+        /// @param  Model - The voxels of the entity.
+        /// @param  Position - The position of the centre of the model in map coordinates.
+        /// @param  Yaw - Rotation about the Y axis in radians.
+        Entity(const std::shared_ptr<const Volume>& Model, const std::array<float, 3>& Position, float Yaw = 0.0f);
+
+    public:
+        /// @brief  Get the transform from model voxel coordinates to map coordinates, rotating the model about its centre.
+        /// @return The transform of the entity.
+        Matrix44 GetTransform(void) const;
+    };
+}
+
+#endif // RAYMARCH_ENTITY_HPP
@@ -0,0 +1,338 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "FluidSimulation.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace DeferredRasterisation {
+    namespace {
+        /// @brief  Flag bits of a brick while lists of bricks are gathered.
+        const std::uint8_t WorkingFlag = 1;
+        const std::uint8_t ChangedFlag = 2;
+        const std::uint8_t ActiveFlag = 4;
+
+        /// @brief  The sideways neighbours of a voxel, and the direction fluid moves when it flows towards each.
+        const std::array<std::array<long, 3>, 4> Sideways = {{ {{-1, 0, 0}}, {{1, 0, 0}}, {{0, 0, -1}}, {{0, 0, 1}} }};
+        const std::array<std::uint8_t, 4> SidewaysDirections = {{FluidSimulation::West, FluidSimulation::East, FluidSimulation::North, FluidSimulation::South}};
+
+        /// @brief  The flow rules of one state, every flow is a function of the voxels around it before the pass.
+        class FlowRules {
+        public:
+            /// @brief  What a voxel is to the moving fluid.
+            enum class Kind {
+                Empty, Fluid, Wall
+            };
+
+        private:
+            const Volume& Source;
+            const std::uint8_t State;
+            const long Gravity;
+            const std::array<long, 3> Size;
+
+        public:
+            FlowRules(const Volume& Source, std::uint8_t State, int Gravity)
+                : Source(Source)
+                , State(State)
+                , Gravity(Gravity)
+                , Size({{static_cast<long>(Source.GetSizeX()), static_cast<long>(Source.GetSizeY()), static_cast<long>(Source.GetSizeZ())}}) {
+            }
+
+            // Voxels outside the volume are walls.
+            Kind GetKind(long X, long Y, long Z, std::uint8_t& Level) const {
+                Level = 0;
+                if ((X < 0) || (Y < 0) || (Z < 0) || (X >= this->Size[0]) || (Y >= this->Size[1]) || (Z >= this->Size[2])) return Kind::Wall;
+                const Voxel& Value = this->Source(X, Y, Z);
+                if (Value.Alpha == 0) return Kind::Empty;
+                if ((Value.State != this->State) || (Value.FillLevel == 0)) return Kind::Wall;
+                Level = Value.FillLevel;
+                return Kind::Fluid;
+            }
+
+            // Room left for fluid of this state.
+            std::uint8_t GetCapacity(long X, long Y, long Z, std::uint8_t& Level) const {
+                switch (this->GetKind(X, Y, Z, Level)) {
+                    case Kind::Empty: return FluidSimulation::MaxFill;
+                    case Kind::Fluid: return static_cast<std::uint8_t>(FluidSimulation::MaxFill - Level);
+                    default: return 0;
+                }
+            }
+
+            // Fluid falls as far as the voxel below has room.
+            std::uint8_t GetFall(long X, long Y, long Z) const {
+                std::uint8_t Level;
+                if (this->GetKind(X, Y, Z, Level) != Kind::Fluid) return 0;
+                std::uint8_t Below;
+                return std::min(Level, this->GetCapacity(X, Y + this->Gravity, Z, Below));
+            }
+
+            // Room left for sideways flow is shared between the sideways neighbours that could flow in.
+            std::uint8_t GetQuota(long X, long Y, long Z) const {
+                std::uint8_t Level;
+                const std::uint8_t Capacity = this->GetCapacity(X, Y, Z, Level);
+                if (Capacity == 0) return 0;
+                std::uint8_t Sources = 0;
+                for (const std::array<long, 3>& Offset : Sideways) {
+                    std::uint8_t NeighbourLevel;
+                    if ((this->GetKind(X + Offset[0], Y, Z + Offset[2], NeighbourLevel) == Kind::Fluid) && (NeighbourLevel > Level + 1)) {
+                        ++Sources;
+                    }
+                }
+                if (Sources == 0) return 0;
+                return static_cast<std::uint8_t>((Capacity - this->GetFall(X, Y - this->Gravity, Z)) / Sources);
+            }
+
+            // What is left after falling is offered to less full sideways neighbours, each offer evening out the levels.
+            std::uint8_t GetFlow(long X, long Y, long Z, std::size_t Side) const {
+                std::uint8_t Level;
+                if (this->GetKind(X, Y, Z, Level) != Kind::Fluid) return 0;
+                const std::uint8_t Rest = static_cast<std::uint8_t>(Level - this->GetFall(X, Y, Z));
+                std::array<std::uint8_t, 4> NeighbourLevels;
+                std::array<bool, 4> Eligible;
+                std::uint8_t EligibleCount = 0;
+                for (std::size_t Index = 0; Index < 4; ++Index) {
+                    const std::uint8_t Capacity = this->GetCapacity(X + Sideways[Index][0], Y, Z + Sideways[Index][2], NeighbourLevels[Index]);
+                    Eligible[Index] = (Capacity > 0) && (NeighbourLevels[Index] + 1 < Rest);
+                    EligibleCount += Eligible[Index] ? 1 : 0;
+                }
+                if (!Eligible[Side]) return 0;
+                const std::uint8_t Offer = static_cast<std::uint8_t>((Rest - NeighbourLevels[Side]) / (EligibleCount + 1));
+                return std::min(Offer, this->GetQuota(X + Sideways[Side][0], Y, Z + Sideways[Side][2]));
+            }
+
+            // Work out the new voxel from the flows into and out of it.
+            Voxel Step(long X, long Y, long Z) const {
+                const Voxel& Current = this->Source(X, Y, Z);
+                std::uint8_t Level;
+                const Kind Own = this->GetKind(X, Y, Z, Level);
+                if (Own == Kind::Wall) return Current;
+
+                // Empty voxels far from fluid stay empty.
+                if (Own == Kind::Empty) {
+                    bool Near = false;
+                    std::uint8_t NeighbourLevel;
+                    Near = Near || (this->GetKind(X, Y - this->Gravity, Z, NeighbourLevel) == Kind::Fluid);
+                    for (const std::array<long, 3>& Offset : Sideways) {
+                        Near = Near || (this->GetKind(X + Offset[0], Y, Z + Offset[2], NeighbourLevel) == Kind::Fluid);
+                    }
+                    if (!Near) return Current;
+                }
+
+                // Flow out, down then sideways.
+                std::size_t Out = 0;
+                if (Own == Kind::Fluid) {
+                    Out += this->GetFall(X, Y, Z);
+                    for (std::size_t Side = 0; Side < 4; ++Side) {
+                        Out += this->GetFlow(X, Y, Z, Side);
+                    }
+                }
+
+                // Flow in from above then from the sides, remembering the first source in case the voxel was empty.
+                const Voxel* FirstSource = nullptr;
+                std::uint8_t FirstDirection = 0;
+                std::size_t In = this->GetFall(X, Y - this->Gravity, Z);
+                if (In != 0) {
+                    FirstSource = &this->Source(X, Y - this->Gravity, Z);
+                    FirstDirection = (this->Gravity < 0) ? FluidSimulation::Down : FluidSimulation::Up;
+                }
+                for (std::size_t Side = 0; Side < 4; ++Side) {
+                    // The neighbour on this side flows back the opposite way.
+                    const std::size_t Opposite = Side ^ 1;
+                    const long NeighbourX = X + Sideways[Side][0];
+                    const long NeighbourZ = Z + Sideways[Side][2];
+                    const std::uint8_t Flow = this->GetFlow(NeighbourX, Y, NeighbourZ, Opposite);
+                    if ((Flow != 0) && (FirstSource == nullptr)) {
+                        FirstSource = &this->Source(NeighbourX, Y, NeighbourZ);
+                        FirstDirection = SidewaysDirections[Opposite];
+                    }
+                    In += Flow;
+                }
+
+                if (In == Out) return Current;
+                const std::size_t NewLevel = Level + In - Out;
+                if (NewLevel == 0) return Voxel();
+                Voxel Result = (Own == Kind::Empty) ? *FirstSource : Current;
+                if (Own == Kind::Empty) {
+                    Result.Direction = FirstDirection;
+                }
+                Result.FillLevel = static_cast<std::uint8_t>(NewLevel);
+                return Result;
+            }
+        };
+    }
+
+    // Nothing to simulate yet.
+    FluidSimulation::FluidSimulation(void)
+        : Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}}) {
+    }
+
+    // Step liquids then gases around the active bricks, the bricks that change stay active.
+    void FluidSimulation::Step(Volume& Target) {
+        Target.Drain(this->Cursor, this->DirtyBricks);
+
+        if (Target.GetSize() != this->Size) {
+            // A new size looks at everything.
+            this->Size = Target.GetSize();
+            this->BrickCount = Target.GetBrickCount();
+            const std::size_t Count = this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2];
+            this->Flags.assign(Count, 0);
+            this->Active.resize(Count);
+            for (std::size_t Brick = 0; Brick < Count; ++Brick) {
+                this->Active[Brick] = Brick;
+            }
+        }
+        else {
+            // Anything else that changed joins the active bricks.
+            for (std::size_t Brick : this->Active) {
+                this->Flags[Brick] |= ActiveFlag;
+            }
+            for (std::size_t Brick : this->DirtyBricks) {
+                if ((this->Flags[Brick] & ActiveFlag) == 0) {
+                    this->Flags[Brick] |= ActiveFlag;
+                    this->Active.push_back(Brick);
+                }
+            }
+            for (std::size_t Brick : this->Active) {
+                this->Flags[Brick] &= static_cast<std::uint8_t>(~ActiveFlag);
+            }
+        }
+
+        this->Changed.clear();
+        if (this->Active.empty()) return;
+
+        // Flows reach a couple of voxels, so a change can move fluid in any touching brick.
+        this->Working.clear();
+        for (std::size_t Brick : this->Active) {
+            this->AddNeighbourhood(Brick, this->Working);
+        }
+        for (std::size_t Brick : this->Working) {
+            this->Flags[Brick] &= static_cast<std::uint8_t>(~WorkingFlag);
+        }
+
+        this->StepState(Target, LiquidState, -1);
+        this->StepState(Target, GasState, 1);
+
+        for (std::size_t Brick : this->Changed) {
+            this->Flags[Brick] &= static_cast<std::uint8_t>(~ChangedFlag);
+        }
+        std::sort(this->Changed.begin(), this->Changed.end());
+        this->Active = this->Changed;
+
+        Target.Drain(this->Cursor, this->DirtyBricks);
+    }
+
+    // Get the changed bricks.
+    const std::vector<std::size_t>& FluidSimulation::GetChangedBricks(void) const {
+        return this->Changed;
+    }
+
+    // Get the number of active bricks.
+    std::size_t FluidSimulation::GetActiveBrickCount(void) const {
+        return this->Active.size();
+    }
+
+    // Step every working brick into the buffer, then write back the bricks that changed.
+    void FluidSimulation::StepState(Volume& Target, std::uint8_t State, int Gravity) {
+        this->Buffer.resize(this->Working.size() * BrickVolume);
+        this->BufferChanged.resize(this->Working.size());
+        const Volume& Source = Target;
+        ThreadPool::GetGlobal().ParallelFor(this->Working.size(), 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                this->BufferChanged[Index] = this->StepBrick(Source, this->Working[Index], State, Gravity, &this->Buffer[Index * BrickVolume]) ? 1 : 0;
+            }
+        });
+
+        // Bricks write disjoint voxels, and only the voxels that changed are written.
+        ThreadPool::GetGlobal().ParallelFor(this->Working.size(), 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                if (this->BufferChanged[Index] == 0) continue;
+                const std::size_t Brick = this->Working[Index];
+                const std::array<std::size_t, 3> Base = {{
+                    (Brick % this->BrickCount[0]) * BrickSize,
+                    ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+                    (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+                }};
+                const Voxel* Output = &this->Buffer[Index * BrickVolume];
+                for (std::size_t IndexZ = Base[2]; IndexZ < std::min(Base[2] + BrickSize, this->Size[2]); ++IndexZ) {
+                    for (std::size_t IndexY = Base[1]; IndexY < std::min(Base[1] + BrickSize, this->Size[1]); ++IndexY) {
+                        for (std::size_t IndexX = Base[0]; IndexX < std::min(Base[0] + BrickSize, this->Size[0]); ++IndexX) {
+                            const Voxel& Value = Output[(IndexX - Base[0]) + BrickSize * ((IndexY - Base[1]) + BrickSize * (IndexZ - Base[2]))];
+                            if (std::memcmp(&Value, &Source(IndexX, IndexY, IndexZ), sizeof(Voxel)) != 0) {
+                                Target.Set(IndexX, IndexY, IndexZ, Value);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        for (std::size_t Index = 0; Index < this->Working.size(); ++Index) {
+            const std::size_t Brick = this->Working[Index];
+            if ((this->BufferChanged[Index] != 0) && ((this->Flags[Brick] & ChangedFlag) == 0)) {
+                this->Flags[Brick] |= ChangedFlag;
+                this->Changed.push_back(Brick);
+            }
+        }
+    }
+
+    // Step each voxel of the brick, comparing with the voxel before.
+    bool FluidSimulation::StepBrick(const Volume& Source, std::size_t Brick, std::uint8_t State, int Gravity, Voxel* Output) const {
+        const FlowRules Rules(Source, State, Gravity);
+        const std::array<std::size_t, 3> Base = {{
+            (Brick % this->BrickCount[0]) * BrickSize,
+            ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+            (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+        }};
+        bool Changed = false;
+        for (std::size_t IndexZ = Base[2]; IndexZ < std::min(Base[2] + BrickSize, this->Size[2]); ++IndexZ) {
+            for (std::size_t IndexY = Base[1]; IndexY < std::min(Base[1] + BrickSize, this->Size[1]); ++IndexY) {
+                for (std::size_t IndexX = Base[0]; IndexX < std::min(Base[0] + BrickSize, this->Size[0]); ++IndexX) {
+                    Voxel& Value = Output[(IndexX - Base[0]) + BrickSize * ((IndexY - Base[1]) + BrickSize * (IndexZ - Base[2]))];
+                    Value = Rules.Step(static_cast<long>(IndexX), static_cast<long>(IndexY), static_cast<long>(IndexZ));
+                    Changed = Changed || (std::memcmp(&Value, &Source(IndexX, IndexY, IndexZ), sizeof(Voxel)) != 0);
+                }
+            }
+        }
+        return Changed;
+    }
+
+    // Add the bricks of the 3x3x3 block around a brick.
+    void FluidSimulation::AddNeighbourhood(std::size_t Brick, std::vector<std::size_t>& List) {
+        const std::array<std::size_t, 3> Centre = {{Brick % this->BrickCount[0], (Brick / this->BrickCount[0]) % this->BrickCount[1], Brick / (this->BrickCount[0] * this->BrickCount[1])}};
+        for (std::size_t IndexZ = (Centre[2] > 0) ? (Centre[2] - 1) : 0; IndexZ < std::min(Centre[2] + 2, this->BrickCount[2]); ++IndexZ) {
+            for (std::size_t IndexY = (Centre[1] > 0) ? (Centre[1] - 1) : 0; IndexY < std::min(Centre[1] + 2, this->BrickCount[1]); ++IndexY) {
+                for (std::size_t IndexX = (Centre[0] > 0) ? (Centre[0] - 1) : 0; IndexX < std::min(Centre[0] + 2, this->BrickCount[0]); ++IndexX) {
+                    const std::size_t Neighbour = IndexX + this->BrickCount[0] * (IndexY + this->BrickCount[1] * IndexZ);
+                    if ((this->Flags[Neighbour] & WorkingFlag) == 0) {
+                        this->Flags[Neighbour] |= WorkingFlag;
+                        List.push_back(Neighbour);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,132 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_FLUIDSIMULATION_HPP
+#define RAYMARCH_FLUIDSIMULATION_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  FluidSimulation steps the liquids and gases of a volume as a cellular automaton.
+    ///         A fluid voxel is an occupied voxel in the liquid or gas state with a non-zero FillLevel, the amount of fluid it holds, every other occupied voxel is a wall.
+    ///         Liquids fall and gases rise into empty voxels or less full voxels of the same state, then what is left spreads sideways towards less full neighbours.
+    ///         Each voxel gathers its new amount from the flows into and out of it, and every flow is worked out the same way by both of its voxels, so fluid is never made or lost.
+    ///         Voxels filled from empty copy the voxel they were filled from, with Direction set to the way the fluid moved.
+    ///         Each state is one pass, the new voxels of a brick are written to a buffer and bricks are only written back once every brick of the pass has been stepped.
+    ///         Only bricks changed by the last step or by anything else, and the bricks around them, are stepped, so quiet fluid costs nothing.
+    class FluidSimulation {
+    public:
+        /// @brief  The material state of gases.
+        constexpr static const std::uint8_t GasState = 0;
+        /// @brief  The material state of liquids.
+        constexpr static const std::uint8_t LiquidState = 1;
+        /// @brief  The amount of fluid in a full voxel.
+        constexpr static const std::uint8_t MaxFill = 7;
+
+        /// @brief  Values of Voxel::Direction for the ways fluid moves.
+        constexpr static const std::uint8_t North = 1;
+        constexpr static const std::uint8_t West = 2;
+        constexpr static const std::uint8_t East = 3;
+        constexpr static const std::uint8_t South = 4;
+        constexpr static const std::uint8_t Up = 5;
+        constexpr static const std::uint8_t Down = 6;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  Tracks the bricks of the volume changed since the last step.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last step, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The bricks that changed recently, the next step starts from these.
+        std::vector<std::size_t> Active;
+
+        /// @brief  The bricks written by the last step in ascending order.
+        std::vector<std::size_t> Changed;
+
+        /// @brief  The bricks stepped by a pass, the active bricks and the bricks around them.
+        std::vector<std::size_t> Working;
+
+        /// @brief  A flag per brick, used to gather lists of bricks without repeats.
+        std::vector<std::uint8_t> Flags;
+
+        /// @brief  The new voxels of each working brick in X-major order, and whether each brick changed.
+        std::vector<Voxel> Buffer;
+        std::vector<std::uint8_t> BufferChanged;
+
+    public:
+        /// @brief  Constructor that creates a simulation of nothing.
+        FluidSimulation(void);
+
+    public:
+        /// @brief  Step the fluids of a volume once, liquids then gases.
+        ///         The first step, and any step with a volume of another size, visits every brick once to find the fluids.
+        ///         The writes of a step are not counted as changes by the next step, it carries its own active bricks instead.
+        /// @param  Target - The volume to simulate, always the same volume, not written by anything else during the step.
+        void Step(Volume& Target);
+
+        /// @brief  Get the bricks written by the last step.
+        /// @return The linear indices of the bricks in ascending order.
+        const std::vector<std::size_t>& GetChangedBricks(void) const;
+
+        /// @brief  Get the number of bricks the next step starts from.
+        /// @return The number of active bricks.
+        std::size_t GetActiveBrickCount(void) const;
+
+    private:
+        /// @brief  Step one state over the working bricks, then write back the bricks that changed.
+        /// @param  Target - The volume being simulated.
+        /// @param  State - The state of the fluid to move.
+        /// @param  Gravity - The way the fluid falls along Y, -1 for liquids and +1 for gases.
+        void StepState(Volume& Target, std::uint8_t State, int Gravity);
+
+        /// @brief  Work out the new voxels of one brick from the volume.
+        /// @param  Source - The volume being simulated.
+        /// @param  Brick - The linear index of the brick.
+        /// @param  State - The state of the fluid to move.
+        /// @param  Gravity - The way the fluid falls along Y.
+        /// @param  Output - Output for the new voxels of the brick in X-major order, BrickVolume entries.
+        /// @return True if any voxel of the brick changed.
+        bool StepBrick(const Volume& Source, std::size_t Brick, std::uint8_t State, int Gravity, Voxel* Output) const;
+
+        /// @brief  Add a brick and every brick touching it to a list, skipping bricks already flagged.
+        /// @param  Brick - The linear index of the brick.
+        /// @param  List - The list to add to.
+        void AddNeighbourhood(std::size_t Brick, std::vector<std::size_t>& List);
+    };
+}
+
+#endif // RAYMARCH_FLUIDSIMULATION_HPP
@@ -23,13 +23,18 @@ THE SOFTWARE
 */
 
 #include "GameState.hpp"
+#include "ThreadPool.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstring>
+#include <utility>
 
 namespace DeferredRasterisation {
     // Constructor that initialises all member variables with workable defaults.
-    GameState::GameState(const std::array<std::size_t, 3>& SceneSize) {
+    GameState::GameState(const std::array<std::size_t, 3>& SceneSize)
+        : SceneVersions(SceneSize) {
         // Offset of the visible scene in the map.
         this->SceneOffset = {{static_cast<int>(SceneSize[0]) / 2, 0, static_cast<int>(SceneSize[2]) / 2}};
 
@@ -39,6 +44,12 @@ namespace DeferredRasterisation {
         // Floating point speed.
         this->SceneVelocity = {{0, 0, 0}};
 
+        // Size of the player's collision box.
+        this->PlayerExtent = {{2.0f, 4.0f, 2.0f}};
+
+        // Height the player's collision box clears, the grass is up to four voxels deep.
+        this->PlayerStepHeight = 4.0f;
+
         // Position of the sun / global light source.
         this->LightPosition  = {{0, 1024, 0}};
 
@@ -62,6 +73,20 @@ namespace DeferredRasterisation {
 
         // The rendered scene volume, the map is unioned into this before rendering.
         this->Scene = Volume(SceneSize);
+        this->SceneBuffer = Volume(SceneSize);
+
+        // The scene is constructed on the first update.
+        this->SceneBuiltOffset = this->SceneOffset;
+        this->SceneStale = true;
+        this->SceneMatchesBake = false;
+
+        // No simulation time has passed.
+        this->SimulationTime = 0.0f;
+
+        // Queries see the empty scene until the first update.
+        this->SceneOccupancy.Update(this->Scene);
+        this->SceneShadows.Update(this->Scene, this->LightPosition);
+        this->SceneOcclusion.Update(this->Scene, this->SceneOccupancy);
     }
 
     // Get the scene offset, the renderer shader applies noise based on position.
@@ -109,14 +134,69 @@ namespace DeferredRasterisation {
         return this->Scene;
     }
 
+    // Get the last published scene.
+    VersionedVolume::Snapshot GameState::GetSceneSnapshot(void) const {
+        return this->SceneVersions.Acquire();
+    }
+
+    // Get the scene occupancy.
+    const OccupancyBitPlane& GameState::GetSceneOccupancy(void) const {
+        return this->SceneOccupancy;
+    }
+
+    // Get the scene shadows.
+    const SunShadowMap& GameState::GetSceneShadows(void) const {
+        return this->SceneShadows;
+    }
+
+    // Get the scene occlusion.
+    const AmbientOcclusion& GameState::GetSceneOcclusion(void) const {
+        return this->SceneOcclusion;
+    }
+
+    // Bring the scene sums up to date and get them.
+    const SummedVolumeTable& GameState::GetSceneSums(void) {
+        this->SceneSums.Update(this->Scene);
+        return this->SceneSums;
+    }
+
+    // Bring the scene pyramid up to date and get it.
+    const VolumePyramid& GameState::GetScenePyramid(void) {
+        this->ScenePyramid.Update(this->Scene);
+        return this->ScenePyramid;
+    }
+
+    // Bring the distance field up to date and get it.
+    const DistanceField& GameState::GetSceneDistances(void) {
+        this->SceneDistances.Update(this->Scene);
+        return this->SceneDistances;
+    }
+
+    // Trace a ray through the scene at its offset in the map.
+    RayCaster::Hit GameState::CastRay(const RayCaster::Ray& Query) const {
+        return RayCaster::Trace(this->Scene, this->SceneOccupancy, this->SceneOffset, Query);
+    }
+
+    // Trace rays through the scene at its offset in the map.
+    void GameState::CastRays(const std::vector<RayCaster::Ray>& Queries, std::vector<RayCaster::Hit>& Hits) const {
+        RayCaster::TraceBatch(this->Scene, this->SceneOccupancy, this->SceneOffset, Queries, Hits);
+    }
+
     // Clear all models from the map.
     void GameState::ClearMap(void) {
         this->Map.clear();
+        this->ProceduralMap.clear();
+        this->ProceduralOrder.clear();
+        this->EditedBricks.clear();
+        this->SceneStale = true;
     }
 
     // Set a map.
     void GameState::SetMap(const std::vector<std::pair<std::array<int, 3>, Volume> >& Map) {
         this->Map = Map;
+        std::fill(this->ProceduralOrder.begin(), this->ProceduralOrder.end(), 0);
+        this->EditedBricks.clear();
+        this->SceneStale = true;
     }
 
     // Get the map.
@@ -127,6 +207,64 @@ namespace DeferredRasterisation {
     // Add a model to the map at a position.
     void GameState::AddToMap(const std::array<int, 3>& Position, const Volume& Model) {
         this->Map.push_back(std::make_pair(Position, Model));
+        // Edited bricks cover the map, so the model is written over them too.
+        for (std::pair<const std::array<int, 3>, Volume>& BrickIndexBrickPair : this->EditedBricks) {
+            const std::array<int, 3>& BrickIndex = BrickIndexBrickPair.first;
+            const int Size = static_cast<int>(BrickSize);
+            BrickIndexBrickPair.second.Insert(Position[0] - BrickIndex[0] * Size, Position[1] - BrickIndex[1] * Size, Position[2] - BrickIndex[2] * Size, Model);
+        }
+        this->SceneStale = true;
+    }
+
+    // Get the procedural volumes of the map.
+    const std::vector<std::pair<std::array<int, 3>, ProceduralVolume> >& GameState::GetProceduralMap(void) const {
+        return this->ProceduralMap;
+    }
+
+    // Add a procedural model to the map at a position.
+    void GameState::AddToMap(const std::array<int, 3>& Position, const ProceduralVolume& Model) {
+        this->ProceduralMap.push_back(std::make_pair(Position, Model));
+        this->ProceduralOrder.push_back(this->Map.size());
+        // Edited bricks cover the map, so the model is written over them too.
+        for (std::pair<const std::array<int, 3>, Volume>& BrickIndexBrickPair : this->EditedBricks) {
+            const std::array<int, 3>& BrickIndex = BrickIndexBrickPair.first;
+            const int Size = static_cast<int>(BrickSize);
+            Model.InsertInto(Position[0] - BrickIndex[0] * Size, Position[1] - BrickIndex[1] * Size, Position[2] - BrickIndex[2] * Size, BrickIndexBrickPair.second);
+        }
+        this->SceneStale = true;
+    }
+
+    // Set the baked world.
+    void GameState::SetSceneCache(const std::shared_ptr<const SceneCache>& Cache) {
+        assert((Cache == nullptr) || Cache->IsOpen());
+        this->BakedScene = Cache;
+        this->EditedBricks.clear();
+        this->SceneStale = true;
+    }
+
+    // Get the baked world.
+    const std::shared_ptr<const SceneCache>& GameState::GetSceneCache(void) const {
+        return this->BakedScene;
+    }
+
+    // Test if the scene is still the baked world.
+    bool GameState::IsSceneBaked(void) const {
+        return this->SceneMatchesBake;
+    }
+
+    // Get the edit queue.
+    EditQueue& GameState::GetEditQueue(void) {
+        return this->Edits;
+    }
+
+    // Get the entities to move them.
+    std::vector<Entity>& GameState::GetEntities(void) {
+        return this->Entities;
+    }
+
+    // Get the entities, the renderer draws each with its own model matrix.
+    const std::vector<Entity>& GameState::GetEntities(void) const {
+        return this->Entities;
     }
 
     // Apply a key press to the game state.
@@ -153,9 +291,25 @@ namespace DeferredRasterisation {
 
     // Update the game state after a time.
     void GameState::Update(float DeltaTime) {
-        // Move player.
+        // Apply edits before anything reads the scene.
+        this->ApplyEdits();
+        this->SceneOccupancy.Update(this->Scene);
+
+        // Move player, the collision box stands centred under the camera target, which the camera follows as the scene scrolls.
+        const std::array<float, 3> PlayerOffset = {{
+            this->CameraTarget[0] * VoxelsPerUnit - this->PlayerExtent[0] / 2.0f,
+            this->CameraTarget[1] * VoxelsPerUnit + this->PlayerStepHeight,
+            this->CameraTarget[2] * VoxelsPerUnit - this->PlayerExtent[2] / 2.0f
+        }};
+        Collision::Body Player;
         for (std::size_t Index = 0; Index < 3; ++Index) {
-            this->ScenePosition[Index] += this->SceneVelocity[Index] * DeltaTime;
+            Player.Position[Index] = this->ScenePosition[Index] + PlayerOffset[Index];
+        }
+        Player.Extent = this->PlayerExtent;
+        Player.Velocity = this->SceneVelocity;
+        Collision::Sweep(this->SceneOccupancy, this->SceneBuiltOffset, DeltaTime, Player);
+        for (std::size_t Index = 0; Index < 3; ++Index) {
+            this->ScenePosition[Index] = Player.Position[Index] - PlayerOffset[Index];
         }
 
         // Update scene offset from position.
@@ -178,14 +332,317 @@ namespace DeferredRasterisation {
             this->FogColour[Index] = NewFogColour;
         }
 
-        // Clear current scene.
-        this->Scene.Clear();
+        // The scene only changes when the map or the scene offset does, otherwise it is left untouched so nothing is marked as changed.
+        if (this->SceneStale || (this->SceneBuiltOffset != this->SceneOffset)) {
+            const bool Scrolled = this->Rebuild();
+
+            // The new scene is the bake only if nothing else is composited over it, and a scrolled scene only if the old one was, later writes are found by the cursor.
+            this->Scene.Drain(this->SceneBakeCursor, this->SceneDirtyBricks);
+            this->SceneMatchesBake = (!Scrolled || this->SceneMatchesBake) && (this->BakedScene != nullptr) && this->Map.empty() && this->ProceduralMap.empty() && this->EditedBricks.empty();
+        }
+
+        // Step falling structures and fluids at a fixed rate.
+        this->SimulationTime = std::min(this->SimulationTime + DeltaTime, static_cast<float>(MaxSimulationSteps) * SimulationStepTime);
+        while (this->SimulationTime >= SimulationStepTime) {
+            this->SimulationTime -= SimulationStepTime;
+            this->SceneIntegrity.Step(this->Scene, this->SceneBuiltOffset, [this](const std::array<int, 3>& Offset, Volume& Target) -> void {
+                this->Composite(Offset, Target);
+            });
+            this->Persist(this->SceneIntegrity.GetChangedBricks());
+            this->SceneFluids.Step(this->Scene);
+            this->Persist(this->SceneFluids.GetChangedBricks());
+        }
+
+        // Light the changed parts of the scene, before publishing so snapshots include it.
+        this->SceneLighting.Update(this->Scene);
+
+        // Any write since the scene was constructed, an edit, light, or a simulation step, leaves it different from the bake.
+        if (this->SceneMatchesBake && this->Scene.IsDirty(this->SceneBakeCursor)) {
+            this->SceneMatchesBake = false;
+        }
+
+        // Publish the changed bricks of the scene, unchanged bricks stay shared with earlier versions.
+        this->Scene.Drain(this->SceneVersionsCursor, this->SceneDirtyBricks);
+        if (!this->SceneDirtyBricks.empty()) {
+            this->SceneVersions.CopyBricks(this->Scene, this->SceneDirtyBricks);
+            this->SceneVersions.Publish();
+        }
+
+        // Bring the occupancy used by queries up to date with the scene.
+        this->SceneOccupancy.Update(this->Scene);
+
+        // Bring the sun shadows up to date with the scene and the moved sun.
+        this->SceneShadows.Update(this->Scene, this->LightPosition);
+
+        // Bake ambient occlusion around the changed parts of the scene.
+        this->SceneOcclusion.Update(this->Scene, this->SceneOccupancy);
+    }
+
+    // Composite the map into a volume, then the edits over it.
+    void GameState::Composite(const std::array<int, 3>& Offset, Volume& Target) const {
+        this->CompositeUnedited(Offset, Target);
+        this->InsertEditedBricks(Offset, Target);
+    }
+
+    // Composite the map into a volume, as it was generated.
+    void GameState::CompositeUnedited(const std::array<int, 3>& Offset, Volume& Target) const {
+        // Clear current contents.
+        Target.Clear();
+
+        // Add the baked world, copying only the bricks that are visible.
+        if (this->BakedScene != nullptr) {
+            const std::array<int, 3>& Origin = this->BakedScene->GetOrigin();
+            this->BakedScene->GetWorld().InsertInto(Origin[0] - Offset[0], Origin[1] - Offset[1], Origin[2] - Offset[2], Target);
+        }
+
+        // Add procedural model data, generating only the chunks that are visible, in order with the model data.
+        std::size_t ProceduralIndex = 0;
+        auto InsertProcedural = [&](std::size_t ModelCount) -> void {
+            for (; (ProceduralIndex < this->ProceduralMap.size()) && (this->ProceduralOrder[ProceduralIndex] <= ModelCount); ++ProceduralIndex) {
+                const std::array<int, 3>& Position = this->ProceduralMap[ProceduralIndex].first;
+                const ProceduralVolume& Model = this->ProceduralMap[ProceduralIndex].second;
+                Model.InsertInto(Position[0] - Offset[0], Position[1] - Offset[1], Position[2] - Offset[2], Target);
+            }
+        };
+
+        // Add model data, each over the procedural models added before it.
+        for (std::size_t ModelIndex = 0; ModelIndex < this->Map.size(); ++ModelIndex) {
+            InsertProcedural(ModelIndex);
+            const std::array<int, 3>& Position = this->Map[ModelIndex].first;
+            const Volume& Model = this->Map[ModelIndex].second;
+            Target.Insert(Position[0] - Offset[0], Position[1] - Offset[1], Position[2] - Offset[2], Model);
+        }
+        InsertProcedural(this->Map.size());
+    }
+
+    // Insert the edited bricks that overlap a volume, they already hold everything beneath them.
+    void GameState::InsertEditedBricks(const std::array<int, 3>& Offset, Volume& Target) const {
+        if (this->EditedBricks.empty()) return;
+        const int Size = static_cast<int>(BrickSize);
+        auto GetBrickIndex = [Size](int Position) -> int { return (Position >= 0) ? (Position / Size) : -((Size - 1 - Position) / Size); };
+        const std::array<std::size_t, 3> TargetSize = Target.GetSize();
+        std::array<int, 3> Begin;
+        std::array<int, 3> End;
+        std::size_t RangeCount = 1;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            if (TargetSize[Axis] == 0) return;
+            Begin[Axis] = GetBrickIndex(Offset[Axis]);
+            End[Axis] = GetBrickIndex(Offset[Axis] + static_cast<int>(TargetSize[Axis]) - 1) + 1;
+            RangeCount *= static_cast<std::size_t>(End[Axis] - Begin[Axis]);
+        }
+
+        auto InsertBrick = [&](const std::pair<const std::array<int, 3>, Volume>& BrickIndexBrickPair) -> void {
+            const std::array<int, 3>& BrickIndex = BrickIndexBrickPair.first;
+            Target.Insert(BrickIndex[0] * Size - Offset[0], BrickIndex[1] * Size - Offset[1], BrickIndex[2] * Size - Offset[2], BrickIndexBrickPair.second);
+        };
+
+        // Look up each brick of the volume when it covers fewer bricks than were edited, otherwise walk the edited bricks and let the volume clip them.
+        if (RangeCount < this->EditedBricks.size()) {
+            for (int BrickZ = Begin[2]; BrickZ < End[2]; ++BrickZ) {
+                for (int BrickY = Begin[1]; BrickY < End[1]; ++BrickY) {
+                    for (int BrickX = Begin[0]; BrickX < End[0]; ++BrickX) {
+                        std::map<std::array<int, 3>, Volume>::const_iterator Found = this->EditedBricks.find({{BrickX, BrickY, BrickZ}});
+                        if (Found != this->EditedBricks.end()) {
+                            InsertBrick(*Found);
+                        }
+                    }
+                }
+            }
+        }
+        else {
+            for (const std::pair<const std::array<int, 3>, Volume>& BrickIndexBrickPair : this->EditedBricks) {
+                InsertBrick(BrickIndexBrickPair);
+            }
+        }
+    }
+
+    // Keep each brick that differs from the unedited map, ignoring light which the scene lighting recomputes, and drop each that matches it again.
+    void GameState::StoreEditedBricks(const std::array<int, 3>& Origin, const Volume& Edited, const Volume& Unedited) {
+        const int Size = static_cast<int>(BrickSize);
+        const std::array<std::size_t, 3> VolumeSize = Edited.GetSize();
+        const std::array<std::size_t, 3>& BrickCount = Edited.GetBrickCount();
+        for (std::size_t BrickZ = 0; BrickZ < BrickCount[2]; ++BrickZ) {
+            for (std::size_t BrickY = 0; BrickY < BrickCount[1]; ++BrickY) {
+                for (std::size_t BrickX = 0; BrickX < BrickCount[0]; ++BrickX) {
+                    bool Differs = false;
+                    for (std::size_t IndexZ = BrickZ * BrickSize; (IndexZ < std::min((BrickZ + 1) * BrickSize, VolumeSize[2])) && !Differs; ++IndexZ) {
+                        for (std::size_t IndexY = BrickY * BrickSize; (IndexY < std::min((BrickY + 1) * BrickSize, VolumeSize[1])) && !Differs; ++IndexY) {
+                            for (std::size_t IndexX = BrickX * BrickSize; (IndexX < std::min((BrickX + 1) * BrickSize, VolumeSize[0])) && !Differs; ++IndexX) {
+                                Voxel EditedValue = Edited(IndexX, IndexY, IndexZ);
+                                Voxel UneditedValue = Unedited(IndexX, IndexY, IndexZ);
+                                EditedValue.Light = 0;
+                                UneditedValue.Light = 0;
+                                Differs = std::memcmp(&EditedValue, &UneditedValue, sizeof(Voxel)) != 0;
+                            }
+                        }
+                    }
+
+                    const std::array<int, 3> BrickIndex = {{Origin[0] / Size + static_cast<int>(BrickX), Origin[1] / Size + static_cast<int>(BrickY), Origin[2] / Size + static_cast<int>(BrickZ)}};
+                    if (!Differs) {
+                        this->EditedBricks.erase(BrickIndex);
+                        continue;
+                    }
+                    Volume& Brick = this->EditedBricks[BrickIndex];
+                    if (Brick.GetSizeX() != BrickSize) {
+                        Brick = Volume(BrickSize, BrickSize, BrickSize);
+                    }
+                    Brick.Insert(-static_cast<int>(BrickX) * Size, -static_cast<int>(BrickY) * Size, -static_cast<int>(BrickZ) * Size, Edited);
+                }
+            }
+        }
+    }
+
+    // Build the next scene in the buffer, then copy it over the scene so bricks that come out the same, such as open air, stay unchanged.
+    bool GameState::Rebuild(void) {
+        const std::array<std::size_t, 3> SceneSize = this->Scene.GetSize();
+        std::array<int, 3> Shift;
+        bool Scrolled = !this->SceneStale;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Shift[Axis] = this->SceneOffset[Axis] - this->SceneBuiltOffset[Axis];
+            Scrolled = Scrolled && (std::abs(Shift[Axis]) < static_cast<int>(SceneSize[Axis]));
+        }
+
+        if (!Scrolled) {
+            this->Composite(this->SceneOffset, this->SceneBuffer);
+        }
+        else {
+            // The overlap moves against the shift.
+            this->SceneBuffer.Insert(-Shift[0], -Shift[1], -Shift[2], this->Scene);
+
+            // Each moved axis exposes a slab across the scene on the side moved towards, the slabs of a diagonal move share their corners.
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                if (Shift[Axis] == 0) continue;
+                std::array<std::size_t, 3> SlabSize = SceneSize;
+                SlabSize[Axis] = static_cast<std::size_t>(std::abs(Shift[Axis]));
+                std::array<int, 3> SlabPosition = {{0, 0, 0}};
+                if (Shift[Axis] > 0) {
+                    SlabPosition[Axis] = static_cast<int>(SceneSize[Axis]) - Shift[Axis];
+                }
+                Volume Slab(SlabSize);
+                this->Composite({{this->SceneOffset[0] + SlabPosition[0], this->SceneOffset[1] + SlabPosition[1], this->SceneOffset[2] + SlabPosition[2]}}, Slab);
+                this->SceneBuffer.Insert(SlabPosition[0], SlabPosition[1], SlabPosition[2], Slab);
+            }
+        }
+
+        this->Scene.Insert(0, 0, 0, this->SceneBuffer);
+        this->SceneBuiltOffset = this->SceneOffset;
+        this->SceneStale = false;
+        return Scrolled;
+    }
+
+    // Apply the queued edits.
+    void GameState::ApplyEdits(void) {
+        this->Edits.Take(this->PendingEdits);
+        if (this->PendingEdits.empty()) return;
+
+        // Bucket the edits by the chunks they touch, consecutive edits usually share a chunk so the last bucket is kept.
+        const int Size = static_cast<int>(EditChunkSize);
+        auto GetChunkIndex = [Size](int Position) -> int { return (Position >= 0) ? (Position / Size) : -((Size - 1 - Position) / Size); };
+        std::map<std::array<int, 3>, std::vector<EditQueue::Edit> > Buckets;
+        std::array<int, 3> LastChunkIndex = {{0, 0, 0}};
+        std::vector<EditQueue::Edit>* LastBucket = nullptr;
+        for (const EditQueue::Edit& Value : this->PendingEdits) {
+            std::array<int, 3> Begin;
+            std::array<int, 3> End;
+            bool Empty = false;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Empty = Empty || (Value.Begin[Axis] >= Value.End[Axis]);
+                Begin[Axis] = GetChunkIndex(Value.Begin[Axis]);
+                End[Axis] = GetChunkIndex(Value.End[Axis] - 1) + 1;
+            }
+            if (Empty) continue;
+            // Only removed structure can leave structure unsupported, edits that add or recolour structure are settled.
+            if ((Value.Type == EditQueue::EditType::CarveSphere) || !StructuralIntegrity::IsStructural(Value.Value)) {
+                this->SceneIntegrity.MarkRemoved(Value.Begin, Value.End);
+            }
+            for (int ChunkZ = Begin[2]; ChunkZ < End[2]; ++ChunkZ) {
+                for (int ChunkY = Begin[1]; ChunkY < End[1]; ++ChunkY) {
+                    for (int ChunkX = Begin[0]; ChunkX < End[0]; ++ChunkX) {
+                        const std::array<int, 3> ChunkIndex = {{ChunkX, ChunkY, ChunkZ}};
+                        if ((LastBucket == nullptr) || (ChunkIndex != LastChunkIndex)) {
+                            LastBucket = &Buckets[ChunkIndex];
+                            LastChunkIndex = ChunkIndex;
+                        }
+                        LastBucket->push_back(Value);
+                    }
+                }
+            }
+        }
 
-        // Add model data to the scene.
-        for (const std::pair<std::array<int, 3>, Volume>& PositionModelPair : this->Map) {
-            const std::array<int, 3>& Position = PositionModelPair.first;
-            const Volume& Model = PositionModelPair.second;
-            this->Scene.Insert(Position[0] - this->SceneOffset[0], Position[1] - this->SceneOffset[1], Position[2] - this->SceneOffset[2], Model);
+        // Each touched chunk is composited as generated, and edited from a copy with the earlier edits inserted.
+        std::vector<std::array<int, 3> > Origins;
+        std::vector<Volume> Unedited;
+        std::vector<Volume> Chunks;
+        std::vector<const std::vector<EditQueue::Edit>*> ChunkEdits;
+        Origins.reserve(Buckets.size());
+        Unedited.reserve(Buckets.size());
+        Chunks.reserve(Buckets.size());
+        for (const std::pair<const std::array<int, 3>, std::vector<EditQueue::Edit> >& ChunkIndexBucketPair : Buckets) {
+            const std::array<int, 3>& ChunkIndex = ChunkIndexBucketPair.first;
+            const std::array<int, 3> Origin = {{ChunkIndex[0] * Size, ChunkIndex[1] * Size, ChunkIndex[2] * Size}};
+            Origins.push_back(Origin);
+            Unedited.emplace_back(EditChunkSize, EditChunkSize, EditChunkSize);
+            this->CompositeUnedited(Origin, Unedited.back());
+            Chunks.push_back(Unedited.back());
+            this->InsertEditedBricks(Origin, Chunks.back());
+            ChunkEdits.push_back(&ChunkIndexBucketPair.second);
+        }
+
+        // Chunks are independent, and each applies its edits a brick per worker.
+        ThreadPool::GetGlobal().ParallelFor(Chunks.size(), 1, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                EditQueue::Apply(*ChunkEdits[Index], Origins[Index], Chunks[Index]);
+            }
+        });
+
+        // Keep the bricks that now differ from the map, and copy the chunks into the scene unless it is about to be constructed again anyway.
+        for (std::size_t Index = 0; Index < Chunks.size(); ++Index) {
+            const std::array<int, 3>& Origin = Origins[Index];
+            this->StoreEditedBricks(Origin, Chunks[Index], Unedited[Index]);
+            if (!this->SceneStale) {
+                this->Scene.Insert(Origin[0] - this->SceneBuiltOffset[0], Origin[1] - this->SceneBuiltOffset[1], Origin[2] - this->SceneBuiltOffset[2], Chunks[Index]);
+            }
+        }
+    }
+
+    // Gather the map bricks the changed scene bricks overlap, then store each again with the part the scene covers copied from it.
+    void GameState::Persist(const std::vector<std::size_t>& Bricks) {
+        if (Bricks.empty()) return;
+        const int Size = static_cast<int>(BrickSize);
+        auto GetBrickIndex = [Size](int Position) -> int { return (Position >= 0) ? (Position / Size) : -((Size - 1 - Position) / Size); };
+        const std::array<std::size_t, 3>& SceneSize = this->Scene.GetSize();
+        const std::array<std::size_t, 3>& BrickCount = this->Scene.GetBrickCount();
+
+        // The scene is offset from the map, so each of its bricks overlaps up to eight map bricks.
+        std::vector<std::array<int, 3> > MapBricks;
+        for (std::size_t Brick : Bricks) {
+            const std::array<std::size_t, 3> BrickPosition = {{Brick % BrickCount[0], (Brick / BrickCount[0]) % BrickCount[1], Brick / (BrickCount[0] * BrickCount[1])}};
+            std::array<int, 3> Begin;
+            std::array<int, 3> End;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Begin[Axis] = GetBrickIndex(static_cast<int>(BrickPosition[Axis] * BrickSize) + this->SceneBuiltOffset[Axis]);
+                End[Axis] = GetBrickIndex(static_cast<int>(std::min((BrickPosition[Axis] + 1) * BrickSize, SceneSize[Axis])) + this->SceneBuiltOffset[Axis] - 1) + 1;
+            }
+            for (int BrickZ = Begin[2]; BrickZ < End[2]; ++BrickZ) {
+                for (int BrickY = Begin[1]; BrickY < End[1]; ++BrickY) {
+                    for (int BrickX = Begin[0]; BrickX < End[0]; ++BrickX) {
+                        MapBricks.push_back({{BrickX, BrickY, BrickZ}});
+                    }
+                }
+            }
+        }
+        std::sort(MapBricks.begin(), MapBricks.end());
+        MapBricks.erase(std::unique(MapBricks.begin(), MapBricks.end()), MapBricks.end());
+
+        Volume Unedited(BrickSize, BrickSize, BrickSize);
+        Volume Edited(BrickSize, BrickSize, BrickSize);
+        for (const std::array<int, 3>& BrickIndex : MapBricks) {
+            const std::array<int, 3> Origin = {{BrickIndex[0] * Size, BrickIndex[1] * Size, BrickIndex[2] * Size}};
+            this->CompositeUnedited(Origin, Unedited);
+            std::map<std::array<int, 3>, Volume>::const_iterator Found = this->EditedBricks.find(BrickIndex);
+            Edited.Insert(0, 0, 0, (Found != this->EditedBricks.end()) ? Found->second : Unedited);
+            Edited.Insert(this->SceneBuiltOffset[0] - Origin[0], this->SceneBuiltOffset[1] - Origin[1], this->SceneBuiltOffset[2] - Origin[2], this->Scene);
+            this->StoreEditedBricks(Origin, Edited, Unedited);
         }
     }
 }
@@ -26,9 +26,27 @@ THE SOFTWARE
 #ifndef RAYMARCH_GAMESTATE_HPP
 #define RAYMARCH_GAMESTATE_HPP
 
+#include "AmbientOcclusion.hpp"
+#include "Collision.hpp"
+#include "DistanceField.hpp"
+#include "EditQueue.hpp"
+#include "Entity.hpp"
+#include "FluidSimulation.hpp"
+#include "LightPropagator.hpp"
+#include "OccupancyBitPlane.hpp"
+#include "ProceduralVolume.hpp"
+#include "RayCaster.hpp"
+#include "StructuralIntegrity.hpp"
+#include "SummedVolumeTable.hpp"
+#include "SceneCache.hpp"
+#include "SunShadowMap.hpp"
+#include "VersionedVolume.hpp"
 #include "Volume.hpp"
+#include "VolumePyramid.hpp"
 
 #include <array>
+#include <map>
+#include <memory>
 #include <vector>
 
 namespace DeferredRasterisation {
@@ -56,6 +74,12 @@ namespace DeferredRasterisation {
         /// @brief  The player velocity.
         std::array<float, 3> SceneVelocity;
 
+        /// @brief  The size of the player's collision box, which stands under the camera target.
+        std::array<float, 3> PlayerExtent;
+
+        /// @brief  The height the player's collision box is lifted above the camera target, so it steps over ground cover instead of into it.
+        float PlayerStepHeight;
+
     private:
         /// @brief  The global light position.
         std::array<float, 3> LightPosition;
@@ -85,19 +109,111 @@ namespace DeferredRasterisation {
         /// @brief  An array of volumes to render at locations.
         std::vector<std::pair<std::array<int, 3>, Volume> > Map;
 
+        /// @brief  An array of procedural volumes to render at locations, only the chunks within the scene are generated.
+        std::vector<std::pair<std::array<int, 3>, ProceduralVolume> > ProceduralMap;
+
+        /// @brief  The number of volumes in Map when each procedural volume was added, so later models are composited over earlier ones whatever their kind.
+        std::vector<std::size_t> ProceduralOrder;
+
+        /// @brief  A baked world mapped from disk, inserted beneath the rest of the map.
+        std::shared_ptr<const SceneCache> BakedScene;
+
         /// @brief  The scene rendered by the renderer, constructed from the map.
         Volume Scene;
 
+        /// @brief  The next scene is built here and then copied over the scene, so only bricks that differ are marked as changed.
+        Volume SceneBuffer;
+
+        /// @brief  The scene offset the scene was last constructed at.
+        std::array<int, 3> SceneBuiltOffset;
+
+        /// @brief  Set when the map changes, so the scene is constructed again.
+        bool SceneStale;
+
+        /// @brief  Set while the scene holds nothing but the baked world at the scene offset, cleared by anything else written into the scene.
+        bool SceneMatchesBake;
+
+        /// @brief  Tracks the bricks of the scene changed since it was last constructed, to find writes that leave it different from the baked world.
+        DirtyCursor SceneBakeCursor;
+
+        /// @brief  Published versions of the scene, read by other threads through snapshots.
+        VersionedVolume SceneVersions;
+
+        /// @brief  Tracks the bricks of the scene changed since the last publish.
+        DirtyCursor SceneVersionsCursor;
+
+        /// @brief  The bricks changed since the last publish, kept to reuse its allocation.
+        std::vector<std::size_t> SceneDirtyBricks;
+
+        /// @brief  Spreads light from emissive voxels of the scene into the voxels around them, relit before each publish.
+        LightPropagator SceneLighting;
+
+        /// @brief  Which voxels of the scene are occupied, brought up to date at the end of each update.
+        OccupancyBitPlane SceneOccupancy;
+
+        /// @brief  Column heights and sun horizons of the scene, brought up to date at the end of each update.
+        SunShadowMap SceneShadows;
+
+        /// @brief  Ambient occlusion of the scene, brought up to date at the end of each update.
+        AmbientOcclusion SceneOcclusion;
+
+        /// @brief  Region sums over the scene, brought up to date when they are asked for.
+        SummedVolumeTable SceneSums;
+
+        /// @brief  Coarse levels of the scene, brought up to date when they are asked for.
+        VolumePyramid ScenePyramid;
+
+        /// @brief  Distances to the nearest occupied voxel of the scene, brought up to date when they are asked for.
+        DistanceField SceneDistances;
+
+    private:
+        /// @brief  The width, height and depth of the chunks edits are grouped and applied in, matching procedural chunks.
+        constexpr static const std::size_t EditChunkSize = ProceduralVolume::ChunkSize;
+
+        /// @brief  Edits submitted by the simulation and players, applied at the start of each update.
+        EditQueue Edits;
+
+        /// @brief  The edits taken from the queue this update, kept to reuse its allocation.
+        std::vector<EditQueue::Edit> PendingEdits;
+
+        /// @brief  Bricks of the map that differ from the map as generated, by brick index, inserted over the rest of the map.
+        ///         Each holds the brick with every edit, simulation step and later model applied, so changes persist when the scene moves.
+        ///         A brick that matches the generated map again is dropped, so only changed bricks are kept.
+        std::map<std::array<int, 3>, Volume> EditedBricks;
+
+    private:
+        /// @brief  The entities moving through the map, drawn by the renderer and never written into the scene.
+        std::vector<Entity> Entities;
+
+    private:
+        /// @brief  The number of voxels in one unit of camera space, the renderer draws each voxel a hundredth of a unit apart.
+        constexpr static const float VoxelsPerUnit = 100.0f;
+
+        /// @brief  The time between steps of the simulations.
+        constexpr static const float SimulationStepTime = 1.0f / 20.0f;
+
+        /// @brief  The most simulation steps taken in one update, slow updates drop the steps beyond this.
+        constexpr static const std::size_t MaxSimulationSteps = 4;
+
+        /// @brief  Drops the parts of the scene that lose their support, the voxels it moves are kept in the edited bricks.
+        StructuralIntegrity SceneIntegrity;
+
+        /// @brief  Steps the liquids and gases of the scene, the voxels it moves are kept in the edited bricks.
+        FluidSimulation SceneFluids;
+
+        /// @brief  The time passed that has not yet been stepped by the simulations.
+        float SimulationTime;
+
     public:
         /// @brief  Constructor to initialise member valiables based on the scene size.
         /// @param  SceneSize - The size of the scene that will be rendered.
         GameState(const std::array<std::size_t, 3>& SceneSize = {{64, 32, 64}});
 
     public:
-        /// @brief  Clear the map.
+        /// @brief  Clear the map, including procedural volumes.
         void ClearMap(void);
 
-        /// @brief  Set the map.
+        /// @brief  Set the map, the new volumes are composited over every procedural volume.
         /// @param  Map - The new map which will overwrite the current map.
         void SetMap(const std::vector<std::pair<std::array<int, 3>, Volume> >& Map);
 
@@ -110,6 +226,41 @@ namespace DeferredRasterisation {
         /// @param  Model - The volume storing the voxels of the model.
         void AddToMap(const std::array<int, 3>& Position, const Volume& Model);
 
+        /// @brief  Get the procedural volumes in the map.
+        /// @return The current procedural volumes.
+        const std::vector<std::pair<std::array<int, 3>, ProceduralVolume> >& GetProceduralMap(void) const;
+
+        /// @brief  Add a procedural volume model to the map at a position.
+        /// @param  Position - The position at which to place the model.
+        /// @param  Model - The procedural volume generating the voxels of the model.
+        void AddToMap(const std::array<int, 3>& Position, const ProceduralVolume& Model);
+
+        /// @brief  Set a baked world, it is kept until replaced and is not removed by clearing the map.
+        /// @param  Cache - The open scene cache, or null to remove the baked world.
+        void SetSceneCache(const std::shared_ptr<const SceneCache>& Cache);
+
+        /// @brief  Get the baked world.
+        /// @return The scene cache, or null if there is none.
+        const std::shared_ptr<const SceneCache>& GetSceneCache(void) const;
+
+        /// @brief  Test if the scene is exactly the baked world at the scene offset, with no other models, edits, or simulated changes, as of the end of the last update.
+        ///         While it is the renderer can draw the stored surface points of the bake rather than the scene.
+        /// @return True if the scene matches the baked world.
+        bool IsSceneBaked(void) const;
+
+        /// @brief  Get the edit queue, edits may be submitted from any thread and are applied at the start of the next update.
+        ///         Edits are removed with the rest of the map when it is cleared or replaced.
+        /// @return The edit queue.
+        EditQueue& GetEditQueue(void);
+
+        /// @brief  Get the entities, they are drawn where they are without touching the scene, so they can be moved every update.
+        /// @return The entities.
+        std::vector<Entity>& GetEntities(void);
+
+        /// @brief  Get the entities.
+        /// @return The entities.
+        const std::vector<Entity>& GetEntities(void) const;
+
     public:
         /// @brief  Get the scene offset.
         /// @return The current scene offset.
@@ -147,6 +298,47 @@ namespace DeferredRasterisation {
         /// @return The current scene volume.
         const Volume& GetScene(void) const;
 
+        /// @brief  Get the scene as it was at the end of the last update, safe to call and read from any thread.
+        /// @return A snapshot of the scene.
+        VersionedVolume::Snapshot GetSceneSnapshot(void) const;
+
+        /// @brief  Get which voxels of the scene are occupied, as of the end of the last update.
+        /// @return The occupancy of the scene.
+        const OccupancyBitPlane& GetSceneOccupancy(void) const;
+
+        /// @brief  Get the column heights and sun horizons of the scene, as of the end of the last update.
+        /// @return The sun shadow map of the scene.
+        const SunShadowMap& GetSceneShadows(void) const;
+
+        /// @brief  Get the ambient occlusion of the scene, as of the end of the last update.
+        /// @return The ambient occlusion of the scene.
+        const AmbientOcclusion& GetSceneOcclusion(void) const;
+
+        /// @brief  Get region sums over the scene, only the bricks changed since they were last asked for are rebuilt.
+        ///         Boxes are in scene coordinates, subtract the scene offset from map coordinates.
+        /// @return The summed volume table of the scene.
+        const SummedVolumeTable& GetSceneSums(void);
+
+        /// @brief  Get the coarse levels of the scene, only the regions changed since they were last asked for are rebuilt.
+        /// @return The pyramid of the scene.
+        const VolumePyramid& GetScenePyramid(void);
+
+        /// @brief  Get the distance of each scene voxel to the nearest occupied voxel, only the regions around changes since they were last asked for are rebuilt.
+        /// @return The distance field of the scene.
+        const DistanceField& GetSceneDistances(void);
+
+    public:
+        /// @brief  Trace a ray through the scene to the first occupied voxel.
+        ///         Only the scene is traced, rays that leave it miss, and results reflect the end of the last update.
+        /// @param  Query - The ray in map coordinates.
+        /// @return The hit in map coordinates.
+        RayCaster::Hit CastRay(const RayCaster::Ray& Query) const;
+
+        /// @brief  Trace many rays through the scene in parallel.
+        /// @param  Queries - The rays in map coordinates.
+        /// @param  Hits - Output for the hit of each ray in map coordinates, resized to match.
+        void CastRays(const std::vector<RayCaster::Ray>& Queries, std::vector<RayCaster::Hit>& Hits) const;
+
     public:
         /// @brief  Input key presses to the state.
         /// @param  Key - The input key.
@@ -156,6 +348,40 @@ namespace DeferredRasterisation {
         /// @brief  Update the state given a time step.
         /// @param  DeltaTime - The time since update was last called.
         void Update(float DeltaTime);
+
+    private:
+        /// @brief  Composite the map and its edited bricks into a volume, replacing its contents.
+        /// @param  Offset - The position of the volume in the map.
+        /// @param  Target - The volume to composite into.
+        void Composite(const std::array<int, 3>& Offset, Volume& Target) const;
+
+        /// @brief  Composite the map as generated into a volume, replacing its contents, without the edited bricks.
+        /// @param  Offset - The position of the volume in the map.
+        /// @param  Target - The volume to composite into.
+        void CompositeUnedited(const std::array<int, 3>& Offset, Volume& Target) const;
+
+        /// @brief  Insert the edited bricks that overlap a volume, looking up only the bricks the volume covers.
+        /// @param  Offset - The position of the volume in the map.
+        /// @param  Target - The volume to insert into.
+        void InsertEditedBricks(const std::array<int, 3>& Offset, Volume& Target) const;
+
+        /// @brief  Store the bricks of an edited region that differ from the map as generated, and drop those that match it.
+        /// @param  Origin - The position of the region in the map, a multiple of the brick size.
+        /// @param  Edited - The region with its edits.
+        /// @param  Unedited - The region as generated.
+        void StoreEditedBricks(const std::array<int, 3>& Origin, const Volume& Edited, const Volume& Unedited);
+
+        /// @brief  Construct the scene at the scene offset.
+        ///         If only the offset changed and the old scene overlaps the new one, the overlap is copied and only the exposed slabs are composited.
+        /// @return True if the old scene was scrolled, false if the whole scene was composited.
+        bool Rebuild(void);
+
+        /// @brief  Apply the queued edits to the chunks of the map they touch, store the bricks that changed, then copy those chunks into the scene.
+        void ApplyEdits(void);
+
+        /// @brief  Copy bricks of the scene into the edited bricks, so changes made in the scene itself persist when the scene moves.
+        /// @param  Bricks - The linear indices of the scene bricks to copy.
+        void Persist(const std::vector<std::size_t>& Bricks);
 	};
 }
 
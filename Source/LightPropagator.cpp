@@ -0,0 +1,299 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "LightPropagator.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace DeferredRasterisation {
+    // Nothing to light yet.
+    LightPropagator::LightPropagator(void)
+        : Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}}) {
+    }
+
+    // Relight the bricks within reach of a change, write the result, then skip the bricks the write marked.
+    void LightPropagator::Update(Volume& Target) {
+        Target.Drain(this->Cursor, this->DirtyBricks);
+
+        if (Target.GetSize() != this->Size) {
+            // A new size relights everything.
+            this->Size = Target.GetSize();
+            this->BrickCount = Target.GetBrickCount();
+            const std::size_t Count = this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2];
+            this->Levels.assign(Count * BrickVolume, 0);
+            this->InRegion.assign(Count, 1);
+            this->Queued.assign(Count, 0);
+            this->Region.resize(Count);
+            for (std::size_t Brick = 0; Brick < Count; ++Brick) {
+                this->Region[Brick] = Brick;
+            }
+        }
+        else {
+            if (this->DirtyBricks.empty()) return;
+
+            // Light can change anywhere a changed brick's light reaches.
+            this->Region.clear();
+            for (std::size_t Brick : this->DirtyBricks) {
+                const std::array<std::size_t, 3> Centre = {{Brick % this->BrickCount[0], (Brick / this->BrickCount[0]) % this->BrickCount[1], Brick / (this->BrickCount[0] * this->BrickCount[1])}};
+                std::array<std::size_t, 3> Begin;
+                std::array<std::size_t, 3> End;
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    Begin[Axis] = (Centre[Axis] > BrickReach) ? (Centre[Axis] - BrickReach) : 0;
+                    End[Axis] = std::min(Centre[Axis] + BrickReach + 1, this->BrickCount[Axis]);
+                }
+                for (std::size_t IndexZ = Begin[2]; IndexZ < End[2]; ++IndexZ) {
+                    for (std::size_t IndexY = Begin[1]; IndexY < End[1]; ++IndexY) {
+                        for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                            const std::size_t Neighbour = IndexX + this->BrickCount[0] * (IndexY + this->BrickCount[1] * IndexZ);
+                            if (this->InRegion[Neighbour] == 0) {
+                                this->InRegion[Neighbour] = 1;
+                                this->Region.push_back(Neighbour);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // The region is solved from darkness so light from a removed emitter cannot hold itself up.
+            for (std::size_t Brick : this->Region) {
+                std::memset(&this->Levels[Brick * BrickVolume], 0, BrickVolume);
+            }
+        }
+
+        this->Propagate(Target);
+        this->Write(Target);
+
+        for (std::size_t Brick : this->Region) {
+            this->InRegion[Brick] = 0;
+        }
+        Target.Drain(this->Cursor, this->DirtyBricks);
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& LightPropagator::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Unpack the level.
+    std::uint8_t LightPropagator::GetLevel(std::size_t X, std::size_t Y, std::size_t Z) const {
+        return this->Levels[this->GetIndex(X, Y, Z)] & 0x0F;
+    }
+
+    // Unpack the tint.
+    std::uint8_t LightPropagator::GetTint(std::size_t X, std::size_t Y, std::size_t Z) const {
+        return this->Levels[this->GetIndex(X, Y, Z)] >> 4;
+    }
+
+    // Solve active bricks from the last round's light, commit the ones that changed and queue their neighbours.
+    void LightPropagator::Propagate(const Volume& Source) {
+        this->Active = this->Region;
+        while (!this->Active.empty()) {
+            this->Solved.resize(this->Active.size() * BrickVolume);
+            this->Changed.resize(this->Active.size());
+            ThreadPool::GetGlobal().ParallelFor(this->Active.size(), 4, [&](std::size_t First, std::size_t Last) -> void {
+                std::array<std::vector<std::uint16_t>, EmitterLevel + 1> Buckets;
+                for (std::size_t Index = First; Index < Last; ++Index) {
+                    this->Changed[Index] = this->SolveBrick(Source, this->Active[Index], &this->Solved[Index * BrickVolume], Buckets) ? 1 : 0;
+                }
+            });
+
+            // Light only grows from darkness, so a brick is solved again only when a neighbour's light grows.
+            this->NextActive.clear();
+            for (std::size_t Index = 0; Index < this->Active.size(); ++Index) {
+                if (this->Changed[Index] == 0) continue;
+                const std::size_t Brick = this->Active[Index];
+                std::memcpy(&this->Levels[Brick * BrickVolume], &this->Solved[Index * BrickVolume], BrickVolume);
+                const std::array<std::size_t, 3> Position = {{Brick % this->BrickCount[0], (Brick / this->BrickCount[0]) % this->BrickCount[1], Brick / (this->BrickCount[0] * this->BrickCount[1])}};
+                const std::array<std::size_t, 3> Strides = {{1, this->BrickCount[0], this->BrickCount[0] * this->BrickCount[1]}};
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    std::array<std::size_t, 2> Neighbours = {{Brick, Brick}};
+                    if (Position[Axis] > 0) Neighbours[0] = Brick - Strides[Axis];
+                    if (Position[Axis] + 1 < this->BrickCount[Axis]) Neighbours[1] = Brick + Strides[Axis];
+                    for (std::size_t Neighbour : Neighbours) {
+                        if ((Neighbour != Brick) && (this->InRegion[Neighbour] != 0) && (this->Queued[Neighbour] == 0)) {
+                            this->Queued[Neighbour] = 1;
+                            this->NextActive.push_back(Neighbour);
+                        }
+                    }
+                }
+            }
+            for (std::size_t Brick : this->NextActive) {
+                this->Queued[Brick] = 0;
+            }
+            std::swap(this->Active, this->NextActive);
+        }
+    }
+
+    // Seed the brick from its emitters and neighbouring faces, then spread light a level at a time from the brightest down.
+    bool LightPropagator::SolveBrick(const Volume& Source, std::size_t Brick, std::uint8_t* Output, std::array<std::vector<std::uint16_t>, EmitterLevel + 1>& Buckets) const {
+        const std::array<std::size_t, 3> Base = {{
+            (Brick % this->BrickCount[0]) * BrickSize,
+            ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+            (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+        }};
+        const std::array<std::size_t, 3> Extent = {{
+            std::min(BrickSize, this->Size[0] - Base[0]),
+            std::min(BrickSize, this->Size[1] - Base[1]),
+            std::min(BrickSize, this->Size[2] - Base[2])
+        }};
+
+        // Light arriving at a voxel keeps the brighter level, equal levels mix their tints.
+        auto Receive = [&](std::size_t Local, std::uint8_t Level, std::uint8_t Tint) -> bool {
+            const std::uint8_t Current = Output[Local] & 0x0F;
+            if (Level > Current) {
+                Output[Local] = static_cast<std::uint8_t>(Level | (Tint << 4));
+                return true;
+            }
+            if ((Level == Current) && (Level != 0)) {
+                Output[Local] |= static_cast<std::uint8_t>(Tint << 4);
+            }
+            return false;
+        };
+
+        // Emitters, and which voxels pass light on.
+        std::array<std::uint8_t, BrickVolume> Transmissive;
+        Transmissive.fill(0);
+        std::memset(Output, 0, BrickVolume);
+        for (std::size_t IndexZ = 0; IndexZ < Extent[2]; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < Extent[1]; ++IndexY) {
+                const Voxel* Row = &Source(Base[0], Base[1] + IndexY, Base[2] + IndexZ);
+                for (std::size_t IndexX = 0; IndexX < Extent[0]; ++IndexX) {
+                    const std::size_t Local = IndexX + BrickSize * (IndexY + BrickSize * IndexZ);
+                    if (!IsTransmissive(Row[IndexX])) continue;
+                    Transmissive[Local] = 1;
+                    if (Row[IndexX].Alpha != 0) {
+                        Output[Local] = static_cast<std::uint8_t>(EmitterLevel | (GetEmitterTint(Row[IndexX]) << 4));
+                    }
+                }
+            }
+        }
+
+        // Light shining in through each face from the neighbouring brick.
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const std::size_t AxisU = (Axis == 0) ? 1 : 0;
+            const std::size_t AxisV = (Axis == 2) ? 1 : 2;
+            for (std::size_t Side = 0; Side < 2; ++Side) {
+                if ((Side == 0) && (Base[Axis] == 0)) continue;
+                if ((Side == 1) && (Base[Axis] + Extent[Axis] >= this->Size[Axis])) continue;
+                const std::size_t Inside = (Side == 0) ? 0 : (Extent[Axis] - 1);
+                for (std::size_t IndexV = 0; IndexV < Extent[AxisV]; ++IndexV) {
+                    for (std::size_t IndexU = 0; IndexU < Extent[AxisU]; ++IndexU) {
+                        std::array<std::size_t, 3> Outside;
+                        Outside[Axis] = (Side == 0) ? (Base[Axis] - 1) : (Base[Axis] + Extent[Axis]);
+                        Outside[AxisU] = Base[AxisU] + IndexU;
+                        Outside[AxisV] = Base[AxisV] + IndexV;
+                        const std::uint8_t Light = this->Levels[this->GetIndex(Outside[0], Outside[1], Outside[2])];
+                        if ((Light & 0x0F) < 2) continue;
+                        if (!IsTransmissive(Source(Outside[0], Outside[1], Outside[2]))) continue;
+                        std::array<std::size_t, 3> Local;
+                        Local[Axis] = Inside;
+                        Local[AxisU] = IndexU;
+                        Local[AxisV] = IndexV;
+                        Receive(Local[0] + BrickSize * (Local[1] + BrickSize * Local[2]), static_cast<std::uint8_t>((Light & 0x0F) - 1), static_cast<std::uint8_t>(Light >> 4));
+                    }
+                }
+            }
+        }
+
+        // Every lit voxel that passes light on waits at its level, a voxel raised later waits again at its new level.
+        for (std::vector<std::uint16_t>& Bucket : Buckets) {
+            Bucket.clear();
+        }
+        bool Lit = false;
+        for (std::size_t Local = 0; Local < BrickVolume; ++Local) {
+            const std::uint8_t Level = Output[Local] & 0x0F;
+            Lit |= (Level != 0);
+            if ((Level >= 2) && (Transmissive[Local] != 0)) {
+                Buckets[Level].push_back(static_cast<std::uint16_t>(Local));
+            }
+        }
+
+        // Levels are spread brightest first, so a voxel's tint is complete before it spreads.
+        if (Lit) {
+            for (std::size_t Level = EmitterLevel; Level >= 2; --Level) {
+                for (std::size_t Entry = 0; Entry < Buckets[Level].size(); ++Entry) {
+                    const std::size_t Local = Buckets[Level][Entry];
+                    if ((Output[Local] & 0x0F) != Level) continue;
+                    const std::uint8_t Tint = Output[Local] >> 4;
+                    const std::array<std::size_t, 3> Position = {{Local % BrickSize, (Local / BrickSize) % BrickSize, Local / (BrickSize * BrickSize)}};
+                    const std::array<std::size_t, 3> Strides = {{1, BrickSize, BrickSize * BrickSize}};
+                    for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                        const std::array<std::size_t, 2> Neighbours = {{Local - Strides[Axis], Local + Strides[Axis]}};
+                        const std::array<bool, 2> Inside = {{Position[Axis] > 0, Position[Axis] + 1 < Extent[Axis]}};
+                        for (std::size_t Side = 0; Side < 2; ++Side) {
+                            if (!Inside[Side]) continue;
+                            if (Receive(Neighbours[Side], static_cast<std::uint8_t>(Level - 1), Tint) && (Level > 2) && (Transmissive[Neighbours[Side]] != 0)) {
+                                Buckets[Level - 1].push_back(static_cast<std::uint16_t>(Neighbours[Side]));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return std::memcmp(Output, &this->Levels[Brick * BrickVolume], BrickVolume) != 0;
+    }
+
+    // Write the light of the region into the occupied voxels whose light changed.
+    void LightPropagator::Write(Volume& Target) const {
+        const Volume& Source = Target;
+        ThreadPool::GetGlobal().ParallelFor(this->Region.size(), 4, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                const std::size_t Brick = this->Region[Index];
+                const std::array<std::size_t, 3> Base = {{
+                    (Brick % this->BrickCount[0]) * BrickSize,
+                    ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+                    (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+                }};
+                const std::uint8_t* Light = &this->Levels[Brick * BrickVolume];
+                for (std::size_t IndexZ = Base[2]; IndexZ < std::min(Base[2] + BrickSize, this->Size[2]); ++IndexZ) {
+                    for (std::size_t IndexY = Base[1]; IndexY < std::min(Base[1] + BrickSize, this->Size[1]); ++IndexY) {
+                        for (std::size_t IndexX = Base[0]; IndexX < std::min(Base[0] + BrickSize, this->Size[0]); ++IndexX) {
+                            const Voxel& Current = Source(IndexX, IndexY, IndexZ);
+                            if (Current.Alpha == 0) continue;
+                            const std::uint8_t Packed = Light[(IndexX - Base[0]) + BrickSize * ((IndexY - Base[1]) + BrickSize * (IndexZ - Base[2]))];
+                            const std::uint8_t Level = std::max<std::uint8_t>(Packed & 0x0F, AmbientLevel);
+                            const std::uint8_t Tint = Packed >> 4;
+                            if ((Current.Light != Level) || (Current.Tint != Tint)) {
+                                Voxel& Lit = Target.GetWritable(IndexX, IndexY, IndexZ);
+                                Lit.Light = Level;
+                                Lit.Tint = Tint;
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // Threshold each channel of the emitter's colour.
+    std::uint8_t LightPropagator::GetEmitterTint(const Voxel& Value) {
+        std::array<std::uint8_t, 4> Pixel;
+        Voxel::Decode(&Value, 1, Pixel.data());
+        return static_cast<std::uint8_t>(((Pixel[0] >= 128) ? 0b100 : 0) | ((Pixel[1] >= 128) ? 0b010 : 0) | ((Pixel[2] >= 128) ? 0b001 : 0));
+    }
+}
@@ -0,0 +1,166 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_LIGHTPROPAGATOR_HPP
+#define RAYMARCH_LIGHTPROPAGATOR_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  LightPropagator spreads block light from emissive voxels through the empty space of a volume and writes it into the Light and Tint of occupied voxels.
+    ///         Emitters are occupied voxels in the plasma state, they shine at the brightest level in the colour of their hue, and light falls by one level per voxel travelled.
+    ///         Occupied voxels that are not emitters are lit by their empty neighbours but block light, light from different emitters at the same level mixes its tint.
+    ///         Light is solved a brick at a time in parallel rounds, each brick reading the last round's light on the faces of its neighbours until no brick changes.
+    ///         Light reaches less than two bricks, so updates only relight the bricks within two bricks of a change.
+    class LightPropagator {
+    public:
+        /// @brief  The material state of emissive voxels.
+        constexpr static const std::uint8_t PlasmaState = 3;
+        /// @brief  The light level of an emitter.
+        constexpr static const std::uint8_t EmitterLevel = 15;
+        /// @brief  The light level written to occupied voxels that are lit less than this, matching the level voxels are created with.
+        constexpr static const std::uint8_t AmbientLevel = 0b1000;
+
+    private:
+        /// @brief  The number of bricks around a change that are relit, enough to cover the reach of the brightest light.
+        constexpr static const std::size_t BrickReach = (EmitterLevel + BrickSize - 1) / BrickSize;
+
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  The light of each voxel, brick by brick with voxels in X-major order within the brick, the level in the low four bits and the tint above it.
+        std::vector<std::uint8_t> Levels;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The bricks being relit by this update.
+        std::vector<std::size_t> Region;
+
+        /// @brief  A flag per brick, set while the brick is in the region.
+        std::vector<std::uint8_t> InRegion;
+
+        /// @brief  The bricks to solve this round and the next, kept to reuse their allocations.
+        std::vector<std::size_t> Active;
+        std::vector<std::size_t> NextActive;
+
+        /// @brief  A flag per brick, set while the brick is queued for the next round.
+        std::vector<std::uint8_t> Queued;
+
+        /// @brief  The light solved for each active brick this round, and whether it changed.
+        std::vector<std::uint8_t> Solved;
+        std::vector<std::uint8_t> Changed;
+
+    public:
+        /// @brief  Constructor that creates an empty light field of no size.
+        LightPropagator(void);
+
+    public:
+        /// @brief  Relight the parts of a volume changed since the last update and write the light into its occupied voxels.
+        ///         The first update, and any update with a volume of another size, relights everything.
+        ///         Only voxels whose light changes are written, and those writes are not counted as changes by the next update.
+        /// @param  Target - The volume to light, always the same volume, not written by anything else during the update.
+        void Update(Volume& Target);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the light level of a voxel, empty voxels included.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The level from zero to EmitterLevel, before the ambient level is applied.
+        std::uint8_t GetLevel(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Get the tint of the light reaching a voxel, empty voxels included.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The tint as red, green and blue bits from high to low.
+        std::uint8_t GetTint(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+    private:
+        /// @brief  Solve the light of the region in rounds, starting from no light in the region.
+        /// @param  Source - The volume being lit.
+        void Propagate(const Volume& Source);
+
+        /// @brief  Solve the light of one brick from its emitters and the light on the faces of its neighbours.
+        /// @param  Source - The volume being lit.
+        /// @param  Brick - The index of the brick.
+        /// @param  Output - Output for the light of the brick, BrickVolume entries.
+        /// @param  Buckets - Scratch for the voxels waiting to spread light, one list per level.
+        /// @return True if the light differs from the brick's current light.
+        bool SolveBrick(const Volume& Source, std::size_t Brick, std::uint8_t* Output, std::array<std::vector<std::uint16_t>, EmitterLevel + 1>& Buckets) const;
+
+        /// @brief  Write the light of the region into the occupied voxels of a volume.
+        /// @param  Target - The volume being lit.
+        void Write(Volume& Target) const;
+
+        /// @brief  Get the index into the light of a voxel.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The index of the voxel's light.
+        std::size_t GetIndex(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Test if light passes through a voxel, true of empty voxels and emitters.
+        /// @param  Value - The voxel to test.
+        /// @return True if light spreads out of the voxel.
+        static bool IsTransmissive(const Voxel& Value);
+
+        /// @brief  Get the tint an emitter shines with, from the colour of its hue.
+        /// @param  Value - The emitter.
+        /// @return The tint as red, green and blue bits from high to low.
+        static std::uint8_t GetEmitterTint(const Voxel& Value);
+    };
+
+    // Find the brick, then the voxel within it.
+    inline std::size_t LightPropagator::GetIndex(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        const std::size_t Brick = (X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize));
+        return Brick * BrickVolume + (X % BrickSize) + BrickSize * ((Y % BrickSize) + BrickSize * (Z % BrickSize));
+    }
+
+    // Empty voxels carry light, emitters shine out of themselves.
+    inline bool LightPropagator::IsTransmissive(const Voxel& Value) {
+        return (Value.Alpha == 0) || (Value.State == PlasmaState);
+    }
+}
+
+#endif // RAYMARCH_LIGHTPROPAGATOR_HPP
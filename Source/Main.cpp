@@ -22,7 +22,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE
 */
 
+#include "ProceduralVolume.hpp"
 #include "Renderer.hpp"
+#include "SceneCache.hpp"
 #include "Volume.hpp"
 #include "VolumeFactory.hpp"
 
@@ -31,14 +33,11 @@ THE SOFTWARE
 
 #include <cassert>
 #include <iostream>
+#include <memory>
 #include <random>
 
 // The main entry point.
 int main(int ArgumentCount, char* ArgumentArray[]) {
-    // Cast the main arguments to void to avoid unused variable warnings.
-    static_cast<void>(ArgumentCount);
-    static_cast<void>(ArgumentArray);
-
     // Store the project name for use when printing output.
     constexpr static const char* ProjectName = "DeferredRasterisation";
 
@@ -160,64 +159,93 @@ int main(int ArgumentCount, char* ArgumentArray[]) {
 
     DeferredRasterisation::GameState State(std::array<std::size_t, 3>{{128, 32, 128}});
 
-    std::cout << "  Creating a floor volume..." << std::endl;
-
-    // Build the floor
-    DeferredRasterisation::Voxel FloorVoxel = DeferredRasterisation::Voxel(128, 128, 128, 255);
-    DeferredRasterisation::Volume Floor = DeferredRasterisation::VolumeFactory::CreateSolid(512, 1, 512, FloorVoxel);
-    State.AddToMap({{0, 0, 0}}, Floor);
-
-    std::cout << "  Creating a grass volume..." << std::endl;
-
-	// Build the grass brownie.
-    DeferredRasterisation::Voxel GrassVoxel = DeferredRasterisation::Voxel(0, 255, 0, 255);
-    DeferredRasterisation::Volume Grass = DeferredRasterisation::VolumeFactory::CreateRandomSponge(512, 3, 512, 0.5, GrassVoxel);
-    State.AddToMap({{0, 1, 0}}, Grass);
-
-    std::cout << "  Creating a sphere volume..." << std::endl;
-
-    DeferredRasterisation::Voxel SphereVoxel = DeferredRasterisation::Voxel(255, 0, 0, 255);
-    DeferredRasterisation::Volume Sphere = DeferredRasterisation::VolumeFactory::CreateEllipsoid(16, 16, 16, SphereVoxel);
-    State.AddToMap({{64, 8, 64}}, Sphere);
-
-    std::cout << "  Creating a column volume..." << std::endl;
+    // An optional scene description replaces the built in scene, it is baked on first use and mapped from the bake after that.
+    if (ArgumentCount > 1) {
+        const std::string DescriptionPath = ArgumentArray[1];
 
-    DeferredRasterisation::Voxel ColumnVoxel = DeferredRasterisation::Voxel(0, 0, 128, 32);
-    DeferredRasterisation::Volume Column = DeferredRasterisation::VolumeFactory::CreateColumn(16, 30, 16, 0.3, ColumnVoxel);
+        std::cout << "  Opening the bake of scene description \"" << DescriptionPath << "\"..." << std::endl;
 
-    std::cout << "  Creating random locations for 100 columns..." << std::endl;
+        std::shared_ptr<DeferredRasterisation::SceneCache> Cache = std::make_shared<DeferredRasterisation::SceneCache>();
+        if (!Cache->Open(DescriptionPath)) {
+            std::cout << "  Baking scene description \"" << DescriptionPath << "\"..." << std::endl;
 
-    std::default_random_engine RandomGenerator;
-    RandomGenerator.seed(std::random_device()());
-    std::uniform_real_distribution<double> RandomDistribution(0, 1);
-
-	// Generate random positions for 100 columns.
-	for (int i = 0; i < 100; i++) {
-        int x = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
-        int z = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
-        State.AddToMap({{x, 1, z}}, Column);
-	}
+            if (!DeferredRasterisation::SceneCache::Bake(DescriptionPath) || !Cache->Open(DescriptionPath)) {
+                std::cerr << "Failed to bake the scene description \"" << DescriptionPath << "\"." << std::endl;
+                glfwTerminate();
+                return EXIT_FAILURE;
+            }
+        }
+        State.SetSceneCache(Cache);
 
-    std::cout << "  Creating some coloured block volumes..." << std::endl;
-
-    DeferredRasterisation::Voxel BlockVoxelRed   = DeferredRasterisation::Voxel(255,   0,   0, 64);
-    DeferredRasterisation::Voxel BlockVoxelGreen = DeferredRasterisation::Voxel(  0, 255,   0, 64);
-    DeferredRasterisation::Voxel BlockVoxelBlue  = DeferredRasterisation::Voxel(  0,   0, 255, 64);
-    DeferredRasterisation::Voxel BlockVoxelBlack = DeferredRasterisation::Voxel(  0,   0,   0, 64);
-    DeferredRasterisation::Voxel BlockVoxelGrey  = DeferredRasterisation::Voxel(128, 128, 128, 64);
-    DeferredRasterisation::Voxel BlockVoxelWhite = DeferredRasterisation::Voxel(255, 255, 255, 64);
-    DeferredRasterisation::Volume BlockRed   = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelRed);
-    DeferredRasterisation::Volume BlockGreen = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGreen);
-    DeferredRasterisation::Volume BlockBlue  = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlue);
-    DeferredRasterisation::Volume BlockBlack = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlack);
-    DeferredRasterisation::Volume BlockGrey  = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGrey);
-    DeferredRasterisation::Volume BlockWhite = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelWhite);
-    State.AddToMap({{ 8 * 2 + 80, 8, 64}}, BlockRed  );
-    State.AddToMap({{12 * 2 + 80, 8, 64}}, BlockGreen);
-    State.AddToMap({{16 * 2 + 80, 8, 64}}, BlockBlue );
-    State.AddToMap({{20 * 2 + 80, 8, 64}}, BlockBlack);
-    State.AddToMap({{24 * 2 + 80, 8, 64}}, BlockGrey );
-    State.AddToMap({{28 * 2 + 80, 8, 64}}, BlockWhite);
+        std::cout << "  Mapped " << Cache->GetPointCount() << " surface points." << std::endl;
+    }
+    else {
+        std::cout << "  Creating a floor volume..." << std::endl;
+
+        // Build the floor, it is generated in chunks as they come into view.
+        DeferredRasterisation::Voxel FloorVoxel = DeferredRasterisation::Voxel(128, 128, 128, 255);
+        DeferredRasterisation::ProceduralVolume Floor({{512, 1, 512}}, [FloorVoxel](const std::array<std::size_t, 3>& Origin, DeferredRasterisation::Volume& Chunk) {
+            static_cast<void>(Origin);
+            Chunk.Fill(FloorVoxel);
+        });
+        State.AddToMap({{0, 0, 0}}, Floor);
+
+        std::cout << "  Creating a grass volume..." << std::endl;
+
+		// Build the grass brownie.
+        DeferredRasterisation::Voxel GrassVoxel = DeferredRasterisation::Voxel(0, 255, 0, 255);
+        // The grass is seeded so it is generated identically on every run, and in chunks as they come into view.
+        const std::uint64_t GrassSeed = 2017;
+        DeferredRasterisation::ProceduralVolume Grass({{512, 3, 512}}, [GrassVoxel, GrassSeed](const std::array<std::size_t, 3>& Origin, DeferredRasterisation::Volume& Chunk) {
+            DeferredRasterisation::VolumeFactory::FillRandomSponge(Chunk, Origin, 0.5, GrassSeed, GrassVoxel);
+        });
+        State.AddToMap({{0, 1, 0}}, Grass);
+
+        std::cout << "  Creating a sphere volume..." << std::endl;
+
+        DeferredRasterisation::Voxel SphereVoxel = DeferredRasterisation::Voxel(255, 0, 0, 255);
+        DeferredRasterisation::Volume Sphere = DeferredRasterisation::VolumeFactory::CreateEllipsoid(16, 16, 16, SphereVoxel);
+        State.AddToMap({{64, 8, 64}}, Sphere);
+
+        std::cout << "  Creating a column volume..." << std::endl;
+
+        DeferredRasterisation::Voxel ColumnVoxel = DeferredRasterisation::Voxel(0, 0, 128, 32);
+        DeferredRasterisation::Volume Column = DeferredRasterisation::VolumeFactory::CreateColumn(16, 30, 16, 0.3, ColumnVoxel);
+
+        std::cout << "  Creating random locations for 100 columns..." << std::endl;
+
+        std::default_random_engine RandomGenerator;
+        RandomGenerator.seed(std::random_device()());
+        std::uniform_real_distribution<double> RandomDistribution(0, 1);
+
+		// Generate random positions for 100 columns.
+		for (int i = 0; i < 100; i++) {
+            int x = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
+            int z = std::floor(RandomDistribution(RandomGenerator) * 32) * 16;
+            State.AddToMap({{x, 1, z}}, Column);
+		}
+
+        std::cout << "  Creating some coloured block volumes..." << std::endl;
+
+        DeferredRasterisation::Voxel BlockVoxelRed   = DeferredRasterisation::Voxel(255,   0,   0, 64);
+        DeferredRasterisation::Voxel BlockVoxelGreen = DeferredRasterisation::Voxel(  0, 255,   0, 64);
+        DeferredRasterisation::Voxel BlockVoxelBlue  = DeferredRasterisation::Voxel(  0,   0, 255, 64);
+        DeferredRasterisation::Voxel BlockVoxelBlack = DeferredRasterisation::Voxel(  0,   0,   0, 64);
+        DeferredRasterisation::Voxel BlockVoxelGrey  = DeferredRasterisation::Voxel(128, 128, 128, 64);
+        DeferredRasterisation::Voxel BlockVoxelWhite = DeferredRasterisation::Voxel(255, 255, 255, 64);
+        DeferredRasterisation::Volume BlockRed   = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelRed);
+        DeferredRasterisation::Volume BlockGreen = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGreen);
+        DeferredRasterisation::Volume BlockBlue  = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlue);
+        DeferredRasterisation::Volume BlockBlack = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelBlack);
+        DeferredRasterisation::Volume BlockGrey  = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelGrey);
+        DeferredRasterisation::Volume BlockWhite = DeferredRasterisation::VolumeFactory::CreateSolid(4, 8, 8, BlockVoxelWhite);
+        State.AddToMap({{ 8 * 2 + 80, 8, 64}}, BlockRed  );
+        State.AddToMap({{12 * 2 + 80, 8, 64}}, BlockGreen);
+        State.AddToMap({{16 * 2 + 80, 8, 64}}, BlockBlue );
+        State.AddToMap({{20 * 2 + 80, 8, 64}}, BlockBlack);
+        State.AddToMap({{24 * 2 + 80, 8, 64}}, BlockGrey );
+        State.AddToMap({{28 * 2 + 80, 8, 64}}, BlockWhite);
+    }
 
     std::cout << "Finished creating an environment." << std::endl;
     std::cout << "----------" << std::endl;
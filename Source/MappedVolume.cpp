@@ -0,0 +1,327 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "MappedVolume.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace DeferredRasterisation {
+    // Empty bricks read as default constructed voxels.
+    const Voxel MappedVolume::EmptyVoxel = Voxel();
+
+    // Start closed.
+    MappedVolume::MappedVolume(void)
+        : Mapping(nullptr)
+        , MappingSize(0)
+        , Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}})
+        , BrickTable(nullptr)
+        , Payload(nullptr) {
+    }
+
+    // Unmap on destruction.
+    MappedVolume::~MappedVolume(void) {
+        this->Close();
+    }
+
+    // Take over the mapping.
+    MappedVolume::MappedVolume(MappedVolume&& Other)
+        : MappedVolume() {
+        *this = std::move(Other);
+    }
+
+    // Swap mappings, the other view is then closed.
+    MappedVolume& MappedVolume::operator=(MappedVolume&& Other) {
+        if (this != &Other) {
+            this->Close();
+            std::swap(this->Mapping, Other.Mapping);
+            std::swap(this->MappingSize, Other.MappingSize);
+            std::swap(this->Size, Other.Size);
+            std::swap(this->BrickCount, Other.BrickCount);
+            std::swap(this->BrickTable, Other.BrickTable);
+            std::swap(this->Payload, Other.Payload);
+        }
+        return *this;
+    }
+
+    // Write the header, the brick table, then each non-empty brick in Morton order.
+    bool MappedVolume::Write(const std::string& Path, const Volume& Source) {
+        const std::array<std::size_t, 3> VolumeSize = Source.GetSize();
+        const std::array<std::size_t, 3> Bricks = {{ (VolumeSize[0] + BrickSize - 1) / BrickSize, (VolumeSize[1] + BrickSize - 1) / BrickSize, (VolumeSize[2] + BrickSize - 1) / BrickSize }};
+        const std::size_t LayerBrickCount = Bricks[0] * Bricks[1];
+
+        // Helper function to gather a brick, returning false if every voxel is empty.
+        auto GatherBrick = [&](std::size_t BrickX, std::size_t BrickY, std::size_t BrickZ, Voxel* Output) -> bool {
+            bool Occupied = false;
+            std::fill(Output, Output + BrickVolume, EmptyVoxel);
+            for (std::size_t IndexZ = BrickZ * BrickSize; IndexZ < std::min((BrickZ + 1) * BrickSize, VolumeSize[2]); ++IndexZ) {
+                for (std::size_t IndexY = BrickY * BrickSize; IndexY < std::min((BrickY + 1) * BrickSize, VolumeSize[1]); ++IndexY) {
+                    for (std::size_t IndexX = BrickX * BrickSize; IndexX < std::min((BrickX + 1) * BrickSize, VolumeSize[0]); ++IndexX) {
+                        const Voxel& Value = Source(IndexX, IndexY, IndexZ);
+                        Output[MortonIndexing::GetBrickOffset(IndexX, IndexY, IndexZ)] = Value;
+                        Occupied = Occupied || (std::memcmp(&Value, &EmptyVoxel, sizeof(Voxel)) != 0);
+                    }
+                }
+            }
+            return Occupied;
+        };
+
+        // Find the occupied bricks in parallel across brick layers, then number them in order.
+        std::vector<std::uint32_t> Table(LayerBrickCount * Bricks[2]);
+        ThreadPool::GetGlobal().ParallelFor(Bricks[2], 1, [&](std::size_t BeginZ, std::size_t EndZ) {
+            std::vector<Voxel> Brick(BrickVolume);
+            for (std::size_t BrickZ = BeginZ; BrickZ < EndZ; ++BrickZ) {
+                for (std::size_t BrickY = 0; BrickY < Bricks[1]; ++BrickY) {
+                    for (std::size_t BrickX = 0; BrickX < Bricks[0]; ++BrickX) {
+                        Table[BrickX + Bricks[0] * (BrickY + Bricks[1] * BrickZ)] = GatherBrick(BrickX, BrickY, BrickZ, Brick.data()) ? 0 : EmptyBrick;
+                    }
+                }
+            }
+        });
+        std::uint64_t StoredBrickCount = 0;
+        for (std::uint32_t& Entry : Table) {
+            if (Entry != EmptyBrick) {
+                if (StoredBrickCount >= EmptyBrick) {
+                    return false;
+                }
+                Entry = static_cast<std::uint32_t>(StoredBrickCount++);
+            }
+        }
+
+        Header FileHeader;
+        std::memset(&FileHeader, 0, sizeof(FileHeader));
+        std::memcpy(FileHeader.Magic, "DRVOLUME", sizeof(FileHeader.Magic));
+        FileHeader.Version = FileVersion;
+        FileHeader.BrickSize = static_cast<std::uint32_t>(BrickSize);
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            FileHeader.Size[Axis] = VolumeSize[Axis];
+        }
+        FileHeader.StoredBrickCount = StoredBrickCount;
+        FileHeader.BrickTableOffset = sizeof(Header);
+        FileHeader.PayloadOffset = ((sizeof(Header) + Table.size() * sizeof(std::uint32_t) + PayloadAlignment - 1) / PayloadAlignment) * PayloadAlignment;
+
+        std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+        if (!File) {
+            return false;
+        }
+        File.write(reinterpret_cast<const char*>(&FileHeader), sizeof(FileHeader));
+        File.write(reinterpret_cast<const char*>(Table.data()), static_cast<std::streamsize>(Table.size() * sizeof(std::uint32_t)));
+        const std::vector<char> Padding(FileHeader.PayloadOffset - sizeof(Header) - Table.size() * sizeof(std::uint32_t), 0);
+        File.write(Padding.data(), static_cast<std::streamsize>(Padding.size()));
+
+        // Gather a layer of bricks at a time in parallel, then write its occupied bricks.
+        std::vector<Voxel> Scratch(LayerBrickCount * BrickVolume);
+        for (std::size_t BrickZ = 0; (BrickZ < Bricks[2]) && File; ++BrickZ) {
+            ThreadPool::GetGlobal().ParallelFor(LayerBrickCount, 16, [&](std::size_t Begin, std::size_t End) {
+                for (std::size_t Brick = Begin; Brick < End; ++Brick) {
+                    if (Table[Brick + LayerBrickCount * BrickZ] != EmptyBrick) {
+                        GatherBrick(Brick % Bricks[0], Brick / Bricks[0], BrickZ, Scratch.data() + Brick * BrickVolume);
+                    }
+                }
+            });
+            for (std::size_t Brick = 0; Brick < LayerBrickCount; ++Brick) {
+                if (Table[Brick + LayerBrickCount * BrickZ] != EmptyBrick) {
+                    File.write(reinterpret_cast<const char*>(Scratch.data() + Brick * BrickVolume), static_cast<std::streamsize>(BrickVolume * sizeof(Voxel)));
+                }
+            }
+        }
+
+        File.flush();
+        return static_cast<bool>(File);
+    }
+
+    // Map the file and validate everything that later reads rely on.
+    bool MappedVolume::Open(const std::string& Path) {
+        this->Close();
+
+        const int Descriptor = ::open(Path.c_str(), O_RDONLY);
+        if (Descriptor < 0) {
+            return false;
+        }
+        struct stat Status;
+        if ((::fstat(Descriptor, &Status) != 0) || (static_cast<std::size_t>(Status.st_size) < sizeof(Header))) {
+            ::close(Descriptor);
+            return false;
+        }
+        const std::size_t FileSize = static_cast<std::size_t>(Status.st_size);
+        void* FileMapping = ::mmap(nullptr, FileSize, PROT_READ, MAP_SHARED, Descriptor, 0);
+        ::close(Descriptor);
+        if (FileMapping == MAP_FAILED) {
+            return false;
+        }
+        this->Mapping = FileMapping;
+        this->MappingSize = FileSize;
+
+        // Check the header, limiting sizes so the offset arithmetic below cannot overflow.
+        Header FileHeader;
+        std::memcpy(&FileHeader, FileMapping, sizeof(FileHeader));
+        bool Valid = (std::memcmp(FileHeader.Magic, "DRVOLUME", sizeof(FileHeader.Magic)) == 0) && (FileHeader.Version == FileVersion) && (FileHeader.BrickSize == BrickSize);
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Valid = Valid && (FileHeader.Size[Axis] > 0) && (FileHeader.Size[Axis] < (1ull << 20));
+        }
+        if (!Valid) {
+            this->Close();
+            return false;
+        }
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            this->Size[Axis] = static_cast<std::size_t>(FileHeader.Size[Axis]);
+            this->BrickCount[Axis] = (this->Size[Axis] + BrickSize - 1) / BrickSize;
+        }
+        const std::uint64_t TableCount = static_cast<std::uint64_t>(this->BrickCount[0]) * this->BrickCount[1] * this->BrickCount[2];
+        Valid = (FileHeader.BrickTableOffset % alignof(std::uint32_t) == 0) && (FileHeader.BrickTableOffset <= FileSize) && (TableCount <= (FileSize - FileHeader.BrickTableOffset) / sizeof(std::uint32_t));
+        Valid = Valid && (FileHeader.PayloadOffset % PayloadAlignment == 0) && (FileHeader.PayloadOffset <= FileSize) && (FileHeader.StoredBrickCount <= (FileSize - FileHeader.PayloadOffset) / (BrickVolume * sizeof(Voxel)));
+        if (!Valid) {
+            this->Close();
+            return false;
+        }
+        this->BrickTable = reinterpret_cast<const std::uint32_t*>(static_cast<const char*>(FileMapping) + FileHeader.BrickTableOffset);
+        this->Payload = reinterpret_cast<const Voxel*>(static_cast<const char*>(FileMapping) + FileHeader.PayloadOffset);
+
+        // Every brick must be empty or refer to a stored brick, this touches the table but none of the payload.
+        for (std::uint64_t Brick = 0; Brick < TableCount; ++Brick) {
+            if ((this->BrickTable[Brick] != EmptyBrick) && (this->BrickTable[Brick] >= FileHeader.StoredBrickCount)) {
+                this->Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Unmap and reset to closed.
+    void MappedVolume::Close(void) {
+        if (this->Mapping != nullptr) {
+            ::munmap(this->Mapping, this->MappingSize);
+        }
+        this->Mapping = nullptr;
+        this->MappingSize = 0;
+        this->Size = {{0, 0, 0}};
+        this->BrickCount = {{0, 0, 0}};
+        this->BrickTable = nullptr;
+        this->Payload = nullptr;
+    }
+
+    // Check for a mapping.
+    bool MappedVolume::IsOpen(void) const {
+        return this->Mapping != nullptr;
+    }
+
+    // Get the size.
+    std::array<std::size_t, 3> MappedVolume::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the width.
+    std::size_t MappedVolume::GetSizeX(void) const {
+        return this->Size[0];
+    }
+
+    // Get the height.
+    std::size_t MappedVolume::GetSizeY(void) const {
+        return this->Size[1];
+    }
+
+    // Get the depth.
+    std::size_t MappedVolume::GetSizeZ(void) const {
+        return this->Size[2];
+    }
+
+    // Clip the region to the file and copy it to the start of the target.
+    void MappedVolume::Extract(const std::array<std::size_t, 3>& Origin, Volume& Target) const {
+        assert(this->IsOpen());
+
+        std::array<std::size_t, 3> Extent;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Extent[Axis] = (Origin[Axis] < this->Size[Axis]) ? std::min(Target.GetSize()[Axis], this->Size[Axis] - Origin[Axis]) : 0;
+        }
+        this->CopyRegion(Origin, {{0, 0, 0}}, Extent, Target);
+    }
+
+    // Clip the file to the target, the same way Volume::Insert clips its source.
+    void MappedVolume::InsertInto(int X, int Y, int Z, Volume& Target) const {
+        assert(this->IsOpen());
+
+        const int Offset[3] = { X, Y, Z };
+        std::array<std::size_t, 3> Source;
+        std::array<std::size_t, 3> Destination;
+        std::array<std::size_t, 3> Extent;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int First = std::max(0, -Offset[Axis]);
+            const int Last = std::min(static_cast<int>(this->Size[Axis]), static_cast<int>(Target.GetSize()[Axis]) - Offset[Axis]);
+            if (First >= Last) return;
+            Source[Axis] = static_cast<std::size_t>(First);
+            Destination[Axis] = static_cast<std::size_t>(First + Offset[Axis]);
+            Extent[Axis] = static_cast<std::size_t>(Last - First);
+        }
+        this->CopyRegion(Source, Destination, Extent, Target);
+    }
+
+    // Copy a region a brick segment at a time, looking up each brick once per row.
+    void MappedVolume::CopyRegion(const std::array<std::size_t, 3>& Source, const std::array<std::size_t, 3>& Destination, const std::array<std::size_t, 3>& Extent, Volume& Target) const {
+        if ((Extent[0] == 0) || (Extent[1] == 0) || (Extent[2] == 0)) return;
+
+        // Rows are written through a pointer, so mark the whole region as changed up front.
+        Target.MarkDirty(Destination, {{ Destination[0] + Extent[0], Destination[1] + Extent[1], Destination[2] + Extent[2] }});
+
+        // Copy the target brick layers in parallel, so no two threads write the same brick.
+        const std::size_t FirstLayer = Destination[2] / BrickSize;
+        const std::size_t LayerCount = (Destination[2] + Extent[2] - 1) / BrickSize + 1 - FirstLayer;
+        ThreadPool::GetGlobal().ParallelFor(LayerCount, 1, [&](std::size_t BeginLayer, std::size_t EndLayer) {
+            const std::size_t BeginZ = std::max((FirstLayer + BeginLayer) * BrickSize, Destination[2]) - Destination[2];
+            const std::size_t EndZ = std::min((FirstLayer + EndLayer) * BrickSize - Destination[2], Extent[2]);
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                const std::size_t FileZ = Source[2] + IndexZ;
+                for (std::size_t IndexY = 0; IndexY < Extent[1]; ++IndexY) {
+                    const std::size_t FileY = Source[1] + IndexY;
+                    const std::uint32_t* TableRow = this->BrickTable + this->BrickCount[0] * ((FileY / BrickSize) + this->BrickCount[1] * (FileZ / BrickSize));
+                    Voxel* TargetRow = &Target.GetWritable(Destination[0], Destination[1] + IndexY, Destination[2] + IndexZ);
+                    for (std::size_t IndexX = 0; IndexX < Extent[0]; ) {
+                        const std::size_t FileX = Source[0] + IndexX;
+                        const std::size_t SegmentEnd = std::min(Extent[0], IndexX + BrickSize - (FileX % BrickSize));
+                        const std::uint32_t Slot = TableRow[FileX / BrickSize];
+                        if (Slot != EmptyBrick) {
+                            const Voxel* Brick = this->Payload + static_cast<std::size_t>(Slot) * BrickVolume;
+                            for (; IndexX < SegmentEnd; ++IndexX) {
+                                TargetRow[IndexX] = Brick[MortonIndexing::GetBrickOffset(Source[0] + IndexX, FileY, FileZ)];
+                            }
+                        }
+                        else {
+                            std::fill(TargetRow + IndexX, TargetRow + SegmentEnd, EmptyVoxel);
+                        }
+                        IndexX = SegmentEnd;
+                    }
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,206 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_MAPPEDVOLUME_HPP
+#define RAYMARCH_MAPPEDVOLUME_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace DeferredRasterisation {
+    /// @brief  MappedVolume is a read only view of a volume file that is memory mapped rather than loaded.
+    ///         A volume file is a header, a table with one entry per brick, then a page aligned payload of the non-empty bricks.
+    ///         Voxels inside a brick are stored in Morton order as their in-memory representation, so files are only portable between builds with the same voxel layout.
+    ///         Opening a file only validates the header and brick table, voxel pages are faulted in as bricks are read.
+    class MappedVolume {
+    public:
+        /// @brief  Volume file header, all fields are in the byte order of the writing machine.
+        ///         A file from a machine of the other byte order fails the version check in Open.
+        struct Header {
+            /// @brief  File identifier, "DRVOLUME".
+            char Magic[8];
+            /// @brief  File format version.
+            std::uint32_t Version;
+            /// @brief  The width, height and depth of a brick.
+            std::uint32_t BrickSize;
+            /// @brief  The size of the volume.
+            std::uint64_t Size[3];
+            /// @brief  The number of non-empty bricks in the payload.
+            std::uint64_t StoredBrickCount;
+            /// @brief  File offset of the brick table.
+            std::uint64_t BrickTableOffset;
+            /// @brief  File offset of the payload.
+            std::uint64_t PayloadOffset;
+        };
+
+        /// @brief  The current file format version.
+        constexpr static const std::uint32_t FileVersion = 1;
+        /// @brief  Brick table entry of a brick that is entirely empty and has no payload.
+        constexpr static const std::uint32_t EmptyBrick = 0xFFFFFFFFu;
+        /// @brief  Alignment of the payload within the file.
+        constexpr static const std::size_t PayloadAlignment = 4096;
+
+    private:
+        /// @brief  The start of the file mapping.
+        void* Mapping;
+        /// @brief  The size of the file mapping in bytes.
+        std::size_t MappingSize;
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+        /// @brief  The brick table, the payload slot of each brick in linear order.
+        const std::uint32_t* BrickTable;
+        /// @brief  The payload of non-empty bricks.
+        const Voxel* Payload;
+
+        /// @brief  The voxel returned for positions in empty bricks.
+        static const Voxel EmptyVoxel;
+
+    public:
+        /// @brief  Constructor that creates a closed view.
+        MappedVolume(void);
+
+        /// @brief  Destructor that unmaps the file.
+        ~MappedVolume(void);
+
+        /// @brief  Deleted copy constructor, each view owns its mapping.
+        MappedVolume(const MappedVolume&) = delete;
+
+        /// @brief  Move constructor that takes over the mapping of another view.
+        /// @param  Other - The view to move from, left closed.
+        MappedVolume(MappedVolume&& Other);
+
+        /// @brief  Deleted copy assignment operator, each view owns its mapping.
+        MappedVolume& operator=(const MappedVolume&) = delete;
+
+        /// @brief  Move assignment operator that takes over the mapping of another view.
+        /// @param  Other - The view to move from, left closed.
+        /// @return Reference to this view.
+        MappedVolume& operator=(MappedVolume&& Other);
+
+    public:
+        /// @brief  Write a volume to a volume file.
+        /// @param  Path - The path of the file to write.
+        /// @param  Source - The volume to write.
+        /// @return True if the file was written.
+        static bool Write(const std::string& Path, const Volume& Source);
+
+    public:
+        /// @brief  Map a volume file, closing any file that is already open.
+        /// @param  Path - The path of the file to map.
+        /// @return True if the file was mapped and its header and brick table are valid.
+        bool Open(const std::string& Path);
+
+        /// @brief  Unmap the file.
+        void Close(void);
+
+        /// @brief  Test if a file is mapped.
+        /// @return True if a file is mapped.
+        bool IsOpen(void) const;
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        std::array<std::size_t, 3> GetSize(void) const;
+
+        /// @brief  Get the width of the volume.
+        /// @return The size in the X dimension.
+        std::size_t GetSizeX(void) const;
+
+        /// @brief  Get the height of the volume.
+        /// @return The size in the Y dimension.
+        std::size_t GetSizeY(void) const;
+
+        /// @brief  Get the depth of the volume.
+        /// @return The size in the Z dimension.
+        std::size_t GetSizeZ(void) const;
+
+    public:
+        /// @brief  Voxel accessor.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return Constant reference to the voxel, or to an empty voxel if its brick is empty.
+        const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Visit every voxel of the volume.
+        /// @param  Function - Called with the X, Y, Z coordinates and a constant reference to each voxel.
+        template <typename FunctionType>
+        void ForEach(FunctionType&& Function) const;
+
+        /// @brief  Copy a region of the file into a volume, used to serve chunks of a mapped world through a ProceduralVolume.
+        ///         Voxels in empty bricks are written as empty voxels, voxels outside the file are left unchanged.
+        /// @param  Origin - The position of the target within the file.
+        /// @param  Target - The volume to copy into.
+        void Extract(const std::array<std::size_t, 3>& Origin, Volume& Target) const;
+
+        /// @brief  Write the part of the file that overlaps a target volume into the target, matching Volume::Insert.
+        ///         Voxels in empty bricks are written as empty voxels.
+        /// @param  X - The X location of the file within the target.
+        /// @param  Y - The Y location of the file within the target.
+        /// @param  Z - The Z location of the file within the target.
+        /// @param  Target - The volume to write into.
+        void InsertInto(int X, int Y, int Z, Volume& Target) const;
+
+    private:
+        /// @brief  Copy a clipped box of the file into a volume a brick segment at a time, empty bricks are copied as empty voxels.
+        /// @param  Source - The first voxel of the box within the file.
+        /// @param  Destination - The first voxel of the box within the target.
+        /// @param  Extent - The size of the box, already clipped to both the file and the target.
+        /// @param  Target - The volume to copy into.
+        void CopyRegion(const std::array<std::size_t, 3>& Source, const std::array<std::size_t, 3>& Destination, const std::array<std::size_t, 3>& Extent, Volume& Target) const;
+    };
+
+    // Look up the brick, then the voxel within the brick.
+    inline const Voxel& MappedVolume::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(this->IsOpen());
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        const std::uint32_t Slot = this->BrickTable[(X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize))];
+        if (Slot == EmptyBrick) {
+            return EmptyVoxel;
+        }
+        return this->Payload[static_cast<std::size_t>(Slot) * BrickVolume + MortonIndexing::GetBrickOffset(X, Y, Z)];
+    }
+
+    // Visit every voxel in linear order.
+    template <typename FunctionType>
+    void MappedVolume::ForEach(FunctionType&& Function) const {
+        for (std::size_t IndexZ = 0; IndexZ < this->Size[2]; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < this->Size[1]; ++IndexY) {
+                for (std::size_t IndexX = 0; IndexX < this->Size[0]; ++IndexX) {
+                    Function(IndexX, IndexY, IndexZ, this->operator()(IndexX, IndexY, IndexZ));
+                }
+            }
+        }
+    }
+}
+
+#endif // RAYMARCH_MAPPEDVOLUME_HPP
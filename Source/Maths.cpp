@@ -122,6 +122,57 @@ namespace DeferredRasterisation {
         );
     }
 
+    Matrix44 Matrix44::Translation(const Vector3& Offset) {
+        return Matrix44(
+            1, 0, 0, Offset[0],
+            0, 1, 0, Offset[1],
+            0, 0, 1, Offset[2],
+            0, 0, 0, 1
+        );
+    }
+
+    Matrix44 Matrix44::Scale(float Factor) {
+        return Matrix44(
+            Factor, 0, 0, 0,
+            0, Factor, 0, 0,
+            0, 0, Factor, 0,
+            0, 0, 0, 1
+        );
+    }
+
+    Matrix44 Matrix44::RotationX(float Radians) {
+        const float Cosine = std::cos(Radians);
+        const float Sine = std::sin(Radians);
+        return Matrix44(
+            1, 0, 0, 0,
+            0, Cosine, -Sine, 0,
+            0, Sine, Cosine, 0,
+            0, 0, 0, 1
+        );
+    }
+
+    Matrix44 Matrix44::RotationY(float Radians) {
+        const float Cosine = std::cos(Radians);
+        const float Sine = std::sin(Radians);
+        return Matrix44(
+            Cosine, 0, Sine, 0,
+            0, 1, 0, 0,
+            -Sine, 0, Cosine, 0,
+            0, 0, 0, 1
+        );
+    }
+
+    Matrix44 Matrix44::RotationZ(float Radians) {
+        const float Cosine = std::cos(Radians);
+        const float Sine = std::sin(Radians);
+        return Matrix44(
+            Cosine, -Sine, 0, 0,
+            Sine, Cosine, 0, 0,
+            0, 0, 1, 0,
+            0, 0, 0, 1
+        );
+    }
+
     float& Matrix44::operator()(unsigned int X, unsigned int Y) {
         return this->Data[Y][X];
     }
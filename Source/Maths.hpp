@@ -122,6 +122,31 @@ namespace DeferredRasterisation {
         /// @return A view matrix.
         static Matrix44 View(const Vector3& Eye, const Vector3& Target, const Vector3& Up);
 
+        /// @brief  Static translation matrix function.
+        /// @param  Offset - The offset to translate by.
+        /// @return A translation matrix.
+        static Matrix44 Translation(const Vector3& Offset);
+
+        /// @brief  Static uniform scale matrix function.
+        /// @param  Factor - The factor to scale every axis by.
+        /// @return A scale matrix.
+        static Matrix44 Scale(float Factor);
+
+        /// @brief  Static rotation matrix function for a rotation about the X axis.
+        /// @param  Radians - The angle to rotate by, counter clockwise looking down the axis towards the origin.
+        /// @return A rotation matrix.
+        static Matrix44 RotationX(float Radians);
+
+        /// @brief  Static rotation matrix function for a rotation about the Y axis.
+        /// @param  Radians - The angle to rotate by, counter clockwise looking down the axis towards the origin.
+        /// @return A rotation matrix.
+        static Matrix44 RotationY(float Radians);
+
+        /// @brief  Static rotation matrix function for a rotation about the Z axis.
+        /// @param  Radians - The angle to rotate by, counter clockwise looking down the axis towards the origin.
+        /// @return A rotation matrix.
+        static Matrix44 RotationZ(float Radians);
+
     public:
         /// @brief  Matrix element accessor, allowing modification.
         /// @return Reference to the indexed element.
@@ -0,0 +1,533 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "MeshVoxeliser.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace DeferredRasterisation {
+    // Dispatch on the lower case file extension.
+    bool MeshVoxeliser::Load(const std::string& Path, Mesh& Output) {
+        const std::size_t Dot = Path.find_last_of('.');
+        if (Dot == std::string::npos) {
+            return false;
+        }
+        std::string Extension = Path.substr(Dot + 1);
+        std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](char Character) -> char { return static_cast<char>(std::tolower(static_cast<unsigned char>(Character))); });
+
+        if (Extension == "obj") {
+            return LoadOBJ(Path, Output);
+        }
+        if (Extension == "stl") {
+            return LoadSTL(Path, Output);
+        }
+        return false;
+    }
+
+    // Parse the vertex, face and material statements of an OBJ file, all other statements are ignored.
+    bool MeshVoxeliser::LoadOBJ(const std::string& Path, Mesh& Output) {
+        std::vector<char> Buffer;
+        if (!ReadFile(Path, Buffer)) {
+            return false;
+        }
+        Output = Mesh();
+
+        // Material libraries are relative to the OBJ file.
+        const std::string Directory = Path.substr(0, Path.find_last_of("/\\") + 1);
+        std::map<std::string, std::array<std::uint8_t, 4>> Materials;
+        const std::array<std::uint8_t, 4> DefaultColour = {{ 200, 200, 200, 255 }};
+        std::array<std::uint8_t, 4> Colour = DefaultColour;
+
+        std::vector<std::uint32_t> Polygon;
+        const char* Cursor = Buffer.data();
+        while (*Cursor != '\0') {
+            const char* LineEnd = Cursor;
+            while ((*LineEnd != '\0') && (*LineEnd != '\n')) {
+                ++LineEnd;
+            }
+            while ((Cursor < LineEnd) && ((*Cursor == ' ') || (*Cursor == '\t'))) {
+                ++Cursor;
+            }
+
+            // Helper functions to match a statement keyword and to read the rest of the line as a name.
+            auto IsKeyword = [&](const char* Keyword) -> bool {
+                const std::size_t Length = std::strlen(Keyword);
+                return (static_cast<std::size_t>(LineEnd - Cursor) > Length) && (std::strncmp(Cursor, Keyword, Length) == 0) && ((Cursor[Length] == ' ') || (Cursor[Length] == '\t'));
+            };
+            auto GetName = [&](std::size_t KeywordLength) -> std::string {
+                const char* Begin = Cursor + KeywordLength;
+                const char* End = LineEnd;
+                while ((Begin < End) && std::isspace(static_cast<unsigned char>(*Begin))) ++Begin;
+                while ((End > Begin) && std::isspace(static_cast<unsigned char>(End[-1]))) --End;
+                return std::string(Begin, End);
+            };
+
+            if (IsKeyword("v")) {
+                char* End = nullptr;
+                const float X = std::strtof(Cursor + 1, &End);
+                const float Y = std::strtof(End, &End);
+                const float Z = std::strtof(End, &End);
+                if (End > LineEnd) {
+                    return false;
+                }
+                Output.Vertices.push_back(Vector3(X, Y, Z));
+            }
+            else if (IsKeyword("f")) {
+                // Read the position index of each corner, skipping texture and normal indices.
+                Polygon.clear();
+                const char* Token = Cursor + 1;
+                for (;;) {
+                    while ((Token < LineEnd) && std::isspace(static_cast<unsigned char>(*Token))) {
+                        ++Token;
+                    }
+                    if (Token >= LineEnd) {
+                        break;
+                    }
+                    char* End = nullptr;
+                    long Index = std::strtol(Token, &End, 10);
+                    if ((End == Token) || (Index == 0)) {
+                        return false;
+                    }
+                    // Negative indices count back from the most recent vertex.
+                    Index = (Index > 0) ? Index - 1 : static_cast<long>(Output.Vertices.size()) + Index;
+                    if (Index < 0) {
+                        return false;
+                    }
+                    Polygon.push_back(static_cast<std::uint32_t>(Index));
+                    Token = End;
+                    while ((Token < LineEnd) && !std::isspace(static_cast<unsigned char>(*Token))) {
+                        ++Token;
+                    }
+                }
+                if (Polygon.size() < 3) {
+                    return false;
+                }
+
+                // Triangulate as a fan.
+                for (std::size_t Corner = 2; Corner < Polygon.size(); ++Corner) {
+                    Output.Triangles.push_back({{ Polygon[0], Polygon[Corner - 1], Polygon[Corner] }});
+                    Output.Colours.push_back(Colour);
+                }
+            }
+            else if (IsKeyword("usemtl")) {
+                const std::map<std::string, std::array<std::uint8_t, 4>>::const_iterator Material = Materials.find(GetName(6));
+                Colour = (Material != Materials.end()) ? Material->second : DefaultColour;
+            }
+            else if (IsKeyword("mtllib")) {
+                // A missing library leaves its materials with the default colour.
+                LoadMTL(Directory + GetName(6), Materials);
+            }
+
+            Cursor = (*LineEnd == '\n') ? LineEnd + 1 : LineEnd;
+        }
+
+        // Faces may only reference vertices that exist.
+        for (const std::array<std::uint32_t, 3>& Triangle : Output.Triangles) {
+            if ((Triangle[0] >= Output.Vertices.size()) || (Triangle[1] >= Output.Vertices.size()) || (Triangle[2] >= Output.Vertices.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Binary STL is an 80 byte header, a triangle count, and 50 bytes per triangle.
+    bool MeshVoxeliser::LoadSTL(const std::string& Path, Mesh& Output) {
+        std::vector<char> Buffer;
+        if (!ReadFile(Path, Buffer)) {
+            return false;
+        }
+        Output = Mesh();
+
+        // The buffer holds a terminating zero after the file contents.
+        const std::size_t FileSize = Buffer.size() - 1;
+        if (FileSize < 84) {
+            return false;
+        }
+        std::uint32_t TriangleCount = 0;
+        std::memcpy(&TriangleCount, Buffer.data() + 80, sizeof(TriangleCount));
+        if (FileSize < 84 + static_cast<std::size_t>(TriangleCount) * 50) {
+            return false;
+        }
+
+        Output.Vertices.resize(static_cast<std::size_t>(TriangleCount) * 3);
+        Output.Triangles.resize(TriangleCount);
+        Output.Colours.resize(TriangleCount);
+
+        // Triangles are at fixed offsets, so they can be decoded in parallel.
+        ThreadPool::GetGlobal().ParallelFor(TriangleCount, 4096, [&](std::size_t Begin, std::size_t End) {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                const char* Record = Buffer.data() + 84 + Index * 50;
+
+                // Skip the facet normal, it is recalculated from the vertices.
+                float Corners[9];
+                std::memcpy(Corners, Record + 12, sizeof(Corners));
+                for (std::size_t Corner = 0; Corner < 3; ++Corner) {
+                    Output.Vertices[Index * 3 + Corner] = Vector3(Corners[Corner * 3 + 0], Corners[Corner * 3 + 1], Corners[Corner * 3 + 2]);
+                }
+                Output.Triangles[Index] = {{ static_cast<std::uint32_t>(Index * 3 + 0), static_cast<std::uint32_t>(Index * 3 + 1), static_cast<std::uint32_t>(Index * 3 + 2) }};
+
+                // The attribute word holds a colour in the VisCAM and SolidView convention, its top bit marks the colour as valid, with blue in bits 0-4, green in bits 5-9 and red in bits 10-14.
+                std::uint16_t Attribute = 0;
+                std::memcpy(&Attribute, Record + 48, sizeof(Attribute));
+                if (Attribute & 0x8000u) {
+                    auto Expand = [](std::uint16_t Channel) -> std::uint8_t { return static_cast<std::uint8_t>((Channel << 3) | (Channel >> 2)); };
+                    Output.Colours[Index] = {{ Expand((Attribute >> 10) & 0x1Fu), Expand((Attribute >> 5) & 0x1Fu), Expand(Attribute & 0x1Fu), 255 }};
+                }
+                else {
+                    Output.Colours[Index] = {{ 200, 200, 200, 255 }};
+                }
+            }
+        });
+        return true;
+    }
+
+    // Voxelise a mesh.
+    Volume MeshVoxeliser::Voxelise(const Mesh& Source, std::size_t Resolution, bool Solid) {
+        assert(Resolution > 0);
+        assert(Source.Colours.size() == Source.Triangles.size());
+
+        const std::size_t TriangleCount = Source.Triangles.size();
+        if ((TriangleCount == 0) || Source.Vertices.empty()) {
+            return Volume(1, 1, 1);
+        }
+
+        // Find the bounds of the mesh.
+        std::array<float, 3> Minimum = {{ Source.Vertices[0][0], Source.Vertices[0][1], Source.Vertices[0][2] }};
+        std::array<float, 3> Maximum = Minimum;
+        for (const Vector3& Vertex : Source.Vertices) {
+            for (unsigned int Axis = 0; Axis < 3; ++Axis) {
+                Minimum[Axis] = std::min(Minimum[Axis], Vertex[Axis]);
+                Maximum[Axis] = std::max(Maximum[Axis], Vertex[Axis]);
+            }
+        }
+
+        // Scale the longest side to span the centres of the first and last voxels.
+        const float LongestSide = std::max(std::max(Maximum[0] - Minimum[0], Maximum[1] - Minimum[1]), Maximum[2] - Minimum[2]);
+        const float Scale = (LongestSide > 0.0f) ? static_cast<float>(Resolution - 1) / LongestSide : 0.0f;
+        std::array<std::size_t, 3> Size;
+        for (unsigned int Axis = 0; Axis < 3; ++Axis) {
+            Size[Axis] = std::min(static_cast<std::size_t>((Maximum[Axis] - Minimum[Axis]) * Scale) + 1, Resolution);
+        }
+        Volume Target(Size[0], Size[1], Size[2]);
+
+        // Move the vertices into voxel coordinates.
+        std::vector<Vector3> Positions(Source.Vertices.size());
+        ThreadPool::GetGlobal().ParallelFor(Positions.size(), 65536, [&](std::size_t Begin, std::size_t End) {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                const Vector3& Vertex = Source.Vertices[Index];
+                Positions[Index] = Vector3((Vertex[0] - Minimum[0]) * Scale + 0.5f, (Vertex[1] - Minimum[1]) * Scale + 0.5f, (Vertex[2] - Minimum[2]) * Scale + 0.5f);
+            }
+        });
+
+        // Convert the triangle colours in one batch.
+        std::vector<Voxel> Values(TriangleCount);
+        Voxel::Encode(Source.Colours.front().data(), TriangleCount, Values.data());
+
+        // Find the range of brick deep slabs each triangle touches, in parallel across triangles.
+        const std::size_t SlabCount = (Size[2] + BrickSize - 1) / BrickSize;
+        std::vector<std::array<std::uint32_t, 2>> SlabRanges(TriangleCount);
+        ThreadPool::GetGlobal().ParallelFor(TriangleCount, 65536, [&](std::size_t Begin, std::size_t End) {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                const std::array<std::uint32_t, 3>& Triangle = Source.Triangles[Index];
+                const float LowerZ = std::min(std::min(Positions[Triangle[0]][2], Positions[Triangle[1]][2]), Positions[Triangle[2]][2]);
+                const float UpperZ = std::max(std::max(Positions[Triangle[0]][2], Positions[Triangle[1]][2]), Positions[Triangle[2]][2]);
+                auto GetSlab = [&](float Depth) -> std::uint32_t {
+                    const float Slice = std::min(std::max(std::floor(Depth), 0.0f), static_cast<float>(Size[2] - 1));
+                    return static_cast<std::uint32_t>(static_cast<std::size_t>(Slice) / BrickSize);
+                };
+                SlabRanges[Index] = {{ GetSlab(LowerZ - 0.5f), GetSlab(UpperZ + 0.5f) }};
+            }
+        });
+
+        // Bucket the triangles by slab, keeping mesh order within each slab so overlapping triangles resolve the same way every time.
+        std::vector<std::size_t> SlabOffsets(SlabCount + 1, 0);
+        for (const std::array<std::uint32_t, 2>& Range : SlabRanges) {
+            for (std::uint32_t Slab = Range[0]; Slab <= Range[1]; ++Slab) {
+                ++SlabOffsets[Slab + 1];
+            }
+        }
+        for (std::size_t Slab = 0; Slab < SlabCount; ++Slab) {
+            SlabOffsets[Slab + 1] += SlabOffsets[Slab];
+        }
+        std::vector<std::uint32_t> SlabTriangles(SlabOffsets[SlabCount]);
+        std::vector<std::size_t> SlabCursors(SlabOffsets.begin(), SlabOffsets.end() - 1);
+        for (std::size_t Index = 0; Index < TriangleCount; ++Index) {
+            for (std::uint32_t Slab = SlabRanges[Index][0]; Slab <= SlabRanges[Index][1]; ++Slab) {
+                SlabTriangles[SlabCursors[Slab]++] = static_cast<std::uint32_t>(Index);
+            }
+        }
+
+        // Rasterise each slab in parallel, no two slabs share a brick.
+        ThreadPool::GetGlobal().ParallelFor(SlabCount, 1, [&](std::size_t BeginSlab, std::size_t EndSlab) {
+            for (std::size_t Slab = BeginSlab; Slab < EndSlab; ++Slab) {
+                const std::size_t BeginZ = Slab * BrickSize;
+                const std::size_t EndZ = std::min(BeginZ + BrickSize, Size[2]);
+                for (std::size_t Entry = SlabOffsets[Slab]; Entry < SlabOffsets[Slab + 1]; ++Entry) {
+                    const std::uint32_t Index = SlabTriangles[Entry];
+                    const std::array<std::uint32_t, 3>& Triangle = Source.Triangles[Index];
+                    RasteriseTriangle(Positions[Triangle[0]], Positions[Triangle[1]], Positions[Triangle[2]], BeginZ, EndZ, Values[Index], Target);
+                }
+            }
+        });
+
+        if (Solid) {
+            FillInterior(Target);
+        }
+
+        // Return.
+        return Target;
+    }
+
+    // Read a file into a zero terminated buffer.
+    bool MeshVoxeliser::ReadFile(const std::string& Path, std::vector<char>& Output) {
+        std::ifstream File(Path, std::ios::binary | std::ios::ate);
+        if (!File) {
+            return false;
+        }
+        const std::streamsize FileSize = File.tellg();
+        if (FileSize < 0) {
+            return false;
+        }
+        File.seekg(0, std::ios::beg);
+        Output.resize(static_cast<std::size_t>(FileSize) + 1);
+        if (!File.read(Output.data(), FileSize)) {
+            return false;
+        }
+        Output.back() = '\0';
+        return true;
+    }
+
+    // Parse the material names and diffuse colours of an MTL file.
+    bool MeshVoxeliser::LoadMTL(const std::string& Path, std::map<std::string, std::array<std::uint8_t, 4>>& Materials) {
+        std::ifstream File(Path);
+        if (!File) {
+            return false;
+        }
+
+        std::string Line;
+        std::string Name;
+        while (std::getline(File, Line)) {
+            const std::size_t Begin = Line.find_first_not_of(" \t");
+            if (Begin == std::string::npos) {
+                continue;
+            }
+            if (Line.compare(Begin, 7, "newmtl ") == 0) {
+                const std::size_t NameBegin = Line.find_first_not_of(" \t", Begin + 7);
+                const std::size_t NameEnd = Line.find_last_not_of(" \t\r");
+                Name = (NameBegin != std::string::npos) ? Line.substr(NameBegin, NameEnd + 1 - NameBegin) : std::string();
+                Materials[Name] = {{ 200, 200, 200, 255 }};
+            }
+            else if ((Line.compare(Begin, 3, "Kd ") == 0) && !Name.empty()) {
+                // Diffuse colours are stored between 0.0 and 1.0.
+                char* End = nullptr;
+                std::array<std::uint8_t, 4>& Colour = Materials[Name];
+                const char* Value = Line.c_str() + Begin + 3;
+                for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                    const float Intensity = std::strtof(Value, &End);
+                    Colour[Channel] = static_cast<std::uint8_t>(std::lround(std::min(std::max(Intensity, 0.0f), 1.0f) * 255.0f));
+                    Value = End;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Rasterise a triangle with the separating axis test, solved for the span of each row rather than per voxel.
+    void MeshVoxeliser::RasteriseTriangle(const Vector3& A, const Vector3& B, const Vector3& C, std::size_t BeginZ, std::size_t EndZ, Voxel Value, Volume& Target) {
+        const std::array<std::size_t, 3> Size = Target.GetSize();
+
+        // Clip the voxel bounds of the triangle to the volume and the slab.
+        std::array<std::size_t, 3> Lower;
+        std::array<std::size_t, 3> Upper;
+        for (unsigned int Axis = 0; Axis < 3; ++Axis) {
+            const float Minimum = std::min(std::min(A[Axis], B[Axis]), C[Axis]);
+            const float Maximum = std::max(std::max(A[Axis], B[Axis]), C[Axis]);
+            if ((Maximum < 0.0f) || (Minimum >= static_cast<float>(Size[Axis]))) {
+                return;
+            }
+            Lower[Axis] = static_cast<std::size_t>(std::max(Minimum, 0.0f));
+            Upper[Axis] = std::min(static_cast<std::size_t>(Maximum) + 1, Size[Axis]);
+        }
+        Lower[2] = std::max(Lower[2], BeginZ);
+        Upper[2] = std::min(Upper[2], EndZ);
+        if (Lower[2] >= Upper[2]) {
+            return;
+        }
+
+        // The separating axes are the triangle normal and the cross product of each edge with each coordinate axis.
+        // The coordinate axes themselves are covered by the voxel bounds above.
+        const float Edges[3][3] = {
+            { B[0] - A[0], B[1] - A[1], B[2] - A[2] },
+            { C[0] - B[0], C[1] - B[1], C[2] - B[2] },
+            { A[0] - C[0], A[1] - C[1], A[2] - C[2] }
+        };
+        float Axes[10][3] = {
+            { Edges[0][1] * Edges[1][2] - Edges[0][2] * Edges[1][1], Edges[0][2] * Edges[1][0] - Edges[0][0] * Edges[1][2], Edges[0][0] * Edges[1][1] - Edges[0][1] * Edges[1][0] }
+        };
+        for (std::size_t Edge = 0; Edge < 3; ++Edge) {
+            const float* Direction = Edges[Edge];
+            const float EdgeAxes[3][3] = {
+                { 0.0f, -Direction[2], Direction[1] },
+                { Direction[2], 0.0f, -Direction[0] },
+                { -Direction[1], Direction[0], 0.0f }
+            };
+            std::memcpy(Axes[1 + Edge * 3], EdgeAxes, sizeof(EdgeAxes));
+        }
+
+        // A voxel centre overlaps the triangle when its projection onto every axis lies within the triangle projection widened by the voxel radius.
+        // The radius is padded slightly so rounding never drops a touching voxel.
+        float Minimums[10];
+        float Maximums[10];
+        for (std::size_t Axis = 0; Axis < 10; ++Axis) {
+            const float* Direction = Axes[Axis];
+            const float ProjectionA = Direction[0] * A[0] + Direction[1] * A[1] + Direction[2] * A[2];
+            const float ProjectionB = Direction[0] * B[0] + Direction[1] * B[1] + Direction[2] * B[2];
+            const float ProjectionC = Direction[0] * C[0] + Direction[1] * C[1] + Direction[2] * C[2];
+            const float Radius = 0.5001f * (std::fabs(Direction[0]) + std::fabs(Direction[1]) + std::fabs(Direction[2]));
+            Minimums[Axis] = std::min(std::min(ProjectionA, ProjectionB), ProjectionC) - Radius;
+            Maximums[Axis] = std::max(std::max(ProjectionA, ProjectionB), ProjectionC) + Radius;
+        }
+
+        for (std::size_t IndexZ = Lower[2]; IndexZ < Upper[2]; ++IndexZ) {
+            const float CentreZ = static_cast<float>(IndexZ) + 0.5f;
+            for (std::size_t IndexY = Lower[1]; IndexY < Upper[1]; ++IndexY) {
+                const float CentreY = static_cast<float>(IndexY) + 0.5f;
+
+                // Each axis limits the centre of the row to an interval, the span is their intersection.
+                float SpanLower = -std::numeric_limits<float>::infinity();
+                float SpanUpper = std::numeric_limits<float>::infinity();
+                bool Empty = false;
+                for (std::size_t Axis = 0; (Axis < 10) && !Empty; ++Axis) {
+                    const float* Direction = Axes[Axis];
+                    const float Offset = Direction[1] * CentreY + Direction[2] * CentreZ;
+                    if (Direction[0] == 0.0f) {
+                        Empty = (Offset < Minimums[Axis]) || (Offset > Maximums[Axis]);
+                    }
+                    else {
+                        float First = (Minimums[Axis] - Offset) / Direction[0];
+                        float Second = (Maximums[Axis] - Offset) / Direction[0];
+                        if (First > Second) {
+                            std::swap(First, Second);
+                        }
+                        SpanLower = std::max(SpanLower, First);
+                        SpanUpper = std::min(SpanUpper, Second);
+                        Empty = SpanLower > SpanUpper;
+                    }
+                }
+                if (Empty) {
+                    continue;
+                }
+
+                // Convert the interval of centres to voxel indices within the bounds.
+                const float BeginX = std::min(std::max(std::ceil(SpanLower - 0.5f), static_cast<float>(Lower[0])), static_cast<float>(Upper[0]));
+                const float EndX = std::min(std::max(std::floor(SpanUpper - 0.5f) + 1.0f, static_cast<float>(Lower[0])), static_cast<float>(Upper[0]));
+                if (BeginX < EndX) {
+                    Target.FillRow(static_cast<std::size_t>(BeginX), static_cast<std::size_t>(EndX), IndexY, IndexZ, Value);
+                }
+            }
+        }
+    }
+
+    // Flood the outside from the boundary, then fill whatever the flood did not reach.
+    void MeshVoxeliser::FillInterior(Volume& Target) {
+        const std::size_t SizeX = Target.GetSizeX();
+        const std::size_t SizeY = Target.GetSizeY();
+        const std::size_t SizeZ = Target.GetSizeZ();
+
+        std::vector<std::uint8_t> Outside(SizeX * SizeY * SizeZ, 0);
+        std::vector<std::array<std::size_t, 3>> Stack;
+
+        // Helper function to test whether a voxel is empty and not yet reached.
+        auto IsOpen = [&](std::size_t X, std::size_t Y, std::size_t Z) -> bool {
+            return (Outside[X + SizeX * (Y + SizeY * Z)] == 0) && (Target(X, Y, Z).Alpha == 0);
+        };
+
+        // Seed the flood with every face of the volume.
+        for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                const bool Face = (IndexZ == 0) || (IndexZ == SizeZ - 1) || (IndexY == 0) || (IndexY == SizeY - 1);
+                for (std::size_t IndexX = 0; IndexX < SizeX; IndexX += (Face || (IndexX == SizeX - 1)) ? 1 : SizeX - 1) {
+                    Stack.push_back({{ IndexX, IndexY, IndexZ }});
+                }
+            }
+        }
+
+        // Flood a row span at a time, queueing one seed for each open run in the four neighbouring rows.
+        while (!Stack.empty()) {
+            const std::array<std::size_t, 3> Seed = Stack.back();
+            Stack.pop_back();
+            if (!IsOpen(Seed[0], Seed[1], Seed[2])) {
+                continue;
+            }
+
+            std::size_t BeginX = Seed[0];
+            std::size_t EndX = Seed[0] + 1;
+            while ((BeginX > 0) && IsOpen(BeginX - 1, Seed[1], Seed[2])) --BeginX;
+            while ((EndX < SizeX) && IsOpen(EndX, Seed[1], Seed[2])) ++EndX;
+            std::fill_n(Outside.begin() + static_cast<std::ptrdiff_t>(BeginX + SizeX * (Seed[1] + SizeY * Seed[2])), EndX - BeginX, 1);
+
+            auto QueueRow = [&](std::size_t Y, std::size_t Z) {
+                bool Running = false;
+                for (std::size_t IndexX = BeginX; IndexX < EndX; ++IndexX) {
+                    const bool Open = IsOpen(IndexX, Y, Z);
+                    if (Open && !Running) {
+                        Stack.push_back({{ IndexX, Y, Z }});
+                    }
+                    Running = Open;
+                }
+            };
+            if (Seed[1] > 0) QueueRow(Seed[1] - 1, Seed[2]);
+            if (Seed[1] + 1 < SizeY) QueueRow(Seed[1] + 1, Seed[2]);
+            if (Seed[2] > 0) QueueRow(Seed[1], Seed[2] - 1);
+            if (Seed[2] + 1 < SizeZ) QueueRow(Seed[1], Seed[2] + 1);
+        }
+
+        // Fill enclosed voxels in parallel slabs, colouring each from the last surface voxel along its row.
+        ThreadPool::GetGlobal().ParallelFor(SizeZ, BrickSize, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    const std::uint8_t* RowOutside = Outside.data() + SizeX * (IndexY + SizeY * IndexZ);
+                    Voxel Surface;
+                    for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                        const Voxel& Current = Target(IndexX, IndexY, IndexZ);
+                        if (Current.Alpha != 0) {
+                            Surface = Current;
+                        }
+                        else if (RowOutside[IndexX] == 0) {
+                            Target.Set(IndexX, IndexY, IndexZ, Surface);
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
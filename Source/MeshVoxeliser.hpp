@@ -0,0 +1,115 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_MESHVOXELISER_HPP
+#define RAYMARCH_MESHVOXELISER_HPP
+
+#include "Maths.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  MeshVoxeliser loads triangle meshes and conservatively rasterises them into volumes.
+    class MeshVoxeliser {
+    public:
+        /// @brief  Mesh is an indexed triangle list with a colour per triangle.
+        struct Mesh {
+            /// @brief  Vertex positions.
+            std::vector<Vector3> Vertices;
+            /// @brief  Vertex indices, three per triangle.
+            std::vector<std::array<std::uint32_t, 3>> Triangles;
+            /// @brief  Triangle colours in R, G, B, A order, one per triangle.
+            std::vector<std::array<std::uint8_t, 4>> Colours;
+        };
+
+    private:
+        /// @brief  Deleted destructor.
+        ~MeshVoxeliser(void) = delete;
+        /// @brief  Deleted constructor.
+        MeshVoxeliser(void) = delete;
+
+    public:
+        /// @brief  Load a mesh, choosing the format from the file extension.
+        /// @param  Path - The path of an .obj or binary .stl file.
+        /// @param  Output - The mesh to load into, any existing contents are replaced.
+        /// @return True if the mesh was loaded.
+        static bool Load(const std::string& Path, Mesh& Output);
+
+        /// @brief  Load a Wavefront OBJ mesh, polygons are triangulated as fans and coloured from the diffuse colour of their material.
+        /// @param  Path - The path of the .obj file, material libraries are looked up relative to it.
+        /// @param  Output - The mesh to load into, any existing contents are replaced.
+        /// @return True if the mesh was loaded.
+        static bool LoadOBJ(const std::string& Path, Mesh& Output);
+
+        /// @brief  Load a binary STL mesh, triangles are coloured from the attribute word in the VisCAM and SolidView convention when its valid bit is set.
+        /// @param  Path - The path of the .stl file.
+        /// @param  Output - The mesh to load into, any existing contents are replaced.
+        /// @return True if the mesh was loaded.
+        static bool LoadSTL(const std::string& Path, Mesh& Output);
+
+        /// @brief  Rasterise a mesh into a volume, every voxel touched by a triangle is set to the colour of that triangle.
+        /// @param  Source - The mesh to rasterise.
+        /// @param  Resolution - The number of voxels along the longest side of the mesh bounds.
+        /// @param  Solid - True to also fill voxels enclosed by the surface, false to only rasterise the surface.
+        /// @return The voxelised mesh, sized to fit the mesh bounds.
+        static Volume Voxelise(const Mesh& Source, std::size_t Resolution, bool Solid);
+
+    private:
+        /// @brief  Read a whole file into memory, followed by a terminating zero.
+        /// @param  Path - The path of the file.
+        /// @param  Output - The file contents.
+        /// @return True if the file was read.
+        static bool ReadFile(const std::string& Path, std::vector<char>& Output);
+
+        /// @brief  Load the diffuse colours of the materials in a material library.
+        /// @param  Path - The path of the .mtl file.
+        /// @param  Materials - The map to add material colours to.
+        /// @return True if the library was read.
+        static bool LoadMTL(const std::string& Path, std::map<std::string, std::array<std::uint8_t, 4>>& Materials);
+
+        /// @brief  Rasterise one triangle into the slices of a volume between two depths.
+        /// @param  A - The first vertex in voxel coordinates.
+        /// @param  B - The second vertex in voxel coordinates.
+        /// @param  C - The third vertex in voxel coordinates.
+        /// @param  BeginZ - The first slice to rasterise.
+        /// @param  EndZ - One past the last slice to rasterise.
+        /// @param  Value - The voxel value.
+        /// @param  Target - The volume to rasterise into.
+        static void RasteriseTriangle(const Vector3& A, const Vector3& B, const Vector3& C, std::size_t BeginZ, std::size_t EndZ, Voxel Value, Volume& Target);
+
+        /// @brief  Fill the voxels enclosed by a surface, found as the empty voxels that cannot be reached from the outside.
+        ///         Each enclosed voxel takes the colour of the nearest surface voxel before it along its row.
+        /// @param  Target - The volume containing the surface.
+        static void FillInterior(Volume& Target);
+    };
+}
+
+#endif // RAYMARCH_MESHVOXELISER_HPP
@@ -0,0 +1,166 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "Noise.hpp"
+#include "CounterRandom.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace DeferredRasterisation {
+    /// @brief  Lattice hash multipliers, these must match the final pass shader.
+    constexpr static const std::uint32_t NoisePrimeX = 0x8DA6B343u;
+    constexpr static const std::uint32_t NoisePrimeY = 0xD8163841u;
+    constexpr static const std::uint32_t NoisePrimeZ = 0xCB1AB31Fu;
+
+    // Combine the coordinates, mix, and keep 24 bits so the value is exact as a float.
+    float Noise::Hash(int X, int Y, int Z, std::uint32_t Seed) {
+        const std::uint32_t Combined = (static_cast<std::uint32_t>(X) * NoisePrimeX) ^ (static_cast<std::uint32_t>(Y) * NoisePrimeY) ^ (static_cast<std::uint32_t>(Z) * NoisePrimeZ) ^ Seed;
+        return static_cast<float>(CounterRandom::Mix32(Combined) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Trilinear interpolation of the eight surrounding lattice values with a smoothstep fade.
+    float Noise::Value3(float X, float Y, float Z, std::uint32_t Seed) {
+        const float FloorX = std::floor(X);
+        const float FloorY = std::floor(Y);
+        const float FloorZ = std::floor(Z);
+        const int LatticeX = static_cast<int>(FloorX);
+        const int LatticeY = static_cast<int>(FloorY);
+        const int LatticeZ = static_cast<int>(FloorZ);
+
+        auto Fade = [](float Value) -> float { return Value * Value * (3.0f - 2.0f * Value); };
+        auto Mix = [](float From, float To, float Amount) -> float { return From + (To - From) * Amount; };
+        const float FadeX = Fade(X - FloorX);
+        const float FadeY = Fade(Y - FloorY);
+        const float FadeZ = Fade(Z - FloorZ);
+
+        return Mix(Mix(Mix(Hash(LatticeX, LatticeY,     LatticeZ,     Seed), Hash(LatticeX + 1, LatticeY,     LatticeZ,     Seed), FadeX),
+                       Mix(Hash(LatticeX, LatticeY + 1, LatticeZ,     Seed), Hash(LatticeX + 1, LatticeY + 1, LatticeZ,     Seed), FadeX), FadeY),
+                   Mix(Mix(Hash(LatticeX, LatticeY,     LatticeZ + 1, Seed), Hash(LatticeX + 1, LatticeY,     LatticeZ + 1, Seed), FadeX),
+                       Mix(Hash(LatticeX, LatticeY + 1, LatticeZ + 1, Seed), Hash(LatticeX + 1, LatticeY + 1, LatticeZ + 1, Seed), FadeX), FadeY), FadeZ);
+    }
+
+    // Evaluate a row of value noise.
+    void Noise::Value3Row(float BeginX, float StepX, float Y, float Z, std::uint32_t Seed, std::size_t Count, float* Output) {
+        std::size_t Index = 0;
+
+        #if defined(__SSE2__)
+            // SSE2 has no 32 bit low multiply, so build one from the two 32x32->64 bit multiplies.
+            auto MultiplyLow = [](__m128i LHS, __m128i RHS) -> __m128i {
+                const __m128i Even = _mm_mul_epu32(LHS, RHS);
+                const __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(LHS, 32), _mm_srli_epi64(RHS, 32));
+                return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+            };
+
+            // Vector version of CounterRandom::Mix32 followed by conversion to a float between 0.0 and 1.0.
+            const __m128i Multiplier1 = _mm_set1_epi32(0x7FEB352D);
+            const __m128i Multiplier2 = _mm_set1_epi32(static_cast<int>(0x846CA68Bu));
+            const __m128 Scale = _mm_set1_ps(1.0f / 16777216.0f);
+            auto HashToFloat = [&](__m128i Value) -> __m128 {
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+                Value = MultiplyLow(Value, Multiplier1);
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 15));
+                Value = MultiplyLow(Value, Multiplier2);
+                Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+                return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(Value, 8)), Scale);
+            };
+
+            auto Fade = [](__m128 Value) -> __m128 { return _mm_mul_ps(_mm_mul_ps(Value, Value), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), Value))); };
+            auto Mix = [](__m128 From, __m128 To, __m128 Amount) -> __m128 { return _mm_add_ps(From, _mm_mul_ps(_mm_sub_ps(To, From), Amount)); };
+
+            // The Y and Z parts of the hash input are the same for the whole row.
+            const float FloorY = std::floor(Y);
+            const float FloorZ = std::floor(Z);
+            const std::uint32_t LatticeY = static_cast<std::uint32_t>(static_cast<int>(FloorY));
+            const std::uint32_t LatticeZ = static_cast<std::uint32_t>(static_cast<int>(FloorZ));
+            const __m128i Row00 = _mm_set1_epi32(static_cast<int>(((LatticeY + 0) * NoisePrimeY) ^ ((LatticeZ + 0) * NoisePrimeZ) ^ Seed));
+            const __m128i Row10 = _mm_set1_epi32(static_cast<int>(((LatticeY + 1) * NoisePrimeY) ^ ((LatticeZ + 0) * NoisePrimeZ) ^ Seed));
+            const __m128i Row01 = _mm_set1_epi32(static_cast<int>(((LatticeY + 0) * NoisePrimeY) ^ ((LatticeZ + 1) * NoisePrimeZ) ^ Seed));
+            const __m128i Row11 = _mm_set1_epi32(static_cast<int>(((LatticeY + 1) * NoisePrimeY) ^ ((LatticeZ + 1) * NoisePrimeZ) ^ Seed));
+            const __m128 FadeY = _mm_set1_ps(((Y - FloorY) * (Y - FloorY)) * (3.0f - 2.0f * (Y - FloorY)));
+            const __m128 FadeZ = _mm_set1_ps(((Z - FloorZ) * (Z - FloorZ)) * (3.0f - 2.0f * (Z - FloorZ)));
+
+            const __m128i PrimeX = _mm_set1_epi32(static_cast<int>(NoisePrimeX));
+            const __m128 Lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+            for (; Index + 4 <= Count; Index += 4) {
+                const __m128 X = _mm_add_ps(_mm_set1_ps(BeginX), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(Index)), Lane), _mm_set1_ps(StepX)));
+
+                // Floor by truncating and stepping down where truncation rounded towards zero.
+                __m128i LatticeX = _mm_cvttps_epi32(X);
+                LatticeX = _mm_add_epi32(LatticeX, _mm_castps_si128(_mm_cmplt_ps(X, _mm_cvtepi32_ps(LatticeX))));
+                const __m128 FadeX = Fade(_mm_sub_ps(X, _mm_cvtepi32_ps(LatticeX)));
+
+                // Hash the eight corners, neighbouring X lattice points differ by one multiple of the prime.
+                const __m128i PartX0 = MultiplyLow(LatticeX, PrimeX);
+                const __m128i PartX1 = _mm_add_epi32(PartX0, PrimeX);
+
+                const __m128 Value = Mix(Mix(Mix(HashToFloat(_mm_xor_si128(PartX0, Row00)), HashToFloat(_mm_xor_si128(PartX1, Row00)), FadeX),
+                                             Mix(HashToFloat(_mm_xor_si128(PartX0, Row10)), HashToFloat(_mm_xor_si128(PartX1, Row10)), FadeX), FadeY),
+                                         Mix(Mix(HashToFloat(_mm_xor_si128(PartX0, Row01)), HashToFloat(_mm_xor_si128(PartX1, Row01)), FadeX),
+                                             Mix(HashToFloat(_mm_xor_si128(PartX0, Row11)), HashToFloat(_mm_xor_si128(PartX1, Row11)), FadeX), FadeY), FadeZ);
+                _mm_storeu_ps(Output + Index, Value);
+            }
+        #endif
+
+        // Evaluate the remaining samples one at a time.
+        for (; Index < Count; ++Index) {
+            Output[Index] = Value3(BeginX + static_cast<float>(Index) * StepX, Y, Z, Seed);
+        }
+    }
+
+    // Sum octaves of value noise.
+    void Noise::FractalRow(float BeginX, float StepX, float Y, float Z, std::size_t Octaves, std::uint32_t Seed, std::size_t Count, float* Output) {
+        std::fill(Output, Output + Count, 0.0f);
+
+        float Octave[256];
+        float Frequency = 1.0f;
+        float Amplitude = 1.0f;
+        float TotalAmplitude = 0.0f;
+        for (std::size_t OctaveIndex = 0; OctaveIndex < Octaves; ++OctaveIndex) {
+            const std::uint32_t OctaveSeed = Seed + static_cast<std::uint32_t>(OctaveIndex) * 0x9E3779B9u;
+            for (std::size_t Begin = 0; Begin < Count; Begin += 256) {
+                const std::size_t BlockCount = std::min<std::size_t>(256, Count - Begin);
+                Value3Row((BeginX + static_cast<float>(Begin) * StepX) * Frequency, StepX * Frequency, Y * Frequency, Z * Frequency, OctaveSeed, BlockCount, Octave);
+                for (std::size_t Index = 0; Index < BlockCount; ++Index) {
+                    Output[Begin + Index] += Octave[Index] * Amplitude;
+                }
+            }
+            TotalAmplitude += Amplitude;
+            Frequency *= 2.0f;
+            Amplitude *= 0.5f;
+        }
+
+        // Normalise back to between 0.0 and 1.0.
+        if (TotalAmplitude > 0.0f) {
+            for (std::size_t Index = 0; Index < Count; ++Index) {
+                Output[Index] /= TotalAmplitude;
+            }
+        }
+    }
+}
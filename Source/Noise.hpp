@@ -0,0 +1,82 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_NOISE_HPP
+#define RAYMARCH_NOISE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DeferredRasterisation {
+    /// @brief  Noise provides lattice value noise and fractal noise built from it.
+    ///         Lattice values come from an integer hash, the same hash is used by the final pass shader for colour noise.
+    class Noise {
+    private:
+        /// @brief  Deleted destructor.
+        ~Noise(void) = delete;
+        /// @brief  Deleted constructor.
+        Noise(void) = delete;
+
+    public:
+        /// @brief  Hash a lattice point to a value between 0.0 and 1.0.
+        /// @param  X - The X coordinate of the lattice point.
+        /// @param  Y - The Y coordinate of the lattice point.
+        /// @param  Z - The Z coordinate of the lattice point.
+        /// @param  Seed - The seed of the noise.
+        /// @return The lattice value.
+        static float Hash(int X, int Y, int Z, std::uint32_t Seed);
+
+        /// @brief  Evaluate smoothly interpolated 3D value noise.
+        /// @param  X - The X coordinate.
+        /// @param  Y - The Y coordinate.
+        /// @param  Z - The Z coordinate.
+        /// @param  Seed - The seed of the noise.
+        /// @return The noise value between 0.0 and 1.0.
+        static float Value3(float X, float Y, float Z, std::uint32_t Seed);
+
+        /// @brief  Evaluate 3D value noise along a row, four samples at a time where SIMD is available.
+        /// @param  BeginX - The X coordinate of the first sample.
+        /// @param  StepX - The X distance between samples.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @param  Seed - The seed of the noise.
+        /// @param  Count - The number of samples.
+        /// @param  Output - The output array, Output[I] equals Value3(BeginX + I * StepX, Y, Z, Seed).
+        static void Value3Row(float BeginX, float StepX, float Y, float Z, std::uint32_t Seed, std::size_t Count, float* Output);
+
+        /// @brief  Evaluate fractal Brownian motion along a row, summing octaves of value noise that double in frequency and halve in amplitude.
+        /// @param  BeginX - The X coordinate of the first sample.
+        /// @param  StepX - The X distance between samples.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @param  Octaves - The number of octaves to sum.
+        /// @param  Seed - The seed of the noise, each octave uses a different seed.
+        /// @param  Count - The number of samples.
+        /// @param  Output - The output array, values are normalised to between 0.0 and 1.0.
+        static void FractalRow(float BeginX, float StepX, float Y, float Z, std::size_t Octaves, std::uint32_t Seed, std::size_t Count, float* Output);
+    };
+}
+
+#endif // RAYMARCH_NOISE_HPP
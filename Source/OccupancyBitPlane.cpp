@@ -0,0 +1,153 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "OccupancyBitPlane.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace DeferredRasterisation {
+    // Nothing to follow yet.
+    OccupancyBitPlane::OccupancyBitPlane(void)
+        : Size({{0, 0, 0}})
+        , RowWords(0)
+        , BrickCount({{0, 0, 0}}) {
+    }
+
+    // Rebuild the changed bricks a brick layer at a time.
+    void OccupancyBitPlane::Update(const Volume& Source) {
+        Source.Drain(this->Cursor, this->DirtyBricks);
+
+        // A new size rebuilds everything.
+        if (Source.GetSize() != this->Size) {
+            this->Size = Source.GetSize();
+            this->RowWords = (this->Size[0] + 63) / 64;
+            this->Rows.assign(this->RowWords * this->Size[1] * this->Size[2], 0);
+            this->BrickCount = Source.GetBrickCount();
+            this->Bricks.assign(this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2], 0);
+            this->DirtyBricks.resize(this->Bricks.size());
+            for (std::size_t Brick = 0; Brick < this->DirtyBricks.size(); ++Brick) {
+                this->DirtyBricks[Brick] = Brick;
+            }
+        }
+        if (this->DirtyBricks.empty()) return;
+
+        // Bricks side by side along X share words, so each thread takes whole layers of bricks, which never share a word.
+        const std::size_t LayerBricks = this->BrickCount[0] * this->BrickCount[1];
+        ThreadPool::GetGlobal().ParallelFor(this->BrickCount[2], 1, [&](std::size_t Begin, std::size_t End) -> void {
+            std::vector<std::size_t>::const_iterator First = std::lower_bound(this->DirtyBricks.cbegin(), this->DirtyBricks.cend(), Begin * LayerBricks);
+            std::vector<std::size_t>::const_iterator Last = std::lower_bound(First, this->DirtyBricks.cend(), End * LayerBricks);
+            for (; First != Last; ++First) {
+                this->RebuildBrick(Source, *First);
+            }
+        });
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& OccupancyBitPlane::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the row width in words.
+    std::size_t OccupancyBitPlane::GetRowWords(void) const {
+        return this->RowWords;
+    }
+
+    // Get the first word of a row.
+    const std::uint64_t* OccupancyBitPlane::GetRow(std::size_t Y, std::size_t Z) const {
+        assert(Y < this->Size[1] && Z < this->Size[2]);
+        return &this->Rows[this->RowWords * (Y + this->Size[1] * Z)];
+    }
+
+    // Get the brick counts.
+    const std::array<std::size_t, 3>& OccupancyBitPlane::GetBrickCount(void) const {
+        return this->BrickCount;
+    }
+
+    // Mask each row of the box against its words.
+    bool OccupancyBitPlane::Overlaps(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const {
+        assert(End[0] <= this->Size[0] && End[1] <= this->Size[1] && End[2] <= this->Size[2]);
+        if ((Begin[0] >= End[0]) || (Begin[1] >= End[1]) || (Begin[2] >= End[2])) return false;
+
+        // Skip the box if every brick it touches is empty.
+        bool AnyBrick = false;
+        for (std::size_t BrickZ = Begin[2] / BrickSize; (BrickZ <= (End[2] - 1) / BrickSize) && !AnyBrick; ++BrickZ) {
+            for (std::size_t BrickY = Begin[1] / BrickSize; (BrickY <= (End[1] - 1) / BrickSize) && !AnyBrick; ++BrickY) {
+                for (std::size_t BrickX = Begin[0] / BrickSize; (BrickX <= (End[0] - 1) / BrickSize) && !AnyBrick; ++BrickX) {
+                    AnyBrick = this->IsBrickOccupied(BrickX, BrickY, BrickZ);
+                }
+            }
+        }
+        if (!AnyBrick) return false;
+
+        // The words and masks are the same for every row.
+        const std::size_t FirstWord = Begin[0] / 64;
+        const std::size_t LastWord = (End[0] - 1) / 64;
+        const std::uint64_t FirstMask = ~std::uint64_t(0) << (Begin[0] % 64);
+        const std::uint64_t LastMask = ~std::uint64_t(0) >> (63 - ((End[0] - 1) % 64));
+        for (std::size_t IndexZ = Begin[2]; IndexZ < End[2]; ++IndexZ) {
+            for (std::size_t IndexY = Begin[1]; IndexY < End[1]; ++IndexY) {
+                const std::uint64_t* Row = this->GetRow(IndexY, IndexZ);
+                if (FirstWord == LastWord) {
+                    if ((Row[FirstWord] & FirstMask & LastMask) != 0) return true;
+                    continue;
+                }
+                std::uint64_t Bits = (Row[FirstWord] & FirstMask) | (Row[LastWord] & LastMask);
+                for (std::size_t Word = FirstWord + 1; Word < LastWord; ++Word) {
+                    Bits |= Row[Word];
+                }
+                if (Bits != 0) return true;
+            }
+        }
+        return false;
+    }
+
+    // Gather one byte of bits per brick row.
+    void OccupancyBitPlane::RebuildBrick(const Volume& Source, std::size_t Brick) {
+        const std::size_t BeginX = (Brick % this->BrickCount[0]) * BrickSize;
+        const std::size_t BeginY = ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize;
+        const std::size_t BeginZ = (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize;
+        const std::size_t EndX = std::min(BeginX + BrickSize, this->Size[0]);
+        const std::size_t EndY = std::min(BeginY + BrickSize, this->Size[1]);
+        const std::size_t EndZ = std::min(BeginZ + BrickSize, this->Size[2]);
+        const std::size_t Word = BeginX / 64;
+        const std::size_t Shift = BeginX % 64;
+
+        std::uint64_t Occupied = 0;
+        for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+            for (std::size_t IndexY = BeginY; IndexY < EndY; ++IndexY) {
+                // Rows of a linear volume are contiguous.
+                const Voxel* Voxels = &Source(BeginX, IndexY, IndexZ);
+                std::uint64_t Bits = 0;
+                for (std::size_t IndexX = 0; IndexX < EndX - BeginX; ++IndexX) {
+                    Bits |= static_cast<std::uint64_t>(Voxels[IndexX].Alpha != 0) << IndexX;
+                }
+                std::uint64_t& Target = this->Rows[Word + this->RowWords * (IndexY + this->Size[1] * IndexZ)];
+                Target = (Target & ~(std::uint64_t(0xFF) << Shift)) | (Bits << Shift);
+                Occupied |= Bits;
+            }
+        }
+        this->Bricks[Brick] = (Occupied != 0) ? 1 : 0;
+    }
+}
@@ -0,0 +1,135 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_OCCUPANCYBITPLANE_HPP
+#define RAYMARCH_OCCUPANCYBITPLANE_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  OccupancyBitPlane is a one bit per voxel copy of which voxels of a volume are non-empty.
+    ///         Rows along X are packed 64 voxels to a word, so a brick row is one byte of a word and whole rows can be tested with a few masks.
+    ///         Each brick also has an occupied flag, so queries can skip empty bricks without looking at their bits.
+    ///         It follows one volume, each update only rebuilds the bricks that changed since the last.
+    class OccupancyBitPlane {
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of words in each row along X.
+        std::size_t RowWords;
+
+        /// @brief  The bits of each row, word X of row Y, Z is at X + RowWords * (Y + SizeY * Z).
+        std::vector<std::uint64_t> Rows;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  Non-zero for each brick in linear order that has at least one occupied voxel.
+        std::vector<std::uint8_t> Bricks;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+    public:
+        /// @brief  Constructor that creates an empty bit plane of no size.
+        OccupancyBitPlane(void);
+
+    public:
+        /// @brief  Bring the bit plane up to date with a volume, rebuilding only the bricks that changed since the last update.
+        ///         The first update, and any update with a volume of another size, rebuilds everything.
+        /// @param  Source - The volume to follow, always the same volume.
+        void Update(const Volume& Source);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the number of words in each row along X.
+        /// @return The number of words.
+        std::size_t GetRowWords(void) const;
+
+        /// @brief  Get the words of a row along X, bit X % 64 of word X / 64 is set if voxel X is occupied.
+        ///         Bits beyond the width of the volume are always clear.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @return Pointer to the first word of the row.
+        const std::uint64_t* GetRow(std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Get the number of bricks along each axis.
+        /// @return The brick counts.
+        const std::array<std::size_t, 3>& GetBrickCount(void) const;
+
+        /// @brief  Test if a voxel is occupied.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return True if the voxel is not empty.
+        bool IsOccupied(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Test if a brick has any occupied voxels.
+        /// @param  BrickX - The X index of the brick.
+        /// @param  BrickY - The Y index of the brick.
+        /// @param  BrickZ - The Z index of the brick.
+        /// @return True if at least one voxel of the brick is not empty.
+        bool IsBrickOccupied(std::size_t BrickX, std::size_t BrickY, std::size_t BrickZ) const;
+
+        /// @brief  Test if any voxel in a box is occupied, a row at a time with a mask per word.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, must be within the volume.
+        /// @return True if at least one voxel of the box is not empty.
+        bool Overlaps(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const;
+
+    private:
+        /// @brief  Rebuild the bits and flag of one brick.
+        /// @param  Source - The volume being followed.
+        /// @param  Brick - The linear index of the brick.
+        void RebuildBrick(const Volume& Source, std::size_t Brick);
+    };
+
+    // Test the bit of the voxel.
+    inline bool OccupancyBitPlane::IsOccupied(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        return ((this->Rows[(X / 64) + this->RowWords * (Y + this->Size[1] * Z)] >> (X % 64)) & 1) != 0;
+    }
+
+    // Test the flag of the brick.
+    inline bool OccupancyBitPlane::IsBrickOccupied(std::size_t BrickX, std::size_t BrickY, std::size_t BrickZ) const {
+        assert(BrickX < this->BrickCount[0] && BrickY < this->BrickCount[1] && BrickZ < this->BrickCount[2]);
+        return this->Bricks[BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ)] != 0;
+    }
+}
+
+#endif // RAYMARCH_OCCUPANCYBITPLANE_HPP
@@ -0,0 +1,111 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ProceduralVolume.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace DeferredRasterisation {
+    // Store the generator, nothing is generated yet.
+    ProceduralVolume::ProceduralVolume(const std::array<std::size_t, 3>& Size, GeneratorType Generator, std::size_t CacheCapacity)
+        : Size(Size)
+        , Generator(Generator)
+        , CacheCapacity(std::max<std::size_t>(CacheCapacity, 1))
+        , Cache(std::make_shared<ChunkCache>()) {
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3> ProceduralVolume::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the number of chunks in the cache.
+    std::size_t ProceduralVolume::GetCachedChunkCount(void) const {
+        return this->Cache->Chunks.size();
+    }
+
+    // Get a chunk from the cache or generate it.
+    const Volume& ProceduralVolume::GetChunk(const std::array<std::size_t, 3>& ChunkIndex) const {
+        ChunkCache& Cache = *this->Cache;
+
+        // Move cached chunks to the front of the list.
+        auto Found = Cache.Lookup.find(ChunkIndex);
+        if (Found != Cache.Lookup.end()) {
+            Cache.Chunks.splice(Cache.Chunks.begin(), Cache.Chunks, Found->second);
+            return Found->second->second;
+        }
+
+        // Evict the least recently used chunk when full.
+        if (Cache.Chunks.size() >= this->CacheCapacity) {
+            Cache.Lookup.erase(Cache.Chunks.back().first);
+            Cache.Chunks.pop_back();
+        }
+
+        // Allocate and generate the chunk, clipped to the volume.
+        std::array<std::size_t, 3> Origin;
+        std::array<std::size_t, 3> ChunkExtent;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Origin[Axis] = ChunkIndex[Axis] * ChunkSize;
+            assert(Origin[Axis] < this->Size[Axis]);
+            ChunkExtent[Axis] = std::min(ChunkSize, this->Size[Axis] - Origin[Axis]);
+        }
+        Cache.Chunks.emplace_front(ChunkIndex, Volume(ChunkExtent));
+        this->Generator(Origin, Cache.Chunks.front().second);
+        Cache.Lookup[ChunkIndex] = Cache.Chunks.begin();
+        return Cache.Chunks.front().second;
+    }
+
+    // Insert the chunks that overlap the target.
+    void ProceduralVolume::InsertInto(int X, int Y, int Z, Volume& Target) const {
+        // Find the range of chunks that overlap the target.
+        const int Offset[3] = { X, Y, Z };
+        const std::array<std::size_t, 3> TargetSize = Target.GetSize();
+        std::size_t BeginChunk[3];
+        std::size_t EndChunk[3];
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int First = std::max(0, -Offset[Axis]);
+            const int Last = std::min(static_cast<int>(this->Size[Axis]), static_cast<int>(TargetSize[Axis]) - Offset[Axis]);
+            if (First >= Last) return;
+            BeginChunk[Axis] = static_cast<std::size_t>(First) / ChunkSize;
+            EndChunk[Axis] = (static_cast<std::size_t>(Last) + ChunkSize - 1) / ChunkSize;
+        }
+
+        // Generate or fetch each chunk and insert it.
+        for (std::size_t ChunkZ = BeginChunk[2]; ChunkZ < EndChunk[2]; ++ChunkZ) {
+            for (std::size_t ChunkY = BeginChunk[1]; ChunkY < EndChunk[1]; ++ChunkY) {
+                for (std::size_t ChunkX = BeginChunk[0]; ChunkX < EndChunk[0]; ++ChunkX) {
+                    const Volume& Chunk = this->GetChunk({{ChunkX, ChunkY, ChunkZ}});
+                    Target.Insert(X + static_cast<int>(ChunkX * ChunkSize), Y + static_cast<int>(ChunkY * ChunkSize), Z + static_cast<int>(ChunkZ * ChunkSize), Chunk);
+                }
+            }
+        }
+    }
+
+    // Drop all cached chunks.
+    void ProceduralVolume::ClearCache(void) {
+        this->Cache->Chunks.clear();
+        this->Cache->Lookup.clear();
+    }
+}
@@ -0,0 +1,110 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_PROCEDURALVOLUME_HPP
+#define RAYMARCH_PROCEDURALVOLUME_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+
+namespace DeferredRasterisation {
+    /// @brief  ProceduralVolume is a volume whose voxels are produced by a generator, one chunk at a time, only when requested.
+    ///         Generated chunks are kept in a bounded least recently used cache that is shared between copies.
+    ///         The cache is not synchronised, a procedural volume and all of its copies must be used from one thread at a time.
+    class ProceduralVolume {
+    public:
+        /// @brief  The edge length of a chunk.
+        constexpr static const std::size_t ChunkSize = 32;
+
+        /// @brief  A generator fills a chunk given the position of the chunk origin within the procedural volume.
+        ///         The chunk is allocated empty, chunks at the far edges are clipped to the size of the volume.
+        typedef std::function<void(const std::array<std::size_t, 3>& Origin, Volume& Chunk)> GeneratorType;
+
+    private:
+        /// @brief  The chunk cache shared between copies of a procedural volume.
+        struct ChunkCache {
+            /// @brief  Materialised chunks, the most recently used chunk is at the front.
+            std::list<std::pair<std::array<std::size_t, 3>, Volume> > Chunks;
+
+            /// @brief  Lookup from chunk index to cached chunk.
+            std::map<std::array<std::size_t, 3>, std::list<std::pair<std::array<std::size_t, 3>, Volume> >::iterator> Lookup;
+        };
+
+    private:
+        /// @brief  Size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The generator that fills chunks.
+        GeneratorType Generator;
+
+        /// @brief  The maximum number of chunks held in the cache.
+        std::size_t CacheCapacity;
+
+        /// @brief  The chunk cache.
+        std::shared_ptr<ChunkCache> Cache;
+
+    public:
+        /// @brief  Constructor that wraps a generator, no voxels are generated until they are requested.
+        /// @param  Size - The size of the volume.
+        /// @param  Generator - The generator that fills chunks.
+        /// @param  CacheCapacity - The maximum number of chunks to keep materialised.
+        ProceduralVolume(const std::array<std::size_t, 3>& Size, GeneratorType Generator, std::size_t CacheCapacity = 256);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return The size of the volume.
+        const std::array<std::size_t, 3> GetSize(void) const;
+
+        /// @brief  Get the number of chunks currently materialised.
+        /// @return The number of cached chunks.
+        std::size_t GetCachedChunkCount(void) const;
+
+    public:
+        /// @brief  Get a chunk, generating it if it is not cached.
+        ///         Although const, this updates the cache shared with every copy, so it is not thread-safe.
+        ///         The reference is only valid until the next call to GetChunk, InsertInto or ClearCache on this volume or any copy, which may evict it.
+        /// @param  ChunkIndex - The index of the chunk along each axis.
+        /// @return The chunk volume.
+        const Volume& GetChunk(const std::array<std::size_t, 3>& ChunkIndex) const;
+
+        /// @brief  Write the part of this volume that overlaps a target volume into the target.
+        ///         Only chunks that overlap the target are generated.
+        /// @param  X - The X location of this volume within the target.
+        /// @param  Y - The Y location of this volume within the target.
+        /// @param  Z - The Z location of this volume within the target.
+        /// @param  Target - The volume to write into.
+        void InsertInto(int X, int Y, int Z, Volume& Target) const;
+
+        /// @brief  Release every materialised chunk.
+        void ClearCache(void);
+    };
+}
+
+#endif // RAYMARCH_PROCEDURALVOLUME_HPP
@@ -0,0 +1,188 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "RayCaster.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace DeferredRasterisation {
+    // Clip the ray to the volume, then step brick by brick through empty space and voxel by voxel through occupied bricks.
+    RayCaster::Hit RayCaster::Trace(const Volume& Source, const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const Ray& Query) {
+        assert(Source.GetSize() == Occupancy.GetSize());
+        const float Infinity = std::numeric_limits<float>::infinity();
+
+        Hit Result;
+        Result.Found = false;
+        Result.Position = {{0, 0, 0}};
+        Result.Normal = {{0, 0, 0}};
+        Result.Distance = Query.MaxDistance;
+        Result.Value = Voxel();
+
+        const std::array<std::size_t, 3>& Size = Occupancy.GetSize();
+        const float Length = std::sqrt(Query.Direction[0] * Query.Direction[0] + Query.Direction[1] * Query.Direction[1] + Query.Direction[2] * Query.Direction[2]);
+        if ((Size[0] == 0) || (Size[1] == 0) || (Size[2] == 0) || (Length == 0.0f)) return Result;
+
+        // The ray relative to the volume, with distances measured along the normalised direction.
+        std::array<float, 3> Start;
+        std::array<float, 3> Direction;
+        std::array<float, 3> Inverse;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Start[Axis] = Query.Origin[Axis] - static_cast<float>(Origin[Axis]);
+            Direction[Axis] = Query.Direction[Axis] / Length;
+            Inverse[Axis] = (Direction[Axis] != 0.0f) ? (1.0f / Direction[Axis]) : Infinity;
+        }
+
+        // Clip the ray to the bounds of the volume.
+        float Near = 0.0f;
+        float Far = Query.MaxDistance;
+        int NearAxis = -1;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const float Extent = static_cast<float>(Size[Axis]);
+            if (Direction[Axis] == 0.0f) {
+                if ((Start[Axis] < 0.0f) || (Start[Axis] >= Extent)) return Result;
+                continue;
+            }
+            float Enter = (0.0f - Start[Axis]) * Inverse[Axis];
+            float Leave = (Extent - Start[Axis]) * Inverse[Axis];
+            if (Enter > Leave) std::swap(Enter, Leave);
+            if (Enter > Near) {
+                Near = Enter;
+                NearAxis = static_cast<int>(Axis);
+            }
+            Far = std::min(Far, Leave);
+        }
+        if (Near > Far) return Result;
+
+        // The first voxel, the entry axis is snapped to the face it entered through.
+        std::array<int, 3> Position;
+        std::array<int, 3> Step;
+        std::array<float, 3> NextBoundary;
+        std::array<float, 3> BoundaryDelta;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int Last = static_cast<int>(Size[Axis]) - 1;
+            Step[Axis] = (Direction[Axis] > 0.0f) ? 1 : ((Direction[Axis] < 0.0f) ? -1 : 0);
+            if (static_cast<int>(Axis) == NearAxis) {
+                Position[Axis] = (Step[Axis] > 0) ? 0 : Last;
+            }
+            else {
+                Position[Axis] = std::min(std::max(static_cast<int>(std::floor(Start[Axis] + Direction[Axis] * Near)), 0), Last);
+            }
+        }
+
+        // Find the distance to the next voxel boundary on each axis from the current voxel.
+        auto ResetBoundaries = [&](void) -> void {
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                if (Step[Axis] == 0) {
+                    NextBoundary[Axis] = Infinity;
+                    BoundaryDelta[Axis] = Infinity;
+                }
+                else {
+                    NextBoundary[Axis] = (static_cast<float>(Position[Axis] + ((Step[Axis] > 0) ? 1 : 0)) - Start[Axis]) * Inverse[Axis];
+                    BoundaryDelta[Axis] = std::abs(Inverse[Axis]);
+                }
+            }
+        };
+        ResetBoundaries();
+
+        std::array<int, 3> Normal = {{0, 0, 0}};
+        if (NearAxis >= 0) {
+            Normal[NearAxis] = -Step[NearAxis];
+        }
+
+        float Distance = Near;
+        const int Brick = static_cast<int>(BrickSize);
+        for (;;) {
+            const std::array<int, 3> BrickPosition = {{Position[0] / Brick, Position[1] / Brick, Position[2] / Brick}};
+            if (!Occupancy.IsBrickOccupied(BrickPosition[0], BrickPosition[1], BrickPosition[2])) {
+                // Leave an empty brick through the nearest of its faces the ray is heading towards.
+                float Exit = Infinity;
+                std::size_t ExitAxis = 0;
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    if (Step[Axis] == 0) continue;
+                    const int Boundary = (BrickPosition[Axis] + ((Step[Axis] > 0) ? 1 : 0)) * Brick;
+                    const float Time = (static_cast<float>(Boundary) - Start[Axis]) * Inverse[Axis];
+                    if (Time < Exit) {
+                        Exit = Time;
+                        ExitAxis = Axis;
+                    }
+                }
+                if (Exit > Far) return Result;
+
+                // Enter the neighbouring brick, other axes stay within the current brick so rounding cannot skip a brick.
+                Distance = std::max(Distance, Exit);
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    const int BrickBegin = BrickPosition[Axis] * Brick;
+                    if (Axis == ExitAxis) {
+                        Position[Axis] = (Step[Axis] > 0) ? (BrickBegin + Brick) : (BrickBegin - 1);
+                    }
+                    else {
+                        const int BrickLast = std::min(BrickBegin + Brick, static_cast<int>(Size[Axis])) - 1;
+                        Position[Axis] = std::min(std::max(static_cast<int>(std::floor(Start[Axis] + Direction[Axis] * Distance)), BrickBegin), BrickLast);
+                    }
+                }
+                if ((Position[ExitAxis] < 0) || (Position[ExitAxis] >= static_cast<int>(Size[ExitAxis]))) return Result;
+                Normal = {{0, 0, 0}};
+                Normal[ExitAxis] = -Step[ExitAxis];
+                ResetBoundaries();
+                continue;
+            }
+
+            // Test the voxel.
+            if (Occupancy.IsOccupied(Position[0], Position[1], Position[2])) {
+                Result.Found = true;
+                Result.Position = {{Position[0] + Origin[0], Position[1] + Origin[1], Position[2] + Origin[2]}};
+                Result.Normal = Normal;
+                Result.Distance = Distance;
+                Result.Value = Source(Position[0], Position[1], Position[2]);
+                return Result;
+            }
+
+            // Step to the neighbouring voxel across the nearest boundary.
+            std::size_t Axis = 0;
+            if (NextBoundary[1] < NextBoundary[Axis]) Axis = 1;
+            if (NextBoundary[2] < NextBoundary[Axis]) Axis = 2;
+            Distance = std::max(Distance, NextBoundary[Axis]);
+            if (Distance > Far) return Result;
+            Position[Axis] += Step[Axis];
+            if ((Position[Axis] < 0) || (Position[Axis] >= static_cast<int>(Size[Axis]))) return Result;
+            NextBoundary[Axis] += BoundaryDelta[Axis];
+            Normal = {{0, 0, 0}};
+            Normal[Axis] = -Step[Axis];
+        }
+    }
+
+    // Rays are independent, so batches split into even chunks.
+    void RayCaster::TraceBatch(const Volume& Source, const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const std::vector<Ray>& Queries, std::vector<Hit>& Hits) {
+        Hits.resize(Queries.size());
+        ThreadPool::GetGlobal().ParallelFor(Queries.size(), 256, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                Hits[Index] = RayCaster::Trace(Source, Occupancy, Origin, Queries[Index]);
+            }
+        });
+    }
+}
@@ -0,0 +1,89 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_RAYCASTER_HPP
+#define RAYMARCH_RAYCASTER_HPP
+
+#include "OccupancyBitPlane.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  RayCaster finds the first occupied voxel along rays through a volume, for picking, line of sight and AI queries.
+    ///         Rays walk the volume with a 3D DDA over the occupancy bit plane, stepping over empty bricks in one go and only visiting voxels in occupied bricks.
+    class RayCaster {
+    private:
+        /// @brief  Deleted destructor.
+        ~RayCaster(void) = delete;
+        /// @brief  Deleted constructor.
+        RayCaster(void) = delete;
+
+    public:
+        /// @brief  A ray in map coordinates, voxel X, Y, Z covers the unit cube from X, Y, Z.
+        struct Ray {
+            /// @brief  The start of the ray.
+            std::array<float, 3> Origin;
+            /// @brief  The direction of the ray, need not be normalised but must not be zero.
+            std::array<float, 3> Direction;
+            /// @brief  The furthest distance along the ray to look for a hit.
+            float MaxDistance;
+        };
+
+        /// @brief  The result of tracing a ray.
+        struct Hit {
+            /// @brief  True if the ray hit an occupied voxel within its maximum distance.
+            bool Found;
+            /// @brief  The position of the hit voxel in map coordinates.
+            std::array<int, 3> Position;
+            /// @brief  The outward normal of the face the ray entered through, zero if the ray started inside the voxel.
+            std::array<int, 3> Normal;
+            /// @brief  The distance along the ray to the face.
+            float Distance;
+            /// @brief  The hit voxel.
+            Voxel Value;
+        };
+
+    public:
+        /// @brief  Trace a ray to the first occupied voxel.
+        /// @param  Source - The volume, providing the value of the hit voxel.
+        /// @param  Occupancy - The occupancy of the volume, up to date with it.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  Query - The ray.
+        /// @return The hit, Found is false if the ray left the volume or went further than its maximum distance first.
+        static Hit Trace(const Volume& Source, const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const Ray& Query);
+
+        /// @brief  Trace many rays in parallel.
+        /// @param  Source - The volume, providing the values of hit voxels.
+        /// @param  Occupancy - The occupancy of the volume, up to date with it.
+        /// @param  Origin - The position of the volume in the map.
+        /// @param  Queries - The rays.
+        /// @param  Hits - Output for the hit of each ray, resized to match.
+        static void TraceBatch(const Volume& Source, const OccupancyBitPlane& Occupancy, const std::array<int, 3>& Origin, const std::vector<Ray>& Queries, std::vector<Hit>& Hits);
+    };
+}
+
+#endif // RAYMARCH_RAYCASTER_HPP
@@ -28,6 +28,8 @@ THE SOFTWARE
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <cstring>
 #include <iostream>
@@ -47,6 +49,21 @@ THE SOFTWARE
 #endif
 
 namespace DeferredRasterisation {
+    namespace {
+        /// @brief  Make the point of a voxel, its position, a placeholder normal, then its hue, saturation and light.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @param  Value - The voxel.
+        /// @return The vertex of the point.
+        std::array<GLfloat, 9> MakePoint(std::size_t X, std::size_t Y, std::size_t Z, const Voxel& Value) {
+            float Hue = float(Value.Hue - uint(4)) / 11.0f;
+            float Saturation = float(Value.Saturation) / 3.0f;
+            float Light = float(Value.Light) / 15.0f;
+            return {{static_cast<float>(X) / 100.0f, static_cast<float>(Y) / 100.0f, static_cast<float>(Z) / 100.0f, 1, 0, 0, Hue, Saturation, Light}};
+        }
+    }
+
     // Constructor that initialises the renderer at the provided size.
     Renderer::Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight)
         : ScreenWidth(ScreenWidth)
@@ -258,6 +275,25 @@ namespace DeferredRasterisation {
             std::abort();
         }
 
+        // Create a texture for the sun shadow map, it is uploaded when the map changes.
+        CHECK_GL(glGenTextures(1, &this->TextureShadow));
+        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureShadow));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        this->ShadowVersion = std::numeric_limits<std::uint64_t>::max();
+
+        // Create a 3D texture for the ambient occlusion, it is uploaded when a bake changes it.
+        CHECK_GL(glGenTextures(1, &this->TextureOcclusion));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        CHECK_GL(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+        this->OcclusionVersion = std::numeric_limits<std::uint64_t>::max();
+
         ///////////////////////////////////////////////////////////////////////////
         /// Uniforms and texture.                                                //
         ///////////////////////////////////////////////////////////////////////////
@@ -268,6 +304,8 @@ namespace DeferredRasterisation {
         // Stage 1.
         this->ShaderUniformModelViewProjection      = CHECK_GL(glGetUniformLocation(this->ShaderProgram1, "ModelViewProjectionMatrix"));
         this->ShaderUniformModel                    = CHECK_GL(glGetUniformLocation(this->ShaderProgram1, "ModelMatrix"));
+        this->ShaderUniformClipMinimum              = CHECK_GL(glGetUniformLocation(this->ShaderProgram1, "ClipMinimum"));
+        this->ShaderUniformClipMaximum              = CHECK_GL(glGetUniformLocation(this->ShaderProgram1, "ClipMaximum"));
 
         this->ShaderUniformPosition                 = CHECK_GL(glGetAttribLocation(this->ShaderProgram1, "InputPosition"));
         this->ShaderUniformNormal                   = CHECK_GL(glGetAttribLocation(this->ShaderProgram1, "InputNormal"));
@@ -283,6 +321,7 @@ namespace DeferredRasterisation {
         this->ShaderUniformPixelDimensions          = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "PixelDimensions"));
         this->ShaderUniformLast                     = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "LastRender"));
         this->ShaderUniformSceneOffset              = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "SceneOffset"));
+        this->ShaderUniformLightPosition            = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "LightPosition"));
 
         // Set the samplers.
         const GLint ShaderUniformSamplerPosition2   = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "PositionSampler"));
@@ -291,6 +330,10 @@ namespace DeferredRasterisation {
         CHECK_GL(glUniform1i(ShaderUniformSamplerNormal2, 1));
         const GLint ShaderUniformSamplerColour2     = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "ColourSampler"));
         CHECK_GL(glUniform1i(ShaderUniformSamplerColour2, 2));
+        const GLint ShaderUniformSamplerShadow2     = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "ShadowSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformSamplerShadow2, 3));
+        const GLint ShaderUniformSamplerOcclusion2  = CHECK_GL(glGetUniformLocation(this->ShaderProgram2, "OcclusionSampler"));
+        CHECK_GL(glUniform1i(ShaderUniformSamplerOcclusion2, 4));
 
         // Configure OpenGL.
         CHECK_GL(glEnable(GL_DEPTH_TEST));
@@ -310,6 +353,25 @@ namespace DeferredRasterisation {
         CHECK_GL(glGenBuffers(1, &this->VertexBuffer));
         CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer));
 
+        this->VertexCount = 0;
+        this->SceneVersion = std::numeric_limits<std::uint64_t>::max();
+        this->FrameIndex = 0;
+
+        CHECK_GL(glVertexAttribPointer(this->ShaderUniformPosition, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (0 * sizeof(GLfloat))));
+        CHECK_GL(glVertexAttribPointer(this->ShaderUniformNormal, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat))));
+        CHECK_GL(glVertexAttribPointer(this->ShaderUniformColour, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (6 * sizeof(GLfloat))));
+
+        CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformPosition));
+        CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformNormal));
+        CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformColour));
+
+        // The baked points use the same vertex layout in a buffer of their own.
+        CHECK_GL(glGenVertexArrays(1, &this->BakedVertexArray));
+        CHECK_GL(glBindVertexArray(this->BakedVertexArray));
+
+        CHECK_GL(glGenBuffers(1, &this->BakedVertexBuffer));
+        CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, this->BakedVertexBuffer));
+
         CHECK_GL(glVertexAttribPointer(this->ShaderUniformPosition, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (0 * sizeof(GLfloat))));
         CHECK_GL(glVertexAttribPointer(this->ShaderUniformNormal, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat))));
         CHECK_GL(glVertexAttribPointer(this->ShaderUniformColour, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (6 * sizeof(GLfloat))));
@@ -343,44 +405,169 @@ namespace DeferredRasterisation {
         Matrix44 ModelViewProjection = ViewProjection * this->Model;
         Matrix44 ViewProjectionInverse = Matrix44::Invert(ViewProjection);
 
-        CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModelViewProjection, 1, GL_TRUE, ModelViewProjection.data()));
-        CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModel, 1, GL_TRUE, this->Model.data()));
+        // Nothing is clipped unless a draw sets its own clip box.
+        CHECK_GL(glUniform3f(this->ShaderUniformClipMinimum, -FLT_MAX, -FLT_MAX, -FLT_MAX));
+        CHECK_GL(glUniform3f(this->ShaderUniformClipMaximum, FLT_MAX, FLT_MAX, FLT_MAX));
+
+        // A baked world on its own is drawn from its stored points until anything changes the scene, from then on the scene is walked.
+        const std::shared_ptr<const SceneCache>& Cache = State.GetSceneCache();
+        if ((Cache != nullptr) && State.IsSceneBaked()) {
+            // Upload the points once, straight from the file mapping.
+            if (this->BakedScene != Cache) {
+                CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, this->BakedVertexBuffer));
+                CHECK_GL(glBufferData(GL_ARRAY_BUFFER, Cache->GetPointCount() * 9 * sizeof(GLfloat), Cache->GetPoints(), GL_STATIC_DRAW));
+                this->BakedScene = Cache;
+            }
 
-        // Allocate a vertex array and fill it from the voxel volume.
-        static std::vector<std::array<GLfloat, 9> > map;
+            // The points are in map coordinates, translate them into the scene.
+            const std::array<int, 3>& SceneOffset = State.GetSceneOffset();
+            Matrix44 SceneModel = this->Model * Matrix44(
+                1, 0, 0, -static_cast<float>(SceneOffset[0]) / 100.0f,
+                0, 1, 0, -static_cast<float>(SceneOffset[1]) / 100.0f,
+                0, 0, 1, -static_cast<float>(SceneOffset[2]) / 100.0f,
+                0, 0, 0, 1
+            );
+            Matrix44 SceneModelViewProjection = ViewProjection * SceneModel;
+
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModelViewProjection, 1, GL_TRUE, SceneModelViewProjection.data()));
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModel, 1, GL_TRUE, SceneModel.data()));
+
+            // Find the bricks that overlap the scene, each row of bricks along X is one contiguous range of points.
+            // The bricks holding a face of the scene where it cuts the world also draw their interior points, so cut solids are not hollow.
+            std::array<std::size_t, 3> BrickBegin;
+            std::array<std::size_t, 3> BrickEnd;
+            std::array<std::array<std::size_t, 2>, 3> CutBricks;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                const long long WorldSize = static_cast<long long>(Cache->GetWorld().GetSize()[Axis]);
+                const long long Begin = std::min(std::max(static_cast<long long>(SceneOffset[Axis]) - Cache->GetOrigin()[Axis], 0ll), WorldSize);
+                const long long End = std::min(std::max(static_cast<long long>(SceneOffset[Axis]) - Cache->GetOrigin()[Axis] + static_cast<long long>(State.GetScene().GetSize()[Axis]), 0ll), WorldSize);
+                BrickBegin[Axis] = static_cast<std::size_t>(Begin / static_cast<long long>(BrickSize));
+                BrickEnd[Axis] = static_cast<std::size_t>((End + static_cast<long long>(BrickSize) - 1) / static_cast<long long>(BrickSize));
+                CutBricks[Axis][0] = (Begin > 0) ? BrickBegin[Axis] : SIZE_MAX;
+                CutBricks[Axis][1] = (End < WorldSize) ? BrickEnd[Axis] - 1 : SIZE_MAX;
+            }
 
-        // Clear the old map, from the previous frame.
-        map.clear();
+            static std::vector<GLint> RangeFirsts;
+            static std::vector<GLsizei> RangeCounts;
+            RangeFirsts.clear();
+            RangeCounts.clear();
 
-        // Ensure enough memory is reserved for the entire scene.
-        map.reserve(State.GetScene().GetSizeZ() * State.GetScene().GetSizeY() * State.GetScene().GetSizeX());
+            // Helper function to add a range, merging ranges that follow on from each other.
+            auto AddRange = [](const std::array<std::size_t, 2>& Range) -> void {
+                if (Range[1] == 0) {
+                    return;
+                }
+                if (!RangeFirsts.empty() && (static_cast<std::size_t>(RangeFirsts.back()) + static_cast<std::size_t>(RangeCounts.back()) == Range[0])) {
+                    RangeCounts.back() += static_cast<GLsizei>(Range[1]);
+                }
+                else {
+                    RangeFirsts.push_back(static_cast<GLint>(Range[0]));
+                    RangeCounts.push_back(static_cast<GLsizei>(Range[1]));
+                }
+            };
+
+            if (BrickBegin[0] < BrickEnd[0]) {
+                for (std::size_t BrickZ = BrickBegin[2]; BrickZ < BrickEnd[2]; ++BrickZ) {
+                    for (std::size_t BrickY = BrickBegin[1]; BrickY < BrickEnd[1]; ++BrickY) {
+                        AddRange(Cache->GetPointRange(BrickBegin[0], BrickEnd[0], BrickY, BrickZ));
+                        if ((BrickY == CutBricks[1][0]) || (BrickY == CutBricks[1][1]) || (BrickZ == CutBricks[2][0]) || (BrickZ == CutBricks[2][1])) {
+                            AddRange(Cache->GetInteriorPointRange(BrickBegin[0], BrickEnd[0], BrickY, BrickZ));
+                        }
+                        else {
+                            if (CutBricks[0][0] != SIZE_MAX) {
+                                AddRange(Cache->GetInteriorPointRange(CutBricks[0][0], CutBricks[0][0] + 1, BrickY, BrickZ));
+                            }
+                            if ((CutBricks[0][1] != SIZE_MAX) && (CutBricks[0][1] != CutBricks[0][0])) {
+                                AddRange(Cache->GetInteriorPointRange(CutBricks[0][1], CutBricks[0][1] + 1, BrickY, BrickZ));
+                            }
+                        }
+                    }
+                }
+            }
 
-        // Brute force copy voxels to the new map.
-        for (std::size_t z = 0; z < State.GetScene().GetSizeZ(); ++z) {
-            for (std::size_t y = 0; y < State.GetScene().GetSizeY(); ++y) {
-                for (std::size_t x = 0; x < State.GetScene().GetSizeX(); ++x) {
-                    const Voxel& v = State.GetScene().operator ()(x, y, z);
+            // Whole bricks are drawn, so clip the points to the scene, the same voxels the scene itself holds.
+            const std::array<std::size_t, 3> SceneSize = State.GetScene().GetSize();
+            CHECK_GL(glUniform3f(this->ShaderUniformClipMinimum, (static_cast<float>(SceneOffset[0]) - 0.5f) / 100.0f, (static_cast<float>(SceneOffset[1]) - 0.5f) / 100.0f, (static_cast<float>(SceneOffset[2]) - 0.5f) / 100.0f));
+            CHECK_GL(glUniform3f(this->ShaderUniformClipMaximum, (static_cast<float>(SceneOffset[0] + static_cast<int>(SceneSize[0])) - 0.5f) / 100.0f, (static_cast<float>(SceneOffset[1] + static_cast<int>(SceneSize[1])) - 0.5f) / 100.0f, (static_cast<float>(SceneOffset[2] + static_cast<int>(SceneSize[2])) - 0.5f) / 100.0f));
 
-                    // Ignore see through voxels.
-                    if (v.Alpha > 0) {
+            // Initial draw.
+            CHECK_GL(glBindVertexArray(this->BakedVertexArray));
+            CHECK_GL(glMultiDrawArrays(GL_POINTS, RangeFirsts.data(), RangeCounts.data(), static_cast<GLsizei>(RangeFirsts.size())));
+
+            // Stop clipping for the draws that follow.
+            CHECK_GL(glUniform3f(this->ShaderUniformClipMinimum, -FLT_MAX, -FLT_MAX, -FLT_MAX));
+            CHECK_GL(glUniform3f(this->ShaderUniformClipMaximum, FLT_MAX, FLT_MAX, FLT_MAX));
+        }
+        else {
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModelViewProjection, 1, GL_TRUE, ModelViewProjection.data()));
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModel, 1, GL_TRUE, this->Model.data()));
+
+            // Only rebuild the vertex buffer when a new version of the scene has been published, reading an immutable snapshot of it.
+            const VersionedVolume::Snapshot Scene = State.GetSceneSnapshot();
+            if (Scene.GetVersion() != this->SceneVersion) {
+                // Allocate a vertex array and fill it from the voxel volume.
+                static std::vector<std::array<GLfloat, 9> > map;
+
+                // Clear the old map, from the previous rebuild.
+                map.clear();
 
-                        float Hue = float(v.Hue - uint(4)) / 11.0f;
-                        float Saturation = float(v.Saturation) / 3.0f;
-                        float Light = float(v.Light) / 15.0f;
+                // Ensure enough memory is reserved for the entire scene.
+                map.reserve(Scene.GetSize()[2] * Scene.GetSize()[1] * Scene.GetSize()[0]);
 
-                        map.push_back({static_cast<float>(x) / 100.0f, static_cast<float>(y) / 100.0f, static_cast<float>(z) / 100.0f, 1, 0, 0, static_cast<float>(Hue), static_cast<float>(Saturation), static_cast<float>(Light)});
+                // Brute force copy voxels to the new map, walking the bricks of the snapshot that are not entirely empty.
+                Scene.ForEach([](std::size_t x, std::size_t y, std::size_t z, const Voxel& v) {
+                    // Ignore see through voxels.
+                    if (v.Alpha > 0) {
+                        map.push_back(MakePoint(x, y, z, v));
                     }
-                }
+                });
+
+                // Upload the map.
+                CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer));
+                CHECK_GL(glBufferData(GL_ARRAY_BUFFER, map.size() * 9 * sizeof(GLfloat), map.data(), GL_STATIC_DRAW));
+                this->VertexCount = map.size();
+                this->SceneVersion = Scene.GetVersion();
             }
+
+            // Initial draw.
+            CHECK_GL(glBindVertexArray(this->VertexArray));
+            CHECK_GL(glDrawArrays(GL_POINTS, 0, this->VertexCount));
         }
 
-        // Upload the map.
-        CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer));
-        CHECK_GL(glBufferData(GL_ARRAY_BUFFER, map.size() * 9 * sizeof(GLfloat), map.data(), GL_STATIC_DRAW));
+        // Draw the entities into the first buffer, each model is uploaded once and every entity only sets its own model matrix.
+        ++this->FrameIndex;
+        const std::array<int, 3>& EntitySceneOffset = State.GetSceneOffset();
+        const Matrix44 MapModel = this->Model * Matrix44::Scale(1.0f / 100.0f) * Matrix44::Translation(Vector3(-static_cast<float>(EntitySceneOffset[0]), -static_cast<float>(EntitySceneOffset[1]), -static_cast<float>(EntitySceneOffset[2])));
+        for (const Entity& Value : State.GetEntities()) {
+            if (Value.Model == nullptr) {
+                continue;
+            }
+            ModelBuffer& Buffer = this->GetModelBuffer(Value.Model);
+            Buffer.LastFrame = this->FrameIndex;
+            if (Buffer.VertexCount == 0) {
+                continue;
+            }
 
-        // Initial draw.
-        CHECK_GL(glBindVertexArray(this->VertexArray));
-        CHECK_GL(glDrawArrays(GL_POINTS, 0, map.size()));
+            // Model points are in voxels over one hundred, like the scene, so they are scaled back to voxels for the entity transform.
+            Matrix44 EntityModel = MapModel * Value.GetTransform() * Matrix44::Scale(100.0f);
+            Matrix44 EntityModelViewProjection = ViewProjection * EntityModel;
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModelViewProjection, 1, GL_TRUE, EntityModelViewProjection.data()));
+            CHECK_GL(glUniformMatrix4fv(this->ShaderUniformModel, 1, GL_TRUE, EntityModel.data()));
+
+            CHECK_GL(glBindVertexArray(Buffer.VertexArray));
+            CHECK_GL(glDrawArrays(GL_POINTS, 0, Buffer.VertexCount));
+        }
+
+        // Release the models no entity has drawn for a while.
+        for (std::map<std::shared_ptr<const Volume>, ModelBuffer>::iterator Iterator = this->ModelBuffers.begin(); Iterator != this->ModelBuffers.end();) {
+            if (this->FrameIndex - Iterator->second.LastFrame <= ModelBufferFrames) {
+                ++Iterator;
+                continue;
+            }
+            CHECK_GL(glDeleteBuffers(1, &Iterator->second.VertexBuffer));
+            CHECK_GL(glDeleteVertexArrays(1, &Iterator->second.VertexArray));
+            Iterator = this->ModelBuffers.erase(Iterator);
+        }
 
         // Disable depth testing for ping pong passes.
         CHECK_GL(glDisable(GL_DEPTH_TEST));
@@ -466,6 +653,29 @@ namespace DeferredRasterisation {
         CHECK_GL(glActiveTexture(GL_TEXTURE2));
         CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureColour2));
 
+        // Only upload the sun shadow map when it has changed, as the sun moves it only changes when its direction turns by a step.
+        const SunShadowMap& Shadows = State.GetSceneShadows();
+        CHECK_GL(glActiveTexture(GL_TEXTURE3));
+        CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->TextureShadow));
+        if (Shadows.GetVersion() != this->ShadowVersion) {
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, Shadows.GetSize()[0], Shadows.GetSize()[2], 0, GL_RG, GL_UNSIGNED_SHORT, Shadows.data()));
+            this->ShadowVersion = Shadows.GetVersion();
+        }
+
+        // Only upload the ambient occlusion when a bake has changed it, rows are single bytes so are not padded.
+        const AmbientOcclusion& Occlusion = State.GetSceneOcclusion();
+        CHECK_GL(glActiveTexture(GL_TEXTURE4));
+        CHECK_GL(glBindTexture(GL_TEXTURE_3D, this->TextureOcclusion));
+        if (Occlusion.GetVersion() != this->OcclusionVersion) {
+            CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+            CHECK_GL(glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, Occlusion.GetSize()[0], Occlusion.GetSize()[1], Occlusion.GetSize()[2], 0, GL_RED, GL_UNSIGNED_BYTE, Occlusion.data()));
+            CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+            this->OcclusionVersion = Occlusion.GetVersion();
+        }
+
+        const GLfloat LightPosition[3] = { State.GetLightPosition()[0], State.GetLightPosition()[1], State.GetLightPosition()[2] };
+        CHECK_GL(glUniform3fv(this->ShaderUniformLightPosition, 1, LightPosition));
+
         const GLfloat Direction[2] = { 0, 1 };
         CHECK_GL(glUniform2fv(this->ShaderUniformEvaluationDirection, 1, Direction));
 
@@ -484,4 +694,54 @@ namespace DeferredRasterisation {
         // Drawing just using one triangle now.
         CHECK_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
     }
+
+    // Find the buffer of the model, creating it with the scene vertex layout the first time, then upload the points if the model was written since the last upload.
+    Renderer::ModelBuffer& Renderer::GetModelBuffer(const std::shared_ptr<const Volume>& Model) {
+        std::map<std::shared_ptr<const Volume>, ModelBuffer>::iterator Found = this->ModelBuffers.find(Model);
+        if (Found == this->ModelBuffers.end()) {
+            ModelBuffer Buffer;
+            CHECK_GL(glGenVertexArrays(1, &Buffer.VertexArray));
+            CHECK_GL(glBindVertexArray(Buffer.VertexArray));
+
+            CHECK_GL(glGenBuffers(1, &Buffer.VertexBuffer));
+            CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, Buffer.VertexBuffer));
+
+            CHECK_GL(glVertexAttribPointer(this->ShaderUniformPosition, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (0 * sizeof(GLfloat))));
+            CHECK_GL(glVertexAttribPointer(this->ShaderUniformNormal, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat))));
+            CHECK_GL(glVertexAttribPointer(this->ShaderUniformColour, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) (6 * sizeof(GLfloat))));
+
+            CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformPosition));
+            CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformNormal));
+            CHECK_GL(glEnableVertexAttribArray(this->ShaderUniformColour));
+
+            // A fresh cursor sees every brick of the model as changed, so the points are uploaded below.
+            Buffer.VertexCount = 0;
+            Buffer.LastFrame = this->FrameIndex;
+            Found = this->ModelBuffers.emplace(Model, Buffer).first;
+        }
+
+        ModelBuffer& Buffer = Found->second;
+        if (!Model->IsDirty(Buffer.Cursor)) {
+            return Buffer;
+        }
+
+        // Move the cursor before reading, so a write during the upload is found next frame.
+        Model->Drain(Buffer.Cursor, this->ModelDirtyBricks);
+        std::vector<std::array<GLfloat, 9> > Points;
+        for (std::size_t IndexZ = 0; IndexZ < Model->GetSizeZ(); ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < Model->GetSizeY(); ++IndexY) {
+                for (std::size_t IndexX = 0; IndexX < Model->GetSizeX(); ++IndexX) {
+                    const Voxel& Value = (*Model)(IndexX, IndexY, IndexZ);
+                    if (Value.Alpha > 0) {
+                        Points.push_back(MakePoint(IndexX, IndexY, IndexZ, Value));
+                    }
+                }
+            }
+        }
+
+        CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, Buffer.VertexBuffer));
+        CHECK_GL(glBufferData(GL_ARRAY_BUFFER, Points.size() * 9 * sizeof(GLfloat), Points.data(), GL_STATIC_DRAW));
+        Buffer.VertexCount = Points.size();
+        return Buffer;
+    }
 }
@@ -34,6 +34,11 @@ THE SOFTWARE
 #include <GL/glew.h>
 
 #include <array>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace DeferredRasterisation {
     /// @brief  Renderer configures and runs OpenGL to draw a scene.
@@ -106,6 +111,18 @@ namespace DeferredRasterisation {
         /// @brief  The framebuffer used to store the intermediate render from stage 2.
         GLuint FrameBuffer2;
 
+        /// @brief  The texture holding the column heights and sun horizons of the scene.
+        GLuint TextureShadow;
+
+        /// @brief  The version of the sun shadow map in the shadow texture, the texture is only uploaded when a new version is made.
+        std::uint64_t ShadowVersion;
+
+        /// @brief  The 3D texture holding the ambient occlusion of the scene.
+        GLuint TextureOcclusion;
+
+        /// @brief  The version of the ambient occlusion in the occlusion texture, the texture is only uploaded when a new version is made.
+        std::uint64_t OcclusionVersion;
+
     private:
         /// @brief  Shader uniform for the pre-multiplied model, view, and projection matrices.
         GLint ShaderUniformModelViewProjection;
@@ -113,6 +130,12 @@ namespace DeferredRasterisation {
         /// @brief  Shader uniform for the model matrix.
         GLint ShaderUniformModel;
 
+        /// @brief  Shader uniform for the lowest corner of the box points are clipped to.
+        GLint ShaderUniformClipMinimum;
+
+        /// @brief  Shader uniform for the highest corner of the box points are clipped to.
+        GLint ShaderUniformClipMaximum;
+
         /// @brief  Shader uniform for the position texture input.
         GLint ShaderUniformPosition;
 
@@ -141,6 +164,9 @@ namespace DeferredRasterisation {
         /// @brief  Shader uniform for the offset of the curret scene.
         GLint ShaderUniformSceneOffset;
 
+        /// @brief  Shader uniform for the position of the sun.
+        GLint ShaderUniformLightPosition;
+
     private:
         /// @brief  Vertex buffer to hold voxel data.
         GLuint VertexBuffer;
@@ -148,6 +174,49 @@ namespace DeferredRasterisation {
         /// @brief  Vertex array to hold vertex buffer.
         GLuint VertexArray;
 
+        /// @brief  The number of points in the vertex buffer.
+        std::size_t VertexCount;
+
+        /// @brief  The version of the scene in the vertex buffer, the buffer is only rebuilt when a new version is published.
+        std::uint64_t SceneVersion;
+
+    private:
+        /// @brief  Vertex buffer to hold the points of a baked world, uploaded once.
+        GLuint BakedVertexBuffer;
+
+        /// @brief  Vertex array to hold the baked vertex buffer.
+        GLuint BakedVertexArray;
+
+        /// @brief  The baked world whose points are in the baked vertex buffer.
+        std::shared_ptr<const SceneCache> BakedScene;
+
+    private:
+        /// @brief  The points of an entity model, uploaded once and drawn for every entity sharing the model.
+        struct ModelBuffer {
+            /// @brief  Vertex array to hold the vertex buffer.
+            GLuint VertexArray;
+            /// @brief  Vertex buffer to hold the points of the model.
+            GLuint VertexBuffer;
+            /// @brief  The number of points in the vertex buffer.
+            std::size_t VertexCount;
+            /// @brief  Tracks writes to the model since its points were uploaded, a model written through another pointer is uploaded again.
+            DirtyCursor Cursor;
+            /// @brief  The last frame an entity drew the model.
+            std::uint64_t LastFrame;
+        };
+
+        /// @brief  The number of frames a model buffer is kept after its last entity stops drawing it, so models that come and go are not uploaded every time.
+        constexpr static const std::uint64_t ModelBufferFrames = 120;
+
+        /// @brief  The uploaded entity models, the shared pointer keeps each model alive while its buffer exists.
+        std::map<std::shared_ptr<const Volume>, ModelBuffer> ModelBuffers;
+
+        /// @brief  The bricks of a model changed since its upload, kept to reuse its allocation.
+        std::vector<std::size_t> ModelDirtyBricks;
+
+        /// @brief  The number of frames rendered.
+        std::uint64_t FrameIndex;
+
 	public:
         /// @brief  Constructor that specifies the size of the renderer viewport.
         Renderer(std::size_t ScreenWidth, std::size_t ScreenHeight);
@@ -155,6 +224,12 @@ namespace DeferredRasterisation {
         /// @brief  Render the gamestate to the current OpenGL window.
         /// @param  State - the state of the game.
         void Render(const GameState& State);
+
+    private:
+        /// @brief  Get the buffer of an entity model, uploading the model the first time it is drawn and again whenever it changed since.
+        /// @param  Model - The entity model.
+        /// @return The buffer of the model.
+        ModelBuffer& GetModelBuffer(const std::shared_ptr<const Volume>& Model);
 	};
 }
 
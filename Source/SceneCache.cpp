@@ -0,0 +1,544 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+#include "SceneCache.hpp"
+#include "CounterRandom.hpp"
+#include "MeshVoxeliser.hpp"
+#include "ThreadPool.hpp"
+#include "VolumeFactory.hpp"
+#include "VoxFile.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace DeferredRasterisation {
+    // Start closed.
+    SceneCache::SceneCache(void)
+        : World()
+        , Origin({{0, 0, 0}})
+        , Mapping(nullptr)
+        , MappingSize(0)
+        , BrickCount({{0, 0, 0}})
+        , BrickTable(nullptr)
+        , Points(nullptr)
+        , PointCount(0) {
+    }
+
+    // Unmap on destruction.
+    SceneCache::~SceneCache(void) {
+        this->Close();
+    }
+
+    // Composite the description, then write each file beside a temporary name so an interrupted bake is never opened.
+    bool SceneCache::Bake(const std::string& DescriptionPath) {
+        std::string Description;
+        std::uint64_t Hash;
+        if (!ReadDescription(DescriptionPath, Description, Hash)) {
+            return false;
+        }
+
+        Volume Composited;
+        std::array<int, 3> CompositedOrigin;
+        if (!Composite(DescriptionPath, Description, Composited, CompositedOrigin)) {
+            return false;
+        }
+
+        const std::string VolumePath = GetBakePath(DescriptionPath, Hash, ".volume");
+        const std::string PointPath = GetBakePath(DescriptionPath, Hash, ".points");
+        if (!MappedVolume::Write(VolumePath + ".tmp", Composited) || (std::rename((VolumePath + ".tmp").c_str(), VolumePath.c_str()) != 0)) {
+            return false;
+        }
+        if (!WritePoints(PointPath + ".tmp", Hash, Composited, CompositedOrigin) || (std::rename((PointPath + ".tmp").c_str(), PointPath.c_str()) != 0)) {
+            return false;
+        }
+        RemoveStaleBakes(DescriptionPath, Hash);
+        return true;
+    }
+
+    // Map both files of the bake and check that they belong together.
+    bool SceneCache::Open(const std::string& DescriptionPath) {
+        this->Close();
+
+        std::string Description;
+        std::uint64_t Hash;
+        if (!ReadDescription(DescriptionPath, Description, Hash)) {
+            return false;
+        }
+        if (!this->World.Open(GetBakePath(DescriptionPath, Hash, ".volume"))) {
+            return false;
+        }
+
+        const int Descriptor = ::open(GetBakePath(DescriptionPath, Hash, ".points").c_str(), O_RDONLY);
+        if (Descriptor < 0) {
+            this->Close();
+            return false;
+        }
+        struct stat Status;
+        if ((::fstat(Descriptor, &Status) != 0) || (static_cast<std::size_t>(Status.st_size) < sizeof(Header))) {
+            ::close(Descriptor);
+            this->Close();
+            return false;
+        }
+        const std::size_t FileSize = static_cast<std::size_t>(Status.st_size);
+        void* FileMapping = ::mmap(nullptr, FileSize, PROT_READ, MAP_SHARED, Descriptor, 0);
+        ::close(Descriptor);
+        if (FileMapping == MAP_FAILED) {
+            this->Close();
+            return false;
+        }
+        this->Mapping = FileMapping;
+        this->MappingSize = FileSize;
+
+        // Check the header against the description and the world.
+        Header FileHeader;
+        std::memcpy(&FileHeader, FileMapping, sizeof(FileHeader));
+        bool Valid = (std::memcmp(FileHeader.Magic, "DRPOINTS", sizeof(FileHeader.Magic)) == 0) && (FileHeader.Version == FileVersion) && (FileHeader.BrickSize == BrickSize) && (FileHeader.DescriptionHash == Hash);
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Valid = Valid && (FileHeader.Size[Axis] == this->World.GetSize()[Axis]) && (FileHeader.Origin[Axis] >= INT_MIN) && (FileHeader.Origin[Axis] <= INT_MAX);
+        }
+        if (!Valid) {
+            this->Close();
+            return false;
+        }
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            this->Origin[Axis] = static_cast<int>(FileHeader.Origin[Axis]);
+            this->BrickCount[Axis] = (this->World.GetSize()[Axis] + BrickSize - 1) / BrickSize;
+        }
+        const std::uint64_t TableCount = 2 * static_cast<std::uint64_t>(this->BrickCount[0]) * this->BrickCount[1] * this->BrickCount[2] + 1;
+        Valid = (FileHeader.BrickTableOffset % alignof(std::uint64_t) == 0) && (FileHeader.BrickTableOffset <= FileSize) && (TableCount <= (FileSize - FileHeader.BrickTableOffset) / sizeof(std::uint64_t));
+        Valid = Valid && (FileHeader.PointOffset % alignof(PointType) == 0) && (FileHeader.PointOffset <= FileSize) && (FileHeader.PointCount <= (FileSize - FileHeader.PointOffset) / sizeof(PointType));
+        if (!Valid) {
+            this->Close();
+            return false;
+        }
+        this->BrickTable = reinterpret_cast<const std::uint64_t*>(static_cast<const char*>(FileMapping) + FileHeader.BrickTableOffset);
+        this->Points = reinterpret_cast<const PointType*>(static_cast<const char*>(FileMapping) + FileHeader.PointOffset);
+        this->PointCount = static_cast<std::size_t>(FileHeader.PointCount);
+
+        // The table must rise from zero to the point count, so every range handed to the renderer is inside the file.
+        for (std::uint64_t Brick = 0; Brick < TableCount; ++Brick) {
+            if ((Brick == 0) ? (this->BrickTable[Brick] != 0) : (this->BrickTable[Brick] < this->BrickTable[Brick - 1])) {
+                this->Close();
+                return false;
+            }
+        }
+        if (this->BrickTable[TableCount - 1] != FileHeader.PointCount) {
+            this->Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Unmap and reset to closed.
+    void SceneCache::Close(void) {
+        this->World.Close();
+        if (this->Mapping != nullptr) {
+            ::munmap(this->Mapping, this->MappingSize);
+        }
+        this->Origin = {{0, 0, 0}};
+        this->Mapping = nullptr;
+        this->MappingSize = 0;
+        this->BrickCount = {{0, 0, 0}};
+        this->BrickTable = nullptr;
+        this->Points = nullptr;
+        this->PointCount = 0;
+    }
+
+    // Check for a mapping.
+    bool SceneCache::IsOpen(void) const {
+        return this->Mapping != nullptr;
+    }
+
+    // Get the world.
+    const MappedVolume& SceneCache::GetWorld(void) const {
+        return this->World;
+    }
+
+    // Get the origin.
+    const std::array<int, 3>& SceneCache::GetOrigin(void) const {
+        return this->Origin;
+    }
+
+    // Get the points.
+    const SceneCache::PointType* SceneCache::GetPoints(void) const {
+        return this->Points;
+    }
+
+    // Get the point count.
+    std::size_t SceneCache::GetPointCount(void) const {
+        return this->PointCount;
+    }
+
+    // Get the brick count.
+    const std::array<std::size_t, 3>& SceneCache::GetBrickCount(void) const {
+        return this->BrickCount;
+    }
+
+    // Bricks are stored in linear order so a run along X is one range of points.
+    std::array<std::size_t, 2> SceneCache::GetPointRange(std::size_t BeginX, std::size_t EndX, std::size_t BrickY, std::size_t BrickZ) const {
+        assert(this->IsOpen());
+        assert(BeginX <= EndX && EndX <= this->BrickCount[0] && BrickY < this->BrickCount[1] && BrickZ < this->BrickCount[2]);
+        const std::size_t Row = this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ);
+        const std::size_t First = static_cast<std::size_t>(this->BrickTable[Row + BeginX]);
+        return {{ First, static_cast<std::size_t>(this->BrickTable[Row + EndX]) - First }};
+    }
+
+    // Interior points follow the surface points, with their own start for each brick.
+    std::array<std::size_t, 2> SceneCache::GetInteriorPointRange(std::size_t BeginX, std::size_t EndX, std::size_t BrickY, std::size_t BrickZ) const {
+        assert(this->IsOpen());
+        assert(BeginX <= EndX && EndX <= this->BrickCount[0] && BrickY < this->BrickCount[1] && BrickZ < this->BrickCount[2]);
+        const std::size_t Row = this->BrickCount[0] * (BrickY + this->BrickCount[1] * (BrickZ + this->BrickCount[2]));
+        const std::size_t First = static_cast<std::size_t>(this->BrickTable[Row + BeginX]);
+        return {{ First, static_cast<std::size_t>(this->BrickTable[Row + EndX]) - First }};
+    }
+
+    // Hash the text with FNV-1a, then mix in the format version and the identity of every referenced file.
+    bool SceneCache::ReadDescription(const std::string& DescriptionPath, std::string& Description, std::uint64_t& Hash) {
+        std::ifstream File(DescriptionPath, std::ios::binary);
+        if (!File) {
+            return false;
+        }
+        Description.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+
+        Hash = 0xCBF29CE484222325ull;
+        for (const char Character : Description) {
+            Hash = (Hash ^ static_cast<std::uint8_t>(Character)) * 0x100000001B3ull;
+        }
+        Hash = CounterRandom::Mix64(Hash ^ FileVersion);
+
+        // The path of a vox or mesh model is the last token of its line.
+        std::istringstream Lines(Description);
+        std::string Line;
+        while (std::getline(Lines, Line)) {
+            Line = Line.substr(0, Line.find('#'));
+            std::istringstream Tokens(Line);
+            std::string Kind;
+            if (!(Tokens >> Kind) || ((Kind != "vox") && (Kind != "mesh"))) {
+                continue;
+            }
+            std::string Path;
+            for (std::string Token; Tokens >> Token; ) {
+                Path = Token;
+            }
+            struct stat Status;
+            if (::stat(ResolvePath(DescriptionPath, Path).c_str(), &Status) == 0) {
+                Hash = CounterRandom::Mix64(Hash ^ static_cast<std::uint64_t>(Status.st_size));
+                Hash = CounterRandom::Mix64(Hash ^ static_cast<std::uint64_t>(Status.st_mtime));
+            }
+        }
+        return true;
+    }
+
+    // Build every model, then insert them in order into a world that bounds them all.
+    bool SceneCache::Composite(const std::string& DescriptionPath, const std::string& Description, Volume& Output, std::array<int, 3>& OutputOrigin) {
+        std::vector<std::pair<std::array<int, 3>, Volume> > Models;
+
+        // Helper functions to read the common fields, each fails the stream on invalid values.
+        auto ReadSize = [](std::istream& Tokens, std::array<std::size_t, 3>& Size) {
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                long long Value = 0;
+                if ((Tokens >> Value) && ((Value <= 0) || (Value > (1 << 16)))) {
+                    Tokens.setstate(std::ios::failbit);
+                }
+                Size[Axis] = static_cast<std::size_t>(Value);
+            }
+        };
+        auto ReadColour = [](std::istream& Tokens, Voxel& Value) {
+            int Channels[4] = { 0, 0, 0, 0 };
+            for (int& Channel : Channels) {
+                if ((Tokens >> Channel) && ((Channel < 0) || (Channel > 255))) {
+                    Tokens.setstate(std::ios::failbit);
+                }
+            }
+            Value = Voxel(static_cast<std::uint8_t>(Channels[0]), static_cast<std::uint8_t>(Channels[1]), static_cast<std::uint8_t>(Channels[2]), static_cast<std::uint8_t>(Channels[3]));
+        };
+
+        std::istringstream Lines(Description);
+        std::string Line;
+        while (std::getline(Lines, Line)) {
+            Line = Line.substr(0, Line.find('#'));
+            std::istringstream Tokens(Line);
+            std::string Kind;
+            if (!(Tokens >> Kind)) {
+                continue;
+            }
+            std::array<int, 3> Position;
+            Tokens >> Position[0] >> Position[1] >> Position[2];
+            std::array<std::size_t, 3> Size = {{0, 0, 0}};
+            Voxel Value;
+
+            if (Kind == "solid") {
+                ReadSize(Tokens, Size);
+                ReadColour(Tokens, Value);
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, VolumeFactory::CreateSolid(Size[0], Size[1], Size[2], Value)));
+                }
+            }
+            else if (Kind == "ellipsoid") {
+                ReadSize(Tokens, Size);
+                ReadColour(Tokens, Value);
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, VolumeFactory::CreateEllipsoid(Size[0], Size[1], Size[2], Value)));
+                }
+            }
+            else if (Kind == "column") {
+                double Radius = 0;
+                ReadSize(Tokens, Size);
+                Tokens >> Radius;
+                ReadColour(Tokens, Value);
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, VolumeFactory::CreateColumn(Size[0], Size[1], Size[2], Radius, Value)));
+                }
+            }
+            else if (Kind == "sponge") {
+                double Density = 0;
+                std::uint64_t Seed = 0;
+                ReadSize(Tokens, Size);
+                Tokens >> Density >> Seed;
+                ReadColour(Tokens, Value);
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, VolumeFactory::CreateRandomSponge(Size[0], Size[1], Size[2], Density, Seed, Value)));
+                }
+            }
+            else if (Kind == "terrain") {
+                std::uint32_t Seed = 0;
+                Voxel Ground;
+                ReadSize(Tokens, Size);
+                Tokens >> Seed;
+                ReadColour(Tokens, Value);
+                ReadColour(Tokens, Ground);
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, VolumeFactory::CreateTerrain(Size[0], Size[1], Size[2], Seed, Value, Ground)));
+                }
+            }
+            else if (Kind == "vox") {
+                std::string Path;
+                std::vector<VoxFile::Model> VoxModels;
+                if ((Tokens >> Path) && !VoxFile::Load(ResolvePath(DescriptionPath, Path), VoxModels)) {
+                    return false;
+                }
+                for (VoxFile::Model& VoxModel : VoxModels) {
+                    const std::array<int, 3> ModelPosition = {{ Position[0] + VoxModel.Position[0], Position[1] + VoxModel.Position[1], Position[2] + VoxModel.Position[2] }};
+                    Models.push_back(std::make_pair(ModelPosition, std::move(VoxModel.Voxels)));
+                }
+            }
+            else if (Kind == "mesh") {
+                std::size_t Resolution = 0;
+                int Solid = 0;
+                std::string Path;
+                MeshVoxeliser::Mesh Model;
+                if ((Tokens >> Resolution >> Solid >> Path) && ((Resolution == 0) || (Resolution > (1 << 12)) || !MeshVoxeliser::Load(ResolvePath(DescriptionPath, Path), Model))) {
+                    return false;
+                }
+                if (Tokens) {
+                    Models.push_back(std::make_pair(Position, MeshVoxeliser::Voxelise(Model, Resolution, Solid != 0)));
+                }
+            }
+            else {
+                return false;
+            }
+
+            // Every field must have been read and nothing may follow them.
+            std::string Trailing;
+            if (!Tokens || (Tokens >> Trailing)) {
+                return false;
+            }
+        }
+        if (Models.empty()) {
+            return false;
+        }
+
+        // Bound every model, then insert each relative to the bounds.
+        std::array<long long, 3> Minimum = {{ LLONG_MAX, LLONG_MAX, LLONG_MAX }};
+        std::array<long long, 3> Maximum = {{ LLONG_MIN, LLONG_MIN, LLONG_MIN }};
+        for (const std::pair<std::array<int, 3>, Volume>& PositionModelPair : Models) {
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Minimum[Axis] = std::min<long long>(Minimum[Axis], PositionModelPair.first[Axis]);
+                Maximum[Axis] = std::max<long long>(Maximum[Axis], PositionModelPair.first[Axis] + static_cast<long long>(PositionModelPair.second.GetSize()[Axis]));
+            }
+        }
+        std::array<std::size_t, 3> WorldSize;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            if (Maximum[Axis] - Minimum[Axis] >= (1ll << 20)) {
+                return false;
+            }
+            WorldSize[Axis] = static_cast<std::size_t>(Maximum[Axis] - Minimum[Axis]);
+            OutputOrigin[Axis] = static_cast<int>(Minimum[Axis]);
+        }
+        Output = Volume(WorldSize);
+        for (const std::pair<std::array<int, 3>, Volume>& PositionModelPair : Models) {
+            const std::array<int, 3>& Position = PositionModelPair.first;
+            Output.Insert(Position[0] - OutputOrigin[0], Position[1] - OutputOrigin[1], Position[2] - OutputOrigin[2], PositionModelPair.second);
+        }
+        return true;
+    }
+
+    // Count the surface and interior voxels of each brick, place the surface points of every brick before the interior points of every brick, then emit the points of each brick.
+    bool SceneCache::WritePoints(const std::string& Path, std::uint64_t Hash, const Volume& Source, const std::array<int, 3>& SourceOrigin) {
+        const std::array<std::size_t, 3> WorldSize = Source.GetSize();
+        const std::array<std::size_t, 3> Bricks = {{ (WorldSize[0] + BrickSize - 1) / BrickSize, (WorldSize[1] + BrickSize - 1) / BrickSize, (WorldSize[2] + BrickSize - 1) / BrickSize }};
+        const std::size_t LayerBrickCount = Bricks[0] * Bricks[1];
+
+        // A voxel is on the surface if it is visible and a face touches an empty voxel or the edge of the world.
+        auto IsSurface = [&](std::size_t X, std::size_t Y, std::size_t Z) -> bool {
+            if (Source(X, Y, Z).Alpha == 0) {
+                return false;
+            }
+            return (X == 0) || (Y == 0) || (Z == 0) || (X + 1 == WorldSize[0]) || (Y + 1 == WorldSize[1]) || (Z + 1 == WorldSize[2])
+                || (Source(X - 1, Y, Z).Alpha == 0) || (Source(X + 1, Y, Z).Alpha == 0)
+                || (Source(X, Y - 1, Z).Alpha == 0) || (Source(X, Y + 1, Z).Alpha == 0)
+                || (Source(X, Y, Z - 1).Alpha == 0) || (Source(X, Y, Z + 1).Alpha == 0);
+        };
+
+        // Helper function to visit the visible voxels of a brick, with a flag that is set for surface voxels.
+        auto ForEachVisible = [&](std::size_t Brick, auto&& Function) {
+            const std::size_t BrickX = Brick % Bricks[0];
+            const std::size_t BrickY = (Brick / Bricks[0]) % Bricks[1];
+            const std::size_t BrickZ = Brick / LayerBrickCount;
+            for (std::size_t IndexZ = BrickZ * BrickSize; IndexZ < std::min((BrickZ + 1) * BrickSize, WorldSize[2]); ++IndexZ) {
+                for (std::size_t IndexY = BrickY * BrickSize; IndexY < std::min((BrickY + 1) * BrickSize, WorldSize[1]); ++IndexY) {
+                    for (std::size_t IndexX = BrickX * BrickSize; IndexX < std::min((BrickX + 1) * BrickSize, WorldSize[0]); ++IndexX) {
+                        if (Source(IndexX, IndexY, IndexZ).Alpha > 0) {
+                            Function(IndexX, IndexY, IndexZ, Source(IndexX, IndexY, IndexZ), IsSurface(IndexX, IndexY, IndexZ));
+                        }
+                    }
+                }
+            }
+        };
+
+        const std::size_t TotalBrickCount = LayerBrickCount * Bricks[2];
+        std::vector<std::uint64_t> Table(2 * TotalBrickCount + 1, 0);
+        ThreadPool::GetGlobal().ParallelFor(Bricks[2], 1, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t Brick = BeginZ * LayerBrickCount; Brick < EndZ * LayerBrickCount; ++Brick) {
+                ForEachVisible(Brick, [&](std::size_t, std::size_t, std::size_t, const Voxel&, bool Surface) {
+                    ++Table[Brick + (Surface ? 0 : TotalBrickCount) + 1];
+                });
+            }
+        });
+        for (std::size_t Brick = 1; Brick < Table.size(); ++Brick) {
+            Table[Brick] += Table[Brick - 1];
+        }
+
+        // Points match the vertices the renderer emits for a scene, but in map coordinates.
+        std::vector<PointType> Output(static_cast<std::size_t>(Table.back()));
+        ThreadPool::GetGlobal().ParallelFor(Bricks[2], 1, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t Brick = BeginZ * LayerBrickCount; Brick < EndZ * LayerBrickCount; ++Brick) {
+                PointType* SurfaceCursor = Output.data() + Table[Brick];
+                PointType* InteriorCursor = Output.data() + Table[Brick + TotalBrickCount];
+                ForEachVisible(Brick, [&](std::size_t X, std::size_t Y, std::size_t Z, const Voxel& Value, bool Surface) {
+                    const float Hue = static_cast<float>(Value.Hue - 4u) / 11.0f;
+                    const float Saturation = static_cast<float>(Value.Saturation) / 3.0f;
+                    const float Light = static_cast<float>(Value.Light) / 15.0f;
+                    PointType*& Cursor = Surface ? SurfaceCursor : InteriorCursor;
+                    *Cursor++ = {{ static_cast<float>(SourceOrigin[0] + static_cast<long long>(X)) / 100.0f, static_cast<float>(SourceOrigin[1] + static_cast<long long>(Y)) / 100.0f, static_cast<float>(SourceOrigin[2] + static_cast<long long>(Z)) / 100.0f, 1, 0, 0, Hue, Saturation, Light }};
+                });
+            }
+        });
+
+        Header FileHeader;
+        std::memset(&FileHeader, 0, sizeof(FileHeader));
+        std::memcpy(FileHeader.Magic, "DRPOINTS", sizeof(FileHeader.Magic));
+        FileHeader.Version = FileVersion;
+        FileHeader.BrickSize = static_cast<std::uint32_t>(BrickSize);
+        FileHeader.DescriptionHash = Hash;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            FileHeader.Origin[Axis] = SourceOrigin[Axis];
+            FileHeader.Size[Axis] = WorldSize[Axis];
+        }
+        FileHeader.PointCount = Table.back();
+        FileHeader.BrickTableOffset = sizeof(Header);
+        FileHeader.PointOffset = ((sizeof(Header) + Table.size() * sizeof(std::uint64_t) + MappedVolume::PayloadAlignment - 1) / MappedVolume::PayloadAlignment) * MappedVolume::PayloadAlignment;
+
+        std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+        if (!File) {
+            return false;
+        }
+        File.write(reinterpret_cast<const char*>(&FileHeader), sizeof(FileHeader));
+        File.write(reinterpret_cast<const char*>(Table.data()), static_cast<std::streamsize>(Table.size() * sizeof(std::uint64_t)));
+        const std::vector<char> Padding(FileHeader.PointOffset - sizeof(Header) - Table.size() * sizeof(std::uint64_t), 0);
+        File.write(Padding.data(), static_cast<std::streamsize>(Padding.size()));
+        File.write(reinterpret_cast<const char*>(Output.data()), static_cast<std::streamsize>(Output.size() * sizeof(PointType)));
+        File.flush();
+        return static_cast<bool>(File);
+    }
+
+    // Absolute paths are kept, others are joined to the directory of the description.
+    std::string SceneCache::ResolvePath(const std::string& DescriptionPath, const std::string& Path) {
+        const std::size_t Separator = DescriptionPath.find_last_of('/');
+        if (Path.empty() || (Path[0] == '/') || (Separator == std::string::npos)) {
+            return Path;
+        }
+        return DescriptionPath.substr(0, Separator + 1) + Path;
+    }
+
+    // Name bakes after the hash so a changed description never picks up a stale bake.
+    std::string SceneCache::GetBakePath(const std::string& DescriptionPath, std::uint64_t Hash, const std::string& Extension) {
+        char HashText[17];
+        std::snprintf(HashText, sizeof(HashText), "%016llx", static_cast<unsigned long long>(Hash));
+        return DescriptionPath + "." + HashText + Extension;
+    }
+
+    // Scan the directory of the description for bake files, and their temporaries, named after any other hash.
+    void SceneCache::RemoveStaleBakes(const std::string& DescriptionPath, std::uint64_t Hash) {
+        const std::size_t Separator = DescriptionPath.find_last_of('/');
+        const std::string Directory = (Separator == std::string::npos) ? std::string(".") : DescriptionPath.substr(0, Separator + 1);
+        const std::string Prefix = ((Separator == std::string::npos) ? DescriptionPath : DescriptionPath.substr(Separator + 1)) + ".";
+        const std::string Current = GetBakePath(DescriptionPath, Hash, "").substr(DescriptionPath.size() + 1);
+
+        DIR* Listing = ::opendir(Directory.c_str());
+        if (Listing == nullptr) {
+            return;
+        }
+        std::vector<std::string> Stale;
+        while (const dirent* Entry = ::readdir(Listing)) {
+            // The name must be the prefix, sixteen hexadecimal digits, and a bake extension.
+            const std::string Name = Entry->d_name;
+            if ((Name.size() <= Prefix.size() + 16) || (Name.compare(0, Prefix.size(), Prefix) != 0)) continue;
+            const std::string HashText = Name.substr(Prefix.size(), 16);
+            if ((HashText == Current) || (HashText.find_first_not_of("0123456789abcdef") != std::string::npos)) continue;
+            const std::string Extension = Name.substr(Prefix.size() + 16);
+            if ((Extension == ".volume") || (Extension == ".points") || (Extension == ".volume.tmp") || (Extension == ".points.tmp")) {
+                Stale.push_back(Name);
+            }
+        }
+        ::closedir(Listing);
+
+        // Files are removed after the listing is closed, a failure only leaves the file behind.
+        for (const std::string& Name : Stale) {
+            std::remove(((Separator == std::string::npos) ? Name : Directory + Name).c_str());
+        }
+    }
+}
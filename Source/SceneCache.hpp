@@ -0,0 +1,212 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+#pragma once
+#ifndef RAYMARCH_SCENECACHE_HPP
+#define RAYMARCH_SCENECACHE_HPP
+
+#include "MappedVolume.hpp"
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace DeferredRasterisation {
+    /// @brief  SceneCache bakes a scene description into a composited world and its points, and maps them back from disk.
+    ///         A description is a text file with one model per line, "#" starts a comment, positions are in map coordinates:
+    ///             solid     X Y Z  SizeX SizeY SizeZ  R G B A
+    ///             ellipsoid X Y Z  SizeX SizeY SizeZ  R G B A
+    ///             column    X Y Z  SizeX SizeY SizeZ  Radius  R G B A
+    ///             sponge    X Y Z  SizeX SizeY SizeZ  Density Seed  R G B A
+    ///             terrain   X Y Z  SizeX SizeY SizeZ  Seed  R G B A  R G B A
+    ///             vox       X Y Z  Path
+    ///             mesh      X Y Z  Resolution Solid Path
+    ///         Models are composited in order, later models overwrite earlier ones as AddToMap does, and paths are relative to the description.
+    ///         The bake is stored beside the description in a volume file and a point file, both named after a hash of the description and of the files it references.
+    ///         The point file holds one renderer vertex per visible voxel in map coordinates, the surface points of every brick followed by the interior points of every brick.
+    ///         Each section is grouped by brick with a table of where each brick starts, so interior points are only drawn where the scene window cuts the world.
+    class SceneCache {
+    public:
+        /// @brief  Point file header, all fields are in the byte order of the writing machine.
+        ///         A file from a machine of the other byte order fails the version check in Open.
+        struct Header {
+            /// @brief  File identifier, "DRPOINTS".
+            char Magic[8];
+            /// @brief  File format version.
+            std::uint32_t Version;
+            /// @brief  The width, height and depth of a brick.
+            std::uint32_t BrickSize;
+            /// @brief  The hash of the description that was baked.
+            std::uint64_t DescriptionHash;
+            /// @brief  The map position of the first voxel of the world.
+            std::int64_t Origin[3];
+            /// @brief  The size of the world.
+            std::uint64_t Size[3];
+            /// @brief  The number of points.
+            std::uint64_t PointCount;
+            /// @brief  File offset of the brick table, the index of the first surface point of each brick in linear order, then of the first interior point of each brick, followed by the point count.
+            std::uint64_t BrickTableOffset;
+            /// @brief  File offset of the points.
+            std::uint64_t PointOffset;
+        };
+
+        /// @brief  A point is a renderer vertex, position, normal and hue, saturation, lightness.
+        typedef std::array<float, 9> PointType;
+
+        /// @brief  The current file format version, part of the hash so a format change invalidates old bakes.
+        constexpr static const std::uint32_t FileVersion = 2;
+
+    private:
+        /// @brief  The composited world.
+        MappedVolume World;
+        /// @brief  The map position of the first voxel of the world.
+        std::array<int, 3> Origin;
+        /// @brief  The start of the point file mapping.
+        void* Mapping;
+        /// @brief  The size of the point file mapping in bytes.
+        std::size_t MappingSize;
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+        /// @brief  The index of the first surface point of each brick, then of the first interior point of each brick, followed by the point count.
+        const std::uint64_t* BrickTable;
+        /// @brief  The points.
+        const PointType* Points;
+        /// @brief  The number of points.
+        std::size_t PointCount;
+
+    public:
+        /// @brief  Constructor that creates a closed cache.
+        SceneCache(void);
+
+        /// @brief  Destructor that unmaps the bake.
+        ~SceneCache(void);
+
+        /// @brief  Deleted copy constructor, each cache owns its mappings.
+        SceneCache(const SceneCache&) = delete;
+
+        /// @brief  Deleted copy assignment operator, each cache owns its mappings.
+        SceneCache& operator=(const SceneCache&) = delete;
+
+    public:
+        /// @brief  Composite a description and write its volume and point files, then delete the files of earlier bakes of it.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @return True if the description was valid and both files were written.
+        static bool Bake(const std::string& DescriptionPath);
+
+        /// @brief  Map the bake of a description, closing any bake that is already open.
+        ///         Only the description is read and the referenced files are checked, the world is not generated.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @return True if a bake matching the current description was found and mapped.
+        bool Open(const std::string& DescriptionPath);
+
+        /// @brief  Unmap the bake.
+        void Close(void);
+
+        /// @brief  Test if a bake is mapped.
+        /// @return True if a bake is mapped.
+        bool IsOpen(void) const;
+
+    public:
+        /// @brief  Get the composited world.
+        /// @return The mapped world volume.
+        const MappedVolume& GetWorld(void) const;
+
+        /// @brief  Get the map position of the world.
+        /// @return The map position of the first voxel of the world.
+        const std::array<int, 3>& GetOrigin(void) const;
+
+        /// @brief  Get the points.
+        /// @return The mapped points, surface points grouped by brick followed by interior points grouped by brick.
+        const PointType* GetPoints(void) const;
+
+        /// @brief  Get the number of points.
+        /// @return The number of points.
+        std::size_t GetPointCount(void) const;
+
+        /// @brief  Get the number of bricks along each axis of the world.
+        /// @return Array of X, Y, Z brick counts.
+        const std::array<std::size_t, 3>& GetBrickCount(void) const;
+
+        /// @brief  Get the surface points of a run of bricks along the X axis, which are stored contiguously.
+        /// @param  BeginX - The first brick of the run.
+        /// @param  EndX - One past the last brick of the run.
+        /// @param  BrickY - The Y index of the bricks.
+        /// @param  BrickZ - The Z index of the bricks.
+        /// @return The index of the first point and the number of points.
+        std::array<std::size_t, 2> GetPointRange(std::size_t BeginX, std::size_t EndX, std::size_t BrickY, std::size_t BrickZ) const;
+
+        /// @brief  Get the interior points of a run of bricks along the X axis, the visible voxels with no empty neighbour that only show where the world is cut.
+        /// @param  BeginX - The first brick of the run.
+        /// @param  EndX - One past the last brick of the run.
+        /// @param  BrickY - The Y index of the bricks.
+        /// @param  BrickZ - The Z index of the bricks.
+        /// @return The index of the first point and the number of points.
+        std::array<std::size_t, 2> GetInteriorPointRange(std::size_t BeginX, std::size_t EndX, std::size_t BrickY, std::size_t BrickZ) const;
+
+    private:
+        /// @brief  Read a description and hash it together with the size and modification time of each file it references.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @param  Description - Output for the text of the description.
+        /// @param  Hash - Output for the hash.
+        /// @return True if the description could be read.
+        static bool ReadDescription(const std::string& DescriptionPath, std::string& Description, std::uint64_t& Hash);
+
+        /// @brief  Composite every model of a description into one world.
+        /// @param  DescriptionPath - The path of the scene description, used to resolve relative paths.
+        /// @param  Description - The text of the description.
+        /// @param  Output - Output for the world.
+        /// @param  OutputOrigin - Output for the map position of the world.
+        /// @return True if every line of the description was valid.
+        static bool Composite(const std::string& DescriptionPath, const std::string& Description, Volume& Output, std::array<int, 3>& OutputOrigin);
+
+        /// @brief  Write the surface and interior points of a world to a point file.
+        /// @param  Path - The path of the file to write.
+        /// @param  Hash - The hash of the description.
+        /// @param  Source - The world.
+        /// @param  SourceOrigin - The map position of the world.
+        /// @return True if the file was written.
+        static bool WritePoints(const std::string& Path, std::uint64_t Hash, const Volume& Source, const std::array<int, 3>& SourceOrigin);
+
+        /// @brief  Resolve a path relative to the directory of the description.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @param  Path - The path to resolve.
+        /// @return The resolved path.
+        static std::string ResolvePath(const std::string& DescriptionPath, const std::string& Path);
+
+        /// @brief  Get the path of a bake file.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @param  Hash - The hash of the description.
+        /// @param  Extension - The extension of the file.
+        /// @return The description path followed by the hash in hexadecimal and the extension.
+        static std::string GetBakePath(const std::string& DescriptionPath, std::uint64_t Hash, const std::string& Extension);
+
+        /// @brief  Delete the bake files of a description left by earlier versions of it, so edits do not accumulate bakes.
+        /// @param  DescriptionPath - The path of the scene description.
+        /// @param  Hash - The hash of the current description, whose bake is kept.
+        static void RemoveStaleBakes(const std::string& DescriptionPath, std::uint64_t Hash);
+    };
+}
+
+#endif // RAYMARCH_SCENECACHE_HPP
@@ -31,6 +31,8 @@ namespace DeferredRasterisation {
         // Uniform parameters.
         uniform mat4 ModelViewProjectionMatrix;
         uniform mat4 ModelMatrix;
+        uniform vec3 ClipMinimum;
+        uniform vec3 ClipMaximum;
 
         // Input data from vertex buffer.
         layout(location=0) in vec3 InputPosition;
@@ -43,11 +45,15 @@ namespace DeferredRasterisation {
         out vec3 VertexColour;
 
         // Main function copies inputs to outputs, transforming positions using the provided matrices.
+        // Points outside the clip box are moved beyond the far plane so they are clipped.
         void main() {
             VertexPosition = (ModelMatrix * vec4(InputPosition, 1.0)).xyz;
             VertexNormal = (ModelMatrix * vec4(InputNormal, 0.0)).xyz;
             VertexColour = InputColour;
             gl_Position = ModelViewProjectionMatrix * vec4(InputPosition, 1.0);
+            if (any(lessThan(InputPosition, ClipMinimum)) || any(greaterThan(InputPosition, ClipMaximum))) {
+                gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+            }
         }
     )";
 
@@ -94,6 +100,8 @@ namespace DeferredRasterisation {
         uniform sampler2D PositionSampler;
         uniform sampler2D NormalSampler;
         uniform sampler2D ColourSampler;
+        uniform sampler2D ShadowSampler;
+        uniform sampler3D OcclusionSampler;
 
         // Uniform parameters.
         uniform mat4 ViewProjectionInverseMatrix;
@@ -102,6 +110,7 @@ namespace DeferredRasterisation {
         uniform vec2 PixelDimensions;
         uniform bool LastRender;
         uniform vec3 SceneOffset;
+        uniform vec3 LightPosition;
 
         // Output data to framebuffer textures.
         layout(location=0) out vec4 FragmentPosition;
@@ -120,25 +129,32 @@ namespace DeferredRasterisation {
             return HSL.z + HSL.y * (RGB - 0.5) * (1.0 - abs(2.0 * HSL.z - 1.0));
         }
 
-        // Hash function to create "random" data from a seed.
-        float Hash(float Seed) {
-            return fract(sin(Seed) * 43758.5453);
+        // Hash function to create "random" data from a lattice point, this must match Noise::Hash.
+        // Integer mixing gives the same values on every GPU, unlike hashing through sin.
+        float Hash(ivec3 Lattice) {
+            uint Value = (uint(Lattice.x) * 0x8DA6B343u) ^ (uint(Lattice.y) * 0xD8163841u) ^ (uint(Lattice.z) * 0xCB1AB31Fu);
+            Value ^= Value >> 16u;
+            Value *= 0x7FEB352Du;
+            Value ^= Value >> 15u;
+            Value *= 0x846CA68Bu;
+            Value ^= Value >> 16u;
+            return float(Value >> 8u) * (1.0 / 16777216.0);
         }
 
-        // Noise function, using hash function to create 3D "random" noise.
-        // The noise function returns a value in the range -1.0f -> 1.0f.
+        // Noise function, using hash function to create 3D "random" noise, this must match Noise::Value3 with a zero seed.
+        // The noise function returns a value in the range 0.0f -> 1.0f.
         float Noise(vec3 Seed) {
             vec3 FloorSeed = floor(Seed);
-            vec3 FractSeed = fract(Seed);
+            vec3 FractSeed = Seed - FloorSeed;
 
             FractSeed = FractSeed * FractSeed * (3.0 - 2.0 * FractSeed);
 
-            float BaseSeed = FloorSeed.x + FloorSeed.y * 57.0 + 113.0 * FloorSeed.z;
+            ivec3 Lattice = ivec3(FloorSeed);
 
-            return mix(mix(mix(Hash(BaseSeed + 0.0), Hash(BaseSeed + 1.0), FractSeed.x),
-                       mix(Hash(BaseSeed + 57.0), Hash(BaseSeed + 58.0), FractSeed.x), FractSeed.y),
-                       mix(mix(Hash(BaseSeed + 113.0), Hash(BaseSeed + 114.0), FractSeed.x),
-                       mix(Hash(BaseSeed + 170.0), Hash(BaseSeed + 171.0), FractSeed.x), FractSeed.y), FractSeed.z);
+            return mix(mix(mix(Hash(Lattice + ivec3(0, 0, 0)), Hash(Lattice + ivec3(1, 0, 0)), FractSeed.x),
+                       mix(Hash(Lattice + ivec3(0, 1, 0)), Hash(Lattice + ivec3(1, 1, 0)), FractSeed.x), FractSeed.y),
+                       mix(mix(Hash(Lattice + ivec3(0, 0, 1)), Hash(Lattice + ivec3(1, 0, 1)), FractSeed.x),
+                       mix(Hash(Lattice + ivec3(0, 1, 1)), Hash(Lattice + ivec3(1, 1, 1)), FractSeed.x), FractSeed.y), FractSeed.z);
         }
 
         // AABB intersection function to determine if the ray passes through the box and at what depth.
@@ -161,13 +177,35 @@ namespace DeferredRasterisation {
             return vec2(IntersectionDepth, BackIntersectionDepth);
         }
 
-        // Hemisphere lighting function.
+        // Hemisphere lighting function, light shines from the sun towards the scene.
         vec3 HemisphereLighting(vec3 Normal) {
-            const vec3 LightPosition = vec3(0.1, -1.0, 0.0);
-            float NdotL = dot(Normal, LightPosition) * 0.5 + 0.5;
+            vec3 LightDirection = -normalize(LightPosition);
+            float NdotL = dot(Normal, LightDirection) * 0.5 + 0.5;
             return mix(vec3(0.886, 0.757, 0.337), vec3(0.518, 0.169, 0.0), NdotL);
         }
 
+        // Sun shadow function, this must match SunShadowMap::IsLit.
+        // A voxel is lit if it is the top of its column and the sun is above the horizon of the column, blended over a small angle.
+        float SunShadow(vec3 Position) {
+            ivec3 VoxelPosition = ivec3(floor(Position * (0.5 / VoxelSize) + 0.5));
+            ivec2 Column = clamp(VoxelPosition.xz, ivec2(0, 0), textureSize(ShadowSampler, 0) - 1);
+            vec2 HeightHorizon = texelFetch(ShadowSampler, Column, 0).xy * 65535.0;
+            if (float(VoxelPosition.y + 1) < HeightHorizon.x) {
+                return 0.0;
+            }
+            float Horizon = HeightHorizon.y * (1.5707963 / 65535.0);
+            float Elevation = asin(normalize(LightPosition).y);
+            return smoothstep(Horizon, Horizon + 0.05, Elevation);
+        }
+
+        // Ambient occlusion function, the fraction of the voxels around a voxel that are occupied.
+        // Flat ground is half enclosed, so only occlusion beyond a half darkens.
+        float AmbientOcclusion(vec3 Position) {
+            ivec3 VoxelPosition = clamp(ivec3(floor(Position * (0.5 / VoxelSize) + 0.5)), ivec3(0, 0, 0), textureSize(OcclusionSampler, 0) - 1);
+            float Occlusion = texelFetch(OcclusionSampler, VoxelPosition, 0).x;
+            return clamp(Occlusion * 2.0 - 1.0, 0.0, 1.0);
+        }
+
         // Main deferred rasterisation shader function.
         void main() {
             vec4 EyePosition = ViewProjectionInverseMatrix * vec4(0.0, 0.0, -1.0, 1.0);
@@ -211,6 +249,10 @@ namespace DeferredRasterisation {
             if (LastRender && BestDepth < 9999999.0) {
                 // Last pass output colour in the first channel.
                 FragmentPosition = vec4(mix(HemisphereLighting(OutputNormal), HSL2RGB(OutputColour), vec3(0.5, 0.5, 0.5)), 1.0);
+                // Darken voxels the sun does not reach.
+                FragmentPosition.xyz *= mix(0.6, 1.0, SunShadow(OutputPosition));
+                // Darken enclosed voxels.
+                FragmentPosition.xyz *= mix(1.0, 0.5, AmbientOcclusion(OutputPosition));
                 // Add some colour noise based on position.
                 FragmentPosition = mix(vec4(Noise((OutputPosition + SceneOffset) * 100.0)), FragmentPosition, vec4(0.9, 0.9, 0.9, 1.0));
                 // TODO: Should output gl_FragDepth
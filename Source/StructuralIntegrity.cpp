@@ -0,0 +1,620 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "StructuralIntegrity.hpp"
+#include "FluidSimulation.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace DeferredRasterisation {
+    namespace {
+        /// @brief  Flag bits of a brick while lists of bricks are gathered.
+        const std::uint8_t SeedFlag = 1;
+        const std::uint8_t ChangedFlag = 2;
+
+        /// @brief  Flag bits of a root once the box is joined.
+        const std::uint8_t AnchoredFlag = 1;
+        const std::uint8_t SeededFlag = 2;
+
+        /// @brief  Count the clear bits below the lowest set bit of a word.
+        /// @param  Word - The word, not zero.
+        /// @return The index of the lowest set bit.
+        inline std::size_t CountTrailingZeros(std::uint64_t Word) {
+            #if defined(__GNUC__)
+                return static_cast<std::size_t>(__builtin_ctzll(Word));
+            #else
+                std::size_t Count = 0;
+                for (; (Word & 1u) == 0; Word >>= 1) {
+                    ++Count;
+                }
+                return Count;
+            #endif
+        }
+
+        /// @brief  Get the index of a voxel within a brick in X-major order.
+        /// @param  Local - The position of the voxel within the brick.
+        /// @return The index of the voxel.
+        inline std::size_t GetLocalIndex(const std::array<std::size_t, 3>& Local) {
+            return Local[0] + BrickSize * (Local[1] + BrickSize * Local[2]);
+        }
+    }
+
+    // Start with no volume.
+    StructuralIntegrity::StructuralIntegrity(void)
+        : Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}})
+        , Offset({{0, 0, 0}})
+        , RegionBegin({{0, 0, 0}})
+        , RegionEnd({{0, 0, 0}})
+        , FragmentCount(0)
+        , FallingBegin({{0, 0, 0}})
+        , FallingEnd({{0, 0, 0}}) {
+    }
+
+    // Fluids are occupied but hold nothing up.
+    bool StructuralIntegrity::IsStructural(const Voxel& Value) {
+        const bool Fluid = ((Value.State == FluidSimulation::GasState) || (Value.State == FluidSimulation::LiquidState)) && (Value.FillLevel != 0);
+        return (Value.Alpha != 0) && !Fluid;
+    }
+
+    // Label the changed bricks, join the box around the removals, then drop the fragments found.
+    void StructuralIntegrity::Step(Volume& Target, const std::array<int, 3>& Offset, const SourceType& Source) {
+        Target.Drain(this->Cursor, this->DirtyBricks);
+
+        const bool Resized = (Target.GetSize() != this->Size);
+        const bool Moved = Resized || (Offset != this->Offset);
+        if (Resized) {
+            // A new size labels everything.
+            this->Size = Target.GetSize();
+            this->BrickCount = Target.GetBrickCount();
+            const std::size_t Count = this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2];
+            this->Bricks.assign(Count, BrickComponents());
+            this->Flags.assign(Count, 0);
+            this->DirtyBricks.resize(Count);
+            for (std::size_t Brick = 0; Brick < Count; ++Brick) {
+                this->DirtyBricks[Brick] = Brick;
+            }
+        }
+
+        // Bricks label their own voxels, so every changed brick is labelled at once.
+        const Volume& Current = Target;
+        this->DirtyRemoved.resize(this->DirtyBricks.size());
+        ThreadPool::GetGlobal().ParallelFor(this->DirtyBricks.size(), 4, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                this->DirtyRemoved[Index] = this->LabelBrick(Current, this->DirtyBricks[Index]);
+            }
+        });
+
+        // A removal can cut the structure beside it in two, so the region around it is grown by a voxel, reaching into the bricks that share a face with it.
+        this->SeedRegions.clear();
+        this->Seeds.clear();
+        auto AddSeedRegion = [this](const std::array<long, 3>& Begin, const std::array<long, 3>& End) -> void {
+            Box Region;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                const long Low = std::max(Begin[Axis] - 1, 0l);
+                const long High = std::min(End[Axis] + 1, static_cast<long>(this->Size[Axis]));
+                if (Low >= High) return;
+                Region.first[Axis] = static_cast<std::size_t>(Low);
+                Region.second[Axis] = static_cast<std::size_t>(High);
+            }
+            this->SeedRegions.push_back(Region);
+            for (std::size_t IndexZ = Region.first[2] / BrickSize; IndexZ <= (Region.second[2] - 1) / BrickSize; ++IndexZ) {
+                for (std::size_t IndexY = Region.first[1] / BrickSize; IndexY <= (Region.second[1] - 1) / BrickSize; ++IndexY) {
+                    for (std::size_t IndexX = Region.first[0] / BrickSize; IndexX <= (Region.second[0] - 1) / BrickSize; ++IndexX) {
+                        const std::size_t Brick = IndexX + this->BrickCount[0] * (IndexY + this->BrickCount[1] * IndexZ);
+                        if ((this->Flags[Brick] & SeedFlag) == 0) {
+                            this->Flags[Brick] |= SeedFlag;
+                            this->Seeds.push_back(Brick);
+                        }
+                    }
+                }
+            }
+        };
+
+        // A move changes every brick it scrolls, so the removals seen by labelling are only trusted when the volume stayed put.
+        if (!Moved) {
+            for (const Box& Removed : this->DirtyRemoved) {
+                if (Removed.first == Removed.second) continue;
+                AddSeedRegion({{static_cast<long>(Removed.first[0]), static_cast<long>(Removed.first[1]), static_cast<long>(Removed.first[2])}}, {{static_cast<long>(Removed.second[0]), static_cast<long>(Removed.second[1]), static_cast<long>(Removed.second[2])}});
+            }
+        }
+
+        // The removals made since the last step and the boxes fragments fell through, which a move would hide.
+        for (const std::pair<std::array<int, 3>, std::array<int, 3> >& Region : this->PendingRegions) {
+            std::array<long, 3> Begin;
+            std::array<long, 3> End;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Begin[Axis] = static_cast<long>(Region.first[Axis]) - Offset[Axis];
+                End[Axis] = static_cast<long>(Region.second[Axis]) - Offset[Axis];
+            }
+            AddSeedRegion(Begin, End);
+        }
+        this->PendingRegions.clear();
+        this->Offset = Offset;
+
+        this->Changed.clear();
+        this->FragmentCount = 0;
+        if (this->Seeds.empty()) return;
+
+        // The box joined is the seeds grown by the margin, structure beyond it is not looked at.
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            this->RegionBegin[Axis] = this->BrickCount[Axis];
+            this->RegionEnd[Axis] = 0;
+        }
+        for (std::size_t Brick : this->Seeds) {
+            const std::array<std::size_t, 3> Centre = {{Brick % this->BrickCount[0], (Brick / this->BrickCount[0]) % this->BrickCount[1], Brick / (this->BrickCount[0] * this->BrickCount[1])}};
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                this->RegionBegin[Axis] = std::min(this->RegionBegin[Axis], Centre[Axis] - std::min(Centre[Axis], RegionMargin));
+                this->RegionEnd[Axis] = std::max(this->RegionEnd[Axis], std::min(Centre[Axis] + RegionMargin + 1, this->BrickCount[Axis]));
+            }
+        }
+
+        // Number the components of the box, each brick owns a run of nodes.
+        const std::array<std::size_t, 3> RegionCount = {{this->RegionEnd[0] - this->RegionBegin[0], this->RegionEnd[1] - this->RegionBegin[1], this->RegionEnd[2] - this->RegionBegin[2]}};
+        this->RegionBases.resize(RegionCount[0] * RegionCount[1] * RegionCount[2] + 1);
+        this->RegionNodes.clear();
+        for (std::size_t Region = 0; Region + 1 < this->RegionBases.size(); ++Region) {
+            const std::size_t Brick = (this->RegionBegin[0] + Region % RegionCount[0]) + this->BrickCount[0] * ((this->RegionBegin[1] + (Region / RegionCount[0]) % RegionCount[1]) + this->BrickCount[1] * (this->RegionBegin[2] + Region / (RegionCount[0] * RegionCount[1])));
+            this->RegionBases[Region] = static_cast<std::uint32_t>(this->RegionNodes.size());
+            for (std::size_t Index = 0; Index < this->Bricks[Brick].Components.size(); ++Index) {
+                this->RegionNodes.push_back(Node(Brick, static_cast<std::uint16_t>(Index + 1)));
+            }
+        }
+        this->RegionBases.back() = static_cast<std::uint32_t>(this->RegionNodes.size());
+        const std::size_t NodeCount = this->RegionNodes.size();
+
+        // Every node starts as its own set, then each brick joins its faces with the next bricks while the others do the same.
+        if (this->Parents.size() < NodeCount) {
+            std::vector<std::atomic<std::uint32_t> >(NodeCount).swap(this->Parents);
+        }
+        ThreadPool::GetGlobal().ParallelFor(NodeCount, 256, [this](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                this->Parents[Index].store(static_cast<std::uint32_t>(Index));
+            }
+        });
+        ThreadPool::GetGlobal().ParallelFor(this->RegionBases.size() - 1, 1, [this](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Region = First; Region < Last; ++Region) {
+                this->JoinBrick(Region);
+            }
+        });
+        this->Roots.resize(NodeCount);
+        ThreadPool::GetGlobal().ParallelFor(NodeCount, 256, [this](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                this->Roots[Index] = this->Find(static_cast<std::uint32_t>(Index));
+            }
+        });
+
+        // A set is a fragment if it holds a component in a seed region and nothing anchors it, the world beyond the volume is only looked at for those sets.
+        this->NodeFlags.resize(NodeCount);
+        ThreadPool::GetGlobal().ParallelFor(NodeCount, 64, [this](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t Index = First; Index < Last; ++Index) {
+                const Node& Part = this->RegionNodes[Index];
+                const bool Seeded = ((this->Flags[Part.first] & SeedFlag) != 0) && this->IsSeeded(Part);
+                this->NodeFlags[Index] = static_cast<std::uint8_t>((Seeded ? SeededFlag : 0) | (this->IsAnchored(Part) ? AnchoredFlag : 0));
+            }
+        });
+        for (std::size_t Brick : this->Seeds) {
+            this->Flags[Brick] &= static_cast<std::uint8_t>(~SeedFlag);
+        }
+        this->RootFlags.assign(NodeCount, 0);
+        for (std::size_t Index = 0; Index < NodeCount; ++Index) {
+            this->RootFlags[this->Roots[Index]] |= this->NodeFlags[Index];
+        }
+        for (std::size_t Index = 0; Index < NodeCount; ++Index) {
+            std::uint8_t& RootFlag = this->RootFlags[this->Roots[Index]];
+            if ((RootFlag != SeededFlag) || (this->Bricks[this->RegionNodes[Index].first].Components[this->RegionNodes[Index].second - 1].Faces == 0)) continue;
+            if (this->IsHeldBeyond(this->RegionNodes[Index], Source)) RootFlag |= AnchoredFlag;
+        }
+
+        // Drop each fragment in turn, its components are marked so the drop can tell them from the structure below.
+        this->Members.clear();
+        for (std::size_t Index = 0; Index < NodeCount; ++Index) {
+            if (this->RootFlags[this->Roots[Index]] == SeededFlag) {
+                this->Members.push_back(std::make_pair(this->Roots[Index], static_cast<std::uint32_t>(Index)));
+            }
+        }
+        std::sort(this->Members.begin(), this->Members.end());
+        for (std::size_t First = 0; First < this->Members.size();) {
+            std::size_t Last = First;
+            this->Nodes.clear();
+            ++this->FragmentCount;
+            for (; (Last < this->Members.size()) && (this->Members[Last].first == this->Members[First].first); ++Last) {
+                const Node& Part = this->RegionNodes[this->Members[Last].second];
+                this->Bricks[Part.first].Components[Part.second - 1].Fragment = static_cast<std::uint32_t>(this->FragmentCount);
+                this->Nodes.push_back(Part);
+            }
+            this->Drop(Target, static_cast<std::uint32_t>(this->FragmentCount));
+            First = Last;
+        }
+        for (const std::pair<std::uint32_t, std::uint32_t>& Member : this->Members) {
+            const Node& Part = this->RegionNodes[Member.second];
+            this->Bricks[Part.first].Components[Part.second - 1].Fragment = 0;
+        }
+
+        for (std::size_t Brick : this->Changed) {
+            this->Flags[Brick] &= static_cast<std::uint8_t>(~ChangedFlag);
+        }
+        std::sort(this->Changed.begin(), this->Changed.end());
+    }
+
+    // Get the changed bricks.
+    const std::vector<std::size_t>& StructuralIntegrity::GetChangedBricks(void) const {
+        return this->Changed;
+    }
+
+    // Get the number of fragments.
+    std::size_t StructuralIntegrity::GetFragmentCount(void) const {
+        return this->FragmentCount;
+    }
+
+    // Keep the box until the next step.
+    void StructuralIntegrity::MarkRemoved(const std::array<int, 3>& Begin, const std::array<int, 3>& End) {
+        this->PendingRegions.push_back(std::make_pair(Begin, End));
+    }
+
+    // Union the structural voxels of the brick with the voxels before them along each axis, then number the roots in order.
+    StructuralIntegrity::Box StructuralIntegrity::LabelBrick(const Volume& Source, std::size_t Brick) {
+        const std::array<std::size_t, 3> Base = {{
+            (Brick % this->BrickCount[0]) * BrickSize,
+            ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+            (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+        }};
+        const std::array<std::size_t, 3> Extent = {{
+            std::min(BrickSize, this->Size[0] - Base[0]),
+            std::min(BrickSize, this->Size[1] - Base[1]),
+            std::min(BrickSize, this->Size[2] - Base[2])
+        }};
+
+        std::array<std::uint64_t, BrickVolume / 64> Mask = {{}};
+        std::array<std::uint16_t, BrickVolume> Parent;
+        auto Find = [&Parent](std::uint16_t Index) -> std::uint16_t {
+            while (Parent[Index] != Index) {
+                Parent[Index] = Parent[Parent[Index]];
+                Index = Parent[Index];
+            }
+            return Index;
+        };
+        auto Union = [&Parent, &Find](std::uint16_t First, std::uint16_t Second) -> void {
+            const std::uint16_t FirstRoot = Find(First);
+            const std::uint16_t SecondRoot = Find(Second);
+            Parent[std::max(FirstRoot, SecondRoot)] = std::min(FirstRoot, SecondRoot);
+        };
+        auto IsSet = [&Mask](std::size_t Index) -> bool {
+            return ((Mask[Index / 64] >> (Index % 64)) & 1u) != 0;
+        };
+        for (std::size_t IndexZ = 0; IndexZ < Extent[2]; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < Extent[1]; ++IndexY) {
+                for (std::size_t IndexX = 0; IndexX < Extent[0]; ++IndexX) {
+                    if (!IsStructural(Source(Base[0] + IndexX, Base[1] + IndexY, Base[2] + IndexZ))) continue;
+                    const std::uint16_t Index = static_cast<std::uint16_t>(GetLocalIndex({{IndexX, IndexY, IndexZ}}));
+                    Mask[Index / 64] |= std::uint64_t(1) << (Index % 64);
+                    Parent[Index] = Index;
+                    if ((IndexX > 0) && IsSet(Index - 1)) Union(Index, static_cast<std::uint16_t>(Index - 1));
+                    if ((IndexY > 0) && IsSet(Index - BrickSize)) Union(Index, static_cast<std::uint16_t>(Index - BrickSize));
+                    if ((IndexZ > 0) && IsSet(Index - BrickSize * BrickSize)) Union(Index, static_cast<std::uint16_t>(Index - BrickSize * BrickSize));
+                }
+            }
+        }
+
+        // Bound the voxels that were structural when the brick was last labelled and are not now.
+        BrickComponents& Entry = this->Bricks[Brick];
+        Box Removed(Base, Base);
+        bool Empty = true;
+        for (std::size_t Word = 0; Word < Mask.size(); ++Word) {
+            for (std::uint64_t Bits = Entry.Mask[Word] & ~Mask[Word]; Bits != 0; Bits &= Bits - 1) {
+                const std::size_t Local = Word * 64 + CountTrailingZeros(Bits);
+                const std::array<std::size_t, 3> Position = {{Base[0] + Local % BrickSize, Base[1] + (Local / BrickSize) % BrickSize, Base[2] + Local / (BrickSize * BrickSize)}};
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    Removed.first[Axis] = Empty ? Position[Axis] : std::min(Removed.first[Axis], Position[Axis]);
+                    Removed.second[Axis] = Empty ? (Position[Axis] + 1) : std::max(Removed.second[Axis], Position[Axis] + 1);
+                }
+                Empty = false;
+            }
+        }
+        Entry.Mask = Mask;
+        Entry.Components.clear();
+
+        // Roots come before the rest of their component, so each component is numbered at its root.
+        std::array<std::uint16_t, BrickVolume> Labels = {{}};
+        for (std::size_t IndexZ = 0; IndexZ < Extent[2]; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < Extent[1]; ++IndexY) {
+                for (std::size_t IndexX = 0; IndexX < Extent[0]; ++IndexX) {
+                    const std::uint16_t Index = static_cast<std::uint16_t>(GetLocalIndex({{IndexX, IndexY, IndexZ}}));
+                    if (!IsSet(Index)) continue;
+                    const std::uint16_t Root = Find(Index);
+                    if (Root == Index) {
+                        Entry.Components.push_back(Component{0, 0, std::numeric_limits<std::uint32_t>::max(), std::numeric_limits<std::uint8_t>::max(), 0, 0});
+                        Labels[Index] = static_cast<std::uint16_t>(Entry.Components.size());
+                    }
+                    else {
+                        Labels[Index] = Labels[Root];
+                    }
+
+                    const std::array<std::size_t, 3> Local = {{IndexX, IndexY, IndexZ}};
+                    const Voxel& Value = Source(Base[0] + IndexX, Base[1] + IndexY, Base[2] + IndexZ);
+                    Component& Part = Entry.Components[Labels[Index] - 1];
+                    Part.Count += 1;
+                    Part.Mass += 1u + Value.Density;
+                    Part.Bottom = std::min(Part.Bottom, static_cast<std::uint32_t>(Base[1] + IndexY));
+                    Part.MinimumStrength = std::min<std::uint8_t>(Part.MinimumStrength, Value.Strength);
+                    for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                        if (Local[Axis] == 0) Part.Faces |= static_cast<std::uint8_t>(1u << (2 * Axis));
+                        if (Local[Axis] + 1 == Extent[Axis]) Part.Faces |= static_cast<std::uint8_t>(2u << (2 * Axis));
+                    }
+                }
+            }
+        }
+
+        // Bricks that are empty or solid need no labels.
+        if (Entry.Components.empty() || ((Entry.Components.size() == 1) && (Entry.Components[0].Count == BrickVolume))) {
+            std::vector<std::uint16_t>().swap(Entry.Labels);
+        }
+        else {
+            Entry.Labels.assign(Labels.begin(), Labels.end());
+        }
+        return Removed;
+    }
+
+    // Empty bricks have no labels, and solid bricks are all the first component.
+    std::uint16_t StructuralIntegrity::GetLabel(std::size_t Brick, std::size_t Local) const {
+        const BrickComponents& Entry = this->Bricks[Brick];
+        if (Entry.Components.empty()) return 0;
+        if (Entry.Labels.empty()) return 1;
+        return Entry.Labels[Local];
+    }
+
+    // Parents only ever point to lower nodes, so a path shortened by another thread still leads to the same root.
+    std::uint32_t StructuralIntegrity::Find(std::uint32_t Index) {
+        while (true) {
+            std::uint32_t Parent = this->Parents[Index].load();
+            if (Parent == Index) return Index;
+            const std::uint32_t Grandparent = this->Parents[Parent].load();
+            if (Grandparent != Parent) {
+                this->Parents[Index].compare_exchange_weak(Parent, Grandparent);
+            }
+            Index = Grandparent;
+        }
+    }
+
+    // Link the higher root under the lower, trying again if another thread linked it first.
+    void StructuralIntegrity::Unite(std::uint32_t First, std::uint32_t Second) {
+        while (true) {
+            First = this->Find(First);
+            Second = this->Find(Second);
+            if (First == Second) return;
+            if (First < Second) std::swap(First, Second);
+            std::uint32_t Expected = First;
+            if (this->Parents[First].compare_exchange_strong(Expected, Second)) return;
+        }
+    }
+
+    // Compare the voxels on each upper face of the brick with those on the lower face of the next brick.
+    void StructuralIntegrity::JoinBrick(std::size_t Region) {
+        const std::array<std::size_t, 3> RegionCount = {{this->RegionEnd[0] - this->RegionBegin[0], this->RegionEnd[1] - this->RegionBegin[1], this->RegionEnd[2] - this->RegionBegin[2]}};
+        const std::array<std::size_t, 3> Centre = {{Region % RegionCount[0], (Region / RegionCount[0]) % RegionCount[1], Region / (RegionCount[0] * RegionCount[1])}};
+        const std::size_t Brick = (this->RegionBegin[0] + Centre[0]) + this->BrickCount[0] * ((this->RegionBegin[1] + Centre[1]) + this->BrickCount[1] * (this->RegionBegin[2] + Centre[2]));
+        if (this->Bricks[Brick].Components.empty()) return;
+
+        std::size_t RegionStride = 1;
+        std::size_t Stride = 1;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const std::size_t NextRegion = Region + RegionStride;
+            const std::size_t Neighbour = Brick + Stride;
+            const bool Inside = (Centre[Axis] + 1 < RegionCount[Axis]);
+            RegionStride *= RegionCount[Axis];
+            Stride *= this->BrickCount[Axis];
+            if (!Inside || this->Bricks[Neighbour].Components.empty()) continue;
+
+            // Runs of voxels along a face usually share their pair of labels, so each pair is only joined once in a row.
+            std::array<std::size_t, 3> Upper;
+            std::array<std::size_t, 3> Lower;
+            Upper[Axis] = BrickSize - 1;
+            Lower[Axis] = 0;
+            std::uint16_t LastLabel = 0;
+            std::uint16_t LastNeighbourLabel = 0;
+            for (std::size_t IndexV = 0; IndexV < BrickSize; ++IndexV) {
+                for (std::size_t IndexU = 0; IndexU < BrickSize; ++IndexU) {
+                    Upper[(Axis + 1) % 3] = Lower[(Axis + 1) % 3] = IndexU;
+                    Upper[(Axis + 2) % 3] = Lower[(Axis + 2) % 3] = IndexV;
+                    const std::uint16_t Label = this->GetLabel(Brick, GetLocalIndex(Upper));
+                    if (Label == 0) continue;
+                    const std::uint16_t NeighbourLabel = this->GetLabel(Neighbour, GetLocalIndex(Lower));
+                    if ((NeighbourLabel == 0) || ((Label == LastLabel) && (NeighbourLabel == LastNeighbourLabel))) continue;
+                    LastLabel = Label;
+                    LastNeighbourLabel = NeighbourLabel;
+                    this->Unite(this->RegionBases[Region] + Label - 1u, this->RegionBases[NextRegion] + NeighbourLabel - 1u);
+                }
+            }
+        }
+    }
+
+    // Look only at the part of each seed region inside the brick.
+    bool StructuralIntegrity::IsSeeded(const Node& Part) const {
+        const std::array<std::size_t, 3> Base = {{
+            (Part.first % this->BrickCount[0]) * BrickSize,
+            ((Part.first / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+            (Part.first / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+        }};
+        for (const Box& Region : this->SeedRegions) {
+            std::array<std::size_t, 3> Begin;
+            std::array<std::size_t, 3> End;
+            bool Overlaps = true;
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Begin[Axis] = std::max(Region.first[Axis], Base[Axis]);
+                End[Axis] = std::min(Region.second[Axis], Base[Axis] + BrickSize);
+                Overlaps = Overlaps && (Begin[Axis] < End[Axis]);
+            }
+            if (!Overlaps) continue;
+            for (std::size_t IndexZ = Begin[2]; IndexZ < End[2]; ++IndexZ) {
+                for (std::size_t IndexY = Begin[1]; IndexY < End[1]; ++IndexY) {
+                    for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                        if (this->GetLabel(Part.first, GetLocalIndex({{IndexX - Base[0], IndexY - Base[1], IndexZ - Base[2]}})) == Part.second) return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // The ground holds up anything on it, and a side of the box inside the volume leads to structure that was not looked at.
+    bool StructuralIntegrity::IsAnchored(const Node& Part) const {
+        const Component& Entry = this->Bricks[Part.first].Components[Part.second - 1];
+        if (static_cast<long>(Entry.Bottom) + this->Offset[1] <= GroundHeight) return true;
+
+        const std::array<std::size_t, 3> Centre = {{Part.first % this->BrickCount[0], (Part.first / this->BrickCount[0]) % this->BrickCount[1], Part.first / (this->BrickCount[0] * this->BrickCount[1])}};
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            if (((Entry.Faces >> (2 * Axis)) & 1u) && (Centre[Axis] == this->RegionBegin[Axis]) && (Centre[Axis] > 0)) return true;
+            if (((Entry.Faces >> (2 * Axis)) & 2u) && (Centre[Axis] + 1 == this->RegionEnd[Axis]) && (Centre[Axis] + 1 < this->BrickCount[Axis])) return true;
+        }
+        return false;
+    }
+
+    // Fill the layer of the world just beyond each face of the volume the component is on, and look for structure beside its voxels.
+    bool StructuralIntegrity::IsHeldBeyond(const Node& Part, const SourceType& Source) const {
+        const Component& Entry = this->Bricks[Part.first].Components[Part.second - 1];
+        const std::array<std::size_t, 3> Centre = {{Part.first % this->BrickCount[0], (Part.first / this->BrickCount[0]) % this->BrickCount[1], Part.first / (this->BrickCount[0] * this->BrickCount[1])}};
+        const std::array<std::size_t, 3> Base = {{Centre[0] * BrickSize, Centre[1] * BrickSize, Centre[2] * BrickSize}};
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            for (std::size_t Side = 0; Side < 2; ++Side) {
+                if (((Entry.Faces >> (2 * Axis + Side)) & 1u) == 0) continue;
+                if ((Side == 0) && (Centre[Axis] != 0)) continue;
+                if ((Side == 1) && (Centre[Axis] + 1 != this->BrickCount[Axis])) continue;
+
+                // The layer covers the face of the brick, one voxel outside the volume.
+                std::array<std::size_t, 3> LayerSize;
+                std::array<int, 3> LayerOffset;
+                for (std::size_t Other = 0; Other < 3; ++Other) {
+                    LayerSize[Other] = std::min(BrickSize, this->Size[Other] - Base[Other]);
+                    LayerOffset[Other] = this->Offset[Other] + static_cast<int>(Base[Other]);
+                }
+                LayerSize[Axis] = 1;
+                LayerOffset[Axis] = this->Offset[Axis] + ((Side == 0) ? -1 : static_cast<int>(this->Size[Axis]));
+                Volume Layer(LayerSize);
+                Source(LayerOffset, Layer);
+
+                std::array<std::size_t, 3> Inside;
+                std::array<std::size_t, 3> Outside;
+                Inside[Axis] = (Side == 0) ? 0 : (this->Size[Axis] - 1 - Base[Axis]);
+                Outside[Axis] = 0;
+                for (std::size_t IndexV = 0; IndexV < LayerSize[(Axis + 2) % 3]; ++IndexV) {
+                    for (std::size_t IndexU = 0; IndexU < LayerSize[(Axis + 1) % 3]; ++IndexU) {
+                        Inside[(Axis + 1) % 3] = Outside[(Axis + 1) % 3] = IndexU;
+                        Inside[(Axis + 2) % 3] = Outside[(Axis + 2) % 3] = IndexV;
+                        if (this->GetLabel(Part.first, GetLocalIndex(Inside)) != Part.second) continue;
+                        if (IsStructural(Layer(Outside[0], Outside[1], Outside[2]))) return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Gather the voxels of the fragment from the bottom up, then move them down a voxel where they are free to fall.
+    void StructuralIntegrity::Drop(Volume& Target, std::uint32_t Fragment) {
+        const Volume& Source = Target;
+        this->Positions.clear();
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            this->FallingBegin[Axis] = std::numeric_limits<int>::max();
+            this->FallingEnd[Axis] = std::numeric_limits<int>::min();
+        }
+        std::uint32_t Mass = 0;
+        std::uint8_t MinimumStrength = std::numeric_limits<std::uint8_t>::max();
+        for (const Node& Part : this->Nodes) {
+            const std::size_t Brick = Part.first;
+            const Component& Entry = this->Bricks[Brick].Components[Part.second - 1];
+            Mass += Entry.Mass;
+            MinimumStrength = std::min(MinimumStrength, Entry.MinimumStrength);
+            const std::array<std::size_t, 3> Base = {{
+                (Brick % this->BrickCount[0]) * BrickSize,
+                ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize,
+                (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize
+            }};
+            for (std::size_t Local = 0; Local < BrickVolume; ++Local) {
+                if (this->GetLabel(Brick, Local) == Part.second) {
+                    this->Positions.push_back({{Base[0] + Local % BrickSize, Base[1] + (Local / BrickSize) % BrickSize, Base[2] + Local / (BrickSize * BrickSize)}});
+                }
+            }
+        }
+        std::stable_sort(this->Positions.begin(), this->Positions.end(), [](const std::array<std::size_t, 3>& First, const std::array<std::size_t, 3>& Second) -> bool {
+            return First[1] < Second[1];
+        });
+
+        // Nothing falls out of the bottom of the volume, the world below it was empty or the fragment would be anchored.
+        auto IsFree = [&Source](const std::array<std::size_t, 3>& Position) -> bool {
+            return (Position[1] > 0) && (Source(Position[0], Position[1] - 1, Position[2]).Alpha == 0);
+        };
+        auto Move = [this, &Target, &Source](const std::array<std::size_t, 3>& Position) -> void {
+            const std::array<std::size_t, 3> Below = {{Position[0], Position[1] - 1, Position[2]}};
+            Target.Set(Below[0], Below[1], Below[2], Source(Position[0], Position[1], Position[2]));
+            Target.Set(Position[0], Position[1], Position[2], Voxel());
+            this->AddChanged(Below);
+            this->AddChanged(Position);
+        };
+
+        const bool Rigid = (Mass <= (static_cast<std::uint32_t>(MinimumStrength) + 1u) * MassPerStrength);
+        if (Rigid) {
+            // The fragment falls only if every voxel below it is empty or part of it, a voxel moving down frees the voxel above it.
+            for (const std::array<std::size_t, 3>& Position : this->Positions) {
+                if (Position[1] == 0) return;
+                if (IsFree(Position)) continue;
+                const std::array<std::size_t, 3> Below = {{Position[0], Position[1] - 1, Position[2]}};
+                const std::size_t Brick = (Below[0] / BrickSize) + this->BrickCount[0] * ((Below[1] / BrickSize) + this->BrickCount[1] * (Below[2] / BrickSize));
+                const std::uint16_t Label = this->GetLabel(Brick, GetLocalIndex({{Below[0] % BrickSize, Below[1] % BrickSize, Below[2] % BrickSize}}));
+                if ((Label == 0) || (this->Bricks[Brick].Components[Label - 1].Fragment != Fragment)) return;
+            }
+            for (const std::array<std::size_t, 3>& Position : this->Positions) {
+                Move(Position);
+            }
+        }
+        else {
+            // Crumbling voxels fall into the voxels below them that are empty, or were emptied by a voxel falling first.
+            for (const std::array<std::size_t, 3>& Position : this->Positions) {
+                if (IsFree(Position)) {
+                    Move(Position);
+                }
+            }
+        }
+
+        // The next step looks where the fragment fell, to keep it falling.
+        if (this->FallingBegin[0] < this->FallingEnd[0]) {
+            this->PendingRegions.push_back(std::make_pair(this->FallingBegin, this->FallingEnd));
+        }
+    }
+
+    // Flag the brick of the voxel and grow the box of the drop to cover it.
+    void StructuralIntegrity::AddChanged(const std::array<std::size_t, 3>& Position) {
+        const std::size_t Brick = (Position[0] / BrickSize) + this->BrickCount[0] * ((Position[1] / BrickSize) + this->BrickCount[1] * (Position[2] / BrickSize));
+        if ((this->Flags[Brick] & ChangedFlag) == 0) {
+            this->Flags[Brick] |= ChangedFlag;
+            this->Changed.push_back(Brick);
+        }
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int World = static_cast<int>(Position[Axis]) + this->Offset[Axis];
+            this->FallingBegin[Axis] = std::min(this->FallingBegin[Axis], World);
+            this->FallingEnd[Axis] = std::max(this->FallingEnd[Axis], World + 1);
+        }
+    }
+}
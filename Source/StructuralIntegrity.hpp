@@ -0,0 +1,260 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_STRUCTURALINTEGRITY_HPP
+#define RAYMARCH_STRUCTURALINTEGRITY_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  StructuralIntegrity finds the parts of a volume that have lost their support and drops them.
+    ///         Every occupied voxel that is not a fluid is structural, and structural voxels that share a face hold each other up.
+    ///         Structure is anchored where it rests on the ground of the world, or where it continues into the world beyond the faces of the volume.
+    ///         Only removals start a search, and only structure within a voxel of a removal can be a fragment, anything else is settled so the map stands as it was made.
+    ///         Each brick labels its structural voxels into components with a union-find of its own, bricks are labelled in parallel.
+    ///         Components are joined across brick faces by a lock free union-find, with the bricks of a box around the removals joined in parallel.
+    ///         Structure reaching the sides of the box continues beyond it, and is taken as supported.
+    ///         A fragment is a set of joined components around a removal that is not anchored.
+    ///         A fragment whose mass, one plus the Density of each voxel, is no more than MassPerStrength for each level of Strength of its weakest voxel falls one voxel a step as one piece.
+    ///         A heavier fragment crumbles, each of its voxels falls on its own.
+    class StructuralIntegrity {
+    public:
+        /// @brief  The function used to look at the world beyond the faces of the volume.
+        /// @param  Offset - The position in the world of the first voxel of the target.
+        /// @param  Target - The volume to fill with the world.
+        typedef std::function<void(const std::array<int, 3>& Offset, Volume& Target)> SourceType;
+
+    public:
+        /// @brief  The height of the ground of the world, structure at or below it is anchored.
+        constexpr static const int GroundHeight = 0;
+        /// @brief  The number of bricks the box joined by a step reaches beyond the bricks around the removals.
+        constexpr static const std::size_t RegionMargin = 4;
+        /// @brief  The mass a fragment can hold together for each level of Strength of its weakest voxel, counting Strength from one.
+        constexpr static const std::uint32_t MassPerStrength = 64;
+
+    private:
+        /// @brief  The structural voxels of a brick that share faces.
+        struct Component {
+            /// @brief  The number of voxels.
+            std::uint32_t Count;
+            /// @brief  The sum of one plus the Density of each voxel.
+            std::uint32_t Mass;
+            /// @brief  The lowest voxel along Y within the volume.
+            std::uint32_t Bottom;
+            /// @brief  The lowest Strength of any voxel.
+            std::uint8_t MinimumStrength;
+            /// @brief  A bit for each face of the brick a voxel is on, the lower and upper faces of X, then of Y, then of Z.
+            std::uint8_t Faces;
+            /// @brief  The fragment the component is part of during a step, zero if none.
+            std::uint32_t Fragment;
+        };
+
+        /// @brief  The components of a brick.
+        struct BrickComponents {
+            /// @brief  The label of each voxel in X-major order, zero for voxels that are not structural, one more than the index of their component otherwise.
+            ///         Empty if the brick has no components, or if it is a single component filling the brick.
+            std::vector<std::uint16_t> Labels;
+            /// @brief  The components of the brick.
+            std::vector<Component> Components;
+            /// @brief  A bit for each structural voxel in X-major order.
+            std::array<std::uint64_t, BrickVolume / 64> Mask;
+        };
+
+        /// @brief  A component of a brick, as the linear index of the brick and the label of the component.
+        typedef std::pair<std::size_t, std::uint16_t> Node;
+
+        /// @brief  A box of voxels of the volume, as the first voxel and one past the last.
+        typedef std::pair<std::array<std::size_t, 3>, std::array<std::size_t, 3> > Box;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  The position of the volume in the world.
+        std::array<int, 3> Offset;
+
+        /// @brief  Tracks the bricks of the volume changed since the last step.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last step, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The box around the structural voxels removed from each dirty brick when it was labelled, empty if none were.
+        std::vector<Box> DirtyRemoved;
+
+        /// @brief  The components of each brick.
+        std::vector<BrickComponents> Bricks;
+
+        /// @brief  A flag per brick, used to gather lists of bricks without repeats.
+        std::vector<std::uint8_t> Flags;
+
+        /// @brief  The boxes of voxels around the removals, grown by a voxel, the components with voxels in them are the only ones that can be part of a fragment.
+        std::vector<Box> SeedRegions;
+
+        /// @brief  The bricks the seed regions overlap.
+        std::vector<std::size_t> Seeds;
+
+        /// @brief  The box of bricks joined by the last step.
+        std::array<std::size_t, 3> RegionBegin;
+        std::array<std::size_t, 3> RegionEnd;
+
+        /// @brief  The index of the first node of each brick of the box, in X-major order, followed by the number of nodes.
+        std::vector<std::uint32_t> RegionBases;
+
+        /// @brief  The components of the box as nodes of the union-find.
+        std::vector<Node> RegionNodes;
+
+        /// @brief  The parent of each node in the union-find, always a node with a lower index or itself.
+        std::vector<std::atomic<std::uint32_t> > Parents;
+
+        /// @brief  The root of each node once every brick face is joined.
+        std::vector<std::uint32_t> Roots;
+
+        /// @brief  Flags for each node, whether it is anchored and whether it is in a seed region.
+        std::vector<std::uint8_t> NodeFlags;
+
+        /// @brief  Flags for each root, whether it is anchored and whether a removal reached it.
+        std::vector<std::uint8_t> RootFlags;
+
+        /// @brief  The nodes of the fragments paired with their roots, grouped by root.
+        std::vector<std::pair<std::uint32_t, std::uint32_t> > Members;
+
+        /// @brief  The components of the fragment being dropped.
+        std::vector<Node> Nodes;
+
+        /// @brief  The voxels of the fragment being dropped.
+        std::vector<std::array<std::size_t, 3> > Positions;
+
+        /// @brief  The bricks written by the last step in ascending order.
+        std::vector<std::size_t> Changed;
+
+        /// @brief  The number of fragments found by the last step.
+        std::size_t FragmentCount;
+
+        /// @brief  The box in world coordinates written by the drop of the current fragment.
+        std::array<int, 3> FallingBegin;
+        std::array<int, 3> FallingEnd;
+
+        /// @brief  The boxes in world coordinates where structure was removed or fell since the last step, the next step looks there even if the volume moved.
+        std::vector<std::pair<std::array<int, 3>, std::array<int, 3> > > PendingRegions;
+
+    public:
+        /// @brief  Constructor that creates a solver of nothing.
+        StructuralIntegrity(void);
+
+    public:
+        /// @brief  Test if a voxel is structural, occupied and not a fluid.
+        /// @param  Value - The voxel to test.
+        /// @return True if the voxel is structural.
+        static bool IsStructural(const Voxel& Value);
+
+        /// @brief  Find the fragments around the removals from a volume and drop each of them by one voxel.
+        ///         The first step, and any step with a volume of another size, labels every brick, later steps label the changed bricks.
+        ///         Without a move, the bricks that lost structural voxels are removals. A move changes the bricks it scrolls, so only the boxes passed to MarkRemoved are.
+        ///         Fragments keep falling because the next step looks at the box each of them was written to.
+        /// @param  Target - The volume to check, always the same volume.
+        /// @param  Offset - The position of the volume in the world.
+        /// @param  Source - Fills a volume with the world, used to look beyond the faces of the volume.
+        void Step(Volume& Target, const std::array<int, 3>& Offset, const SourceType& Source);
+
+        /// @brief  Get the bricks written by the last step.
+        /// @return The linear indices of the bricks in ascending order.
+        const std::vector<std::size_t>& GetChangedBricks(void) const;
+
+        /// @brief  Get the number of fragments found by the last step, including fragments that could not fall.
+        /// @return The number of fragments.
+        std::size_t GetFragmentCount(void) const;
+
+        /// @brief  Mark a box where structure was removed by something other than the solver, so the next step looks there even if the volume moved.
+        /// @param  Begin - The first voxel of the box in world coordinates.
+        /// @param  End - One past the last voxel of the box in world coordinates.
+        void MarkRemoved(const std::array<int, 3>& Begin, const std::array<int, 3>& End);
+
+    private:
+        /// @brief  Label the structural voxels of a brick into components.
+        /// @param  Source - The volume to label.
+        /// @param  Brick - The linear index of the brick.
+        /// @return The box around the structural voxels of the brick removed since it was last labelled, empty if none were.
+        Box LabelBrick(const Volume& Source, std::size_t Brick);
+
+        /// @brief  Get the label of a voxel of a brick.
+        /// @param  Brick - The linear index of the brick.
+        /// @param  Local - The index of the voxel within the brick in X-major order.
+        /// @return The label of the voxel, zero if it is not structural.
+        std::uint16_t GetLabel(std::size_t Brick, std::size_t Local) const;
+
+        /// @brief  Find the root of a node, halving the path to it.
+        /// @param  Index - The node.
+        /// @return The root of the node.
+        std::uint32_t Find(std::uint32_t Index);
+
+        /// @brief  Join the sets of two nodes, safe to call from many threads at once.
+        /// @param  First - A node.
+        /// @param  Second - Another node.
+        void Unite(std::uint32_t First, std::uint32_t Second);
+
+        /// @brief  Join the components of a brick of the box with those of the next bricks of the box along each axis.
+        /// @param  Region - The index of the brick within the box in X-major order.
+        void JoinBrick(std::size_t Region);
+
+        /// @brief  Test if a component has a voxel in a seed region.
+        /// @param  Part - The component, of a brick the seed regions overlap.
+        /// @return True if the component can be part of a fragment.
+        bool IsSeeded(const Node& Part) const;
+
+        /// @brief  Test if a component rests on the ground, or reaches a side of the box that is inside the volume.
+        /// @param  Part - The component.
+        /// @return True if the component is anchored.
+        bool IsAnchored(const Node& Part) const;
+
+        /// @brief  Test if a component on a face of the volume continues into the world beyond it.
+        /// @param  Part - The component.
+        /// @param  Source - Fills a volume with the world.
+        /// @return True if a structural voxel of the world beyond the volume touches the component.
+        bool IsHeldBeyond(const Node& Part, const SourceType& Source) const;
+
+        /// @brief  Drop the fragment in Nodes by one voxel, as one piece or crumbling.
+        /// @param  Target - The volume to write.
+        /// @param  Fragment - The number of the fragment.
+        void Drop(Volume& Target, std::uint32_t Fragment);
+
+        /// @brief  Add a brick to the written bricks, and grow the box in world coordinates written by the drop.
+        /// @param  Position - A voxel written by the step.
+        void AddChanged(const std::array<std::size_t, 3>& Position);
+    };
+}
+
+#endif // RAYMARCH_STRUCTURALINTEGRITY_HPP
@@ -0,0 +1,342 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "SummedVolumeTable.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace DeferredRasterisation {
+    // Nothing to follow yet.
+    SummedVolumeTable::SummedVolumeTable(void)
+        : Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}}) {
+    }
+
+    // Rebuild the changed bricks, then the running sums over bricks.
+    void SummedVolumeTable::Update(const Volume& Source) {
+        Source.Drain(this->Cursor, this->DirtyBricks);
+
+        // A new size rebuilds everything.
+        if (Source.GetSize() != this->Size) {
+            this->Size = Source.GetSize();
+            this->BrickCount = Source.GetBrickCount();
+            const std::size_t CountX = this->BrickCount[0];
+            const std::size_t CountY = this->BrickCount[1];
+            const std::size_t CountZ = this->BrickCount[2];
+            this->BrickTables.assign(CountX * CountY * CountZ * ChannelCount * TableVolume, 0);
+            this->FacesX.assign((CountX + 1) * CountY * CountZ * ChannelCount * TableSize * TableSize, 0);
+            this->FacesY.assign(CountX * (CountY + 1) * CountZ * ChannelCount * TableSize * TableSize, 0);
+            this->FacesZ.assign(CountX * CountY * (CountZ + 1) * ChannelCount * TableSize * TableSize, 0);
+            this->EdgesXY.assign((CountX + 1) * (CountY + 1) * CountZ * ChannelCount * TableSize, 0);
+            this->EdgesXZ.assign((CountX + 1) * CountY * (CountZ + 1) * ChannelCount * TableSize, 0);
+            this->EdgesYZ.assign(CountX * (CountY + 1) * (CountZ + 1) * ChannelCount * TableSize, 0);
+            this->Totals.assign((CountX + 1) * (CountY + 1) * (CountZ + 1) * ChannelCount, 0);
+            this->DirtyBricks.resize(CountX * CountY * CountZ);
+            for (std::size_t Brick = 0; Brick < this->DirtyBricks.size(); ++Brick) {
+                this->DirtyBricks[Brick] = Brick;
+            }
+        }
+        if (this->DirtyBricks.empty()) return;
+
+        // Brick tables are independent.
+        ThreadPool::GetGlobal().ParallelFor(this->DirtyBricks.size(), 4, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Index = Begin; Index < End; ++Index) {
+                this->RebuildBrick(Source, this->DirtyBricks[Index]);
+            }
+        });
+
+        // The running sums are a few entries per brick, so they are rebuilt whole.
+        this->RebuildRunningSums();
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& SummedVolumeTable::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Combine the sums to the eight corners of the box.
+    std::uint64_t SummedVolumeTable::GetSum(std::size_t Channel, const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const {
+        assert(Channel < ChannelCount);
+        std::array<std::size_t, 3> First;
+        std::array<std::size_t, 3> Last;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Last[Axis] = std::min(End[Axis], this->Size[Axis]);
+            First[Axis] = std::min(Begin[Axis], Last[Axis]);
+            if (First[Axis] == Last[Axis]) return 0;
+        }
+        const std::int64_t Sum =
+            static_cast<std::int64_t>(this->GetPrefix(Channel, Last[0], Last[1], Last[2]))
+          - static_cast<std::int64_t>(this->GetPrefix(Channel, First[0], Last[1], Last[2]))
+          - static_cast<std::int64_t>(this->GetPrefix(Channel, Last[0], First[1], Last[2]))
+          - static_cast<std::int64_t>(this->GetPrefix(Channel, Last[0], Last[1], First[2]))
+          + static_cast<std::int64_t>(this->GetPrefix(Channel, First[0], First[1], Last[2]))
+          + static_cast<std::int64_t>(this->GetPrefix(Channel, First[0], Last[1], First[2]))
+          + static_cast<std::int64_t>(this->GetPrefix(Channel, Last[0], First[1], First[2]))
+          - static_cast<std::int64_t>(this->GetPrefix(Channel, First[0], First[1], First[2]));
+        return static_cast<std::uint64_t>(Sum);
+    }
+
+    // Count solid voxels.
+    std::uint64_t SummedVolumeTable::GetCount(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const {
+        return this->GetSum(OccupiedChannel, Begin, End);
+    }
+
+    // Sum light levels.
+    std::uint64_t SummedVolumeTable::GetLight(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const {
+        return this->GetSum(LightChannel, Begin, End);
+    }
+
+    // Sum each hue channel.
+    std::array<std::uint64_t, 16> SummedVolumeTable::GetHueHistogram(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const {
+        std::array<std::uint64_t, 16> Histogram;
+        for (std::size_t Hue = 0; Hue < Histogram.size(); ++Hue) {
+            Histogram[Hue] = this->GetSum(HueChannel + Hue, Begin, End);
+        }
+        return Histogram;
+    }
+
+    // Split the box from the corner into whole bricks and the partial brick on each axis.
+    std::uint64_t SummedVolumeTable::GetPrefix(std::size_t Channel, std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X <= this->Size[0] && Y <= this->Size[1] && Z <= this->Size[2]);
+        const std::size_t CountX = this->BrickCount[0];
+        const std::size_t CountY = this->BrickCount[1];
+        const std::size_t BrickX = X / BrickSize;
+        const std::size_t BrickY = Y / BrickSize;
+        const std::size_t BrickZ = Z / BrickSize;
+        const std::size_t LocalX = X % BrickSize;
+        const std::size_t LocalY = Y % BrickSize;
+        const std::size_t LocalZ = Z % BrickSize;
+
+        // Whole bricks on every axis.
+        std::uint64_t Sum = this->Totals[(BrickX + (CountX + 1) * (BrickY + (CountY + 1) * BrickZ)) * ChannelCount + Channel];
+
+        // Whole bricks on two axes, part of a brick on the third.
+        if (LocalZ != 0) Sum += this->EdgesXY[((BrickX + (CountX + 1) * (BrickY + (CountY + 1) * BrickZ)) * ChannelCount + Channel) * TableSize + LocalZ];
+        if (LocalY != 0) Sum += this->EdgesXZ[((BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * ChannelCount + Channel) * TableSize + LocalY];
+        if (LocalX != 0) Sum += this->EdgesYZ[((BrickX + CountX * (BrickY + (CountY + 1) * BrickZ)) * ChannelCount + Channel) * TableSize + LocalX];
+
+        // Whole bricks on one axis, part of a brick on the other two.
+        if ((LocalY != 0) && (LocalZ != 0)) Sum += this->FacesX[((BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * ChannelCount + Channel) * TableSize * TableSize + LocalY + TableSize * LocalZ];
+        if ((LocalX != 0) && (LocalZ != 0)) Sum += this->FacesY[((BrickX + CountX * (BrickY + (CountY + 1) * BrickZ)) * ChannelCount + Channel) * TableSize * TableSize + LocalX + TableSize * LocalZ];
+        if ((LocalX != 0) && (LocalY != 0)) Sum += this->FacesZ[((BrickX + CountX * (BrickY + CountY * BrickZ)) * ChannelCount + Channel) * TableSize * TableSize + LocalX + TableSize * LocalY];
+
+        // Part of a brick on every axis.
+        if ((LocalX != 0) && (LocalY != 0) && (LocalZ != 0)) Sum += this->GetBrickTable(BrickX, BrickY, BrickZ, Channel)[LocalX + TableSize * (LocalY + TableSize * LocalZ)];
+        return Sum;
+    }
+
+    // Scatter the voxels into the table, then run prefix sums along each axis.
+    void SummedVolumeTable::RebuildBrick(const Volume& Source, std::size_t Brick) {
+        const std::size_t BeginX = (Brick % this->BrickCount[0]) * BrickSize;
+        const std::size_t BeginY = ((Brick / this->BrickCount[0]) % this->BrickCount[1]) * BrickSize;
+        const std::size_t BeginZ = (Brick / (this->BrickCount[0] * this->BrickCount[1])) * BrickSize;
+        const std::size_t EndX = std::min(BeginX + BrickSize, this->Size[0]);
+        const std::size_t EndY = std::min(BeginY + BrickSize, this->Size[1]);
+        const std::size_t EndZ = std::min(BeginZ + BrickSize, this->Size[2]);
+
+        std::uint16_t* Tables = &this->BrickTables[Brick * ChannelCount * TableVolume];
+        std::fill(Tables, Tables + ChannelCount * TableVolume, 0);
+
+        // Entry I + 1, J + 1, K + 1 holds voxel I, J, K, leaving zero rows at the start of each axis.
+        for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+            for (std::size_t IndexY = BeginY; IndexY < EndY; ++IndexY) {
+                for (std::size_t IndexX = BeginX; IndexX < EndX; ++IndexX) {
+                    const Voxel& Value = Source(IndexX, IndexY, IndexZ);
+                    const std::size_t Entry = (IndexX - BeginX + 1) + TableSize * ((IndexY - BeginY + 1) + TableSize * (IndexZ - BeginZ + 1));
+                    Tables[LightChannel * TableVolume + Entry] = Value.Light;
+                    if (Value.Alpha != 0) {
+                        Tables[OccupiedChannel * TableVolume + Entry] = 1;
+                        Tables[(HueChannel + Value.Hue) * TableVolume + Entry] = 1;
+                    }
+                }
+            }
+        }
+
+        // Prefix sums along X, then Y, then Z, turn the values into sums from the corner.
+        for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+            std::uint16_t* Table = &Tables[Channel * TableVolume];
+            for (std::size_t Row = 1; Row < TableSize * TableSize; ++Row) {
+                std::uint16_t* Entries = &Table[Row * TableSize];
+                for (std::size_t Index = 1; Index < TableSize; ++Index) {
+                    Entries[Index] += Entries[Index - 1];
+                }
+            }
+            for (std::size_t Slice = 1; Slice < TableSize; ++Slice) {
+                for (std::size_t Row = 1; Row < TableSize; ++Row) {
+                    std::uint16_t* Entries = &Table[(Row + TableSize * Slice) * TableSize];
+                    for (std::size_t Index = 0; Index < TableSize; ++Index) {
+                        Entries[Index] += Entries[Index - TableSize];
+                    }
+                }
+            }
+            for (std::size_t Index = TableSize * TableSize; Index < TableVolume; ++Index) {
+                Table[Index] += Table[Index - TableSize * TableSize];
+            }
+        }
+    }
+
+    // Accumulate brick faces along their axis, then faces into edges, then edges into totals.
+    void SummedVolumeTable::RebuildRunningSums(void) {
+        const std::size_t CountX = this->BrickCount[0];
+        const std::size_t CountY = this->BrickCount[1];
+        const std::size_t CountZ = this->BrickCount[2];
+        const std::size_t FaceEntries = ChannelCount * TableSize * TableSize;
+        const std::size_t EdgeEntries = ChannelCount * TableSize;
+
+        // Face sums before the first changed brick of a line are unchanged.
+        this->FirstDirty[0].assign(CountY * CountZ, CountX);
+        this->FirstDirty[1].assign(CountX * CountZ, CountY);
+        this->FirstDirty[2].assign(CountX * CountY, CountZ);
+        for (std::size_t Brick : this->DirtyBricks) {
+            const std::size_t BrickX = Brick % CountX;
+            const std::size_t BrickY = (Brick / CountX) % CountY;
+            const std::size_t BrickZ = Brick / (CountX * CountY);
+            std::size_t& FirstX = this->FirstDirty[0][BrickY + CountY * BrickZ];
+            std::size_t& FirstY = this->FirstDirty[1][BrickX + CountX * BrickZ];
+            std::size_t& FirstZ = this->FirstDirty[2][BrickX + CountX * BrickY];
+            FirstX = std::min(FirstX, BrickX);
+            FirstY = std::min(FirstY, BrickY);
+            FirstZ = std::min(FirstZ, BrickZ);
+        }
+
+        // Faces, each line of bricks along the axis is independent.
+        ThreadPool::GetGlobal().ParallelFor(CountZ, 1, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t BrickZ = Begin; BrickZ < End; ++BrickZ) {
+                for (std::size_t BrickY = 0; BrickY < CountY; ++BrickY) {
+                    for (std::size_t BrickX = this->FirstDirty[0][BrickY + CountY * BrickZ]; BrickX < CountX; ++BrickX) {
+                        const std::uint32_t* Previous = &this->FacesX[(BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * FaceEntries];
+                        std::uint32_t* Next = &this->FacesX[((BrickX + 1) + (CountX + 1) * (BrickY + CountY * BrickZ)) * FaceEntries];
+                        for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                            const std::uint16_t* Table = this->GetBrickTable(BrickX, BrickY, BrickZ, Channel);
+                            for (std::size_t Entry = 0; Entry < TableSize * TableSize; ++Entry) {
+                                Next[Channel * TableSize * TableSize + Entry] = Previous[Channel * TableSize * TableSize + Entry] + Table[BrickSize + TableSize * Entry];
+                            }
+                        }
+                    }
+                }
+                for (std::size_t BrickX = 0; BrickX < CountX; ++BrickX) {
+                    for (std::size_t BrickY = this->FirstDirty[1][BrickX + CountX * BrickZ]; BrickY < CountY; ++BrickY) {
+                        const std::uint32_t* Previous = &this->FacesY[(BrickX + CountX * (BrickY + (CountY + 1) * BrickZ)) * FaceEntries];
+                        std::uint32_t* Next = &this->FacesY[(BrickX + CountX * ((BrickY + 1) + (CountY + 1) * BrickZ)) * FaceEntries];
+                        for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                            const std::uint16_t* Table = this->GetBrickTable(BrickX, BrickY, BrickZ, Channel);
+                            for (std::size_t EntryZ = 0; EntryZ < TableSize; ++EntryZ) {
+                                for (std::size_t EntryX = 0; EntryX < TableSize; ++EntryX) {
+                                    const std::size_t Entry = Channel * TableSize * TableSize + EntryX + TableSize * EntryZ;
+                                    Next[Entry] = Previous[Entry] + Table[EntryX + TableSize * (BrickSize + TableSize * EntryZ)];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+        ThreadPool::GetGlobal().ParallelFor(CountY, 1, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t BrickY = Begin; BrickY < End; ++BrickY) {
+                for (std::size_t BrickX = 0; BrickX < CountX; ++BrickX) {
+                    for (std::size_t BrickZ = this->FirstDirty[2][BrickX + CountX * BrickY]; BrickZ < CountZ; ++BrickZ) {
+                        const std::uint32_t* Previous = &this->FacesZ[(BrickX + CountX * (BrickY + CountY * BrickZ)) * FaceEntries];
+                        std::uint32_t* Next = &this->FacesZ[(BrickX + CountX * (BrickY + CountY * (BrickZ + 1))) * FaceEntries];
+                        for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                            const std::uint16_t* Table = this->GetBrickTable(BrickX, BrickY, BrickZ, Channel);
+                            for (std::size_t Entry = 0; Entry < TableSize * TableSize; ++Entry) {
+                                Next[Channel * TableSize * TableSize + Entry] = Previous[Channel * TableSize * TableSize + Entry] + Table[Entry + TableSize * TableSize * BrickSize];
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        // Edges along Z sum the X faces at Y = BrickSize over Y.
+        for (std::size_t BrickZ = 0; BrickZ < CountZ; ++BrickZ) {
+            for (std::size_t BrickX = 0; BrickX <= CountX; ++BrickX) {
+                for (std::size_t BrickY = 0; BrickY < CountY; ++BrickY) {
+                    const std::uint32_t* Face = &this->FacesX[(BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * FaceEntries];
+                    const std::uint32_t* Previous = &this->EdgesXY[(BrickX + (CountX + 1) * (BrickY + (CountY + 1) * BrickZ)) * EdgeEntries];
+                    std::uint32_t* Next = &this->EdgesXY[(BrickX + (CountX + 1) * ((BrickY + 1) + (CountY + 1) * BrickZ)) * EdgeEntries];
+                    for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                        for (std::size_t Entry = 0; Entry < TableSize; ++Entry) {
+                            Next[Channel * TableSize + Entry] = Previous[Channel * TableSize + Entry] + Face[Channel * TableSize * TableSize + BrickSize + TableSize * Entry];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Edges along Y sum the X faces at Z = BrickSize over Z.
+        for (std::size_t BrickY = 0; BrickY < CountY; ++BrickY) {
+            for (std::size_t BrickX = 0; BrickX <= CountX; ++BrickX) {
+                for (std::size_t BrickZ = 0; BrickZ < CountZ; ++BrickZ) {
+                    const std::uint32_t* Face = &this->FacesX[(BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * FaceEntries];
+                    const std::uint32_t* Previous = &this->EdgesXZ[(BrickX + (CountX + 1) * (BrickY + CountY * BrickZ)) * EdgeEntries];
+                    std::uint32_t* Next = &this->EdgesXZ[(BrickX + (CountX + 1) * (BrickY + CountY * (BrickZ + 1))) * EdgeEntries];
+                    for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                        for (std::size_t Entry = 0; Entry < TableSize; ++Entry) {
+                            Next[Channel * TableSize + Entry] = Previous[Channel * TableSize + Entry] + Face[Channel * TableSize * TableSize + Entry + TableSize * BrickSize];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Edges along X sum the Y faces at Z = BrickSize over Z.
+        for (std::size_t BrickY = 0; BrickY <= CountY; ++BrickY) {
+            for (std::size_t BrickX = 0; BrickX < CountX; ++BrickX) {
+                for (std::size_t BrickZ = 0; BrickZ < CountZ; ++BrickZ) {
+                    const std::uint32_t* Face = &this->FacesY[(BrickX + CountX * (BrickY + (CountY + 1) * BrickZ)) * FaceEntries];
+                    const std::uint32_t* Previous = &this->EdgesYZ[(BrickX + CountX * (BrickY + (CountY + 1) * BrickZ)) * EdgeEntries];
+                    std::uint32_t* Next = &this->EdgesYZ[(BrickX + CountX * (BrickY + (CountY + 1) * (BrickZ + 1))) * EdgeEntries];
+                    for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                        for (std::size_t Entry = 0; Entry < TableSize; ++Entry) {
+                            Next[Channel * TableSize + Entry] = Previous[Channel * TableSize + Entry] + Face[Channel * TableSize * TableSize + Entry + TableSize * BrickSize];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Totals sum the edges along Z at Z = BrickSize over Z.
+        for (std::size_t BrickY = 0; BrickY <= CountY; ++BrickY) {
+            for (std::size_t BrickX = 0; BrickX <= CountX; ++BrickX) {
+                for (std::size_t BrickZ = 0; BrickZ < CountZ; ++BrickZ) {
+                    const std::uint32_t* Edge = &this->EdgesXY[(BrickX + (CountX + 1) * (BrickY + (CountY + 1) * BrickZ)) * EdgeEntries];
+                    const std::uint32_t* Previous = &this->Totals[(BrickX + (CountX + 1) * (BrickY + (CountY + 1) * BrickZ)) * ChannelCount];
+                    std::uint32_t* Next = &this->Totals[(BrickX + (CountX + 1) * (BrickY + (CountY + 1) * (BrickZ + 1))) * ChannelCount];
+                    for (std::size_t Channel = 0; Channel < ChannelCount; ++Channel) {
+                        Next[Channel] = Previous[Channel] + Edge[Channel * TableSize + BrickSize];
+                    }
+                }
+            }
+        }
+    }
+
+    // Get the table of a brick and channel.
+    const std::uint16_t* SummedVolumeTable::GetBrickTable(std::size_t BrickX, std::size_t BrickY, std::size_t BrickZ, std::size_t Channel) const {
+        const std::size_t Brick = BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ);
+        return &this->BrickTables[(Brick * ChannelCount + Channel) * TableVolume];
+    }
+}
@@ -0,0 +1,163 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_SUMMEDVOLUMETABLE_HPP
+#define RAYMARCH_SUMMEDVOLUMETABLE_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  SummedVolumeTable answers sum queries over any box of a volume in constant time: solid voxel counts, total light and hue histograms.
+    ///         Each brick holds a summed volume table of its own voxels, so a changed brick only rebuilds its own table.
+    ///         Small brick level tables then hold running sums of the faces, edges and totals of the bricks before each brick.
+    ///         A sum from the corner of the volume is split into at most eight lookups, the part inside its brick and the parts covered by whole bricks on one, two or three axes.
+    ///         It follows one volume, each update only rebuilds the bricks that changed since the last.
+    class SummedVolumeTable {
+    public:
+        /// @brief  The channel counting non-empty voxels.
+        constexpr static const std::size_t OccupiedChannel = 0;
+        /// @brief  The channel summing the light level of every voxel.
+        constexpr static const std::size_t LightChannel = 1;
+        /// @brief  The first of sixteen channels counting the non-empty voxels of each hue.
+        constexpr static const std::size_t HueChannel = 2;
+        /// @brief  The number of channels.
+        constexpr static const std::size_t ChannelCount = HueChannel + 16;
+
+    private:
+        /// @brief  The number of entries along each axis of a brick table, one more than the brick size for the zero row.
+        constexpr static const std::size_t TableSize = BrickSize + 1;
+        /// @brief  The number of entries in a brick table of one channel.
+        constexpr static const std::size_t TableVolume = TableSize * TableSize * TableSize;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  The table of each brick and channel, entry I, J, K sums the voxels of the brick before local X = I, Y = J, Z = K.
+        std::vector<std::uint16_t> BrickTables;
+
+        /// @brief  Running sums along X of the X = BrickSize faces of bricks, 9x9 entries over Y and Z per channel for each brick position from 0 to the brick count.
+        std::vector<std::uint32_t> FacesX;
+        /// @brief  Running sums along Y of the Y = BrickSize faces of bricks, 9x9 entries over X and Z.
+        std::vector<std::uint32_t> FacesY;
+        /// @brief  Running sums along Z of the Z = BrickSize faces of bricks, 9x9 entries over X and Y.
+        std::vector<std::uint32_t> FacesZ;
+
+        /// @brief  Running sums over X and Y of the brick edges along Z, 9 entries over Z.
+        std::vector<std::uint32_t> EdgesXY;
+        /// @brief  Running sums over X and Z of the brick edges along Y, 9 entries over Y.
+        std::vector<std::uint32_t> EdgesXZ;
+        /// @brief  Running sums over Y and Z of the brick edges along X, 9 entries over X.
+        std::vector<std::uint32_t> EdgesYZ;
+
+        /// @brief  Running sums over X, Y and Z of the brick totals.
+        std::vector<std::uint32_t> Totals;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  The first changed brick along each line of bricks in X, Y and Z, or the brick count if none changed.
+        std::array<std::vector<std::size_t>, 3> FirstDirty;
+
+    public:
+        /// @brief  Constructor that creates an empty table of no size.
+        SummedVolumeTable(void);
+
+    public:
+        /// @brief  Bring the table up to date with a volume, rebuilding only the bricks that changed since the last update.
+        ///         The first update, and any update with a volume of another size, rebuilds everything.
+        /// @param  Source - The volume to follow, always the same volume.
+        void Update(const Volume& Source);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Sum a channel over a box.
+        /// @param  Channel - The channel to sum.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, clipped to the volume.
+        /// @return The sum over the part of the box within the volume.
+        std::uint64_t GetSum(std::size_t Channel, const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const;
+
+        /// @brief  Count the non-empty voxels in a box.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, clipped to the volume.
+        /// @return The number of non-empty voxels.
+        std::uint64_t GetCount(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const;
+
+        /// @brief  Sum the light level of every voxel in a box.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, clipped to the volume.
+        /// @return The total light.
+        std::uint64_t GetLight(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const;
+
+        /// @brief  Count the non-empty voxels of each hue in a box.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, clipped to the volume.
+        /// @return The number of non-empty voxels of each hue.
+        std::array<std::uint64_t, 16> GetHueHistogram(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) const;
+
+    private:
+        /// @brief  Sum a channel over the box from the corner of the volume to a position.
+        /// @param  Channel - The channel to sum.
+        /// @param  X - One past the last X coordinate, up to the width of the volume.
+        /// @param  Y - One past the last Y coordinate, up to the height of the volume.
+        /// @param  Z - One past the last Z coordinate, up to the depth of the volume.
+        /// @return The sum.
+        std::uint64_t GetPrefix(std::size_t Channel, std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Rebuild the table of one brick.
+        /// @param  Source - The volume being followed.
+        /// @param  Brick - The linear index of the brick.
+        void RebuildBrick(const Volume& Source, std::size_t Brick);
+
+        /// @brief  Rebuild the running sums over bricks from the brick tables.
+        ///         Face sums are only rebuilt along lines of bricks with a changed brick, from that brick on.
+        void RebuildRunningSums(void);
+
+        /// @brief  Get the table of a brick and channel.
+        /// @param  BrickX - The X index of the brick.
+        /// @param  BrickY - The Y index of the brick.
+        /// @param  BrickZ - The Z index of the brick.
+        /// @param  Channel - The channel.
+        /// @return Pointer to the first entry of the table.
+        const std::uint16_t* GetBrickTable(std::size_t BrickX, std::size_t BrickY, std::size_t BrickZ, std::size_t Channel) const;
+    };
+}
+
+#endif // RAYMARCH_SUMMEDVOLUMETABLE_HPP
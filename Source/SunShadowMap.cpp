@@ -0,0 +1,186 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "SunShadowMap.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace DeferredRasterisation {
+    // Nothing to follow yet.
+    SunShadowMap::SunShadowMap(void)
+        : Size({{0, 0, 0}})
+        , Azimuth(0)
+        , Version(0) {
+    }
+
+    // Find heights over changed bricks, then horizons where heights or the sun's direction changed.
+    void SunShadowMap::Update(const Volume& Source, const std::array<float, 3>& LightPosition) {
+        Source.Drain(this->Cursor, this->DirtyBricks);
+
+        // The sun overhead has no direction across the ground, the last direction is kept.
+        std::size_t NewAzimuth = this->Azimuth;
+        if ((LightPosition[0] != 0.0f) || (LightPosition[2] != 0.0f)) {
+            const double Turn = std::atan2(LightPosition[2], LightPosition[0]) / (2.0 * M_PI);
+            NewAzimuth = static_cast<std::size_t>(std::lround(Turn * AzimuthSteps + AzimuthSteps)) % AzimuthSteps;
+        }
+
+        // A new size finds everything.
+        if (Source.GetSize() != this->Size) {
+            this->Size = Source.GetSize();
+            this->Texels.assign(2 * this->Size[0] * this->Size[2], 0);
+            this->Azimuth = NewAzimuth;
+            this->UpdateHeights(Source, {{0, 0}}, {{this->Size[0], this->Size[2]}});
+            this->UpdateHorizons({{0, 0}}, {{this->Size[0], this->Size[2]}});
+            ++this->Version;
+            return;
+        }
+
+        bool Changed = false;
+        if (!this->DirtyBricks.empty()) {
+            // The columns over the changed bricks.
+            const std::array<std::size_t, 3>& BrickCount = Source.GetBrickCount();
+            std::array<std::size_t, 2> Begin = {{this->Size[0], this->Size[2]}};
+            std::array<std::size_t, 2> End = {{0, 0}};
+            for (std::size_t Brick : this->DirtyBricks) {
+                const std::array<std::size_t, 2> Column = {{Brick % BrickCount[0], Brick / (BrickCount[0] * BrickCount[1])}};
+                for (std::size_t Axis = 0; Axis < 2; ++Axis) {
+                    const std::size_t Limit = this->Size[(Axis == 0) ? 0 : 2];
+                    Begin[Axis] = std::min(Begin[Axis], Column[Axis] * BrickSize);
+                    End[Axis] = std::max(End[Axis], std::min((Column[Axis] + 1) * BrickSize, Limit));
+                }
+            }
+
+            // A changed height can shadow or uncover columns up to a march away.
+            if (this->UpdateHeights(Source, Begin, End)) {
+                Changed = true;
+                if (NewAzimuth == this->Azimuth) {
+                    for (std::size_t Axis = 0; Axis < 2; ++Axis) {
+                        const std::size_t Limit = this->Size[(Axis == 0) ? 0 : 2];
+                        Begin[Axis] = (Begin[Axis] > MaxSteps) ? (Begin[Axis] - MaxSteps) : 0;
+                        End[Axis] = std::min(End[Axis] + MaxSteps, Limit);
+                    }
+                    this->UpdateHorizons(Begin, End);
+                }
+            }
+        }
+
+        if (NewAzimuth != this->Azimuth) {
+            this->Azimuth = NewAzimuth;
+            this->UpdateHorizons({{0, 0}}, {{this->Size[0], this->Size[2]}});
+            Changed = true;
+        }
+        if (Changed) {
+            ++this->Version;
+        }
+    }
+
+    // Get the volume size.
+    const std::array<std::size_t, 3>& SunShadowMap::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Get the texels.
+    const std::uint16_t* SunShadowMap::data(void) const {
+        return this->Texels.data();
+    }
+
+    // Get the version.
+    std::uint64_t SunShadowMap::GetVersion(void) const {
+        return this->Version;
+    }
+
+    // Read the first channel of the column.
+    std::size_t SunShadowMap::GetHeight(std::size_t X, std::size_t Z) const {
+        assert(X < this->Size[0] && Z < this->Size[2]);
+        return this->Texels[2 * (X + this->Size[0] * Z) + 0];
+    }
+
+    // Scale the second channel of the column back to radians.
+    float SunShadowMap::GetHorizon(std::size_t X, std::size_t Z) const {
+        assert(X < this->Size[0] && Z < this->Size[2]);
+        return static_cast<float>(this->Texels[2 * (X + this->Size[0] * Z) + 1]) * static_cast<float>(M_PI / 2.0) / static_cast<float>(MaxHorizon);
+    }
+
+    // Compare the sun's elevation with the horizon of the top of the column.
+    bool SunShadowMap::IsLit(std::size_t X, std::size_t Y, std::size_t Z, const std::array<float, 3>& LightPosition) const {
+        if (Y + 1 < this->GetHeight(X, Z)) return false;
+        const float Elevation = std::atan2(LightPosition[1], std::sqrt(LightPosition[0] * LightPosition[0] + LightPosition[2] * LightPosition[2]));
+        return Elevation > this->GetHorizon(X, Z);
+    }
+
+    // Scan each column down from the top, rows of columns in parallel.
+    bool SunShadowMap::UpdateHeights(const Volume& Source, const std::array<std::size_t, 2>& Begin, const std::array<std::size_t, 2>& End) {
+        std::atomic<bool> Changed(false);
+        ThreadPool::GetGlobal().ParallelFor(End[1] - Begin[1], 1, [&](std::size_t First, std::size_t Last) -> void {
+            bool RowsChanged = false;
+            for (std::size_t IndexZ = Begin[1] + First; IndexZ < Begin[1] + Last; ++IndexZ) {
+                for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                    std::size_t Height = this->Size[1];
+                    while ((Height > 0) && (Source(IndexX, Height - 1, IndexZ).Alpha == 0)) {
+                        --Height;
+                    }
+                    std::uint16_t& Texel = this->Texels[2 * (IndexX + this->Size[0] * IndexZ) + 0];
+                    if (Texel != Height) {
+                        Texel = static_cast<std::uint16_t>(Height);
+                        RowsChanged = true;
+                    }
+                }
+            }
+            if (RowsChanged) {
+                Changed.store(true, std::memory_order_relaxed);
+            }
+        });
+        return Changed.load(std::memory_order_relaxed);
+    }
+
+    // March each column towards the sun over the heights, keeping the steepest rise.
+    void SunShadowMap::UpdateHorizons(const std::array<std::size_t, 2>& Begin, const std::array<std::size_t, 2>& End) {
+        // Steps advance one column along the major axis, so no column is skipped.
+        const double Angle = 2.0 * M_PI * static_cast<double>(this->Azimuth) / static_cast<double>(AzimuthSteps);
+        const double Major = std::max(std::abs(std::cos(Angle)), std::abs(std::sin(Angle)));
+        const std::array<double, 2> Step = {{std::cos(Angle) / Major, std::sin(Angle) / Major}};
+        const double StepLength = 1.0 / Major;
+
+        ThreadPool::GetGlobal().ParallelFor(End[1] - Begin[1], 1, [&](std::size_t First, std::size_t Last) -> void {
+            for (std::size_t IndexZ = Begin[1] + First; IndexZ < Begin[1] + Last; ++IndexZ) {
+                for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                    const double Base = static_cast<double>(this->Texels[2 * (IndexX + this->Size[0] * IndexZ) + 0]);
+                    double Steepest = 0.0;
+                    for (std::size_t Index = 1; Index <= MaxSteps; ++Index) {
+                        const double ColumnX = std::floor(static_cast<double>(IndexX) + Step[0] * static_cast<double>(Index) + 0.5);
+                        const double ColumnZ = std::floor(static_cast<double>(IndexZ) + Step[1] * static_cast<double>(Index) + 0.5);
+                        if ((ColumnX < 0.0) || (ColumnZ < 0.0) || (ColumnX >= static_cast<double>(this->Size[0])) || (ColumnZ >= static_cast<double>(this->Size[2]))) break;
+                        const double Rise = static_cast<double>(this->Texels[2 * (static_cast<std::size_t>(ColumnX) + this->Size[0] * static_cast<std::size_t>(ColumnZ)) + 0]) - Base;
+                        Steepest = std::max(Steepest, Rise / (StepLength * static_cast<double>(Index)));
+                    }
+                    const double Horizon = std::atan(Steepest) / (M_PI / 2.0);
+                    this->Texels[2 * (IndexX + this->Size[0] * IndexZ) + 1] = static_cast<std::uint16_t>(std::lround(Horizon * MaxHorizon));
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,131 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_SUNSHADOWMAP_HPP
+#define RAYMARCH_SUNSHADOWMAP_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  SunShadowMap holds, for each column of a volume, the height of its top-most occupied voxel and the horizon angle towards the sun.
+    ///         The horizon angle is the steepest elevation over the tops of the columns towards the sun, so the top of a column is lit when the sun is above it.
+    ///         Voxels below the top of their column are shadowed by it.
+    ///         The horizon only depends on the direction of the sun across the ground, so it is rebuilt when that turns by a step, not as the sun rises and sets.
+    ///         Each column is two 16 bit values, the height in voxels and the horizon angle scaled so 65535 is straight up, ready for an RG16 texture.
+    class SunShadowMap {
+    public:
+        /// @brief  The number of columns marched towards the sun when finding the horizon.
+        constexpr static const std::size_t MaxSteps = 64;
+        /// @brief  The number of directions across the ground the sun is quantised to.
+        constexpr static const std::size_t AzimuthSteps = 256;
+        /// @brief  The stored horizon angle of straight up, angles are stored as a fraction of it.
+        constexpr static const std::uint16_t MaxHorizon = 65535;
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The height and horizon angle of each column in X-major order.
+        std::vector<std::uint16_t> Texels;
+
+        /// @brief  The quantised direction of the sun across the ground the horizons were found for.
+        std::size_t Azimuth;
+
+        /// @brief  Incremented whenever a texel changes, so uploads can be skipped.
+        std::uint64_t Version;
+
+        /// @brief  Tracks the bricks of the volume changed since the last update.
+        DirtyCursor Cursor;
+
+        /// @brief  The bricks changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+    public:
+        /// @brief  Constructor that creates an empty map of no size.
+        SunShadowMap(void);
+
+    public:
+        /// @brief  Bring the map up to date with a volume and the position of the sun.
+        ///         Heights are found again for the columns over changed bricks, and horizons for the columns within reach of a changed height.
+        ///         Every horizon is found again when the direction of the sun across the ground changes by a step.
+        /// @param  Source - The volume to follow, always the same volume.
+        /// @param  LightPosition - The position of the sun relative to the volume, its direction is used.
+        void Update(const Volume& Source, const std::array<float, 3>& LightPosition);
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+        /// @brief  Get the texels, a height and horizon angle per column in X-major order.
+        /// @return A const pointer to the first texel.
+        const std::uint16_t* data(void) const;
+
+        /// @brief  Get the version of the texels.
+        /// @return A value that changes whenever any texel changes.
+        std::uint64_t GetVersion(void) const;
+
+        /// @brief  Get the height of a column.
+        /// @param  X - The X coordinate of the column.
+        /// @param  Z - The Z coordinate of the column.
+        /// @return One above the top-most occupied voxel, zero for an empty column.
+        std::size_t GetHeight(std::size_t X, std::size_t Z) const;
+
+        /// @brief  Get the horizon angle of a column towards the sun.
+        /// @param  X - The X coordinate of the column.
+        /// @param  Z - The Z coordinate of the column.
+        /// @return The angle in radians above the ground.
+        float GetHorizon(std::size_t X, std::size_t Z) const;
+
+        /// @brief  Test if the sun reaches a voxel, the same test the renderer makes.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @param  LightPosition - The position of the sun, in the direction the map was last updated for.
+        /// @return True if the voxel is the top of its column and the sun is above its horizon.
+        bool IsLit(std::size_t X, std::size_t Y, std::size_t Z, const std::array<float, 3>& LightPosition) const;
+
+    private:
+        /// @brief  Find the heights of a box of columns.
+        /// @param  Source - The volume being followed.
+        /// @param  Begin - The first column, X then Z.
+        /// @param  End - One past the last column, X then Z.
+        /// @return True if any height changed.
+        bool UpdateHeights(const Volume& Source, const std::array<std::size_t, 2>& Begin, const std::array<std::size_t, 2>& End);
+
+        /// @brief  Find the horizon angles of a box of columns from the heights.
+        /// @param  Begin - The first column, X then Z.
+        /// @param  End - One past the last column, X then Z.
+        void UpdateHorizons(const std::array<std::size_t, 2>& Begin, const std::array<std::size_t, 2>& End);
+    };
+}
+
+#endif // RAYMARCH_SUNSHADOWMAP_HPP
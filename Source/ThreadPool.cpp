@@ -0,0 +1,136 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace DeferredRasterisation {
+    // Start the worker threads.
+    ThreadPool::ThreadPool(std::size_t WorkerCount)
+        : Stopping(false) {
+        for (std::size_t Index = 0; Index < WorkerCount; ++Index) {
+            this->Workers.emplace_back(&ThreadPool::Work, this);
+        }
+    }
+
+    // Stop and join the worker threads.
+    ThreadPool::~ThreadPool(void) {
+        {
+            std::lock_guard<std::mutex> Lock(this->TaskMutex);
+            this->Stopping = true;
+        }
+        this->TaskAvailable.notify_all();
+        for (std::thread& Worker : this->Workers) {
+            Worker.join();
+        }
+    }
+
+    // The workers plus the calling thread.
+    std::size_t ThreadPool::GetThreadCount(void) const {
+        return this->Workers.size() + 1;
+    }
+
+    // Run a function over chunks of a range.
+    void ThreadPool::ParallelFor(std::size_t Count, std::size_t Granularity, const std::function<void(std::size_t, std::size_t)>& Function) {
+        if (Count == 0) return;
+        Granularity = std::max<std::size_t>(Granularity, 1);
+        const std::size_t ChunkCount = (Count + Granularity - 1) / Granularity;
+
+        // Run small ranges or single threaded pools directly.
+        if ((ChunkCount == 1) || this->Workers.empty()) {
+            for (std::size_t Begin = 0; Begin < Count; Begin += Granularity) {
+                Function(Begin, std::min(Begin + Granularity, Count));
+            }
+            return;
+        }
+
+        // Shared state, helpers may outlive this call if they start after every chunk is taken.
+        struct ChunkState {
+            std::atomic<std::size_t> NextChunk;
+            std::size_t FinishedChunks;
+            std::mutex Mutex;
+            std::condition_variable Finished;
+        };
+        std::shared_ptr<ChunkState> State = std::make_shared<ChunkState>();
+        State->NextChunk = 0;
+        State->FinishedChunks = 0;
+
+        // Claim and process chunks until none are left.
+        const std::function<void(std::size_t, std::size_t)>* FunctionPointer = &Function;
+        auto Process = [State, FunctionPointer, Count, Granularity, ChunkCount](void) -> void {
+            std::size_t Processed = 0;
+            for (std::size_t Chunk = State->NextChunk++; Chunk < ChunkCount; Chunk = State->NextChunk++) {
+                const std::size_t Begin = Chunk * Granularity;
+                (*FunctionPointer)(Begin, std::min(Begin + Granularity, Count));
+                ++Processed;
+            }
+            if (Processed > 0) {
+                std::lock_guard<std::mutex> Lock(State->Mutex);
+                State->FinishedChunks += Processed;
+                if (State->FinishedChunks == ChunkCount) {
+                    State->Finished.notify_all();
+                }
+            }
+        };
+
+        // Wake helpers, the function is only dereferenced while chunks remain so the pointer stays valid.
+        const std::size_t HelperCount = std::min(this->Workers.size(), ChunkCount - 1);
+        {
+            std::lock_guard<std::mutex> Lock(this->TaskMutex);
+            for (std::size_t Index = 0; Index < HelperCount; ++Index) {
+                this->Tasks.push_back(Process);
+            }
+        }
+        this->TaskAvailable.notify_all();
+
+        // The calling thread works too, then waits for chunks still running on other threads.
+        Process();
+        std::unique_lock<std::mutex> Lock(State->Mutex);
+        State->Finished.wait(Lock, [&State, ChunkCount](void) -> bool { return State->FinishedChunks == ChunkCount; });
+    }
+
+    // Create the shared pool on first use.
+    ThreadPool& ThreadPool::GetGlobal(void) {
+        static ThreadPool Global(std::max<std::size_t>(std::thread::hardware_concurrency(), 1) - 1);
+        return Global;
+    }
+
+    // Take tasks from the queue until the pool stops.
+    void ThreadPool::Work(void) {
+        for (;;) {
+            std::function<void(void)> Task;
+            {
+                std::unique_lock<std::mutex> Lock(this->TaskMutex);
+                this->TaskAvailable.wait(Lock, [this](void) -> bool { return this->Stopping || !this->Tasks.empty(); });
+                if (this->Tasks.empty()) return;
+                Task = std::move(this->Tasks.front());
+                this->Tasks.pop_front();
+            }
+            Task();
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_THREADPOOL_HPP
+#define RAYMARCH_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  ThreadPool runs data parallel work on a fixed set of worker threads.
+    class ThreadPool {
+    private:
+        /// @brief  The worker threads.
+        std::vector<std::thread> Workers;
+
+        /// @brief  Queued tasks waiting for a worker.
+        std::deque<std::function<void(void)> > Tasks;
+
+        /// @brief  Mutex protecting the task queue.
+        std::mutex TaskMutex;
+
+        /// @brief  Signalled when a task is queued or the pool is stopping.
+        std::condition_variable TaskAvailable;
+
+        /// @brief  Set when the pool is being destroyed.
+        bool Stopping;
+
+    public:
+        /// @brief  Constructor that starts the worker threads.
+        /// @param  WorkerCount - The number of worker threads, the thread calling ParallelFor also does work.
+        ThreadPool(std::size_t WorkerCount);
+
+        /// @brief  Destructor that finishes queued tasks and joins the worker threads.
+        ~ThreadPool(void);
+
+        /// @brief  Deleted copy constructor.
+        ThreadPool(const ThreadPool&) = delete;
+
+        /// @brief  Deleted copy assignment.
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+    public:
+        /// @brief  Get the number of threads that take part in a parallel for, including the caller.
+        /// @return The number of threads.
+        std::size_t GetThreadCount(void) const;
+
+        /// @brief  Split a range into chunks and process them in parallel, returning once every chunk is done.
+        ///         Chunks start on multiples of the granularity, so callers can align them to bricks or slabs.
+        ///         It is safe to call this from within a chunk.
+        /// @param  Count - The size of the range [0, Count).
+        /// @param  Granularity - The size of each chunk.
+        /// @param  Function - Called with the begin and end of each chunk.
+        void ParallelFor(std::size_t Count, std::size_t Granularity, const std::function<void(std::size_t, std::size_t)>& Function);
+
+    public:
+        /// @brief  Get the shared pool, sized to the hardware on first use.
+        /// @return The shared pool.
+        static ThreadPool& GetGlobal(void);
+
+    private:
+        /// @brief  The worker thread loop.
+        void Work(void);
+    };
+}
+
+#endif // RAYMARCH_THREADPOOL_HPP
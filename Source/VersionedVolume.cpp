@@ -0,0 +1,219 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+#include "VersionedVolume.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace DeferredRasterisation {
+    // Empty bricks read as default constructed voxels.
+    const Voxel VersionedVolume::EmptyVoxel = Voxel();
+
+    // Start without a version.
+    VersionedVolume::Snapshot::Snapshot(void)
+        : Bricks(nullptr)
+        , Size({{0, 0, 0}})
+        , BrickCount({{0, 0, 0}})
+        , Version(0) {
+    }
+
+    // Check for a version.
+    bool VersionedVolume::Snapshot::IsValid(void) const {
+        return this->Bricks != nullptr;
+    }
+
+    // Get the version number.
+    std::uint64_t VersionedVolume::Snapshot::GetVersion(void) const {
+        return this->Version;
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& VersionedVolume::Snapshot::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Copy a row of each brick at a time, leaving the target clear where bricks are empty.
+    void VersionedVolume::Snapshot::CopyTo(Volume& Target) const {
+        assert(this->IsValid());
+        assert(Target.GetSize() == this->Size);
+        Target.Clear();
+        ThreadPool::GetGlobal().ParallelFor(this->BrickCount[2], 1, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t BrickZ = BeginZ; BrickZ < EndZ; ++BrickZ) {
+                for (std::size_t BrickY = 0; BrickY < this->BrickCount[1]; ++BrickY) {
+                    for (std::size_t BrickX = 0; BrickX < this->BrickCount[0]; ++BrickX) {
+                        const std::shared_ptr<const Brick>& Stored = (*this->Bricks)[BrickX + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ)];
+                        if (Stored == nullptr) {
+                            continue;
+                        }
+                        const std::size_t EndX = std::min(BrickSize, this->Size[0] - BrickX * BrickSize);
+                        const std::size_t EndY = std::min(BrickSize, this->Size[1] - BrickY * BrickSize);
+                        const std::size_t EndZ = std::min(BrickSize, this->Size[2] - BrickZ * BrickSize);
+                        for (std::size_t IndexZ = 0; IndexZ < EndZ; ++IndexZ) {
+                            for (std::size_t IndexY = 0; IndexY < EndY; ++IndexY) {
+                                const Voxel* Row = Stored->data() + BrickSize * (IndexY + BrickSize * IndexZ);
+                                std::copy(Row, Row + EndX, &Target.GetWritable(BrickX * BrickSize, BrickY * BrickSize + IndexY, BrickZ * BrickSize + IndexZ));
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // Allocate an empty live version and publish it.
+    VersionedVolume::VersionedVolume(const std::array<std::size_t, 3>& Size)
+        : Size(Size)
+        , BrickCount({{ (Size[0] + BrickSize - 1) / BrickSize, (Size[1] + BrickSize - 1) / BrickSize, (Size[2] + BrickSize - 1) / BrickSize }})
+        , Live(BrickCount[0] * BrickCount[1] * BrickCount[2])
+        , Changed(true) {
+        this->Publish();
+    }
+
+    // Get the size.
+    const std::array<std::size_t, 3>& VersionedVolume::GetSize(void) const {
+        return this->Size;
+    }
+
+    // Copy the brick before handing out a reference into it.
+    Voxel& VersionedVolume::operator()(std::size_t X, std::size_t Y, std::size_t Z) {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        Brick& Writable = this->GetWritableBrick((X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize)));
+        this->Changed = true;
+        return Writable[(X % BrickSize) + BrickSize * ((Y % BrickSize) + BrickSize * (Z % BrickSize))];
+    }
+
+    // Read the live version in place.
+    const Voxel& VersionedVolume::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        const std::shared_ptr<Brick>& Stored = this->Live[(X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize))];
+        if (Stored == nullptr) {
+            return EmptyVoxel;
+        }
+        return (*Stored)[(X % BrickSize) + BrickSize * ((Y % BrickSize) + BrickSize * (Z % BrickSize))];
+    }
+
+    // Release every brick, snapshots keep their own references.
+    void VersionedVolume::Clear(void) {
+        for (std::shared_ptr<Brick>& Stored : this->Live) {
+            Stored.reset();
+        }
+        this->Changed = true;
+    }
+
+    // Gather each brick from the source in parallel, every thread owns the bricks it is given.
+    void VersionedVolume::CopyBricks(const Volume& Source, const std::vector<std::size_t>& Bricks) {
+        assert(Source.GetSize() == this->Size);
+        if (Bricks.empty()) return;
+        ThreadPool::GetGlobal().ParallelFor(Bricks.size(), 16, [&](std::size_t Begin, std::size_t End) {
+            for (std::size_t Entry = Begin; Entry < End; ++Entry) {
+                const std::size_t Index = Bricks[Entry];
+                assert(Index < this->Live.size());
+                const std::size_t BrickX = Index % this->BrickCount[0];
+                const std::size_t BrickY = (Index / this->BrickCount[0]) % this->BrickCount[1];
+                const std::size_t BrickZ = Index / (this->BrickCount[0] * this->BrickCount[1]);
+                const std::size_t EndX = std::min(BrickSize, this->Size[0] - BrickX * BrickSize);
+                const std::size_t EndY = std::min(BrickSize, this->Size[1] - BrickY * BrickSize);
+                const std::size_t EndZ = std::min(BrickSize, this->Size[2] - BrickZ * BrickSize);
+
+                // Leave bricks that are entirely empty unallocated.
+                bool Occupied = false;
+                for (std::size_t IndexZ = 0; (IndexZ < EndZ) && !Occupied; ++IndexZ) {
+                    for (std::size_t IndexY = 0; (IndexY < EndY) && !Occupied; ++IndexY) {
+                        const Voxel* Row = &Source(BrickX * BrickSize, BrickY * BrickSize + IndexY, BrickZ * BrickSize + IndexZ);
+                        for (std::size_t IndexX = 0; (IndexX < EndX) && !Occupied; ++IndexX) {
+                            Occupied = (std::memcmp(&Row[IndexX], &EmptyVoxel, sizeof(Voxel)) != 0);
+                        }
+                    }
+                }
+                if (!Occupied) {
+                    this->Live[Index].reset();
+                    continue;
+                }
+
+                // The whole brick is overwritten, so a brick shared with a snapshot is replaced rather than copied.
+                Brick& Writable = this->GetReplacedBrick(Index);
+                for (std::size_t IndexZ = 0; IndexZ < EndZ; ++IndexZ) {
+                    for (std::size_t IndexY = 0; IndexY < EndY; ++IndexY) {
+                        const Voxel* Row = &Source(BrickX * BrickSize, BrickY * BrickSize + IndexY, BrickZ * BrickSize + IndexZ);
+                        std::copy(Row, Row + EndX, Writable.data() + BrickSize * (IndexY + BrickSize * IndexZ));
+                    }
+                }
+            }
+        });
+        this->Changed = true;
+    }
+
+    // Share the live bricks with a new immutable table, so the next write to each brick copies it.
+    VersionedVolume::Snapshot VersionedVolume::Publish(void) {
+        std::lock_guard<std::mutex> Lock(this->PublishedMutex);
+        if (this->Changed) {
+            Snapshot Next;
+            Next.Bricks = std::make_shared<const std::vector<std::shared_ptr<const Brick> > >(this->Live.begin(), this->Live.end());
+            Next.Size = this->Size;
+            Next.BrickCount = this->BrickCount;
+            Next.Version = this->Published.IsValid() ? this->Published.Version + 1 : 0;
+            this->Published = std::move(Next);
+            this->Changed = false;
+        }
+        return this->Published;
+    }
+
+    // Copy the last published version under the lock.
+    VersionedVolume::Snapshot VersionedVolume::Acquire(void) const {
+        std::lock_guard<std::mutex> Lock(this->PublishedMutex);
+        return this->Published;
+    }
+
+    // A brick only the live version refers to can be written in place, anything else is copied first.
+    VersionedVolume::Brick& VersionedVolume::GetWritableBrick(std::size_t Index) {
+        std::shared_ptr<Brick>& Stored = this->Live[Index];
+        if (Stored == nullptr) {
+            Stored = std::make_shared<Brick>();
+            std::fill(Stored->begin(), Stored->end(), EmptyVoxel);
+        }
+        else if (Stored.use_count() > 1) {
+            Stored = std::make_shared<Brick>(*Stored);
+        }
+        else {
+            // The last reader may have just released the brick on another thread, order its reads before these writes.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *Stored;
+    }
+
+    // Allocate a new brick unless the live brick is already unshared, either way the voxels outside the volume are empty.
+    VersionedVolume::Brick& VersionedVolume::GetReplacedBrick(std::size_t Index) {
+        std::shared_ptr<Brick>& Stored = this->Live[Index];
+        if ((Stored == nullptr) || (Stored.use_count() > 1)) {
+            Stored = std::make_shared<Brick>();
+        }
+        else {
+            // The last reader may have just released the brick on another thread, order its reads before these writes.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *Stored;
+    }
+}
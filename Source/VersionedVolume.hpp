@@ -0,0 +1,217 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+#pragma once
+#ifndef RAYMARCH_VERSIONEDVOLUME_HPP
+#define RAYMARCH_VERSIONEDVOLUME_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  VersionedVolume is a volume with copy on write, brick granular snapshots.
+    ///         One writer thread mutates the live version and publishes it, any number of reader threads acquire immutable snapshots of the last published version.
+    ///         Bricks are shared between the live version and every snapshot until the writer changes them, only the changed bricks are copied.
+    ///         A version, and every brick only it refers to, is released when its last snapshot is dropped.
+    class VersionedVolume {
+    public:
+        /// @brief  A brick of voxels, stored X fastest then Y then Z.
+        typedef std::array<Voxel, BrickVolume> Brick;
+
+        /// @brief  Snapshot is an immutable view of one published version, safe to read from any thread.
+        class Snapshot {
+        private:
+            friend class VersionedVolume;
+
+            /// @brief  The bricks of the version in linear order, null for bricks that are entirely empty.
+            std::shared_ptr<const std::vector<std::shared_ptr<const Brick> > > Bricks;
+            /// @brief  The size of the volume.
+            std::array<std::size_t, 3> Size;
+            /// @brief  The number of bricks along each axis.
+            std::array<std::size_t, 3> BrickCount;
+            /// @brief  The version number.
+            std::uint64_t Version;
+
+        public:
+            /// @brief  Constructor that creates a snapshot of nothing.
+            Snapshot(void);
+
+        public:
+            /// @brief  Test if the snapshot refers to a version.
+            /// @return True if the snapshot refers to a version.
+            bool IsValid(void) const;
+
+            /// @brief  Get the version number, each publish that changed something increases it.
+            /// @return The version number.
+            std::uint64_t GetVersion(void) const;
+
+            /// @brief  Get the size of the volume.
+            /// @return Array of X, Y, Z dimensions.
+            const std::array<std::size_t, 3>& GetSize(void) const;
+
+            /// @brief  Voxel accessor.
+            /// @param  X - The X coordinate of the voxel.
+            /// @param  Y - The Y coordinate of the voxel.
+            /// @param  Z - The Z coordinate of the voxel.
+            /// @return Constant reference to the voxel, or to an empty voxel if its brick is empty.
+            const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+            /// @brief  Visit every voxel of every brick that is not entirely empty, a brick at a time.
+            /// @param  Function - Called with the X, Y, Z coordinates and a constant reference to each voxel.
+            template <typename FunctionType>
+            void ForEach(FunctionType&& Function) const;
+
+            /// @brief  Copy the snapshot into a volume of the same size, for work that needs a plain volume such as saving.
+            /// @param  Target - The volume to copy into.
+            void CopyTo(Volume& Target) const;
+        };
+
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+        /// @brief  The bricks of the live version, null for bricks that are entirely empty.
+        std::vector<std::shared_ptr<Brick> > Live;
+        /// @brief  Set when the live version differs from the last published version.
+        bool Changed;
+        /// @brief  The last published version.
+        Snapshot Published;
+        /// @brief  Mutex protecting the last published version.
+        mutable std::mutex PublishedMutex;
+
+        /// @brief  The voxel returned for positions in empty bricks.
+        static const Voxel EmptyVoxel;
+
+    public:
+        /// @brief  Constructor that creates an empty volume and publishes it as version zero.
+        /// @param  Size - The size of the volume.
+        VersionedVolume(const std::array<std::size_t, 3>& Size);
+
+        /// @brief  Deleted copy constructor, readers share a volume through snapshots.
+        VersionedVolume(const VersionedVolume&) = delete;
+
+        /// @brief  Deleted copy assignment operator, readers share a volume through snapshots.
+        VersionedVolume& operator=(const VersionedVolume&) = delete;
+
+    public:
+        /// @brief  Get the size of the volume.
+        /// @return Array of X, Y, Z dimensions.
+        const std::array<std::size_t, 3>& GetSize(void) const;
+
+    public:
+        /// @brief  Writer voxel accessor, copies the brick first if a snapshot shares it.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return Reference to the voxel in the live version.
+        Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z);
+
+        /// @brief  Writer voxel accessor that does not copy.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return Constant reference to the voxel in the live version.
+        const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+
+        /// @brief  Set every voxel to empty, releasing every brick of the live version.
+        void Clear(void);
+
+        /// @brief  Copy bricks of a volume of the same size into the live version, typically the bricks drained from its dirty cursor.
+        ///         Bricks that are entirely empty are released rather than stored.
+        /// @param  Source - The volume to copy from.
+        /// @param  Bricks - The linear indices of the bricks to copy.
+        void CopyBricks(const Volume& Source, const std::vector<std::size_t>& Bricks);
+
+    public:
+        /// @brief  Make the live version visible to readers, called by the writer.
+        ///         Publishing without changes keeps the current version.
+        /// @return The published snapshot.
+        Snapshot Publish(void);
+
+        /// @brief  Get the last published version, safe to call from any thread.
+        /// @return The snapshot.
+        Snapshot Acquire(void) const;
+
+    private:
+        /// @brief  Get a brick of the live version that no snapshot shares, copying or allocating it as needed.
+        ///         Safe to call for different bricks from several threads, the caller marks the version as changed.
+        /// @param  Index - The linear index of the brick.
+        /// @return The brick.
+        Brick& GetWritableBrick(std::size_t Index);
+
+        /// @brief  Get a brick of the live version that no snapshot shares, for a caller that overwrites the whole brick, a shared brick is replaced by a new empty brick rather than copied.
+        ///         Safe to call for different bricks from several threads, the caller marks the version as changed.
+        /// @param  Index - The linear index of the brick.
+        /// @return The brick, its voxels outside the volume are empty.
+        Brick& GetReplacedBrick(std::size_t Index);
+    };
+
+    // Look up the brick, then the voxel within the brick.
+    inline const Voxel& VersionedVolume::Snapshot::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(this->IsValid());
+        assert(X < this->Size[0] && Y < this->Size[1] && Z < this->Size[2]);
+        const std::shared_ptr<const Brick>& Stored = (*this->Bricks)[(X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize))];
+        if (Stored == nullptr) {
+            return EmptyVoxel;
+        }
+        return (*Stored)[(X % BrickSize) + BrickSize * ((Y % BrickSize) + BrickSize * (Z % BrickSize))];
+    }
+
+    // Walk the stored bricks in linear order, clipping bricks at the far edges.
+    template <typename FunctionType>
+    void VersionedVolume::Snapshot::ForEach(FunctionType&& Function) const {
+        assert(this->IsValid());
+        std::size_t Index = 0;
+        for (std::size_t BrickZ = 0; BrickZ < this->BrickCount[2]; ++BrickZ) {
+            for (std::size_t BrickY = 0; BrickY < this->BrickCount[1]; ++BrickY) {
+                for (std::size_t BrickX = 0; BrickX < this->BrickCount[0]; ++BrickX, ++Index) {
+                    const std::shared_ptr<const Brick>& Stored = (*this->Bricks)[Index];
+                    if (Stored == nullptr) {
+                        continue;
+                    }
+                    const std::size_t EndX = std::min(BrickSize, this->Size[0] - BrickX * BrickSize);
+                    const std::size_t EndY = std::min(BrickSize, this->Size[1] - BrickY * BrickSize);
+                    const std::size_t EndZ = std::min(BrickSize, this->Size[2] - BrickZ * BrickSize);
+                    for (std::size_t IndexZ = 0; IndexZ < EndZ; ++IndexZ) {
+                        for (std::size_t IndexY = 0; IndexY < EndY; ++IndexY) {
+                            const Voxel* Row = Stored->data() + BrickSize * (IndexY + BrickSize * IndexZ);
+                            for (std::size_t IndexX = 0; IndexX < EndX; ++IndexX) {
+                                Function(BrickX * BrickSize + IndexX, BrickY * BrickSize + IndexY, BrickZ * BrickSize + IndexZ, Row[IndexX]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif // RAYMARCH_VERSIONEDVOLUME_HPP
@@ -24,83 +24,229 @@ THE SOFTWARE
 
 #include "Volume.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <utility>
 
 namespace DeferredRasterisation {
-    // Construct and allocate a volume of a given size.
-    Volume::Volume(const std::array<std::size_t, 3>& Size)
-        : Size(Size)
-        , Data(Size[0] * Size[1] * Size[2]) {
+    // Construct a volume with no voxels.
+    template <typename IndexingType>
+    BasicVolume<IndexingType>::BasicVolume(void)
+        : BasicVolume(0, 0, 0) {
     }
 
     // Construct and allocate a volume of a given size.
-    Volume::Volume(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ)
+    template <typename IndexingType>
+    BasicVolume<IndexingType>::BasicVolume(const std::array<std::size_t, 3>& Size)
+        : BasicVolume(Size[0], Size[1], Size[2]) {
+    }
+
+    // Construct and allocate a volume of a given size, every brick is new so every brick starts changed.
+    template <typename IndexingType>
+    BasicVolume<IndexingType>::BasicVolume(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ)
         : Size{{SizeX, SizeY, SizeZ}}
-        , Data(Size[0] * Size[1] * Size[2]) {
+        , Data(IndexingType::GetAllocation(Size))
+        , BrickCount{{(SizeX + BrickSize - 1) / BrickSize, (SizeY + BrickSize - 1) / BrickSize, (SizeZ + BrickSize - 1) / BrickSize}}
+        , BrickStamps(BrickCount[0] * BrickCount[1] * BrickCount[2])
+        , Epoch(GetNextEpoch()) {
+        std::fill(this->BrickStamps.begin(), this->BrickStamps.end(), this->Epoch);
+    }
+
+    // Copy the voxels of another volume, the stamps of the other volume are from its own history so every brick is stamped again.
+    template <typename IndexingType>
+    BasicVolume<IndexingType>& BasicVolume<IndexingType>::operator=(const BasicVolume& Other) {
+        if (this != &Other) {
+            this->Size = Other.Size;
+            this->Data = Other.Data;
+            this->BrickCount = Other.BrickCount;
+        }
+        this->Epoch = GetNextEpoch();
+        this->BrickStamps.assign(this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2], this->Epoch);
+        return *this;
+    }
+
+    // Take the voxels of another volume, every brick is stamped again.
+    template <typename IndexingType>
+    BasicVolume<IndexingType>& BasicVolume<IndexingType>::operator=(BasicVolume&& Other) {
+        if (this != &Other) {
+            this->Size = Other.Size;
+            this->Data = std::move(Other.Data);
+            this->BrickCount = Other.BrickCount;
+            Other.Size = {{0, 0, 0}};
+            Other.Data.clear();
+            Other.BrickCount = {{0, 0, 0}};
+            Other.BrickStamps.clear();
+        }
+        this->Epoch = GetNextEpoch();
+        this->BrickStamps.assign(this->BrickCount[0] * this->BrickCount[1] * this->BrickCount[2], this->Epoch);
+        return *this;
     }
 
     // Get the volume size.
-    const std::array<std::size_t, 3> Volume::GetSize(void) const {
+    template <typename IndexingType>
+    const std::array<std::size_t, 3> BasicVolume<IndexingType>::GetSize(void) const {
         return this->Size;
     }
 
     // Get the volume width.
-    std::size_t Volume::GetSizeX(void) const {
+    template <typename IndexingType>
+    std::size_t BasicVolume<IndexingType>::GetSizeX(void) const {
         return this->Size[0];
     }
 
     // Get the volume height.
-    std::size_t Volume::GetSizeY(void) const {
+    template <typename IndexingType>
+    std::size_t BasicVolume<IndexingType>::GetSizeY(void) const {
         return this->Size[1];
     }
 
     // Get the volume depth.
-    std::size_t Volume::GetSizeZ(void) const {
+    template <typename IndexingType>
+    std::size_t BasicVolume<IndexingType>::GetSizeZ(void) const {
         return this->Size[2];
     }
 
-    // Get a voxel from within the volume.
-    Voxel& Volume::operator()(std::size_t X, std::size_t Y, std::size_t Z) {
-        assert(X < this->Size[0]);
-        assert(Y < this->Size[1]);
-        assert(Z < this->Size[2]);
-        return this->Data[X + this->Size[0] * (Y + this->Size[1] * (Z))];
+    // Get the brick counts.
+    template <typename IndexingType>
+    const std::array<std::size_t, 3>& BasicVolume<IndexingType>::GetBrickCount(void) const {
+        return this->BrickCount;
+    }
+
+    // Stamp every brick the box overlaps.
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::MarkDirty(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End) {
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            assert(Begin[Axis] <= End[Axis]);
+            assert(End[Axis] <= this->Size[Axis]);
+            if (Begin[Axis] == End[Axis]) return;
+        }
+        for (std::size_t BrickZ = Begin[2] / BrickSize; BrickZ <= (End[2] - 1) / BrickSize; ++BrickZ) {
+            for (std::size_t BrickY = Begin[1] / BrickSize; BrickY <= (End[1] - 1) / BrickSize; ++BrickY) {
+                std::uint64_t* Row = this->BrickStamps.data() + this->BrickCount[0] * (BrickY + this->BrickCount[1] * BrickZ);
+                std::fill(Row + Begin[0] / BrickSize, Row + (End[0] - 1) / BrickSize + 1, this->Epoch);
+            }
+        }
+    }
+
+    // Collect the bricks stamped since the cursor, then move to a new epoch so later writes are newer than the cursor.
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::Drain(DirtyCursor& Cursor, std::vector<std::size_t>& Bricks) const {
+        Bricks.clear();
+        for (std::size_t Brick = 0; Brick < this->BrickStamps.size(); ++Brick) {
+            if (this->BrickStamps[Brick] >= Cursor.Epoch) {
+                Bricks.push_back(Brick);
+            }
+        }
+        this->Epoch = GetNextEpoch();
+        Cursor.Epoch = this->Epoch;
     }
 
-    // Get a voxel from within the volume.
-    const Voxel& Volume::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
-        return const_cast<Volume*>(this)->operator()(X, Y, Z);
+    // Look for any brick stamped since the cursor.
+    template <typename IndexingType>
+    bool BasicVolume<IndexingType>::IsDirty(const DirtyCursor& Cursor) const {
+        return std::any_of(this->BrickStamps.begin(), this->BrickStamps.end(), [&Cursor](std::uint64_t Stamp) { return Stamp >= Cursor.Epoch; });
     }
 
     // Get the volume data.
-    const Voxel* Volume::data(void) const {
+    template <typename IndexingType>
+    const Voxel* BasicVolume<IndexingType>::data(void) const {
         return this->Data.data();
     }
 
     // Clear the volume to empty voxels.
-    void Volume::Clear(void) {
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::Clear(void) {
         this->Fill(Voxel());
     }
 
-    // Fill the volume with voxels of the given type.
-    void Volume::Fill(Voxel Value) {
-        std::fill(this->Data.begin(), this->Data.end(), Value);
+    // Fill the volume with voxels of the given type, a row at a time so only bricks that change are stamped.
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::Fill(Voxel Value) {
+        for (std::size_t IndexZ = 0; IndexZ < this->Size[2]; ++IndexZ) {
+            for (std::size_t IndexY = 0; IndexY < this->Size[1]; ++IndexY) {
+                this->FillRow(0, this->Size[0], IndexY, IndexZ, Value);
+            }
+        }
     }
 
-    // Copy a source volume into this volume.
-    void Volume::Insert(int X, int Y, int Z, Volume Source) {
-        for (std::size_t IndexX = 0; IndexX < Source.Size[0]; ++IndexX) {
-            if (X + static_cast<int>(IndexX) < 0) continue;
-            if (X + IndexX >= this->Size[0]) break;
-            for (std::size_t IndexY = 0; IndexY < Source.Size[1]; ++IndexY) {
-                if (Y + static_cast<int>(IndexY) < 0) continue;
-                if (Y + IndexY >= this->Size[1]) break;
-                for (std::size_t IndexZ = 0; IndexZ < Source.Size[2]; ++IndexZ) {
-                    if (Z + static_cast<int>(IndexZ) < 0) continue;
-                    if (Z + IndexZ >= this->Size[2]) break;
-                    this->operator()(X + IndexX, Y + IndexY, Z + IndexZ) = Source(IndexX, IndexY, IndexZ);
+    // Fill part of a row with voxels of the given type.
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::FillRow(std::size_t BeginX, std::size_t EndX, std::size_t Y, std::size_t Z, Voxel Value) {
+        assert(BeginX <= EndX);
+        assert(EndX <= this->Size[0]);
+        auto Differs = [&Value](const Voxel& Other) -> bool { return std::memcmp(&Other, &Value, sizeof(Voxel)) != 0; };
+        if constexpr (IndexingType::ContiguousRows) {
+            // Split the span at brick boundaries, each part is only written and stamped if it changes.
+            for (std::size_t First = BeginX; First < EndX;) {
+                const std::size_t Last = std::min(EndX, (First / BrickSize + 1) * BrickSize);
+                const Voxel* Row = &(*this)(First, Y, Z);
+                if (std::any_of(Row, Row + (Last - First), Differs)) {
+                    Voxel* WritableRow = &this->GetWritable(First, Y, Z);
+                    std::fill(WritableRow, WritableRow + (Last - First), Value);
+                }
+                First = Last;
+            }
+        }
+        else {
+            for (std::size_t X = BeginX; X < EndX; ++X) {
+                if (Differs((*this)(X, Y, Z))) {
+                    this->Set(X, Y, Z, Value);
                 }
             }
         }
     }
+
+    // Copy a source volume into this volume, only bricks that change are stamped.
+    template <typename IndexingType>
+    void BasicVolume<IndexingType>::Insert(int X, int Y, int Z, const BasicVolume& Source) {
+        // Clip the source to the bounds of this volume.
+        const int Offset[3] = { X, Y, Z };
+        std::size_t Begin[3];
+        std::size_t End[3];
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            const int First = std::max(0, -Offset[Axis]);
+            const int Last = std::min(static_cast<int>(Source.Size[Axis]), static_cast<int>(this->Size[Axis]) - Offset[Axis]);
+            if (First >= Last) return;
+            Begin[Axis] = static_cast<std::size_t>(First);
+            End[Axis] = static_cast<std::size_t>(Last);
+        }
+
+        // Walk the overlap with X innermost so both volumes are read in storage order.
+        for (std::size_t IndexZ = Begin[2]; IndexZ < End[2]; ++IndexZ) {
+            for (std::size_t IndexY = Begin[1]; IndexY < End[1]; ++IndexY) {
+                if constexpr (IndexingType::ContiguousRows) {
+                    // Split each row at the brick boundaries of this volume, and copy only the parts that differ.
+                    for (std::size_t First = Begin[0]; First < End[0];) {
+                        const std::size_t Last = std::min(End[0], ((X + First) / BrickSize + 1) * BrickSize - X);
+                        const Voxel* SourceRow = &Source(First, IndexY, IndexZ);
+                        if (std::memcmp(SourceRow, &(*this)(X + First, Y + IndexY, Z + IndexZ), (Last - First) * sizeof(Voxel)) != 0) {
+                            std::copy(SourceRow, SourceRow + (Last - First), &this->GetWritable(X + First, Y + IndexY, Z + IndexZ));
+                        }
+                        First = Last;
+                    }
+                }
+                else {
+                    for (std::size_t IndexX = Begin[0]; IndexX < End[0]; ++IndexX) {
+                        const Voxel& Value = Source(IndexX, IndexY, IndexZ);
+                        if (std::memcmp(&Value, &(*this)(X + IndexX, Y + IndexY, Z + IndexZ), sizeof(Voxel)) != 0) {
+                            this->Set(X + IndexX, Y + IndexY, Z + IndexZ, Value);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Epochs are shared by every volume of an indexing policy, so a volume replaced by another still reports every brick to existing cursors.
+    template <typename IndexingType>
+    std::uint64_t BasicVolume<IndexingType>::GetNextEpoch(void) {
+        static std::atomic<std::uint64_t> Counter(1);
+        return Counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Instantiate both layouts.
+    template class BasicVolume<LinearIndexing>;
+    template class BasicVolume<MortonIndexing>;
 }
@@ -27,14 +27,34 @@ THE SOFTWARE
 #define RAYMARCH_VOLUME_HPP
 
 #include "Voxel.hpp"
+#include "VolumeIndexing.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdint>
 #include <vector>
 
 namespace DeferredRasterisation {
-    /// @brief  Volume holds a voxel volume.
-    class Volume {
+    /// @brief  DirtyCursor is one consumer's position in the change history of a volume.
+    ///         A default constructed cursor has seen nothing, so its first drain reports every brick.
+    struct DirtyCursor {
+        /// @brief  Bricks stamped at or after this epoch have not been seen.
+        std::uint64_t Epoch = 0;
+    };
+
+    /// @brief  BasicVolume holds a voxel volume, stored in the order chosen by an indexing policy.
+    ///         Every mutating path stamps the bricks it touches, so consumers can drain just the bricks that changed.
+    ///         Clear, Fill, FillRow and Insert compare before writing, and only touch bricks whose voxels change.
+    ///         Reads through operator() never stamp, single voxels are written through Set or GetWritable.
+    ///         Writers on several threads must write disjoint bricks, which slabs of brick depth along Z already are.
+    /// @tparam IndexingType - The indexing policy, LinearIndexing or MortonIndexing.
+    template <typename IndexingType>
+    class BasicVolume {
+    public:
+        /// @brief  The indexing policy of this volume.
+        typedef IndexingType Indexing;
+
     private:
         /// @brief  Size of the volume.
         std::array<std::size_t, 3> Size;
@@ -42,19 +62,44 @@ namespace DeferredRasterisation {
         /// @brief  The volume data.
         std::vector<Voxel> Data;
 
+        /// @brief  The number of bricks along each axis.
+        std::array<std::size_t, 3> BrickCount;
+
+        /// @brief  The epoch of the last write to each brick, in linear brick order.
+        std::vector<std::uint64_t> BrickStamps;
+
+        /// @brief  The epoch stamped by writes, advanced by every drain so later writes are newer than any cursor.
+        mutable std::uint64_t Epoch;
+
     public:
-        /// @brief  Defaulted constructor.
-        Volume(void) = default;
+        /// @brief  Constructor that creates an empty volume of no size.
+        BasicVolume(void);
 
         /// @brief  Constructor that allocates an empty volume.
         /// @param  Size - The size of the volume to allocate.
-        Volume(const std::array<std::size_t, 3>& Size);
+        BasicVolume(const std::array<std::size_t, 3>& Size);
 
         /// @brief  Constructor that allocates an empty volume.
         /// @param  SizeX - The width of the volume.
         /// @param  SizeY - The height of the volume.
         /// @param  SizeZ - The depth of the volume.
-        Volume(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ);
+        BasicVolume(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ);
+
+        /// @brief  Copy constructor.
+        BasicVolume(const BasicVolume&) = default;
+
+        /// @brief  Move constructor.
+        BasicVolume(BasicVolume&&) = default;
+
+        /// @brief  Copy assignment operator, every brick is stamped as changed so every cursor sees the replaced contents.
+        /// @param  Other - The volume to copy.
+        /// @return Reference to this volume.
+        BasicVolume& operator=(const BasicVolume& Other);
+
+        /// @brief  Move assignment operator, every brick is stamped as changed so every cursor sees the replaced contents.
+        /// @param  Other - The volume to move from.
+        /// @return Reference to this volume.
+        BasicVolume& operator=(BasicVolume&& Other);
 
     public:
         /// @brief  Get the size of the allocated volume.
@@ -73,25 +118,67 @@ namespace DeferredRasterisation {
         /// @return The depth of the volume.
         std::size_t GetSizeZ(void) const;
 
+        /// @brief  Get the number of bricks along each axis, used to decode the brick indices reported by Drain.
+        /// @return The brick counts, a brick index is X + CountX * (Y + CountY * Z).
+        const std::array<std::size_t, 3>& GetBrickCount(void) const;
+
+    public:
+        /// @brief  Mark a box of voxels as changed, for callers that write through a pointer into the data.
+        /// @param  Begin - The first voxel of the box.
+        /// @param  End - One past the last voxel of the box, must be within the volume.
+        void MarkDirty(const std::array<std::size_t, 3>& Begin, const std::array<std::size_t, 3>& End);
+
+        /// @brief  Get the bricks changed since a cursor last drained, then advance the cursor.
+        ///         Each consumer keeps its own cursor, draining one does not affect any other.
+        ///         Drains must not run at the same time as writes or other drains.
+        /// @param  Cursor - The cursor of the consumer.
+        /// @param  Bricks - Output for the indices of the changed bricks in ascending order, cleared first.
+        void Drain(DirtyCursor& Cursor, std::vector<std::size_t>& Bricks) const;
+
+        /// @brief  Test if any brick changed since a cursor last drained, without advancing it.
+        /// @param  Cursor - The cursor of the consumer.
+        /// @return True if a drain would report at least one brick.
+        bool IsDirty(const DirtyCursor& Cursor) const;
+
     public:
-        /// @brief  Get a voxel within this volume.
+        /// @brief  Get a voxel within this volume, reading never marks a brick as changed.
         /// @param  X - The X coordinate within this volume to get.
         /// @param  Y - The Y coordinate within this volume to get.
         /// @param  Z - The Z coordinate within this volume to get.
-        /// @return A reference to a voxel within this volume.
-        Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z);
+        /// @return A const reference to a voxel within this volume.
+        const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
 
-        /// @brief  Get a voxel within this volume.
+        /// @brief  Get a voxel within this volume to write to, its brick is marked as changed even if nothing is written.
         /// @param  X - The X coordinate within this volume to get.
         /// @param  Y - The Y coordinate within this volume to get.
         /// @param  Z - The Z coordinate within this volume to get.
-        /// @return A const reference to a voxel within this volume.
-        const Voxel& operator()(std::size_t X, std::size_t Y, std::size_t Z) const;
+        /// @return A reference to a voxel within this volume.
+        Voxel& GetWritable(std::size_t X, std::size_t Y, std::size_t Z);
+
+        /// @brief  Set a voxel within this volume, its brick is marked as changed.
+        /// @param  X - The X coordinate within this volume to set.
+        /// @param  Y - The Y coordinate within this volume to set.
+        /// @param  Z - The Z coordinate within this volume to set.
+        /// @param  Value - The voxel to store.
+        void Set(std::size_t X, std::size_t Y, std::size_t Z, Voxel Value);
 
     public:
-        /// @brief  Get a pointer to the data in this volume.
+        /// @brief  Visit every voxel in storage order, which is the fastest way to walk the whole volume.
+        ///         Every brick is marked as changed.
+        /// @param  Function - Called with the X, Y, Z coordinates and a reference to each voxel.
+        template <typename FunctionType>
+        void ForEach(FunctionType&& Function);
+
+        /// @brief  Visit every voxel in storage order, which is the fastest way to walk the whole volume.
+        /// @param  Function - Called with the X, Y, Z coordinates and a const reference to each voxel.
+        template <typename FunctionType>
+        void ForEach(FunctionType&& Function) const;
+
+    public:
+        /// @brief  Get a pointer to the data in this volume, the layout is defined by the indexing policy.
         /// @return A const pointer to the data in the volume.
         const Voxel* data(void) const;
+
     public:
         /// @brief  Clear the volume, set all voxels to empty.
         void Clear(void);
@@ -100,13 +187,83 @@ namespace DeferredRasterisation {
         /// @param  Value - The voxel type used to fill the volume.
         void Fill(Voxel Value);
 
+        /// @brief  Fill a span of a row along the X axis, set all voxels in the span to a given type.
+        /// @param  BeginX - The first X coordinate of the span.
+        /// @param  EndX - One past the last X coordinate of the span.
+        /// @param  Y - The Y coordinate of the row.
+        /// @param  Z - The Z coordinate of the row.
+        /// @param  Value - The voxel type used to fill the span.
+        void FillRow(std::size_t BeginX, std::size_t EndX, std::size_t Y, std::size_t Z, Voxel Value);
+
         /// @brief  Combine this volume with another source.
         /// @param  X - The X location to position the source volume within this volume.
         /// @param  Y - The Y location to position the source volume within this volume.
         /// @param  Z - The Z location to position the source volume within this volume.
         /// @param  Source - The source volume to write into this volume.
-        void Insert(int X, int Y, int Z, Volume Source);
+        void Insert(int X, int Y, int Z, const BasicVolume& Source);
+
+    private:
+        /// @brief  Get a new epoch, greater than every epoch handed out before by any volume.
+        /// @return The epoch.
+        static std::uint64_t GetNextEpoch(void);
 	};
+
+    /// @brief  Volume is the default X-major linear volume.
+    typedef BasicVolume<LinearIndexing> Volume;
+
+    /// @brief  MortonVolume stores bricks with Z-curve order inside each brick, so every 2x2x2 cell is contiguous.
+    ///         The engine keeps to Volume, Benchmark/VolumeIndexing.cpp measured this layout slower for surface detection, light and downsampling.
+    typedef BasicVolume<MortonIndexing> MortonVolume;
+
+    // The voxel accessors are defined here so they can be inlined into callers.
+    template <typename IndexingType>
+    inline const Voxel& BasicVolume<IndexingType>::operator()(std::size_t X, std::size_t Y, std::size_t Z) const {
+        assert(X < this->Size[0]);
+        assert(Y < this->Size[1]);
+        assert(Z < this->Size[2]);
+        return this->Data[IndexingType::GetIndex(this->Size, X, Y, Z)];
+    }
+
+    template <typename IndexingType>
+    inline Voxel& BasicVolume<IndexingType>::GetWritable(std::size_t X, std::size_t Y, std::size_t Z) {
+        assert(X < this->Size[0]);
+        assert(Y < this->Size[1]);
+        assert(Z < this->Size[2]);
+        // Only store a stamp that differs, runs of writes to one brick then only read it.
+        std::uint64_t& Stamp = this->BrickStamps[(X / BrickSize) + this->BrickCount[0] * ((Y / BrickSize) + this->BrickCount[1] * (Z / BrickSize))];
+        if (Stamp != this->Epoch) {
+            Stamp = this->Epoch;
+        }
+        return this->Data[IndexingType::GetIndex(this->Size, X, Y, Z)];
+    }
+
+    template <typename IndexingType>
+    inline void BasicVolume<IndexingType>::Set(std::size_t X, std::size_t Y, std::size_t Z, Voxel Value) {
+        this->GetWritable(X, Y, Z) = Value;
+    }
+
+    template <typename IndexingType>
+    template <typename FunctionType>
+    void BasicVolume<IndexingType>::ForEach(FunctionType&& Function) {
+        std::fill(this->BrickStamps.begin(), this->BrickStamps.end(), this->Epoch);
+        Voxel* Voxels = this->Data.data();
+        IndexingType::ForEach(this->Size, [&](std::size_t X, std::size_t Y, std::size_t Z, std::size_t Index) {
+            Function(X, Y, Z, Voxels[Index]);
+        });
+    }
+
+    template <typename IndexingType>
+    template <typename FunctionType>
+    void BasicVolume<IndexingType>::ForEach(FunctionType&& Function) const {
+        const Voxel* Voxels = this->Data.data();
+        IndexingType::ForEach(this->Size, [&](std::size_t X, std::size_t Y, std::size_t Z, std::size_t Index) {
+            Function(X, Y, Z, Voxels[Index]);
+        });
+    }
+
+    // The remaining members are instantiated in Volume.cpp.
+    extern template class BasicVolume<LinearIndexing>;
+    extern template class BasicVolume<MortonIndexing>;
 }
 
 #endif // RAYMARCH_VOLUME_HPP
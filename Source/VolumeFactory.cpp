@@ -23,9 +23,14 @@ THE SOFTWARE
 */
 
 #include "VolumeFactory.hpp"
+#include "CounterRandom.hpp"
+#include "Noise.hpp"
+#include "ThreadPool.hpp"
 
+#include <algorithm>
 #include <cassert>
-#include <random>
+#include <cmath>
+#include <vector>
 
 namespace DeferredRasterisation {
     // Create a solid cuboid volume all set to the same voxel type.
@@ -53,52 +58,134 @@ namespace DeferredRasterisation {
         // Helper function to square values.
         auto Square = [](double Value) -> double { return Value * Value; };
 
-        // Loop over all voxels of the volume and fill them if they are within the ellipsoid.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                const double PartialY = Square((static_cast<double>(IndexY) - RadiusY) / RadiusY);
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
-                    const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
-
-                    // Evaluate the ellipsoid equation.
-                    if (PartialX + PartialY + PartialZ < 1.0) {
-                        Ellipsoid(IndexX, IndexY, IndexZ) = Value;
-                    }
+        // Generate slabs of brick depth in parallel, filling the span of each row that lies within the ellipsoid.
+        ThreadPool::GetGlobal().ParallelFor(SizeZ, BrickSize, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    const double PartialY = Square((static_cast<double>(IndexY) - RadiusY) / RadiusY);
+
+                    // Solve the ellipsoid equation for X, then refine with the exact test.
+                    const double Remainder = 1.0 - PartialY - PartialZ;
+                    const double HalfWidth = (Remainder > 0.0) ? RadiusX * std::sqrt(Remainder) : 0.0;
+                    const std::array<std::size_t, 2> Span = GetRowSpan(SizeX, RadiusX, HalfWidth, [&](std::size_t IndexX) -> bool {
+                        const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
+                        return PartialX + PartialY + PartialZ < 1.0;
+                    });
+                    Ellipsoid.FillRow(Span[0], Span[1], IndexY, IndexZ, Value);
                 }
             }
-        }
+        });
 
         // Return.
         return Ellipsoid;
     }
 
     // Create a sponge cubeoid by randomly setting positions in the cuboid.
-    Volume VolumeFactory::CreateRandomSponge(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Density, Voxel Value) {
-        assert(Density >= 0 && Density <= 1);
-
+    Volume VolumeFactory::CreateRandomSponge(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Density, std::uint64_t Seed, Voxel Value) {
         // Allocate the volume.
         DeferredRasterisation::Volume Sponge = DeferredRasterisation::Volume(SizeX, SizeY, SizeZ);
 
-        // Create a random generator.
-        std::default_random_engine RandomGenerator;
-        RandomGenerator.seed(std::random_device()());
-        std::uniform_real_distribution<double> RandomDistribution(0, 1);
-
-        // Loop over all voxels of the volume and fill them randomly.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
-                    // Evalueate the random function.
-                    if (RandomDistribution(RandomGenerator) < Density) {
-                        Sponge(IndexX, IndexY, IndexZ) = Value;
+        // Fill the whole sponge.
+        FillRandomSponge(Sponge, {{0, 0, 0}}, Density, Seed, Value);
+
+        // Return.
+        return Sponge;
+    }
+
+    // Fill part of a sponge, samples are taken at the position within the whole sponge.
+    void VolumeFactory::FillRandomSponge(Volume& Target, const std::array<std::size_t, 3>& Origin, double Density, std::uint64_t Seed, Voxel Value) {
+        assert(Density >= 0 && Density <= 1);
+
+        const std::size_t SizeX = Target.GetSizeX();
+        const std::size_t SizeY = Target.GetSizeY();
+        const std::size_t SizeZ = Target.GetSizeZ();
+
+        // A voxel is filled when its 32 bit sample is below the density threshold.
+        const std::uint64_t Threshold = static_cast<std::uint64_t>(std::ldexp(Density, 32));
+
+        // Generate slabs of brick depth in parallel, drawing a row of samples at a time.
+        ThreadPool::GetGlobal().ParallelFor(SizeZ, BrickSize, [&](std::size_t BeginZ, std::size_t EndZ) {
+            std::uint32_t Samples[256];
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
+                    const std::uint32_t RowKey = CounterRandom::GetRowKey(Seed, static_cast<int>(Origin[1] + IndexY), static_cast<int>(Origin[2] + IndexZ));
+                    for (std::size_t BeginX = 0; BeginX < SizeX; BeginX += 256) {
+                        const std::size_t Count = std::min<std::size_t>(256, SizeX - BeginX);
+                        CounterRandom::SampleRow(RowKey, static_cast<int>(Origin[0] + BeginX), Count, Samples);
+                        for (std::size_t Index = 0; Index < Count; ++Index) {
+                            // Evalueate the random function.
+                            if (Samples[Index] < Threshold) {
+                                Target.Set(BeginX + Index, IndexY, IndexZ, Value);
+                            }
+                        }
                     }
                 }
             }
-        }
+        });
+    }
+
+    // Create a terrain the height of the volume.
+    Volume VolumeFactory::CreateTerrain(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, std::uint32_t Seed, Voxel Surface, Voxel Ground) {
+        // Allocate the volume.
+        DeferredRasterisation::Volume Terrain = DeferredRasterisation::Volume(SizeX, SizeY, SizeZ);
+
+        // Fill the whole terrain.
+        FillTerrain(Terrain, {{0, 0, 0}}, SizeY, Seed, Surface, Ground);
 
         // Return.
-        return Sponge;
+        return Terrain;
+    }
+
+    // Fill part of a terrain, noise is sampled at the position within the whole terrain.
+    void VolumeFactory::FillTerrain(Volume& Target, const std::array<std::size_t, 3>& Origin, std::size_t Height, std::uint32_t Seed, Voxel Surface, Voxel Ground) {
+        const std::size_t SizeX = Target.GetSizeX();
+        const std::size_t SizeY = Target.GetSizeY();
+        const std::size_t SizeZ = Target.GetSizeZ();
+
+        // Shape of the terrain, distances are in voxels.
+        const std::size_t HeightOctaves = 5;
+        const float HeightFrequency = 1.0f / 128.0f;
+        const float MinimumHeight = 0.25f * static_cast<float>(Height);
+        const float HeightRange = 0.75f * static_cast<float>(Height);
+        const float CaveFrequency = 1.0f / 16.0f;
+        const float CaveThreshold = 0.7f;
+        const std::size_t CaveCrust = 3;
+        const std::uint32_t CaveSeed = Seed ^ 0x5BD1E995u;
+
+        // Generate slabs of brick depth in parallel, evaluating noise a row at a time.
+        ThreadPool::GetGlobal().ParallelFor(SizeZ, BrickSize, [&](std::size_t BeginZ, std::size_t EndZ) {
+            std::vector<float> Heights(SizeX);
+            std::vector<std::size_t> Columns(SizeX);
+            std::vector<float> Caves(SizeX);
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                const float WorldZ = static_cast<float>(Origin[2] + IndexZ);
+
+                // The heightfield is shared by every row of the slice.
+                Noise::FractalRow(static_cast<float>(Origin[0]) * HeightFrequency, HeightFrequency, 0.0f, WorldZ * HeightFrequency, HeightOctaves, Seed, SizeX, Heights.data());
+                std::size_t HighestColumn = 0;
+                for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                    Columns[IndexX] = static_cast<std::size_t>(MinimumHeight + Heights[IndexX] * HeightRange);
+                    HighestColumn = std::max(HighestColumn, Columns[IndexX]);
+                }
+
+                // Rows above the highest column of the slice are empty.
+                for (std::size_t IndexY = 0; (IndexY < SizeY) && (Origin[1] + IndexY < HighestColumn); ++IndexY) {
+                    const std::size_t WorldY = Origin[1] + IndexY;
+                    Noise::Value3Row(static_cast<float>(Origin[0]) * CaveFrequency, CaveFrequency, static_cast<float>(WorldY) * CaveFrequency, WorldZ * CaveFrequency, CaveSeed, SizeX, Caves.data());
+                    for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
+                        // Leave a crust below the surface so caves do not leave floating surface voxels.
+                        if (WorldY >= Columns[IndexX]) {
+                            continue;
+                        }
+                        if ((WorldY + CaveCrust < Columns[IndexX]) && (Caves[IndexX] > CaveThreshold)) {
+                            continue;
+                        }
+                        Target.Set(IndexX, IndexY, IndexZ, (WorldY + 1 == Columns[IndexX]) ? Surface : Ground);
+                    }
+                }
+            }
+        });
     }
 
     // Create a column volumn.
@@ -115,26 +202,53 @@ namespace DeferredRasterisation {
         // Helper function to square values.
         auto Square = [](double Value)->double { return Value * Value; };
 
-        // Loop over all voxels of the volume and fill ones that are within the column.
-        for (std::size_t IndexX = 0; IndexX < SizeX; ++IndexX) {
-            const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
-            for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
-                for (std::size_t IndexZ = 0; IndexZ < SizeZ; ++IndexZ) {
+        // Generate slabs of brick depth in parallel.
+        ThreadPool::GetGlobal().ParallelFor(SizeZ, BrickSize, [&](std::size_t BeginZ, std::size_t EndZ) {
+            for (std::size_t IndexZ = BeginZ; IndexZ < EndZ; ++IndexZ) {
+                const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
+
+                // The span within the X and Z circle is the same for every row of this slice.
+                const double Remainder = Radius - PartialZ;
+                const double HalfWidth = (Remainder > 0.0) ? RadiusX * std::sqrt(Remainder) : 0.0;
+                const std::array<std::size_t, 2> Span = GetRowSpan(SizeX, RadiusX, HalfWidth, [&](std::size_t IndexX) -> bool {
+                    const double PartialX = Square((static_cast<double>(IndexX) - RadiusX) / RadiusX);
+                    return PartialX + PartialZ < Radius;
+                });
+
+                for (std::size_t IndexY = 0; IndexY < SizeY; ++IndexY) {
                     // Fill the top and bottom layers completely.
                     if (IndexY == 0 || IndexY == SizeY-1) {
-                        Column(IndexX, IndexY, IndexZ) = Value;
-                        continue;
+                        Column.FillRow(0, SizeX, IndexY, IndexZ, Value);
                     }
-                    const double PartialZ = Square((static_cast<double>(IndexZ) - RadiusZ) / RadiusZ);
-                    // Evaluate the X and Z circle for inclusion in the column.
-                    if (PartialX + PartialZ < Radius) {
-                        Column(IndexX, IndexY, IndexZ) = Value;
+                    else {
+                        Column.FillRow(Span[0], Span[1], IndexY, IndexZ, Value);
                     }
                 }
             }
-        }
+        });
 
         // Return.
         return Column;
     }
+
+    // Refine an analytic row span against the exact test.
+    std::array<std::size_t, 2> VolumeFactory::GetRowSpan(std::size_t Size, double Centre, double HalfWidth, const std::function<bool(std::size_t)>& Inside) {
+        // Clamp the analytic estimate to the row.
+        auto Clamp = [Size](double Value) -> std::size_t { return static_cast<std::size_t>(std::min(std::max(Value, 0.0), static_cast<double>(Size))); };
+        std::size_t Begin = Clamp(std::ceil(Centre - HalfWidth));
+        std::size_t End = Clamp(std::floor(Centre + HalfWidth) + 1.0);
+
+        // An empty estimate is seeded at the centre, the shape is convex so any span must contain the voxel nearest the centre.
+        if (Begin >= End) {
+            Begin = End = std::min(Clamp(std::round(Centre)), Size);
+        }
+
+        // Grow or shrink each end by the few voxels that rounding can get wrong.
+        while ((Begin > 0) && Inside(Begin - 1)) --Begin;
+        while ((End < Size) && Inside(End)) ++End;
+        while ((Begin < End) && !Inside(Begin)) ++Begin;
+        while ((End > Begin) && !Inside(End - 1)) --End;
+
+        return {{ Begin, End }};
+    }
 }
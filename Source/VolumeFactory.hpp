@@ -28,6 +28,10 @@ THE SOFTWARE
 
 #include "Volume.hpp"
 
+#include <array>
+#include <cstdint>
+#include <functional>
+
 namespace DeferredRasterisation {
     /// @brief  VolumeFactory provides a number of factory functions to create volumes.
     class VolumeFactory {
@@ -53,12 +57,42 @@ namespace DeferredRasterisation {
         static Volume CreateEllipsoid(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, Voxel Value);
 
         /// @brief  Create a sponge by only setting random positions in a cuboid volume to a given voxel type.
+        ///         Each voxel is decided by a counter-based generator, so the same seed always gives the same sponge.
         /// @param  SizeX - Width of the volume.
         /// @param  SizeY - Height of the volume.
         /// @param  SizeZ - Depth of the volume.
         /// @param  Density - The fill ratio of the sponge between 0.0 and 1.0.
+        /// @param  Seed - The seed of the random generator.
         /// @param  Value - The voxel value.
-        static Volume CreateRandomSponge(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Density, Voxel Value);
+        static Volume CreateRandomSponge(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Density, std::uint64_t Seed, Voxel Value);
+
+        /// @brief  Fill a volume with part of a larger random sponge, used to generate a sponge chunk by chunk.
+        ///         The result matches the same region of a sponge created in one piece with the same seed.
+        /// @param  Target - The volume to fill, voxels that are not set are left unchanged.
+        /// @param  Origin - The position of the target within the larger sponge.
+        /// @param  Density - The fill ratio of the sponge between 0.0 and 1.0.
+        /// @param  Seed - The seed of the random generator.
+        /// @param  Value - The voxel value.
+        static void FillRandomSponge(Volume& Target, const std::array<std::size_t, 3>& Origin, double Density, std::uint64_t Seed, Voxel Value);
+
+        /// @brief  Create a terrain from a fractal noise heightfield with noise carved caves.
+        /// @param  SizeX - Width of the volume.
+        /// @param  SizeY - Height of the volume, also the highest the terrain can reach.
+        /// @param  SizeZ - Depth of the volume.
+        /// @param  Seed - The seed of the noise.
+        /// @param  Surface - The voxel value of the top layer.
+        /// @param  Ground - The voxel value below the top layer.
+        static Volume CreateTerrain(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, std::uint32_t Seed, Voxel Surface, Voxel Ground);
+
+        /// @brief  Fill a volume with part of a larger terrain, used to generate a terrain chunk by chunk.
+        ///         The result matches the same region of a terrain created in one piece with the same height and seed.
+        /// @param  Target - The volume to fill, voxels that are not set are left unchanged.
+        /// @param  Origin - The position of the target within the larger terrain.
+        /// @param  Height - The height of the larger terrain.
+        /// @param  Seed - The seed of the noise.
+        /// @param  Surface - The voxel value of the top layer.
+        /// @param  Ground - The voxel value below the top layer.
+        static void FillTerrain(Volume& Target, const std::array<std::size_t, 3>& Origin, std::size_t Height, std::uint32_t Seed, Voxel Surface, Voxel Ground);
 
         /// @brief  Create a column volume of a given voxel type.
         /// @param  SizeX - Width of the volume.
@@ -67,6 +101,16 @@ namespace DeferredRasterisation {
         /// @param  Radius - The radius of the column radius between 0.0 and 1.0.
         /// @param  Value - The voxel value.
         static Volume CreateColumn(std::size_t SizeX, std::size_t SizeY, std::size_t SizeZ, double Radius, Voxel Value);
+
+    private:
+        /// @brief  Find the filled span of a row through a shape that is convex along the row.
+        ///         The analytic estimate is refined with the exact per voxel test, so spans match a brute force evaluation.
+        /// @param  Size - The length of the row.
+        /// @param  Centre - The centre of the span.
+        /// @param  HalfWidth - The analytic half width of the span, may be zero if the row only grazes the shape.
+        /// @param  Inside - The exact per voxel test.
+        /// @return The first voxel of the span and one past the last voxel, equal if the span is empty.
+        static std::array<std::size_t, 2> GetRowSpan(std::size_t Size, double Centre, double HalfWidth, const std::function<bool(std::size_t)>& Inside);
     };
 }
 
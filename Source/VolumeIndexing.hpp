@@ -0,0 +1,206 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_VOLUMEINDEXING_HPP
+#define RAYMARCH_VOLUMEINDEXING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace DeferredRasterisation {
+    /// @brief  The edge length of a brick, the cubic tile used by bricked storage.
+    constexpr static const std::size_t BrickSize = 8;
+
+    /// @brief  The number of voxels in a brick.
+    constexpr static const std::size_t BrickVolume = BrickSize * BrickSize * BrickSize;
+
+    /// @brief  LinearIndexing stores voxels in X-major order, rows of X are stacked along Y and then along Z.
+    class LinearIndexing {
+    private:
+        /// @brief  Deleted destructor.
+        ~LinearIndexing(void) = delete;
+        /// @brief  Deleted constructor.
+        LinearIndexing(void) = delete;
+
+    public:
+        /// @brief  Rows along the X axis are contiguous in memory.
+        constexpr static const bool ContiguousRows = true;
+
+    public:
+        /// @brief  Get the number of voxels that must be allocated to store a volume.
+        /// @param  Size - The size of the volume.
+        /// @return The number of voxels to allocate.
+        static std::size_t GetAllocation(const std::array<std::size_t, 3>& Size) {
+            return Size[0] * Size[1] * Size[2];
+        }
+
+        /// @brief  Get the storage index of a voxel.
+        /// @param  Size - The size of the volume.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The index of the voxel in storage.
+        static std::size_t GetIndex(const std::array<std::size_t, 3>& Size, std::size_t X, std::size_t Y, std::size_t Z) {
+            return X + Size[0] * (Y + Size[1] * (Z));
+        }
+
+        /// @brief  Visit every voxel of a volume in storage order.
+        /// @param  Size - The size of the volume.
+        /// @param  Function - Called with the X, Y, Z coordinates and storage index of each voxel.
+        template <typename FunctionType>
+        static void ForEach(const std::array<std::size_t, 3>& Size, FunctionType&& Function) {
+            std::size_t Index = 0;
+            for (std::size_t Z = 0; Z < Size[2]; ++Z) {
+                for (std::size_t Y = 0; Y < Size[1]; ++Y) {
+                    for (std::size_t X = 0; X < Size[0]; ++X, ++Index) {
+                        Function(X, Y, Z, Index);
+                    }
+                }
+            }
+        }
+    };
+
+    /// @brief  MortonIndexing stores voxels in cubic bricks, with voxels inside a brick in Morton (Z-curve) order.
+    ///         Bricks themselves are stored in linear order, partial bricks at the edges are padded.
+    ///         Every voxel in a brick shares a handful of cache lines with its neighbours along all three axes.
+    ///         Volume files store their brick payloads in this order, and MortonVolume is stored in it.
+    class MortonIndexing {
+    private:
+        /// @brief  Deleted destructor.
+        ~MortonIndexing(void) = delete;
+        /// @brief  Deleted constructor.
+        MortonIndexing(void) = delete;
+
+    private:
+        /// @brief  Spread the low three bits of a coordinate so they occupy every third bit.
+        /// @param  Value - The coordinate within a brick.
+        /// @return The spread bits.
+        constexpr static std::size_t Spread(std::size_t Value) {
+            return (Value & 1) | ((Value & 2) << 2) | ((Value & 4) << 4);
+        }
+
+        /// @brief  Build the table mapping a linear position within a brick to its Morton code.
+        /// @return The Morton code of every position within a brick, indexed by X + 8 * (Y + 8 * Z).
+        constexpr static std::array<std::uint16_t, BrickVolume> MakeMortonTable(void) {
+            std::array<std::uint16_t, BrickVolume> Table = {};
+            for (std::size_t Index = 0; Index < BrickVolume; ++Index) {
+                const std::size_t X = Index % BrickSize;
+                const std::size_t Y = (Index / BrickSize) % BrickSize;
+                const std::size_t Z = Index / (BrickSize * BrickSize);
+                Table[Index] = static_cast<std::uint16_t>(Spread(X) | (Spread(Y) << 1) | (Spread(Z) << 2));
+            }
+            return Table;
+        }
+
+        /// @brief  Morton codes of every position within a brick, a table lookup is cheaper than spreading bits.
+        static const std::array<std::uint16_t, BrickVolume> MortonTable;
+
+        /// @brief  Compact every third bit of a Morton code back into a coordinate.
+        /// @param  Value - The (shifted) Morton code.
+        /// @return The compacted coordinate within a brick.
+        static std::size_t Compact(std::size_t Value) {
+            return (Value & 1) | ((Value >> 2) & 2) | ((Value >> 4) & 4);
+        }
+
+        /// @brief  Get the number of bricks along each axis.
+        /// @param  Size - The size of the volume.
+        /// @return The number of bricks required to cover the volume.
+        static std::array<std::size_t, 3> GetBrickCount(const std::array<std::size_t, 3>& Size) {
+            return {{ (Size[0] + BrickSize - 1) / BrickSize, (Size[1] + BrickSize - 1) / BrickSize, (Size[2] + BrickSize - 1) / BrickSize }};
+        }
+
+    public:
+        /// @brief  Rows along the X axis are not contiguous in memory.
+        constexpr static const bool ContiguousRows = false;
+
+    public:
+        /// @brief  Get the number of voxels that must be allocated to store a volume.
+        /// @param  Size - The size of the volume.
+        /// @return The number of voxels to allocate, including brick padding.
+        static std::size_t GetAllocation(const std::array<std::size_t, 3>& Size) {
+            const std::array<std::size_t, 3> BrickCount = GetBrickCount(Size);
+            return BrickCount[0] * BrickCount[1] * BrickCount[2] * BrickVolume;
+        }
+
+        /// @brief  Get the position of a voxel within its brick.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The Morton code of the voxel within its brick.
+        static std::size_t GetBrickOffset(std::size_t X, std::size_t Y, std::size_t Z) {
+            return MortonTable[(X % BrickSize) + BrickSize * ((Y % BrickSize) + BrickSize * (Z % BrickSize))];
+        }
+
+        /// @brief  Get the storage index of a voxel.
+        /// @param  Size - The size of the volume.
+        /// @param  X - The X coordinate of the voxel.
+        /// @param  Y - The Y coordinate of the voxel.
+        /// @param  Z - The Z coordinate of the voxel.
+        /// @return The index of the voxel in storage.
+        static std::size_t GetIndex(const std::array<std::size_t, 3>& Size, std::size_t X, std::size_t Y, std::size_t Z) {
+            const std::size_t BrickCountX = (Size[0] + BrickSize - 1) / BrickSize;
+            const std::size_t BrickCountY = (Size[1] + BrickSize - 1) / BrickSize;
+            const std::size_t Brick = (X / BrickSize) + BrickCountX * ((Y / BrickSize) + BrickCountY * (Z / BrickSize));
+            return Brick * BrickVolume + GetBrickOffset(X, Y, Z);
+        }
+
+        /// @brief  Visit every voxel of a volume in storage order, skipping brick padding.
+        /// @param  Size - The size of the volume.
+        /// @param  Function - Called with the X, Y, Z coordinates and storage index of each voxel.
+        template <typename FunctionType>
+        static void ForEach(const std::array<std::size_t, 3>& Size, FunctionType&& Function) {
+            const std::array<std::size_t, 3> BrickCount = GetBrickCount(Size);
+            std::size_t Index = 0;
+            for (std::size_t BrickZ = 0; BrickZ < BrickCount[2]; ++BrickZ) {
+                for (std::size_t BrickY = 0; BrickY < BrickCount[1]; ++BrickY) {
+                    for (std::size_t BrickX = 0; BrickX < BrickCount[0]; ++BrickX) {
+                        // Full bricks can skip the bounds checks.
+                        const bool Full = ((BrickX + 1) * BrickSize <= Size[0]) && ((BrickY + 1) * BrickSize <= Size[1]) && ((BrickZ + 1) * BrickSize <= Size[2]);
+                        // Walk the brick as 64 consecutive 2x2x2 cells, decoding only the cell position.
+                        for (std::size_t Cell = 0; Cell < BrickVolume; Cell += 8) {
+                            const std::size_t CellX = BrickX * BrickSize + Compact(Cell);
+                            const std::size_t CellY = BrickY * BrickSize + Compact(Cell >> 1);
+                            const std::size_t CellZ = BrickZ * BrickSize + Compact(Cell >> 2);
+                            for (std::size_t Corner = 0; Corner < 8; ++Corner, ++Index) {
+                                const std::size_t X = CellX + (Corner & 1);
+                                const std::size_t Y = CellY + ((Corner >> 1) & 1);
+                                const std::size_t Z = CellZ + (Corner >> 2);
+                                if (Full || ((X < Size[0]) && (Y < Size[1]) && (Z < Size[2]))) {
+                                    Function(X, Y, Z, Index);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // The Morton table is built at compile time.
+    inline const std::array<std::uint16_t, BrickVolume> MortonIndexing::MortonTable = MortonIndexing::MakeMortonTable();
+}
+
+#endif // RAYMARCH_VOLUMEINDEXING_HPP
@@ -0,0 +1,165 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "VolumePyramid.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace DeferredRasterisation {
+    // Nothing to follow yet.
+    VolumePyramid::VolumePyramid(void)
+        : Size({{0, 0, 0}}) {
+    }
+
+    // Update each level from the changes of the level below.
+    void VolumePyramid::Update(const Volume& Source) {
+        // A new size allocates new levels, fresh cursors then report every brick.
+        if (Source.GetSize() != this->Size) {
+            this->Size = Source.GetSize();
+            this->Levels.clear();
+            this->Cursors.clear();
+            std::array<std::size_t, 3> LevelSize = this->Size;
+            while ((LevelSize[0] * LevelSize[1] * LevelSize[2]) > 1) {
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    LevelSize[Axis] = (LevelSize[Axis] + 1) / 2;
+                }
+                this->Levels.emplace_back(LevelSize);
+                this->Cursors.emplace_back();
+            }
+        }
+
+        // Stop at the first level below which nothing changed, levels above it are already up to date.
+        const Volume* Finer = &Source;
+        for (std::size_t Level = 0; Level < this->Levels.size(); ++Level) {
+            Finer->Drain(this->Cursors[Level], this->DirtyBricks);
+            if (this->DirtyBricks.empty()) break;
+            this->Downsample(*Finer, this->Levels[Level]);
+            Finer = &this->Levels[Level];
+        }
+    }
+
+    // Get the number of coarse levels.
+    std::size_t VolumePyramid::GetLevelCount(void) const {
+        return this->Levels.size();
+    }
+
+    // Get a coarse level.
+    const Volume& VolumePyramid::GetLevel(std::size_t Level) const {
+        assert((Level >= 1) && (Level <= this->Levels.size()));
+        return this->Levels[Level - 1];
+    }
+
+    // Group the changed bricks by the coarse brick they fall in, then rebuild the coarse bricks in parallel.
+    void VolumePyramid::Downsample(const Volume& Finer, Volume& Coarser) {
+        const std::array<std::size_t, 3>& FineBrickCount = Finer.GetBrickCount();
+        const std::array<std::size_t, 3>& CoarseBrickCount = Coarser.GetBrickCount();
+        const std::array<std::size_t, 3> FineSize = Finer.GetSize();
+        const std::array<std::size_t, 3> CoarseSize = Coarser.GetSize();
+
+        // A fine brick covers one octant of a coarse brick.
+        this->ChildMasks.assign(CoarseBrickCount[0] * CoarseBrickCount[1] * CoarseBrickCount[2], 0);
+        this->ActiveBricks.clear();
+        for (std::size_t Brick : this->DirtyBricks) {
+            const std::size_t BrickX = Brick % FineBrickCount[0];
+            const std::size_t BrickY = (Brick / FineBrickCount[0]) % FineBrickCount[1];
+            const std::size_t BrickZ = Brick / (FineBrickCount[0] * FineBrickCount[1]);
+            const std::size_t Parent = (BrickX / 2) + CoarseBrickCount[0] * ((BrickY / 2) + CoarseBrickCount[1] * (BrickZ / 2));
+            if (this->ChildMasks[Parent] == 0) {
+                this->ActiveBricks.push_back(Parent);
+            }
+            this->ChildMasks[Parent] |= static_cast<std::uint8_t>(1u << ((BrickX % 2) + 2 * (BrickY % 2) + 4 * (BrickZ % 2)));
+        }
+
+        const Volume& Target = Coarser;
+        ThreadPool::GetGlobal().ParallelFor(this->ActiveBricks.size(), 1, [&](std::size_t Begin, std::size_t End) -> void {
+            for (std::size_t Active = Begin; Active < End; ++Active) {
+                const std::size_t Parent = this->ActiveBricks[Active];
+                const std::size_t ParentX = Parent % CoarseBrickCount[0];
+                const std::size_t ParentY = (Parent / CoarseBrickCount[0]) % CoarseBrickCount[1];
+                const std::size_t ParentZ = Parent / (CoarseBrickCount[0] * CoarseBrickCount[1]);
+
+                for (std::size_t Octant = 0; Octant < 8; ++Octant) {
+                    if ((this->ChildMasks[Parent] & (1u << Octant)) == 0) continue;
+
+                    // The coarse voxels covered by this octant.
+                    const std::size_t Half = BrickSize / 2;
+                    const std::array<std::size_t, 3> OctantBegin = {{
+                        ParentX * BrickSize + (Octant % 2) * Half,
+                        ParentY * BrickSize + ((Octant / 2) % 2) * Half,
+                        ParentZ * BrickSize + (Octant / 4) * Half
+                    }};
+                    const std::array<std::size_t, 3> OctantEnd = {{
+                        std::min(OctantBegin[0] + Half, CoarseSize[0]),
+                        std::min(OctantBegin[1] + Half, CoarseSize[1]),
+                        std::min(OctantBegin[2] + Half, CoarseSize[2])
+                    }};
+
+                    for (std::size_t IndexZ = OctantBegin[2]; IndexZ < OctantEnd[2]; ++IndexZ) {
+                        for (std::size_t IndexY = OctantBegin[1]; IndexY < OctantEnd[1]; ++IndexY) {
+                            for (std::size_t IndexX = OctantBegin[0]; IndexX < OctantEnd[0]; ++IndexX) {
+                                // Gather the children that exist, the last row of an odd sized level has fewer.
+                                std::array<const Voxel*, 8> Children;
+                                std::size_t ChildCount = 0;
+                                std::size_t LightTotal = 0;
+                                for (std::size_t Child = 0; Child < 8; ++Child) {
+                                    const std::size_t ChildX = 2 * IndexX + (Child % 2);
+                                    const std::size_t ChildY = 2 * IndexY + ((Child / 2) % 2);
+                                    const std::size_t ChildZ = 2 * IndexZ + (Child / 4);
+                                    if ((ChildX >= FineSize[0]) || (ChildY >= FineSize[1]) || (ChildZ >= FineSize[2])) continue;
+                                    Children[ChildCount] = &Finer(ChildX, ChildY, ChildZ);
+                                    LightTotal += Children[ChildCount]->Light;
+                                    ++ChildCount;
+                                }
+
+                                // Take the non-empty child whose hue is most common among the non-empty children.
+                                Voxel Value;
+                                std::size_t BestVotes = 0;
+                                for (std::size_t Child = 0; Child < ChildCount; ++Child) {
+                                    if (Children[Child]->Alpha == 0) continue;
+                                    std::size_t Votes = 0;
+                                    for (std::size_t Other = 0; Other < ChildCount; ++Other) {
+                                        Votes += ((Children[Other]->Alpha != 0) && (Children[Other]->Hue == Children[Child]->Hue)) ? 1 : 0;
+                                    }
+                                    if (Votes > BestVotes) {
+                                        BestVotes = Votes;
+                                        Value = *Children[Child];
+                                    }
+                                }
+                                Value.Light = static_cast<std::uint8_t>((LightTotal + ChildCount / 2) / ChildCount);
+
+                                // Unchanged voxels are not written, so their bricks are not marked as changed.
+                                if (std::memcmp(&Target(IndexX, IndexY, IndexZ), &Value, sizeof(Voxel)) != 0) {
+                                    Coarser.Set(IndexX, IndexY, IndexZ, Value);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,90 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_VOLUMEPYRAMID_HPP
+#define RAYMARCH_VOLUMEPYRAMID_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  VolumePyramid holds successively halved copies of a volume, down to a single voxel.
+    ///         Each coarse voxel covers 2x2x2 voxels of the level below. It is non-empty if any of them is, takes the most common hue among the non-empty ones, and averages their light.
+    ///         Coarse levels are volumes themselves, so their changes are tracked by brick and each level is rebuilt only where the level below changed.
+    ///         It follows one volume, each update only rebuilds the bricks that changed since the last.
+    class VolumePyramid {
+    private:
+        /// @brief  The size of the volume.
+        std::array<std::size_t, 3> Size;
+
+        /// @brief  The coarse levels, element 0 is level 1 at half the size of the volume.
+        std::vector<Volume> Levels;
+
+        /// @brief  The cursor each level reads the changes of the level below with, element 0 follows the volume.
+        std::vector<DirtyCursor> Cursors;
+
+        /// @brief  The bricks of a level changed since the last update, kept to reuse its allocation.
+        std::vector<std::size_t> DirtyBricks;
+
+        /// @brief  For each brick of a coarse level, a bit for each of its eight child bricks that changed.
+        std::vector<std::uint8_t> ChildMasks;
+
+        /// @brief  The bricks of a coarse level with at least one changed child brick.
+        std::vector<std::size_t> ActiveBricks;
+
+    public:
+        /// @brief  Constructor that creates an empty pyramid of no size.
+        VolumePyramid(void);
+
+    public:
+        /// @brief  Bring the pyramid up to date with a volume, rebuilding only where the volume changed since the last update.
+        ///         The first update, and any update with a volume of another size, rebuilds everything.
+        /// @param  Source - The volume to follow, always the same volume.
+        void Update(const Volume& Source);
+
+    public:
+        /// @brief  Get the number of coarse levels.
+        /// @return The number of levels, zero for an empty volume.
+        std::size_t GetLevelCount(void) const;
+
+        /// @brief  Get a coarse level.
+        /// @param  Level - The level, from 1 at half the size of the volume up to the level count.
+        /// @return The level, an empty voxel means the whole region it covers is empty.
+        const Volume& GetLevel(std::size_t Level) const;
+
+    private:
+        /// @brief  Recompute the voxels of a coarse level over changed bricks of the level below.
+        ///         Each coarse brick is written by one worker, and voxels are only written if they change so unchanged regions stop propagating up.
+        /// @param  Finer - The level below.
+        /// @param  Coarser - The level to update.
+        void Downsample(const Volume& Finer, Volume& Coarser);
+    };
+}
+
+#endif // RAYMARCH_VOLUMEPYRAMID_HPP
@@ -0,0 +1,282 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "VolumeStream.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace DeferredRasterisation {
+    // Write a volume by copying it a slab at a time.
+    bool VolumeStream::Write(std::ostream& Stream, const Volume& Source) {
+        return Write(Stream, Source.GetSize(), [&](const std::array<std::size_t, 3>& Origin, Volume& Slab) {
+            Slab.Insert(0, 0, -static_cast<int>(Origin[2]), Source);
+        });
+    }
+
+    // Write the header, then for each slab a table of encoded brick sizes followed by the encoded bricks.
+    bool VolumeStream::Write(std::ostream& Stream, const std::array<std::size_t, 3>& Size, const SourceType& Source) {
+        assert(Size[0] > 0 && Size[1] > 0 && Size[2] > 0);
+
+        // Refuse sizes that Read would reject.
+        if ((Size[0] >= MaxAxisSize) || (Size[1] >= MaxAxisSize) || (Size[2] >= MaxAxisSize) || (static_cast<std::uint64_t>(Size[0]) * Size[1] > MaxSlabArea)) {
+            return false;
+        }
+
+        Header StreamHeader;
+        std::memset(&StreamHeader, 0, sizeof(StreamHeader));
+        std::memcpy(StreamHeader.Magic, "DRSTREAM", sizeof(StreamHeader.Magic));
+        StreamHeader.Version = StreamVersion;
+        StreamHeader.Codec = CodecNone;
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            StreamHeader.Size[Axis] = Size[Axis];
+        }
+        Stream.write(reinterpret_cast<const char*>(&StreamHeader), sizeof(StreamHeader));
+
+        const std::size_t BrickCountX = (Size[0] + BrickSize - 1) / BrickSize;
+        const std::size_t BrickCountY = (Size[1] + BrickSize - 1) / BrickSize;
+        std::vector<std::vector<std::uint8_t>> Encoded(BrickCountX * BrickCountY);
+        std::vector<std::uint16_t> EncodedSizes(BrickCountX * BrickCountY);
+
+        for (std::size_t BeginZ = 0; (BeginZ < Size[2]) && Stream; BeginZ += BrickSize) {
+            Volume Slab(Size[0], Size[1], std::min(BrickSize, Size[2] - BeginZ));
+            Source({{ 0, 0, BeginZ }}, Slab);
+
+            // Gather and encode the bricks of the slab in parallel.
+            ThreadPool::GetGlobal().ParallelFor(Encoded.size(), 16, [&](std::size_t Begin, std::size_t End) {
+                Voxel Brick[BrickVolume];
+                for (std::size_t Index = Begin; Index < End; ++Index) {
+                    const std::size_t BeginX = (Index % BrickCountX) * BrickSize;
+                    const std::size_t BeginY = (Index / BrickCountX) * BrickSize;
+                    std::fill(Brick, Brick + BrickVolume, Voxel());
+                    for (std::size_t IndexZ = 0; IndexZ < Slab.GetSizeZ(); ++IndexZ) {
+                        for (std::size_t IndexY = BeginY; IndexY < std::min(BeginY + BrickSize, Size[1]); ++IndexY) {
+                            for (std::size_t IndexX = BeginX; IndexX < std::min(BeginX + BrickSize, Size[0]); ++IndexX) {
+                                Brick[MortonIndexing::GetBrickOffset(IndexX, IndexY, IndexZ)] = Slab(IndexX, IndexY, IndexZ);
+                            }
+                        }
+                    }
+                    EncodeBrick(Brick, Encoded[Index]);
+                    EncodedSizes[Index] = static_cast<std::uint16_t>(Encoded[Index].size());
+                }
+            });
+
+            Stream.write(reinterpret_cast<const char*>(EncodedSizes.data()), static_cast<std::streamsize>(EncodedSizes.size() * sizeof(std::uint16_t)));
+            for (const std::vector<std::uint8_t>& Brick : Encoded) {
+                Stream.write(reinterpret_cast<const char*>(Brick.data()), static_cast<std::streamsize>(Brick.size()));
+            }
+        }
+
+        Stream.flush();
+        return static_cast<bool>(Stream);
+    }
+
+    // Read a whole volume by inserting each slab.
+    bool VolumeStream::Read(std::istream& Stream, Volume& Target) {
+        return Read(Stream, [&](const std::array<std::size_t, 3>& Size, const std::array<std::size_t, 3>& Origin, const Volume& Slab) {
+            if (Origin[2] == 0) {
+                Target = Volume(Size);
+            }
+            Target.Insert(0, 0, static_cast<int>(Origin[2]), Slab);
+        });
+    }
+
+    // Read the header, then decode each slab in parallel and pass it on.
+    bool VolumeStream::Read(std::istream& Stream, const ConsumerType& Consumer) {
+        Header StreamHeader;
+        if (!Stream.read(reinterpret_cast<char*>(&StreamHeader), sizeof(StreamHeader))) {
+            return false;
+        }
+        bool Valid = (std::memcmp(StreamHeader.Magic, "DRSTREAM", sizeof(StreamHeader.Magic)) == 0) && (StreamHeader.Version == StreamVersion) && (StreamHeader.Codec == CodecNone);
+        for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+            Valid = Valid && (StreamHeader.Size[Axis] > 0) && (StreamHeader.Size[Axis] < MaxAxisSize);
+        }
+        // Limit the slab allocated from the header, so a corrupt stream cannot request an enormous slab.
+        Valid = Valid && (StreamHeader.Size[0] * StreamHeader.Size[1] <= MaxSlabArea);
+        if (!Valid) {
+            return false;
+        }
+        const std::array<std::size_t, 3> Size = {{ static_cast<std::size_t>(StreamHeader.Size[0]), static_cast<std::size_t>(StreamHeader.Size[1]), static_cast<std::size_t>(StreamHeader.Size[2]) }};
+
+        const std::size_t BrickCountX = (Size[0] + BrickSize - 1) / BrickSize;
+        const std::size_t BrickCountY = (Size[1] + BrickSize - 1) / BrickSize;
+        std::vector<std::uint16_t> EncodedSizes(BrickCountX * BrickCountY);
+        std::vector<std::size_t> EncodedOffsets(EncodedSizes.size() + 1);
+        std::vector<std::uint8_t> Encoded;
+
+        for (std::size_t BeginZ = 0; BeginZ < Size[2]; BeginZ += BrickSize) {
+            if (!Stream.read(reinterpret_cast<char*>(EncodedSizes.data()), static_cast<std::streamsize>(EncodedSizes.size() * sizeof(std::uint16_t)))) {
+                return false;
+            }
+            EncodedOffsets[0] = 0;
+            for (std::size_t Index = 0; Index < EncodedSizes.size(); ++Index) {
+                EncodedOffsets[Index + 1] = EncodedOffsets[Index] + EncodedSizes[Index];
+            }
+            Encoded.resize(EncodedOffsets.back());
+            if (!Stream.read(reinterpret_cast<char*>(Encoded.data()), static_cast<std::streamsize>(Encoded.size()))) {
+                return false;
+            }
+
+            // Decode and scatter the bricks of the slab in parallel.
+            Volume Slab(Size[0], Size[1], std::min(BrickSize, Size[2] - BeginZ));
+            std::atomic<bool> Decoded(true);
+            ThreadPool::GetGlobal().ParallelFor(EncodedSizes.size(), 16, [&](std::size_t Begin, std::size_t End) {
+                Voxel Brick[BrickVolume];
+                for (std::size_t Index = Begin; Index < End; ++Index) {
+                    if (!DecodeBrick(Encoded.data() + EncodedOffsets[Index], EncodedSizes[Index], Brick)) {
+                        Decoded = false;
+                        return;
+                    }
+                    const std::size_t BeginX = (Index % BrickCountX) * BrickSize;
+                    const std::size_t BeginY = (Index / BrickCountX) * BrickSize;
+                    for (std::size_t IndexZ = 0; IndexZ < Slab.GetSizeZ(); ++IndexZ) {
+                        for (std::size_t IndexY = BeginY; IndexY < std::min(BeginY + BrickSize, Size[1]); ++IndexY) {
+                            for (std::size_t IndexX = BeginX; IndexX < std::min(BeginX + BrickSize, Size[0]); ++IndexX) {
+                                Slab.Set(IndexX, IndexY, IndexZ, Brick[MortonIndexing::GetBrickOffset(IndexX, IndexY, IndexZ)]);
+                            }
+                        }
+                    }
+                }
+            });
+            if (!Decoded) {
+                return false;
+            }
+
+            Consumer(Size, {{ 0, 0, BeginZ }}, Slab);
+        }
+        return true;
+    }
+
+    // Choose the smallest of the three brick encodings.
+    void VolumeStream::EncodeBrick(const Voxel* Brick, std::vector<std::uint8_t>& Output) {
+        static_assert(sizeof(Voxel) == sizeof(std::uint32_t), "Voxels are encoded as 32 bit values.");
+        std::uint32_t Values[BrickVolume];
+        std::memcpy(Values, Brick, sizeof(Values));
+
+        // A uniform brick is just its value.
+        if (std::all_of(Values + 1, Values + BrickVolume, [&](std::uint32_t Value) -> bool { return Value == Values[0]; })) {
+            Output.resize(1 + sizeof(std::uint32_t));
+            Output[0] = static_cast<std::uint8_t>(BrickModeType::Uniform);
+            std::memcpy(Output.data() + 1, &Values[0], sizeof(std::uint32_t));
+            return;
+        }
+
+        // Split the brick into runs of up to 256 equal values, giving each distinct value a palette index.
+        std::uint32_t Palette[256];
+        std::size_t PaletteCount = 0;
+        std::size_t PaletteHit = 0;
+        std::uint8_t Runs[2 * BrickVolume];
+        std::size_t RunBytes = 0;
+        bool Fits = true;
+        for (std::size_t Index = 0; (Index < BrickVolume) && Fits; ) {
+            const std::uint32_t Value = Values[Index];
+            std::size_t Length = 1;
+            while ((Index + Length < BrickVolume) && (Length < 256) && (Values[Index + Length] == Value)) {
+                ++Length;
+            }
+
+            // Values usually repeat the previous palette hit, otherwise search the palette.
+            if ((PaletteCount == 0) || (Palette[PaletteHit] != Value)) {
+                PaletteHit = static_cast<std::size_t>(std::find(Palette, Palette + PaletteCount, Value) - Palette);
+                if (PaletteHit == PaletteCount) {
+                    if (PaletteCount == 256) {
+                        Fits = false;
+                        break;
+                    }
+                    Palette[PaletteCount++] = Value;
+                }
+            }
+            Runs[RunBytes++] = static_cast<std::uint8_t>(Length - 1);
+            Runs[RunBytes++] = static_cast<std::uint8_t>(PaletteHit);
+            Index += Length;
+        }
+
+        const std::size_t PaletteSize = 2 + PaletteCount * sizeof(std::uint32_t) + RunBytes;
+        if (Fits && (PaletteSize < 1 + sizeof(Values))) {
+            Output.resize(PaletteSize);
+            Output[0] = static_cast<std::uint8_t>(BrickModeType::Palette);
+            Output[1] = static_cast<std::uint8_t>(PaletteCount - 1);
+            std::memcpy(Output.data() + 2, Palette, PaletteCount * sizeof(std::uint32_t));
+            std::memcpy(Output.data() + 2 + PaletteCount * sizeof(std::uint32_t), Runs, RunBytes);
+            return;
+        }
+
+        // Noisy bricks are stored raw.
+        Output.resize(1 + sizeof(Values));
+        Output[0] = static_cast<std::uint8_t>(BrickModeType::Raw);
+        std::memcpy(Output.data() + 1, Values, sizeof(Values));
+    }
+
+    // Decode a brick, rejecting any encoding that does not describe exactly one brick.
+    bool VolumeStream::DecodeBrick(const std::uint8_t* Data, std::size_t Size, Voxel* Brick) {
+        if (Size == 0) {
+            return false;
+        }
+        switch (static_cast<BrickModeType>(Data[0])) {
+            case BrickModeType::Uniform: {
+                if (Size != 1 + sizeof(Voxel)) {
+                    return false;
+                }
+                Voxel Value;
+                std::memcpy(&Value, Data + 1, sizeof(Voxel));
+                std::fill(Brick, Brick + BrickVolume, Value);
+                return true;
+            }
+            case BrickModeType::Palette: {
+                if (Size < 2) {
+                    return false;
+                }
+                const std::size_t PaletteCount = static_cast<std::size_t>(Data[1]) + 1;
+                const std::uint8_t* Runs = Data + 2 + PaletteCount * sizeof(Voxel);
+                if (Size < 2 + PaletteCount * sizeof(Voxel)) {
+                    return false;
+                }
+                const std::uint8_t* RunsEnd = Data + Size;
+                std::size_t Index = 0;
+                for (; (Runs + 1 < RunsEnd) && (Index < BrickVolume); Runs += 2) {
+                    const std::size_t Length = static_cast<std::size_t>(Runs[0]) + 1;
+                    if ((Runs[1] >= PaletteCount) || (Index + Length > BrickVolume)) {
+                        return false;
+                    }
+                    Voxel Value;
+                    std::memcpy(&Value, Data + 2 + Runs[1] * sizeof(Voxel), sizeof(Voxel));
+                    std::fill(Brick + Index, Brick + Index + Length, Value);
+                    Index += Length;
+                }
+                return (Index == BrickVolume) && (Runs == RunsEnd);
+            }
+            case BrickModeType::Raw: {
+                if (Size != 1 + BrickVolume * sizeof(Voxel)) {
+                    return false;
+                }
+                std::memcpy(Brick, Data + 1, BrickVolume * sizeof(Voxel));
+                return true;
+            }
+        }
+        return false;
+    }
+}
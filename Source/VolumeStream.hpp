@@ -0,0 +1,129 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_VOLUMESTREAM_HPP
+#define RAYMARCH_VOLUMESTREAM_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  VolumeStream serialises volumes to and from compressed streams one brick deep slab at a time.
+    ///         Each brick is compressed independently as a single value, a palette with run-length encoded indices, or raw voxels.
+    ///         Only one slab is held uncompressed at a time, and the bricks of a slab are compressed and decompressed in parallel.
+    class VolumeStream {
+    public:
+        /// @brief  Stream header, all fields are in the byte order of the writing machine.
+        ///         A stream from a machine of the other byte order fails the version check in Read.
+        struct Header {
+            /// @brief  Stream identifier, "DRSTREAM".
+            char Magic[8];
+            /// @brief  Stream format version.
+            std::uint32_t Version;
+            /// @brief  The general purpose codec applied to each slab after brick encoding.
+            std::uint32_t Codec;
+            /// @brief  The size of the volume.
+            std::uint64_t Size[3];
+        };
+
+        /// @brief  The current stream format version.
+        constexpr static const std::uint32_t StreamVersion = 1;
+        /// @brief  Codec value for slabs that only use brick encoding, no other codec is currently supported.
+        constexpr static const std::uint32_t CodecNone = 0;
+        /// @brief  The largest supported size of an axis, exclusive.
+        constexpr static const std::uint64_t MaxAxisSize = 1ull << 20;
+        /// @brief  The largest supported width times height, which bounds the slab held uncompressed to 128 MiB.
+        constexpr static const std::uint64_t MaxSlabArea = 1ull << 22;
+
+        /// @brief  A source fills a slab given the position of the slab origin within the volume.
+        ///         The slab is allocated empty and is the full width and height of the volume.
+        typedef std::function<void(const std::array<std::size_t, 3>& Origin, Volume& Slab)> SourceType;
+
+        /// @brief  A consumer receives each slab in order along with the size of the whole volume.
+        typedef std::function<void(const std::array<std::size_t, 3>& Size, const std::array<std::size_t, 3>& Origin, const Volume& Slab)> ConsumerType;
+
+    private:
+        /// @brief  Brick encodings, stored in the first byte of each encoded brick.
+        ///         Uniform bricks store one value, palette bricks store up to 256 values followed by runs of palette indices, raw bricks store every voxel.
+        enum class BrickModeType : std::uint8_t {
+            Uniform, Palette, Raw
+        };
+
+    private:
+        /// @brief  Deleted destructor.
+        ~VolumeStream(void) = delete;
+        /// @brief  Deleted constructor.
+        VolumeStream(void) = delete;
+
+    public:
+        /// @brief  Write a volume to a stream.
+        /// @param  Stream - The stream to write to.
+        /// @param  Source - The volume to write.
+        /// @return True if the volume was written, false if it is larger than the supported sizes.
+        static bool Write(std::ostream& Stream, const Volume& Source);
+
+        /// @brief  Write a volume that is produced a slab at a time, so it never has to exist uncompressed in memory.
+        /// @param  Stream - The stream to write to.
+        /// @param  Size - The size of the volume.
+        /// @param  Source - The function that fills each slab.
+        /// @return True if the volume was written, false if it is larger than the supported sizes.
+        static bool Write(std::ostream& Stream, const std::array<std::size_t, 3>& Size, const SourceType& Source);
+
+        /// @brief  Read a whole volume from a stream.
+        /// @param  Stream - The stream to read from.
+        /// @param  Target - The volume to read into, replaced by a volume of the stored size.
+        /// @return True if the volume was read.
+        static bool Read(std::istream& Stream, Volume& Target);
+
+        /// @brief  Read a volume a slab at a time, so it never has to exist uncompressed in memory.
+        /// @param  Stream - The stream to read from.
+        /// @param  Consumer - The function that receives each slab.
+        /// @return True if the whole volume was read, false if the stream is invalid or larger than the supported sizes.
+        ///         Slabs before an error have already been passed to the consumer.
+        static bool Read(std::istream& Stream, const ConsumerType& Consumer);
+
+    private:
+        /// @brief  Encode a brick.
+        /// @param  Brick - The voxels of the brick in Morton order.
+        /// @param  Output - The encoded brick, replaces any existing contents.
+        static void EncodeBrick(const Voxel* Brick, std::vector<std::uint8_t>& Output);
+
+        /// @brief  Decode a brick.
+        /// @param  Data - The encoded brick.
+        /// @param  Size - The size of the encoded brick in bytes.
+        /// @param  Brick - The voxels of the brick in Morton order.
+        /// @return True if the encoded brick was valid.
+        static bool DecodeBrick(const std::uint8_t* Data, std::size_t Size, Voxel* Brick);
+    };
+}
+
+#endif // RAYMARCH_VOLUMESTREAM_HPP
@@ -0,0 +1,439 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#include "VoxFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+namespace DeferredRasterisation {
+    // Collect the chunks of each model and the scene graph, then decode models in parallel.
+    bool VoxFile::Load(const std::string& Path, std::vector<Model>& Models) {
+        Models.clear();
+
+        std::ifstream File(Path, std::ios::binary | std::ios::ate);
+        if (!File) {
+            return false;
+        }
+        const std::streamsize FileSize = File.tellg();
+        if (FileSize < 20) {
+            return false;
+        }
+        std::vector<std::uint8_t> Buffer(static_cast<std::size_t>(FileSize));
+        File.seekg(0, std::ios::beg);
+        if (!File.read(reinterpret_cast<char*>(Buffer.data()), FileSize)) {
+            return false;
+        }
+        const std::uint8_t* End = Buffer.data() + Buffer.size();
+
+        // Helper function to read a little endian integer within a limit.
+        auto ReadInt32 = [](const std::uint8_t*& Cursor, const std::uint8_t* Limit, std::int32_t& Value) -> bool {
+            if (Limit - Cursor < 4) {
+                return false;
+            }
+            std::memcpy(&Value, Cursor, sizeof(Value));
+            Cursor += 4;
+            return true;
+        };
+
+        // The file is a magic number, a version, then the main chunk whose children hold everything else.
+        if ((std::memcmp(Buffer.data(), "VOX ", 4) != 0) || (std::memcmp(Buffer.data() + 8, "MAIN", 4) != 0)) {
+            return false;
+        }
+        const std::uint8_t* Cursor = Buffer.data() + 12;
+        std::int32_t MainContentSize = 0;
+        std::int32_t MainChildrenSize = 0;
+        if (!ReadInt32(Cursor, End, MainContentSize) || !ReadInt32(Cursor, End, MainChildrenSize) || (MainContentSize < 0) || (MainChildrenSize < 0) || (MainContentSize > End - Cursor) || (MainChildrenSize > End - Cursor - MainContentSize)) {
+            return false;
+        }
+        Cursor += MainContentSize;
+        const std::uint8_t* ChildrenEnd = Cursor + MainChildrenSize;
+
+        // Model chunks only point into the buffer, decoding happens once every chunk has been found.
+        struct ModelChunks {
+            std::array<std::int32_t, 3> Size;
+            const std::uint8_t* Voxels;
+            std::int32_t VoxelCount;
+        };
+        std::vector<ModelChunks> Chunks;
+
+        // Scene graph nodes are transforms, groups or shapes.
+        struct SceneNode {
+            std::array<int, 3> Translation;
+            std::vector<std::int32_t> Children;
+            std::int32_t ModelIndex;
+        };
+        std::map<std::int32_t, SceneNode> Nodes;
+
+        std::array<std::uint8_t, 1024> Palette = GetDefaultPalette();
+
+        while (Cursor < ChildrenEnd) {
+            std::int32_t ContentSize = 0;
+            std::int32_t ChildrenSize = 0;
+            const std::uint8_t* Identifier = Cursor;
+            Cursor += 4;
+            if (!ReadInt32(Cursor, ChildrenEnd, ContentSize) || !ReadInt32(Cursor, ChildrenEnd, ChildrenSize) || (ContentSize < 0) || (ChildrenSize < 0) || (ContentSize > ChildrenEnd - Cursor) || (ChildrenSize > ChildrenEnd - Cursor - ContentSize)) {
+                return false;
+            }
+            const std::uint8_t* Content = Cursor;
+            const std::uint8_t* ContentEnd = Content + ContentSize;
+
+            if (std::memcmp(Identifier, "SIZE", 4) == 0) {
+                ModelChunks Chunk = { {{ 0, 0, 0 }}, nullptr, 0 };
+                for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                    if (!ReadInt32(Content, ContentEnd, Chunk.Size[Axis]) || (Chunk.Size[Axis] <= 0) || (static_cast<std::size_t>(Chunk.Size[Axis]) > MaximumModelSize)) {
+                        return false;
+                    }
+                }
+                Chunks.push_back(Chunk);
+            }
+            else if (std::memcmp(Identifier, "XYZI", 4) == 0) {
+                // Voxels belong to the preceding size chunk.
+                if (Chunks.empty() || (Chunks.back().Voxels != nullptr)) {
+                    return false;
+                }
+                if (!ReadInt32(Content, ContentEnd, Chunks.back().VoxelCount) || (Chunks.back().VoxelCount < 0) || (Chunks.back().VoxelCount > (ContentEnd - Content) / 4)) {
+                    return false;
+                }
+                Chunks.back().Voxels = Content;
+            }
+            else if (std::memcmp(Identifier, "RGBA", 4) == 0) {
+                // Palette entry N holds colour index N + 1, colour index 0 is empty.
+                if (ContentSize < 1024) {
+                    return false;
+                }
+                std::memcpy(Palette.data() + 4, Content, 1020);
+            }
+            else if (std::memcmp(Identifier, "nTRN", 4) == 0) {
+                std::int32_t NodeIndex = 0;
+                std::int32_t ChildIndex = 0;
+                std::int32_t Reserved = 0;
+                std::int32_t Layer = 0;
+                std::int32_t FrameCount = 0;
+                std::map<std::string, std::string> Attributes;
+                if (!ReadInt32(Content, ContentEnd, NodeIndex) || !ReadDictionary(Content, ContentEnd, Attributes) || !ReadInt32(Content, ContentEnd, ChildIndex) || !ReadInt32(Content, ContentEnd, Reserved) || !ReadInt32(Content, ContentEnd, Layer) || !ReadInt32(Content, ContentEnd, FrameCount)) {
+                    return false;
+                }
+                SceneNode Node = { {{ 0, 0, 0 }}, { ChildIndex }, -1 };
+                std::map<std::string, std::string> Frame;
+                if ((FrameCount > 0) && ReadDictionary(Content, ContentEnd, Frame) && (Frame.count("_t") != 0)) {
+                    const char* Translation = Frame["_t"].c_str();
+                    char* Next = nullptr;
+                    for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                        Node.Translation[Axis] = static_cast<int>(std::strtol(Translation, &Next, 10));
+                        Translation = Next;
+                    }
+                }
+                Nodes[NodeIndex] = Node;
+            }
+            else if (std::memcmp(Identifier, "nGRP", 4) == 0) {
+                std::int32_t NodeIndex = 0;
+                std::int32_t ChildCount = 0;
+                std::map<std::string, std::string> Attributes;
+                if (!ReadInt32(Content, ContentEnd, NodeIndex) || !ReadDictionary(Content, ContentEnd, Attributes) || !ReadInt32(Content, ContentEnd, ChildCount) || (ChildCount < 0) || (ChildCount > (ContentEnd - Content) / 4)) {
+                    return false;
+                }
+                SceneNode Node = { {{ 0, 0, 0 }}, std::vector<std::int32_t>(static_cast<std::size_t>(ChildCount)), -1 };
+                for (std::int32_t& Child : Node.Children) {
+                    ReadInt32(Content, ContentEnd, Child);
+                }
+                Nodes[NodeIndex] = Node;
+            }
+            else if (std::memcmp(Identifier, "nSHP", 4) == 0) {
+                std::int32_t NodeIndex = 0;
+                std::int32_t ModelCount = 0;
+                std::int32_t ModelIndex = 0;
+                std::map<std::string, std::string> Attributes;
+                if (!ReadInt32(Content, ContentEnd, NodeIndex) || !ReadDictionary(Content, ContentEnd, Attributes) || !ReadInt32(Content, ContentEnd, ModelCount) || (ModelCount < 1) || !ReadInt32(Content, ContentEnd, ModelIndex)) {
+                    return false;
+                }
+                Nodes[NodeIndex] = { {{ 0, 0, 0 }}, {}, ModelIndex };
+            }
+
+            // Skip the content and any children, unknown chunks are ignored.
+            Cursor += ContentSize + ChildrenSize;
+        }
+
+        for (const ModelChunks& Chunk : Chunks) {
+            if (Chunk.Voxels == nullptr) {
+                return false;
+            }
+        }
+        Models.resize(Chunks.size());
+
+        // Walk the scene graph from the root, accumulating translations down to each shape.
+        // MagicaVoxel places a model by its centre, the position is converted to the Y up minimum corner.
+        for (Model& Current : Models) {
+            Current.Position = {{ 0, 0, 0 }};
+        }
+        std::function<void(std::int32_t, std::array<int, 3>, std::size_t)> Visit = [&](std::int32_t NodeIndex, std::array<int, 3> Translation, std::size_t Depth) {
+            const std::map<std::int32_t, SceneNode>::const_iterator Node = Nodes.find(NodeIndex);
+            if ((Node == Nodes.end()) || (Depth > 64)) {
+                return;
+            }
+            for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                Translation[Axis] += Node->second.Translation[Axis];
+            }
+            if ((Node->second.ModelIndex >= 0) && (static_cast<std::size_t>(Node->second.ModelIndex) < Chunks.size())) {
+                const std::array<std::int32_t, 3>& Size = Chunks[static_cast<std::size_t>(Node->second.ModelIndex)].Size;
+                const std::array<int, 3> Minimum = {{ Translation[0] - Size[0] / 2, Translation[1] - Size[1] / 2, Translation[2] - Size[2] / 2 }};
+                Models[static_cast<std::size_t>(Node->second.ModelIndex)].Position = {{ Minimum[0], Minimum[2], -(Minimum[1] + Size[1]) }};
+            }
+            for (std::int32_t Child : Node->second.Children) {
+                Visit(Child, Translation, Depth + 1);
+            }
+        };
+        Visit(0, {{ 0, 0, 0 }}, 0);
+
+        // Convert the palette in one batch, colour index 0 stays empty.
+        Voxel PaletteVoxels[256];
+        Voxel::Encode(Palette.data(), 256, PaletteVoxels);
+        PaletteVoxels[0] = Voxel();
+
+        // Decode the models in parallel, rotating each voxel from Z up to Y up.
+        ThreadPool::GetGlobal().ParallelFor(Chunks.size(), 1, [&](std::size_t Begin, std::size_t Finish) {
+            for (std::size_t Index = Begin; Index < Finish; ++Index) {
+                const ModelChunks& Chunk = Chunks[Index];
+                Volume& Voxels = Models[Index].Voxels;
+                Voxels = Volume(static_cast<std::size_t>(Chunk.Size[0]), static_cast<std::size_t>(Chunk.Size[2]), static_cast<std::size_t>(Chunk.Size[1]));
+                for (std::int32_t Entry = 0; Entry < Chunk.VoxelCount; ++Entry) {
+                    const std::uint8_t* Element = Chunk.Voxels + Entry * 4;
+                    if ((Element[0] < Chunk.Size[0]) && (Element[1] < Chunk.Size[1]) && (Element[2] < Chunk.Size[2]) && (Element[3] != 0)) {
+                        Voxels.Set(Element[0], Element[2], static_cast<std::size_t>(Chunk.Size[1] - 1 - Element[1]), PaletteVoxels[Element[3]]);
+                    }
+                }
+            }
+        });
+        return true;
+    }
+
+    // Split the volume into models, build a palette from the decoded voxel colours, and place the models with a scene graph.
+    bool VoxFile::Save(const std::string& Path, const Volume& Source) {
+        static_assert(Volume::Indexing::ContiguousRows, "Rows are decoded in place.");
+
+        // Helper functions to build chunks.
+        auto AppendInt32 = [](std::vector<std::uint8_t>& Output, std::int32_t Value) {
+            std::uint8_t Bytes[4];
+            std::memcpy(Bytes, &Value, sizeof(Bytes));
+            Output.insert(Output.end(), Bytes, Bytes + 4);
+        };
+        auto AppendString = [&](std::vector<std::uint8_t>& Output, const std::string& Value) {
+            AppendInt32(Output, static_cast<std::int32_t>(Value.size()));
+            Output.insert(Output.end(), Value.begin(), Value.end());
+        };
+        auto AppendChunk = [&](std::vector<std::uint8_t>& Output, const char* Identifier, const std::vector<std::uint8_t>& Content, const std::vector<std::uint8_t>& Children) {
+            Output.insert(Output.end(), Identifier, Identifier + 4);
+            AppendInt32(Output, static_cast<std::int32_t>(Content.size()));
+            AppendInt32(Output, static_cast<std::int32_t>(Children.size()));
+            Output.insert(Output.end(), Content.begin(), Content.end());
+            Output.insert(Output.end(), Children.begin(), Children.end());
+        };
+
+        // MagicaVoxel X is volume X, MagicaVoxel Y runs against volume Z, and MagicaVoxel Z is volume Y.
+        const std::array<std::size_t, 3> Size = Source.GetSize();
+        const std::array<std::size_t, 3> VoxSize = {{ Size[0], Size[2], Size[1] }};
+        const std::array<std::size_t, 3> TileCount = {{ (VoxSize[0] + MaximumModelSize - 1) / MaximumModelSize, (VoxSize[1] + MaximumModelSize - 1) / MaximumModelSize, (VoxSize[2] + MaximumModelSize - 1) / MaximumModelSize }};
+
+        std::vector<std::uint8_t> MainChildren;
+        std::vector<std::uint32_t> PaletteColours;
+        std::map<std::uint32_t, std::uint8_t> PaletteLookup;
+        std::vector<std::array<int, 3>> Translations;
+        std::vector<std::uint8_t> Pixels(Size[0] * 4);
+
+        for (std::size_t TileZ = 0; TileZ < TileCount[2]; ++TileZ) {
+            for (std::size_t TileY = 0; TileY < TileCount[1]; ++TileY) {
+                for (std::size_t TileX = 0; TileX < TileCount[0]; ++TileX) {
+                    const std::array<std::size_t, 3> Origin = {{ TileX * MaximumModelSize, TileY * MaximumModelSize, TileZ * MaximumModelSize }};
+                    const std::array<std::size_t, 3> TileSize = {{ std::min(MaximumModelSize, VoxSize[0] - Origin[0]), std::min(MaximumModelSize, VoxSize[1] - Origin[1]), std::min(MaximumModelSize, VoxSize[2] - Origin[2]) }};
+
+                    std::vector<std::uint8_t> SizeContent;
+                    for (std::size_t Axis = 0; Axis < 3; ++Axis) {
+                        AppendInt32(SizeContent, static_cast<std::int32_t>(TileSize[Axis]));
+                    }
+
+                    // Decode each row of the tile and give every new colour a palette index.
+                    std::vector<std::uint8_t> Elements;
+                    for (std::size_t VoxZ = 0; VoxZ < TileSize[2]; ++VoxZ) {
+                        for (std::size_t VoxY = 0; VoxY < TileSize[1]; ++VoxY) {
+                            const std::size_t IndexY = Origin[2] + VoxZ;
+                            const std::size_t IndexZ = Size[2] - 1 - (Origin[1] + VoxY);
+                            Voxel::Decode(&Source(Origin[0], IndexY, IndexZ), TileSize[0], Pixels.data());
+                            for (std::size_t VoxX = 0; VoxX < TileSize[0]; ++VoxX) {
+                                const std::uint8_t* Pixel = Pixels.data() + VoxX * 4;
+                                if (Pixel[3] == 0) {
+                                    continue;
+                                }
+                                std::uint32_t Colour = 0;
+                                std::memcpy(&Colour, Pixel, sizeof(Colour));
+                                std::map<std::uint32_t, std::uint8_t>::const_iterator Entry = PaletteLookup.find(Colour);
+                                if (Entry == PaletteLookup.end()) {
+                                    if (PaletteColours.size() == 255) {
+                                        return false;
+                                    }
+                                    PaletteColours.push_back(Colour);
+                                    Entry = PaletteLookup.insert({ Colour, static_cast<std::uint8_t>(PaletteColours.size()) }).first;
+                                }
+                                const std::uint8_t Element[4] = { static_cast<std::uint8_t>(VoxX), static_cast<std::uint8_t>(VoxY), static_cast<std::uint8_t>(VoxZ), Entry->second };
+                                Elements.insert(Elements.end(), Element, Element + 4);
+                            }
+                        }
+                    }
+                    std::vector<std::uint8_t> VoxelContent;
+                    AppendInt32(VoxelContent, static_cast<std::int32_t>(Elements.size() / 4));
+                    VoxelContent.insert(VoxelContent.end(), Elements.begin(), Elements.end());
+
+                    AppendChunk(MainChildren, "SIZE", SizeContent, {});
+                    AppendChunk(MainChildren, "XYZI", VoxelContent, {});
+                    // Offset MagicaVoxel Y by the volume depth so loading the file places the volume back at the origin.
+                    const int TranslationY = static_cast<int>(Origin[1] + TileSize[1] / 2) - static_cast<int>(Size[2]);
+                    Translations.push_back({{ static_cast<int>(Origin[0] + TileSize[0] / 2), TranslationY, static_cast<int>(Origin[2] + TileSize[2] / 2) }});
+                }
+            }
+        }
+
+        // Scene graph: a root transform, a group, then a transform and shape per model.
+        std::vector<std::uint8_t> Node;
+        AppendInt32(Node, 0);
+        AppendInt32(Node, 0);
+        AppendInt32(Node, 1);
+        AppendInt32(Node, -1);
+        AppendInt32(Node, -1);
+        AppendInt32(Node, 1);
+        AppendInt32(Node, 0);
+        AppendChunk(MainChildren, "nTRN", Node, {});
+
+        Node.clear();
+        AppendInt32(Node, 1);
+        AppendInt32(Node, 0);
+        AppendInt32(Node, static_cast<std::int32_t>(Translations.size()));
+        for (std::size_t Index = 0; Index < Translations.size(); ++Index) {
+            AppendInt32(Node, static_cast<std::int32_t>(2 + Index * 2));
+        }
+        AppendChunk(MainChildren, "nGRP", Node, {});
+
+        for (std::size_t Index = 0; Index < Translations.size(); ++Index) {
+            Node.clear();
+            AppendInt32(Node, static_cast<std::int32_t>(2 + Index * 2));
+            AppendInt32(Node, 0);
+            AppendInt32(Node, static_cast<std::int32_t>(3 + Index * 2));
+            AppendInt32(Node, -1);
+            AppendInt32(Node, 0);
+            AppendInt32(Node, 1);
+            AppendInt32(Node, 1);
+            AppendString(Node, "_t");
+            AppendString(Node, std::to_string(Translations[Index][0]) + " " + std::to_string(Translations[Index][1]) + " " + std::to_string(Translations[Index][2]));
+            AppendChunk(MainChildren, "nTRN", Node, {});
+
+            Node.clear();
+            AppendInt32(Node, static_cast<std::int32_t>(3 + Index * 2));
+            AppendInt32(Node, 0);
+            AppendInt32(Node, 1);
+            AppendInt32(Node, static_cast<std::int32_t>(Index));
+            AppendInt32(Node, 0);
+            AppendChunk(MainChildren, "nSHP", Node, {});
+        }
+
+        // Palette entry N holds colour index N + 1.
+        std::vector<std::uint8_t> PaletteContent(1024, 0);
+        std::memcpy(PaletteContent.data(), PaletteColours.data(), PaletteColours.size() * sizeof(std::uint32_t));
+        AppendChunk(MainChildren, "RGBA", PaletteContent, {});
+
+        std::vector<std::uint8_t> Output = { 'V', 'O', 'X', ' ' };
+        AppendInt32(Output, 150);
+        AppendChunk(Output, "MAIN", {}, MainChildren);
+
+        std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+        File.write(reinterpret_cast<const char*>(Output.data()), static_cast<std::streamsize>(Output.size()));
+        return static_cast<bool>(File);
+    }
+
+    // The default palette is a 6x6x6 colour cube without black, followed by red, green, blue and grey ramps.
+    std::array<std::uint8_t, 1024> VoxFile::GetDefaultPalette(void) {
+        std::array<std::uint8_t, 1024> Palette = {};
+        std::size_t Index = 1;
+        const std::uint8_t CubeLevels[6] = { 0xFF, 0xCC, 0x99, 0x66, 0x33, 0x00 };
+        for (std::uint8_t Red : CubeLevels) {
+            for (std::uint8_t Green : CubeLevels) {
+                for (std::uint8_t Blue : CubeLevels) {
+                    if ((Red | Green | Blue) != 0) {
+                        Palette[Index * 4 + 0] = Red;
+                        Palette[Index * 4 + 1] = Green;
+                        Palette[Index * 4 + 2] = Blue;
+                        Palette[Index * 4 + 3] = 0xFF;
+                        ++Index;
+                    }
+                }
+            }
+        }
+        const std::uint8_t RampLevels[10] = { 0xEE, 0xDD, 0xBB, 0xAA, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11 };
+        for (std::size_t Ramp = 0; Ramp < 4; ++Ramp) {
+            for (std::uint8_t Level : RampLevels) {
+                Palette[Index * 4 + 0] = ((Ramp == 0) || (Ramp == 3)) ? Level : 0;
+                Palette[Index * 4 + 1] = ((Ramp == 1) || (Ramp == 3)) ? Level : 0;
+                Palette[Index * 4 + 2] = ((Ramp == 2) || (Ramp == 3)) ? Level : 0;
+                Palette[Index * 4 + 3] = 0xFF;
+                ++Index;
+            }
+        }
+        return Palette;
+    }
+
+    // A dictionary is a count followed by key and value strings, each a length followed by bytes.
+    bool VoxFile::ReadDictionary(const std::uint8_t*& Cursor, const std::uint8_t* End, std::map<std::string, std::string>& Dictionary) {
+        auto ReadString = [&](std::string& Value) -> bool {
+            std::int32_t Length = 0;
+            if (End - Cursor < 4) {
+                return false;
+            }
+            std::memcpy(&Length, Cursor, sizeof(Length));
+            Cursor += 4;
+            if ((Length < 0) || (Length > End - Cursor)) {
+                return false;
+            }
+            Value.assign(reinterpret_cast<const char*>(Cursor), static_cast<std::size_t>(Length));
+            Cursor += Length;
+            return true;
+        };
+
+        std::int32_t Count = 0;
+        if (End - Cursor < 4) {
+            return false;
+        }
+        std::memcpy(&Count, Cursor, sizeof(Count));
+        Cursor += 4;
+        for (std::int32_t Entry = 0; Entry < Count; ++Entry) {
+            std::string Key;
+            std::string Value;
+            if (!ReadString(Key) || !ReadString(Value)) {
+                return false;
+            }
+            Dictionary[Key] = Value;
+        }
+        return true;
+    }
+}
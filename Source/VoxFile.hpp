@@ -0,0 +1,88 @@
+/*
+The MIT License
+
+Copyright (c) 2017 Geoffrey Daniels. http://gpdaniels.com/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+*/
+
+#pragma once
+#ifndef RAYMARCH_VOXFILE_HPP
+#define RAYMARCH_VOXFILE_HPP
+
+#include "Volume.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DeferredRasterisation {
+    /// @brief  VoxFile loads and saves MagicaVoxel .vox files.
+    ///         MagicaVoxel is Z up, models are rotated to Y up on load and back on save, keeping the same handedness.
+    class VoxFile {
+    public:
+        /// @brief  Model is one model of a .vox file.
+        struct Model {
+            /// @brief  The position of the model minimum corner, suitable for GameState::AddToMap.
+            ///         Taken from the translations of the scene graph, rotations are ignored.
+            std::array<int, 3> Position;
+            /// @brief  The voxels of the model.
+            Volume Voxels;
+        };
+
+        /// @brief  The largest model size MagicaVoxel supports along each axis.
+        constexpr static const std::size_t MaximumModelSize = 256;
+
+    private:
+        /// @brief  Deleted destructor.
+        ~VoxFile(void) = delete;
+        /// @brief  Deleted constructor.
+        VoxFile(void) = delete;
+
+    public:
+        /// @brief  Load every model of a .vox file, models are decoded in parallel.
+        /// @param  Path - The path of the file.
+        /// @param  Models - The loaded models, any existing contents are replaced.
+        /// @return True if the file was loaded.
+        static bool Load(const std::string& Path, std::vector<Model>& Models);
+
+        /// @brief  Save a volume as a .vox file, volumes larger than a model are split into several models placed by the scene graph.
+        /// @param  Path - The path of the file.
+        /// @param  Source - The volume to save.
+        /// @return True if the file was saved.
+        static bool Save(const std::string& Path, const Volume& Source);
+
+    private:
+        /// @brief  Get the palette used by files without a palette chunk.
+        /// @return The default palette in R, G, B, A order, indexed by colour index.
+        static std::array<std::uint8_t, 1024> GetDefaultPalette(void);
+
+        /// @brief  Read a dictionary of strings from a scene graph chunk.
+        /// @param  Cursor - The read position, advanced past the dictionary.
+        /// @param  End - The end of the chunk.
+        /// @param  Dictionary - The dictionary entries.
+        /// @return True if the dictionary lies within the chunk.
+        static bool ReadDictionary(const std::uint8_t*& Cursor, const std::uint8_t* End, std::map<std::string, std::string>& Dictionary);
+    };
+}
+
+#endif // RAYMARCH_VOXFILE_HPP
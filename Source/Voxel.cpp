@@ -26,6 +26,11 @@ THE SOFTWARE
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 namespace DeferredRasterisation {
     // Constructor for empty voxels.
@@ -58,6 +63,120 @@ namespace DeferredRasterisation {
         this->FillLevel = 0;
     }
 
+    // Convert pixels to voxels through the quantised hue table, four at a time where SIMD is available.
+    void Voxel::Encode(const std::uint8_t* Pixels, std::size_t Count, Voxel* Voxels) {
+        static_assert(sizeof(Voxel) == sizeof(std::uint32_t), "Voxels are expected to pack into 32 bits.");
+
+        const std::array<std::uint8_t, 32768>& HueTable = GetHueTable();
+
+        // The packed word of a coloured voxel with no hue or alpha, and the bit positions of the hue and alpha fields.
+        static const std::array<std::uint32_t, 3> Layout = []() -> std::array<std::uint32_t, 3> {
+            auto Pack = [](const Voxel& Value) -> std::uint32_t { std::uint32_t Word; std::memcpy(&Word, &Value, sizeof(Word)); return Word; };
+            auto LowestBit = [](std::uint32_t Word) -> std::uint32_t { std::uint32_t Bit = 0; while (((Word >> Bit) & 1) == 0) ++Bit; return Bit; };
+            Voxel Base(0, 0, 0, 0);
+            Base.Hue = 0;
+            Voxel HueOne = Base;
+            HueOne.Hue = 1;
+            Voxel AlphaOne = Base;
+            AlphaOne.Alpha = 1;
+            return {{ Pack(Base), LowestBit(Pack(HueOne) ^ Pack(Base)), LowestBit(Pack(AlphaOne) ^ Pack(Base)) }};
+        }();
+
+        std::size_t Index = 0;
+
+        #if defined(__SSE2__)
+            const __m128i ChannelMask = _mm_set1_epi32(0x1F);
+            const __m128i BaseWord = _mm_set1_epi32(static_cast<int>(Layout[0]));
+            const __m128i HueShift = _mm_cvtsi32_si128(static_cast<int>(Layout[1]));
+            const __m128i AlphaShift = _mm_cvtsi32_si128(static_cast<int>(Layout[2]));
+            alignas(16) std::uint32_t HueIndices[4];
+
+            for (; Index + 4 <= Count; Index += 4) {
+                // Each lane holds one RGBA pixel with red in the lowest byte.
+                const __m128i Pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels + 4 * Index));
+
+                // Quantise the colour channels to 5 bits and combine them into a hue table index.
+                const __m128i Red = _mm_and_si128(_mm_srli_epi32(Pixel, 3), ChannelMask);
+                const __m128i Green = _mm_and_si128(_mm_srli_epi32(Pixel, 11), ChannelMask);
+                const __m128i Blue = _mm_and_si128(_mm_srli_epi32(Pixel, 19), ChannelMask);
+                _mm_store_si128(reinterpret_cast<__m128i*>(HueIndices), _mm_or_si128(_mm_slli_epi32(Red, 10), _mm_or_si128(_mm_slli_epi32(Green, 5), Blue)));
+
+                // Look up the hues, SSE2 has no gather so these are scalar loads.
+                const __m128i Hue = _mm_set_epi32(HueTable[HueIndices[3]], HueTable[HueIndices[2]], HueTable[HueIndices[1]], HueTable[HueIndices[0]]);
+
+                // The voxel alpha is the top three bits of the pixel alpha.
+                const __m128i Alpha = _mm_srli_epi32(Pixel, 29);
+
+                // Assemble and store the packed voxels.
+                const __m128i Word = _mm_or_si128(BaseWord, _mm_or_si128(_mm_sll_epi32(Hue, HueShift), _mm_sll_epi32(Alpha, AlphaShift)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(Voxels + Index), Word);
+            }
+        #endif
+
+        // Convert the remaining pixels one at a time, through the same table so the result does not depend on the count.
+        for (; Index < Count; ++Index) {
+            const std::uint8_t* Pixel = Pixels + 4 * Index;
+            Voxels[Index] = Voxel(Pixel[0], Pixel[1], Pixel[2], Pixel[3]);
+            Voxels[Index].Hue = HueTable[GetHueIndex(Pixel[0], Pixel[1], Pixel[2])];
+        }
+    }
+
+    // Convert voxels back to pixels using a table indexed by hue, alpha, and whether the voxel is coloured.
+    void Voxel::Decode(const Voxel* Voxels, std::size_t Count, std::uint8_t* Pixels) {
+        static const std::array<std::array<std::uint8_t, 4>, 256> ColourTable = []() -> std::array<std::array<std::uint8_t, 4>, 256> {
+            std::array<std::array<std::uint8_t, 4>, 256> Table = {};
+            for (std::size_t Hue = 0; Hue < 16; ++Hue) {
+                std::array<float, 3> Colour;
+                if (Hue < 4) {
+                    // Greys are stored as the maximum channel divided by 85, decode to the middle of each band so colours survive re-encoding.
+                    const float Greys[4] = { 0.0f, 128.0f, 212.0f, 255.0f };
+                    Colour.fill(Greys[Hue] / 255.0f);
+                }
+                else {
+                    // Hues 4 to 15 cover the colour wheel, converted at full saturation and value.
+                    // Hues 4 and 15 share the wrap around at red, hue 15 is decoded in the middle of its half so it survives re-encoding.
+                    const float Wheel = ((Hue == 15) ? 10.75f : static_cast<float>(Hue - 4)) / 11.0f * 6.0f;
+                    Colour[0] = std::min(std::max(std::abs(Wheel - 3.0f) - 1.0f, 0.0f), 1.0f);
+                    Colour[1] = std::min(std::max(2.0f - std::abs(Wheel - 2.0f), 0.0f), 1.0f);
+                    Colour[2] = std::min(std::max(2.0f - std::abs(Wheel - 4.0f), 0.0f), 1.0f);
+                }
+                for (std::size_t Alpha = 0; Alpha < 8; ++Alpha) {
+                    std::array<std::uint8_t, 4>& Entry = Table[(Hue << 4) | (Alpha << 1) | 1];
+                    for (std::size_t Channel = 0; Channel < 3; ++Channel) {
+                        Entry[Channel] = static_cast<std::uint8_t>(std::round(Colour[Channel] * 255.0f));
+                    }
+                    // Replicate the three alpha bits so that full alpha decodes to 255.
+                    Entry[3] = static_cast<std::uint8_t>((Alpha << 5) | (Alpha << 2) | (Alpha >> 1));
+                }
+            }
+            return Table;
+        }();
+
+        for (std::size_t Index = 0; Index < Count; ++Index) {
+            const Voxel& Value = Voxels[Index];
+            const std::size_t Key = (static_cast<std::size_t>(Value.Hue) << 4) | (static_cast<std::size_t>(Value.Alpha) << 1) | (Value.Saturation != 0 ? 1 : 0);
+            std::memcpy(Pixels + 4 * Index, ColourTable[Key].data(), 4);
+        }
+    }
+
+    // Index the hue table by the top five bits of each channel.
+    std::size_t Voxel::GetHueIndex(std::uint8_t R, std::uint8_t G, std::uint8_t B) {
+        return (static_cast<std::size_t>(R >> 3) << 10) | (static_cast<std::size_t>(G >> 3) << 5) | static_cast<std::size_t>(B >> 3);
+    }
+
+    // Build the hue table once, evaluating the exact conversion for each quantised colour with its bits replicated to 8 bits.
+    const std::array<std::uint8_t, 32768>& Voxel::GetHueTable(void) {
+        static const std::array<std::uint8_t, 32768> HueTable = []() -> std::array<std::uint8_t, 32768> {
+            std::array<std::uint8_t, 32768> Table;
+            auto Expand = [](std::size_t Value) -> std::uint8_t { return static_cast<std::uint8_t>((Value << 3) | (Value >> 2)); };
+            for (std::size_t Index = 0; Index < Table.size(); ++Index) {
+                Table[Index] = RGB2Hue(Expand((Index >> 10) & 0x1F), Expand((Index >> 5) & 0x1F), Expand(Index & 0x1F));
+            }
+            return Table;
+        }();
+        return HueTable;
+    }
+
     // Helper function to convert an RGB colour to a hue.
     std::uint8_t Voxel::RGB2Hue(std::uint8_t R, std::uint8_t G, std::uint8_t B) {
         std::uint8_t Max = std::max(R, std::max(G, B));
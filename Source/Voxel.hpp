@@ -26,6 +26,8 @@ THE SOFTWARE
 #ifndef RAYMARCH_VOXEL_HPP
 #define RAYMARCH_VOXEL_HPP
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 
 namespace DeferredRasterisation {
@@ -68,13 +70,38 @@ namespace DeferredRasterisation {
         /// @param  A - Value for the alpha channel.
         Voxel(std::uint8_t R, std::uint8_t G, std::uint8_t B, std::uint8_t A = 255u);
 
+    public:
+        /// @brief  Convert an array of RGBA pixels into coloured voxels, approximately equivalent to constructing each voxel from its colour.
+        ///         Hues come from a table of colours quantised to 5 bits per channel, so about 6% of colours, mostly near grey, get a different hue than the constructor gives.
+        /// @param  Pixels - The pixels to convert, four bytes per pixel in R, G, B, A order.
+        /// @param  Count - The number of pixels to convert.
+        /// @param  Voxels - The output array, must hold at least Count voxels.
+        static void Encode(const std::uint8_t* Pixels, std::size_t Count, Voxel* Voxels);
+
+        /// @brief  Convert an array of voxels back into RGBA pixels, empty voxels become transparent black.
+        /// @param  Voxels - The voxels to convert.
+        /// @param  Count - The number of voxels to convert.
+        /// @param  Pixels - The output array, must hold at least 4 * Count bytes.
+        static void Decode(const Voxel* Voxels, std::size_t Count, std::uint8_t* Pixels);
+
     private:
         /// @brief  Function to convert RGB colour to a 4 bit Hue.
         /// @param  R - Value for the red channel.
         /// @param  G - Value for the green channel.
         /// @param  B - Value for the blue channel.
         /// @return Hue as a 4 bit value.
-        std::uint8_t RGB2Hue(std::uint8_t R, std::uint8_t G, std::uint8_t B);
+        static std::uint8_t RGB2Hue(std::uint8_t R, std::uint8_t G, std::uint8_t B);
+
+        /// @brief  Get the index of a colour in the hue table, each channel is quantised to 5 bits.
+        /// @param  R - Value for the red channel.
+        /// @param  G - Value for the green channel.
+        /// @param  B - Value for the blue channel.
+        /// @return The index of the colour in the hue table.
+        static std::size_t GetHueIndex(std::uint8_t R, std::uint8_t G, std::uint8_t B);
+
+        /// @brief  Get the table of precomputed hues for every quantised RGB colour.
+        /// @return The hue table, built on first use.
+        static const std::array<std::uint8_t, 32768>& GetHueTable(void);
     };
 }
 